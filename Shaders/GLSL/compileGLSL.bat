@@ -2,5 +2,15 @@ echo Current directory is %cd%
 C:/VulkanSDK/1.3.280.0/Bin/glslc.exe shader.vert -o   ../Compiled/GLSL/vert.spv
 C:/VulkanSDK/1.3.280.0/Bin/glslc.exe shader.frag -o   ../Compiled/GLSL/frag.spv
 C:/VulkanSDK/1.3.280.0/Bin/glslc.exe particle.comp -o ../Compiled/GLSL/particle.spv
+C:/VulkanSDK/1.3.280.0/Bin/glslc.exe downsample.comp --target-env=vulkan1.1 -DFORMAT=rgba8 -DUSE_SUBGROUP_QUAD -o ../Compiled/GLSL/downsample_rgba8.spv
+C:/VulkanSDK/1.3.280.0/Bin/glslc.exe downsample.comp -DFORMAT=rgba8 -o ../Compiled/GLSL/downsample_rgba8_noquad.spv
+C:/VulkanSDK/1.3.280.0/Bin/glslc.exe downsample.comp --target-env=vulkan1.1 -DFORMAT=rgba8_snorm -DUSE_SUBGROUP_QUAD -o ../Compiled/GLSL/downsample_rgba8_snorm.spv
+C:/VulkanSDK/1.3.280.0/Bin/glslc.exe downsample.comp -DFORMAT=rgba8_snorm -o ../Compiled/GLSL/downsample_rgba8_snorm_noquad.spv
+C:/VulkanSDK/1.3.280.0/Bin/glslc.exe downsample.comp --target-env=vulkan1.1 -DFORMAT=r32f -DUSE_SUBGROUP_QUAD -o ../Compiled/GLSL/downsample_r32f.spv
+C:/VulkanSDK/1.3.280.0/Bin/glslc.exe downsample.comp -DFORMAT=r32f -o ../Compiled/GLSL/downsample_r32f_noquad.spv
+C:/VulkanSDK/1.3.280.0/Bin/glslc.exe downsample.comp --target-env=vulkan1.1 -DFORMAT=rg32f -DUSE_SUBGROUP_QUAD -o ../Compiled/GLSL/downsample_rg32f.spv
+C:/VulkanSDK/1.3.280.0/Bin/glslc.exe downsample.comp -DFORMAT=rg32f -o ../Compiled/GLSL/downsample_rg32f_noquad.spv
+C:/VulkanSDK/1.3.280.0/Bin/glslc.exe downsample.comp --target-env=vulkan1.1 -DFORMAT=rgba32f -DUSE_SUBGROUP_QUAD -o ../Compiled/GLSL/downsample_rgba32f.spv
+C:/VulkanSDK/1.3.280.0/Bin/glslc.exe downsample.comp -DFORMAT=rgba32f -o ../Compiled/GLSL/downsample_rgba32f_noquad.spv
 pause
 
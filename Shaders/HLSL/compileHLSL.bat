@@ -2,5 +2,15 @@ echo Current directory is %cd%
 C:/VulkanSDK/1.3.280.0/Bin/dxc.exe -T ps_6_0 -E main -spirv -fvk-use-dx-layout -fspv-target-env=vulkan1.0 -D VULKAN=1 -Fo ../Compiled/HLSL/frag.spv frag.hlsl
 C:/VulkanSDK/1.3.280.0/Bin/dxc.exe -T vs_6_0 -E main -spirv -fvk-use-dx-layout -fspv-target-env=vulkan1.0 -D VULKAN=1 -Fo ../Compiled/HLSL/vert.spv vert.hlsl
 C:/VulkanSDK/1.3.280.0/Bin/dxc.exe -T cs_6_0 -E main -spirv -fvk-use-dx-layout -fspv-target-env=vulkan1.0 -D VULKAN=1 -Fo ../Compiled/HLSL/particle.spv particle.hlsl 
+C:/VulkanSDK/1.3.280.0/Bin/dxc.exe -T cs_6_0 -E main -spirv -fvk-use-dx-layout -fspv-target-env=vulkan1.1 -D VULKAN=1 -D FORMAT=\"rgba8\" -D USE_SUBGROUP_QUAD=1 -Fo ../Compiled/HLSL/downsample_rgba8.spv downsample.hlsl
+C:/VulkanSDK/1.3.280.0/Bin/dxc.exe -T cs_6_0 -E main -spirv -fvk-use-dx-layout -fspv-target-env=vulkan1.0 -D VULKAN=1 -D FORMAT=\"rgba8\" -Fo ../Compiled/HLSL/downsample_rgba8_noquad.spv downsample.hlsl
+C:/VulkanSDK/1.3.280.0/Bin/dxc.exe -T cs_6_0 -E main -spirv -fvk-use-dx-layout -fspv-target-env=vulkan1.1 -D VULKAN=1 -D FORMAT=\"rgba8snorm\" -D USE_SUBGROUP_QUAD=1 -Fo ../Compiled/HLSL/downsample_rgba8_snorm.spv downsample.hlsl
+C:/VulkanSDK/1.3.280.0/Bin/dxc.exe -T cs_6_0 -E main -spirv -fvk-use-dx-layout -fspv-target-env=vulkan1.0 -D VULKAN=1 -D FORMAT=\"rgba8snorm\" -Fo ../Compiled/HLSL/downsample_rgba8_snorm_noquad.spv downsample.hlsl
+C:/VulkanSDK/1.3.280.0/Bin/dxc.exe -T cs_6_0 -E main -spirv -fvk-use-dx-layout -fspv-target-env=vulkan1.1 -D VULKAN=1 -D FORMAT=\"r32f\" -D USE_SUBGROUP_QUAD=1 -Fo ../Compiled/HLSL/downsample_r32f.spv downsample.hlsl
+C:/VulkanSDK/1.3.280.0/Bin/dxc.exe -T cs_6_0 -E main -spirv -fvk-use-dx-layout -fspv-target-env=vulkan1.0 -D VULKAN=1 -D FORMAT=\"r32f\" -Fo ../Compiled/HLSL/downsample_r32f_noquad.spv downsample.hlsl
+C:/VulkanSDK/1.3.280.0/Bin/dxc.exe -T cs_6_0 -E main -spirv -fvk-use-dx-layout -fspv-target-env=vulkan1.1 -D VULKAN=1 -D FORMAT=\"rg32f\" -D USE_SUBGROUP_QUAD=1 -Fo ../Compiled/HLSL/downsample_rg32f.spv downsample.hlsl
+C:/VulkanSDK/1.3.280.0/Bin/dxc.exe -T cs_6_0 -E main -spirv -fvk-use-dx-layout -fspv-target-env=vulkan1.0 -D VULKAN=1 -D FORMAT=\"rg32f\" -Fo ../Compiled/HLSL/downsample_rg32f_noquad.spv downsample.hlsl
+C:/VulkanSDK/1.3.280.0/Bin/dxc.exe -T cs_6_0 -E main -spirv -fvk-use-dx-layout -fspv-target-env=vulkan1.1 -D VULKAN=1 -D FORMAT=\"rgba32f\" -D USE_SUBGROUP_QUAD=1 -Fo ../Compiled/HLSL/downsample_rgba32f.spv downsample.hlsl
+C:/VulkanSDK/1.3.280.0/Bin/dxc.exe -T cs_6_0 -E main -spirv -fvk-use-dx-layout -fspv-target-env=vulkan1.0 -D VULKAN=1 -D FORMAT=\"rgba32f\" -Fo ../Compiled/HLSL/downsample_rgba32f_noquad.spv downsample.hlsl
 pause
 
@@ -0,0 +1,189 @@
+
+// Single pass downsampler, up to 12 mips in one dispatch.
+// Every workgroup reduces a 64x64 tile of the source down to mip 6, the last workgroup to finish (atomic counter)
+// reduces mip 6 down to mip 12. Compiled per storage format (FORMAT) and with/without quad operations
+// (USE_SUBGROUP_QUAD), both defined by compileHLSL.bat. Without them 2x2 blocks are reduced through groupshared memory.
+
+#ifndef FORMAT
+#define FORMAT "rgba8"
+#endif
+
+[[vk::constant_id(0)]] const uint REDUCTION = 0; // 0 average, 1 min, 2 max
+
+struct Constants
+{
+    uint2 srcSize;
+    uint numMips;
+    uint numWorkGroups;
+};
+
+[[vk::push_constant]] ConstantBuffer<Constants> pc;
+
+[[vk::binding(0)]] [[vk::image_format(FORMAT)]] RWTexture2D<float4> srcMip : register(u0);
+[[vk::binding(1)]] [[vk::image_format(FORMAT)]] RWTexture2D<float4> dstMips[12] : register(u1);
+[[vk::binding(2)]] [[vk::image_format(FORMAT)]] globallycoherent RWTexture2D<float4> mip6 : register(u2); // Same image as dstMips[5], read back by the last workgroup
+[[vk::binding(3)]] globallycoherent RWStructuredBuffer<uint> counter : register(u3);
+
+groupshared float4 tile[16][16];
+#ifndef USE_SUBGROUP_QUAD
+groupshared float4 quadScratch[256];
+#endif
+groupshared uint lastWorkGroup;
+
+float4 reduce4(float4 a, float4 b, float4 c, float4 d)
+{
+    if (REDUCTION == 1)
+        return min(min(a, b), min(c, d));
+    if (REDUCTION == 2)
+        return max(max(a, b), max(c, d));
+    return (a + b + c + d) * 0.25;
+}
+
+uint2 mipSize(uint mip)
+{
+    return max(pc.srcSize >> mip, uint2(1, 1));
+}
+
+void storeMip(uint mip, uint2 p, float4 value)
+{
+    if (any(p >= mipSize(mip)))
+        return;
+
+    if (mip == 6)
+        mip6[p] = value;
+    else
+        dstMips[mip - 1][p] = value;
+}
+
+float4 loadSource(bool fromMip6, uint2 p)
+{
+    if (fromMip6)
+        return mip6[min(p, mipSize(6) - 1)];
+
+    return srcMip[min(p, pc.srcSize - 1)];
+}
+
+// Lanes 4n..4n+3 hold a 2x2 block, reduces it across them. Has to be reached by the whole workgroup.
+float4 reduceQuad(float4 value, uint localIndex)
+{
+#ifdef USE_SUBGROUP_QUAD
+    const float4 horizontal = QuadReadAcrossX(value);
+    const float4 vertical = QuadReadAcrossY(value);
+    const float4 diagonal = QuadReadAcrossDiagonal(value);
+    return reduce4(value, horizontal, vertical, diagonal);
+#else
+    GroupMemoryBarrierWithGroupSync();
+    quadScratch[localIndex] = value;
+    GroupMemoryBarrierWithGroupSync();
+
+    const uint base = localIndex & ~3u;
+    return reduce4(quadScratch[base], quadScratch[base + 1], quadScratch[base + 2], quadScratch[base + 3]);
+#endif
+}
+
+// 16x16 threads, 2x2 blocks of them in consecutive lanes so quad operations line up with texels
+uint2 remapThread(uint localIndex)
+{
+    const uint a = localIndex % 64;
+    const uint2 inner = uint2((((a >> 2) & 7) & ~1u) | (a & 1), (((a >> 3) & 7) & ~3u) | ((a >> 1) & 3));
+    return inner + uint2(8 * ((localIndex >> 6) % 2), 8 * (localIndex >> 7));
+}
+
+// Source tile of 64x64 down to mip firstMip (32x32) and firstMip + 1 (16x16), the latter is left in tile
+void downsampleFirstTwo(bool fromMip6, uint firstMip, uint2 workGroup, uint localIndex)
+{
+    const uint2 xy = remapThread(localIndex);
+
+    float4 values[4];
+    for (uint i = 0; i < 4; i++) {
+        const uint2 p = workGroup * 32 + xy + uint2(i % 2, i / 2) * 16;
+        // Past the edge the edge texel repeats, the next level then clamps the way a 2x2 box over the mip would
+        const uint2 c = min(p, mipSize(firstMip) - 1);
+        values[i] = reduce4(loadSource(fromMip6, c * 2), loadSource(fromMip6, c * 2 + uint2(1, 0)),
+            loadSource(fromMip6, c * 2 + uint2(0, 1)), loadSource(fromMip6, c * 2 + uint2(1, 1)));
+        storeMip(firstMip, p, values[i]);
+    }
+
+    if (pc.numMips <= firstMip)
+        return;
+
+    for (uint j = 0; j < 4; j++)
+        values[j] = reduceQuad(values[j], localIndex);
+
+    if (localIndex % 4 == 0) {
+        for (uint k = 0; k < 4; k++) {
+            const uint2 p = xy / 2 + uint2(k % 2, k / 2) * 8;
+            storeMip(firstMip + 1, workGroup * 16 + p, values[k]);
+            tile[p.y][p.x] = values[k];
+        }
+    }
+
+    GroupMemoryBarrierWithGroupSync();
+}
+
+// Halves what's in tile, size is that of the output
+void downsampleTile(uint mip, uint size, uint2 workGroup, uint localIndex)
+{
+    const uint2 p = uint2(localIndex % size, localIndex / size);
+    const bool active = localIndex < size * size;
+
+    // Last texel of the level above that's inside the image, in tile coordinates
+    const int2 last = clamp(int2(mipSize(mip - 1)) - 1 - int2(workGroup * size * 2), int2(0, 0), int2(size * 2 - 1, size * 2 - 1));
+    const uint2 p0 = uint2(min(int2(p * 2), last));
+    const uint2 p1 = uint2(min(int2(p * 2 + 1), last));
+
+    float4 value = float4(0.0, 0.0, 0.0, 0.0);
+    if (active)
+        value = reduce4(tile[p0.y][p0.x], tile[p0.y][p1.x], tile[p1.y][p0.x], tile[p1.y][p1.x]);
+
+    GroupMemoryBarrierWithGroupSync();
+
+    if (active) {
+        tile[p.y][p.x] = value;
+        storeMip(mip, workGroup * size + p, value);
+    }
+
+    GroupMemoryBarrierWithGroupSync();
+}
+
+void downsampleRest(uint firstMip, uint2 workGroup, uint localIndex)
+{
+    uint size = 8;
+    for (uint mip = firstMip; mip < firstMip + 4 && mip <= pc.numMips; mip++) {
+        downsampleTile(mip, size, workGroup, localIndex);
+        size /= 2;
+    }
+}
+
+[numthreads(256, 1, 1)]
+void main(uint localIndex : SV_GroupIndex, uint3 groupId : SV_GroupID)
+{
+    const uint2 workGroup = groupId.xy;
+
+    downsampleFirstTwo(false, 1, workGroup, localIndex);
+    if (pc.numMips <= 2)
+        return;
+
+    downsampleRest(3, workGroup, localIndex);
+    if (pc.numMips <= 6)
+        return;
+
+    // Mip 6 of every workgroup has to be visible before the counter says so
+    DeviceMemoryBarrier();
+    if (localIndex == 0)
+        InterlockedAdd(counter[0], 1, lastWorkGroup);
+    GroupMemoryBarrierWithGroupSync();
+
+    if (lastWorkGroup != pc.numWorkGroups - 1)
+        return;
+
+    // Back to 0 for the next dispatch
+    if (localIndex == 0)
+        counter[0] = 0;
+
+    downsampleFirstTwo(true, 7, uint2(0, 0), localIndex);
+    if (pc.numMips <= 8)
+        return;
+
+    downsampleRest(9, uint2(0, 0), localIndex);
+}
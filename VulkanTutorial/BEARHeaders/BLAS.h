@@ -26,6 +26,10 @@ public:
 		const std::string& name = "default_blas_name");
 	~BLAS();
 	void Update();
+
+	// Diverged from OG BEAR. Without ray tracing on the device a BLAS is created empty and never built.
+	static bool IsSupported();
+
 	// Getter
 	const GPUBlasHandle& GetBLASRef() const { return m_BLASHandle; }
 
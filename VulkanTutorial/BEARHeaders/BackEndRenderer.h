@@ -1,5 +1,7 @@
 #pragma once
 #include <cstdint>
+#include <memory>
+#include <vector>
 
 #define GLFW_INCLUDE_VULKAN
 
@@ -14,9 +16,12 @@ class BackEndRenderer
 {
 public:
 	BackEndRenderer();
-	~BackEndRenderer() {};
+	~BackEndRenderer();
 
 	void Initialize(GLFWwindow* window, Texture** mainRenderTargets, CommandList* cmdList);
+	// Diverged from OG BEAR. No window, surface or swapchain, frames are rendered into a ring of offscreen
+	// render targets instead, one per frame in flight. Neither GLFW nor ImGui are initialized.
+	void InitializeHeadless(uint32_t width, uint32_t height);
 	void BeginFrame();
 	void EndFrame();
 	void Shutdown();
@@ -29,14 +34,22 @@ public:
 
 	// Gets the ID of the current Render Target
 	uint32_t GetCurrentBackBufferIndex() const;
+	// Diverged from OG BEAR. The render target of that ID when headless, nullptr otherwise.
+	Texture* GetOffscreenTarget(uint32_t index) const;
 
 	void PresentFrame();
 	void WaitForCmdQueueExecute();
 
+	// Destroys retired resources that no frame in flight can reference anymore.
+	// Call after waiting on the fence of the current frame.
+	void ReleaseRetiredResources(); // Diverged from OG BEAR
+
 	uint32_t GetFrameIndex() const { return m_FrameIndex; }
 	uint32_t GetFrameCounter() const { return m_FrameCounter; }
 
 private:
-	uint32_t m_FrameIndex;
-	uint32_t m_FrameCounter;
+	uint32_t m_FrameIndex = 0;
+	uint32_t m_FrameCounter = 0;
+
+	std::vector<std::unique_ptr<Texture>> m_OffscreenTargets; // Headless only
 };
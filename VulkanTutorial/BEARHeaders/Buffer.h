@@ -1,5 +1,8 @@
 #pragma once
+#include <cstdint>
+#include <functional>
 #include <string>
+#include "BEARHeaders/Callsite.h"
 #include "BEARVulkan/TypeDefs.h"
 
 
@@ -16,6 +19,8 @@ enum class BufferFlags : unsigned int
 	// regularly updated
 	VERTEX_BUFFER = 1 << 7, 
 	INDEX_BUFFER = 1 << 8,  // Diverged from OG BEAR
+	READBACK_HEAP = 1 << 9, // Readback heap is written by the GPU and read by the CPU, used for getting results back
+	// Diverged from OG BEAR
 };
 
 // Enable bitwise operations on the BufferFlags enum
@@ -29,6 +34,10 @@ inline BufferFlags operator&(BufferFlags a, BufferFlags b)
 	return static_cast<BufferFlags>(static_cast<int>(a) & static_cast<int>(b));
 }
 
+// Writes elements [firstElement, firstElement + numElements) to destination, which points straight into mapped memory:
+// the buffer itself when it's host visible, the staging window otherwise. Called in order, every element exactly once.
+using BufferGenerator = std::function<void(void* destination, uint64_t firstElement, uint64_t numElements)>; // Diverged from OG BEAR
+
 class Buffer
 {
 public:
@@ -36,7 +45,11 @@ public:
 
 	// Constructing a Buffer from CPU Data
 	Buffer(const void* data, const size_t stride, const size_t count, BufferFlags flags = BufferFlags::NONE,
-		const std::string& name = "default_name");
+		const std::string& name = "default_name", const Callsite& callsite = Callsite::Current()); // Callsite diverged from OG BEAR
+
+	// Constructing a Buffer from a generator, the data never exists anywhere but in mapped memory
+	Buffer(const size_t stride, const size_t count, const BufferGenerator& generator, BufferFlags flags = BufferFlags::NONE,
+		const std::string& name = "default_name", const Callsite& callsite = Callsite::Current()); // Diverged from OG BEAR
 
 	~Buffer();
 
@@ -44,26 +57,42 @@ public:
 	Buffer(const Buffer&) = delete;
 	Buffer& operator=(const Buffer&) = delete;
 
-	// Explicitly define move constructor and move assignment operator as it mirrors GPU resource
-	Buffer(Buffer&& other) noexcept {}
-	Buffer& operator=(Buffer&& other) noexcept {
-		return *this;
-	}
+	// Moving transfers ownership of the GPU resource, the moved-from Buffer is left empty
+	Buffer(Buffer&& other) noexcept;
+	Buffer& operator=(Buffer&& other) noexcept;
 
 
-	uint32_t GetNumElements() const { return m_Count; }
+	uint64_t GetNumElements() const { return m_Count; }
 	uint32_t GetStride() const { return m_Stride; } // in Bytes
-	uint32_t GetSizeBytes() const { return m_Count * m_Stride; } // in Bytes
+	uint64_t GetSizeBytes() const { return m_Count * m_Stride; } // in Bytes
 	std::string GetName() const { return m_Name; }
 	BufferFlags GetFlags() const { return m_Flags; }
 	GPUBufferHandle& GetGPUHandleRef() { return m_BufferHandle; }
+	// Writes from the start of the buffer and flushes right away
 	void UpdateData(const void* data, size_t dataSizeInBytes);
 
+	// Writes a sub-range. For mapped non-coherent memory the write is only recorded, call Flush() before the GPU reads it.
+	// Buffers the CPU can't map only get the changed bytes streamed through the staging window, the copy is ordered
+	// after frames already submitted and before the ones recorded after it, so in flight frames can't see a torn update.
+	void UpdateRange(uint64_t offsetInBytes, const void* data, uint64_t dataSizeInBytes); // Diverged from OG BEAR
+
+	// Flushes all coalesced dirty ranges in a single call, no-op for coherent memory
+	void Flush(); // Diverged from OG BEAR
+
+	// Only for host visible buffers (READBACK_HEAP / UPLOAD_HEAP). Make sure the GPU is done writing first.
+	void ReadData(void* destination, size_t dataSizeInBytes, size_t offsetInBytes = 0); // Diverged from OG BEAR
+
 private:
+	// Creates the VkBuffer and its memory, shared by the constructors
+	void CreateBuffer(const size_t stride, const size_t count, BufferFlags flags, const std::string& name, const Callsite& callsite, bool initialData);
+
+	// Hands the GPU resource to the retire queue, it's destroyed once no frame in flight uses it
+	void Release();
+
 	GPUBufferHandle m_BufferHandle;
 	std::string m_Name = "DEFAULT_NAME_FOR_BUFFER";
 	uint32_t m_Stride = 0;
-	uint32_t m_Count = 0;
+	uint64_t m_Count = 0;
 	BufferFlags m_Flags = BufferFlags::NONE;
 };
 
@@ -0,0 +1,12 @@
+#pragma once
+
+// Where a resource was created from, shows up in the GPU memory registry. Diverged from OG BEAR
+// Default arguments are evaluated by the caller, so a `Callsite callsite = Callsite::Current()` parameter records
+// whoever called the function. Code that constructs through a ResourcePool passes Callsite::Current() explicitly.
+struct Callsite
+{
+	const char* m_File = "unknown";
+	int m_Line = 0;
+
+	static Callsite Current(const char* file = __builtin_FILE(), int line = __builtin_LINE()) { return { file, line }; }
+};
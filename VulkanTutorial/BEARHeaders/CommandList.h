@@ -1,14 +1,29 @@
 #pragma once
+#include <cstdint>
+#include <memory>
+
+#include "BEARHeaders/Texture.h"
 #include "BEARVulkan/TypeDefs.h"
 
 
 class Buffer;
-class Texture;
 class ComputePipelineDescription;
 class SamplerDescriptorHeap;
 class ResourceDescriptorHeap;
 class TLAS;
 
+// Handed out by ReadbackAsync. The data is ready once the command list it was recorded in has finished on
+// the GPU, and stays available until that frame slot gets recorded into again (g_MaxFramesInFlight frames).
+struct ReadbackTicket
+{
+	uint32_t m_FrameSlot = UINT32_MAX;
+	uint64_t m_Submission = 0;
+	uint64_t m_Offset = 0; // Into the readback ring of the frame slot
+	uint64_t m_Size = 0;
+
+	bool IsValid() const { return m_FrameSlot != UINT32_MAX; }
+};
+
 class CommandList
 {
 public:
@@ -37,7 +52,29 @@ public:
 
 	// Copy of Resources
 	void CopyResource(Buffer& bufferDst, Buffer& bufferSrc); // Buffers should have the same size
-	void CopyResource(Texture& textureDst, Texture& textureSrc); // Textures should have same size and format
+	// Textures should have same size and format. The layouts are where each one is at, they're put back there after the copy.
+	void CopyResource(Texture& textureDst, Texture& textureSrc, TextureLayout dstLayout = TextureLayout::SHADER_READ, TextureLayout srcLayout = TextureLayout::SHADER_READ);
+
+	// Rebuilds mips 1 and up from mip 0 on the GPU, for textures created with TextureFlags::MIPMAP_COMPUTE.
+	// Uses the texture's MipReduction, one dispatch per 12 mips. layout is where mip 0 is at, e.g. RENDER_TARGET right
+	// after rendering into it. The other mips are overwritten whatever they're in, all of them end up in SHADER_READ.
+	void GenerateMips(Texture& texture, TextureLayout layout = TextureLayout::SHADER_READ); // Diverged from OG BEAR
+
+	// Inline update through vkCmdUpdateBuffer, ordered with the rest of the command list. Only the given bytes
+	// cross the bus. Offset and size must be multiples of 4, size at most 65536 - use Buffer::UpdateRange otherwise.
+	void UpdateBuffer(Buffer& buffer, uint64_t offsetInBytes, const void* data, uint64_t sizeInBytes); // Diverged from OG BEAR
+
+	// Asynchronous GPU -> CPU readback, recorded into this command list. Never stalls.
+	// Returns an invalid ticket if the readback ring of this frame is full.
+	ReadbackTicket ReadbackAsync(Buffer& buffer, uint64_t offsetInBytes = 0, uint64_t sizeInBytes = UINT64_MAX); // Diverged from OG BEAR
+	// Tightly packed rows (of 4x4 blocks for BCn), the mip is read from and put back in layout. Diverged from OG BEAR
+	ReadbackTicket ReadbackAsync(Texture& texture, uint32_t mipLevel = 0, TextureLayout layout = TextureLayout::SHADER_READ);
+
+	// True once the GPU is done with the copy, false while pending or once the data has been overwritten
+	bool IsReadbackReady(const ReadbackTicket& ticket) const;
+
+	// Copies the data out if it's ready, returns false otherwise
+	bool GetReadbackData(const ReadbackTicket& ticket, void* destination);
 
 	// Sync Functions
 	void Begin(uint32_t test);
@@ -57,7 +94,18 @@ public:
 	
 
 private:
+	// Reserves space in the readback ring of the current frame slot, UINT64_MAX if it's full
+	uint64_t AllocateReadback(uint64_t sizeInBytes);
+
 	uint32_t m_FrameIndex = 0;
 	GPUCommandListHandle m_CmdListHandle;
+
+	// Readback ring, one host cached buffer per frame slot - created on first use
+	std::unique_ptr<Buffer> m_ReadbackBuffers[wVkConstants::g_MaxFramesInFlight];
+	uint64_t m_ReadbackOffset = 0;
+
+	// Which submission each frame slot holds, used to tell if a ticket is ready or outdated
+	uint64_t m_SubmissionCounter = 0;
+	uint64_t m_SlotSubmission[wVkConstants::g_MaxFramesInFlight] = {};
 };
 
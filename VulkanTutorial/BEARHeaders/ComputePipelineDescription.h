@@ -9,10 +9,18 @@ class ComputePipelineDescription
 {
 public:
 	ComputePipelineDescription() = default;
-	~ComputePipelineDescription() = default;
+	~ComputePipelineDescription();
+
+	// Delete copy constructor and copy assignment operator as it mirrors GPU resource
+	ComputePipelineDescription(const ComputePipelineDescription&) = delete;
+	ComputePipelineDescription& operator=(const ComputePipelineDescription&) = delete;
+
+	// Moving transfers ownership of the GPU resource, the moved-from pipeline is left empty
+	ComputePipelineDescription(ComputePipelineDescription&& other) noexcept;
+	ComputePipelineDescription& operator=(ComputePipelineDescription&& other) noexcept;
 
 	void Initialize(const std::string& shaderName, ShaderLayout& layout);
-	void Destroy(); //Deviated from OG BEAR
+	void Destroy(); //Deviated from OG BEAR - Retires the pipeline, safe to call while frames are in flight
 
 	GPUComputePipelineHandle& GetPipelineHandleRef() { return m_PipelineHandle; }
 	ShaderLayout GetShaderLayout() const { return m_ShaderLayout; }
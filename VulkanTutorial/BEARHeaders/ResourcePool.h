@@ -0,0 +1,143 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <optional>
+#include <utility>
+#include <vector>
+
+#include "Utils/ConsoleLogger.h"
+
+class Buffer;
+class Texture;
+class Sampler;
+class ComputePipelineDescription;
+
+// Generational handle to a resource owned by a ResourcePool.
+// The generation is bumped every time a slot is freed, so a handle to a destroyed
+// resource can never silently resolve to whatever gets placed in its slot afterwards.
+template <typename T>
+struct ResourceHandle
+{
+	uint32_t m_Index = UINT32_MAX;
+	uint32_t m_Generation = 0;
+
+	bool IsValid() const { return m_Index != UINT32_MAX; }
+
+	bool operator==(const ResourceHandle& other) const { return m_Index == other.m_Index && m_Generation == other.m_Generation; }
+	bool operator!=(const ResourceHandle& other) const { return !(*this == other); }
+};
+
+typedef ResourceHandle<Buffer> BufferHandle;
+typedef ResourceHandle<Texture> TextureHandle;
+typedef ResourceHandle<Sampler> SamplerHandle;
+typedef ResourceHandle<ComputePipelineDescription> ComputePipelineHandle;
+
+// Owns resources and hands out generational handles to them.
+// Slots live in a deque so a resource never changes address while it's alive, descriptor caches
+// key on the resource address. Destroying a resource runs its destructor right away, the GPU objects
+// behind it are retired (see wVkRetireQueue) and only freed once no frame in flight can use them.
+template <typename T>
+class ResourcePool
+{
+public:
+	ResourcePool() = default;
+	~ResourcePool() = default;
+
+	ResourcePool(const ResourcePool&) = delete;
+	ResourcePool& operator=(const ResourcePool&) = delete;
+
+	template <typename... Args>
+	ResourceHandle<T> Create(Args&&... args)
+	{
+		uint32_t index;
+		if (!m_FreeSlots.empty())
+		{
+			index = m_FreeSlots.back();
+			m_FreeSlots.pop_back();
+		}
+		else
+		{
+			index = static_cast<uint32_t>(m_Slots.size());
+			m_Slots.emplace_back();
+		}
+
+		Slot& slot = m_Slots[index];
+		slot.m_Resource.emplace(std::forward<Args>(args)...);
+		m_NumAlive++;
+
+		return ResourceHandle<T>{ index, slot.m_Generation };
+	}
+
+	// Adopts an already constructed resource
+	ResourceHandle<T> Adopt(T&& resource) { return Create(std::move(resource)); }
+
+	// Returns nullptr for invalid or stale handles
+	T* Get(const ResourceHandle<T>& handle)
+	{
+		if (handle.m_Index >= m_Slots.size())
+			return nullptr;
+
+		Slot& slot = m_Slots[handle.m_Index];
+		if (slot.m_Generation != handle.m_Generation || !slot.m_Resource.has_value())
+			return nullptr;
+
+		return &slot.m_Resource.value();
+	}
+
+	T& operator[](const ResourceHandle<T>& handle)
+	{
+		T* resource = Get(handle);
+		ASSERT(resource != nullptr, "Invalid or stale resource handle [index %i, generation %i]", static_cast<int>(handle.m_Index), static_cast<int>(handle.m_Generation));
+		return *resource;
+	}
+
+	bool IsAlive(const ResourceHandle<T>& handle) { return Get(handle) != nullptr; }
+
+	// Destroys the resource and invalidates the handle
+	void Destroy(ResourceHandle<T>& handle)
+	{
+		if (Get(handle) == nullptr)
+		{
+			handle = {};
+			return;
+		}
+
+		Slot& slot = m_Slots[handle.m_Index];
+		slot.m_Resource.reset();
+		slot.m_Generation++;
+		m_FreeSlots.push_back(handle.m_Index);
+		m_NumAlive--;
+
+		handle = {};
+	}
+
+	void DestroyAll()
+	{
+		for (uint32_t i = 0; i < m_Slots.size(); i++)
+		{
+			Slot& slot = m_Slots[i];
+			if (!slot.m_Resource.has_value())
+				continue;
+
+			slot.m_Resource.reset();
+			slot.m_Generation++;
+			m_FreeSlots.push_back(i);
+		}
+
+		m_NumAlive = 0;
+	}
+
+	uint32_t GetNumAlive() const { return m_NumAlive; }
+
+private:
+	struct Slot
+	{
+		std::optional<T> m_Resource;
+		uint32_t m_Generation = 0;
+	};
+
+	std::deque<Slot> m_Slots;
+	std::vector<uint32_t> m_FreeSlots;
+	uint32_t m_NumAlive = 0;
+};
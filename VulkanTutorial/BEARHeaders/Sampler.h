@@ -109,6 +109,13 @@ struct SamplerState
 	MinFilter MinFilter;
 	MagFilter MagFilter;
 	WrapUV WrapUV;
+
+	// Diverged from OG BEAR. Samplers are shared by state, these are part of it too.
+	// Anisotropy is clamped to what the device supports, 1 turns it off.
+	float MaxAnisotropy = 16.0f;
+	float MipLodBias = 0.0f;
+	float MinLod = 0.0f;
+	float MaxLod = 1000.0f; // No clamp
 };
 
 // Define a generic GPU sampler class
@@ -120,16 +127,16 @@ public:
 	~Sampler();
 
 	Sampler(MinFilter minFilter, MagFilter magFilter, WrapUV wrapUV);
+	// Diverged from OG BEAR. Samplers with the same state share one VkSampler, see wVkSamplerCache.
+	explicit Sampler(const SamplerState& state);
 
 	// Delete copy constructor and copy assignment operator as it mirrors GPU resource
 	Sampler(const Sampler&) = delete;
 	Sampler& operator=(const Sampler&) = delete;
 
-	// Explicitly define move constructor and move assignment operator as it mirrors GPU resource
-	Sampler(Sampler&& other) noexcept {}
-	Sampler& operator=(Sampler&& other) noexcept {
-		return *this;
-	}
+	// Moving transfers ownership of the GPU resource, the moved-from Sampler is left empty
+	Sampler(Sampler&& other) noexcept;
+	Sampler& operator=(Sampler&& other) noexcept;
 
 
 	GPUSamplerHandle GetGPUHandle() const { return m_SamplerHandle; }
@@ -137,6 +144,9 @@ public:
 	SamplerState GetSamplerState() const { return m_SamplerState; }
 
 private:
+	// Drops our reference, the shared sampler is retired once nothing holds one anymore
+	void Release();
+
 	GPUSamplerHandle m_SamplerHandle;
 	SamplerState m_SamplerState;
 };
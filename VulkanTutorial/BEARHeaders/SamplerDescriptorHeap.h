@@ -10,11 +10,16 @@ class SamplerDescriptorHeap
 {
 public:
 	SamplerDescriptorHeap() = default;
-	~SamplerDescriptorHeap() = default;
+	~SamplerDescriptorHeap();
+
+	// Delete copy constructor and copy assignment operator as it mirrors GPU resource
+	SamplerDescriptorHeap(const SamplerDescriptorHeap&) = delete;
+	SamplerDescriptorHeap& operator=(const SamplerDescriptorHeap&) = delete;
 
 	void Initialize(int maxNumberResources);
 
-	// Pushes a sampler to the heap
+	// Pushes a sampler to the heap. Diverged from OG BEAR: a sampler that's already in it isn't placed again,
+	// its existing index is returned. The heap holds its own reference, the Sampler can go away.
 	int AddSampler(Sampler& sampler);
 	// Switches a resource in the heap to the new one
 	void SwitchSampler(Sampler& newSampler, int heapID);
@@ -46,5 +51,7 @@ private:
 
 	// Array that stores the samplers with their sampling states
 	std::vector<SamplerState> m_SamplerStates;
+	std::vector<GPUSamplerHandle> m_Samplers; // Diverged from OG BEAR, the references the heap holds
+	GPUSamplerHandle m_FillerSampler; // Diverged from OG BEAR, in every slot nothing's been added to yet
 };
 
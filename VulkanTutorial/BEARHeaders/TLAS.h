@@ -16,6 +16,10 @@ public:
 	~TLAS();
 	void Update();
 
+	// Diverged from OG BEAR. Same as BLAS::IsSupported, an unsupported TLAS stays empty.
+	static bool IsSupported();
+
+
 	// Getters
 	const GPUTlasDescHandle& GetTLASRef() const { return m_TLAS; }
 	glm::mat4& GetInstanceTransformRef(const uint32_t id) const;
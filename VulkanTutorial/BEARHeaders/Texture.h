@@ -1,6 +1,7 @@
 #pragma once
 #include <string>
 
+#include "BEARHeaders/Callsite.h"
 #include "BEARVulkan/TypeDefs.h"
 
 enum class TextureFormat
@@ -11,6 +12,20 @@ enum class TextureFormat
 	R32_FLOAT,
 	R32_G32_FLOAT,
 	R32_G32_B32_A32_FLOAT,
+	R16_FLOAT, // Diverged from OG BEAR. Half floats, HDR data at half the memory of the 32 bit formats.
+	R16_G16_FLOAT, // Diverged from OG BEAR
+	R16_G16_B16_A16_FLOAT, // Diverged from OG BEAR
+
+	// Diverged from OG BEAR. Block compressed, created from RGBA8 texels that are encoded on the CPU (wVkBlockEncoder).
+	// Only for R_TEXTURE, check IsFormatSupported first.
+	BC1_UNORM, // RGB + 1 bit alpha, 4 bits per texel
+	BC1_SRGB,
+	BC3_UNORM, // RGBA, 8 bits per texel
+	BC3_SRGB,
+	BC4_UNORM, // R, 4 bits per texel
+	BC5_UNORM, // RG, 8 bits per texel, e.g. normal maps
+	BC7_UNORM, // RGBA, 8 bits per texel, best quality of the lot
+	BC7_SRGB,
 	// New types will be added when needed
 };
 
@@ -18,7 +33,17 @@ enum class TextureFlags
 {
 	NONE = 0,
 	MIPMAP_GENERATE = 1 << 1,
-	ALLOW_UA = 1 << 2 // Will allow a DX12 texture to be writable in a shader
+	ALLOW_UA = 1 << 2, // Will allow a DX12 texture to be writable in a shader
+	STREAMED = 1 << 3, // Diverged from OG BEAR. Created without data, only a placeholder is resident until the texture streamer fills it in
+	MIPMAP_COMPUTE = 1 << 4, // Diverged from OG BEAR. Full mip chain built by the single pass compute downsampler, see CommandList::GenerateMips
+};
+
+// Diverged from OG BEAR. How MIPMAP_COMPUTE textures combine 2x2 texels into one, MIN/MAX are what a Hi-Z chain needs
+enum class MipReduction
+{
+	AVERAGE = 0,
+	MIN = 1,
+	MAX = 2,
 };
 
 enum class TextureType
@@ -28,6 +53,17 @@ enum class TextureType
 	RW_TEXTURE = 2,
 };
 
+// Diverged from OG BEAR. Textures rest in SHADER_READ between command lists. CommandList calls that touch one take the
+// layout it's in when the caller has moved it elsewhere in the same command list (rendered into it, wrote it as UAV).
+enum class TextureLayout
+{
+	SHADER_READ = 0,
+	RENDER_TARGET = 1,
+	UNORDERED_ACCESS = 2,
+	COPY_SOURCE = 3,
+	COPY_DEST = 4,
+};
+
 // Enable bitwise operations on the TextureFlags enum
 inline TextureFlags operator|(TextureFlags a, TextureFlags b)
 {
@@ -46,6 +82,7 @@ struct TextureSpec
 	TextureFormat m_Format;
 	TextureType m_Type;
 	TextureFlags m_Flags;
+	MipReduction m_MipReduction = MipReduction::AVERAGE; // Diverged from OG BEAR
 };
 
 class Texture
@@ -54,25 +91,31 @@ public:
 	Texture() = default;
 
 	// Constructing a texture from raw data
-	Texture(const void* data, TextureSpec spec, const std::string& name = "default_name");
+	Texture(const void* data, TextureSpec spec, const std::string& name = "default_name", const Callsite& callsite = Callsite::Current()); // Callsite diverged from OG BEAR
 
 	~Texture();
 
+	// Whether the device can sample textures of this format, the BCn formats are optional
+	static bool IsFormatSupported(TextureFormat format); // Diverged from OG BEAR
+
 	// Delete copy constructor and copy assignment operator as it mirrors GPU resource
 	Texture(const Texture&) = delete;
 	Texture& operator=(const Texture&) = delete;
 
-	// Explicitly define move constructor and move assignment operator as it mirrors GPU resource
-	Texture(Texture&& other) noexcept {}
-	Texture& operator=(Texture&& other) noexcept {
-		return *this;
-	}
+	// Moving transfers ownership of the GPU resource, the moved-from Texture is left empty
+	Texture(Texture&& other) noexcept;
+	Texture& operator=(Texture&& other) noexcept;
 
-	// Only works for RenderTarget - Windows
 	// Workaround for `ResizeFrameBuffers`
-	// ToDo : For PS5 (all) and Windows (R and RW Tex).
+	// Diverged from OG BEAR. Works for every texture that isn't streamed, the texels are undefined after a resize.
+	// The memory is reused when the new size fits in it.
 	void ResizeTexture(int newWidth, int newHeight);
+	// All of mip 0, laid out like the data the texture was created with. The other mips are rebuilt on the GPU.
 	void UpdateTexture(const void* data);
+	// Diverged from OG BEAR. Texels of a width x height region of one mip, rows tightly packed. Doesn't wait for the GPU and
+	// leaves the other mips alone, for textures that change every frame (video, CPU generated data).
+	// Neither works on block compressed or streamed textures.
+	void UpdateRegion(uint32_t mip, uint32_t x, uint32_t y, uint32_t width, uint32_t height, const void* data);
 
 	// Getters
 	std::string GetName() const { return m_Name; }
@@ -83,15 +126,21 @@ public:
 
 	int GetWidth() const { return m_Spec.m_Width; }
 	int GetHeight() const { return m_Spec.m_Height; }
+	uint32_t GetBytesPerPixel() const { return m_Channels * m_BytesPerChannel; } // 0 for block compressed formats
 
 	GPUTextureHandle& GetGPUHandleRef() { return m_TextureHandle; }
 
 private:
-	TextureSpec m_Spec;
+	// Hands the GPU resource to the retire queue, it's destroyed once no frame in flight uses it
+	void Release();
+	// Updated textures leave the residency manager, it would bring evicted mips back from a chain with the old texels
+	void DetachSourceMips();
+
+	TextureSpec m_Spec = {};
 	GPUTextureHandle m_TextureHandle = {};
 	uint32_t m_Channels = 0;
 
-	[[maybe_unused]] uint32_t m_SizeInBytes = 0;
+	[[maybe_unused]] uint64_t m_SizeInBytes = 0;
 	[[maybe_unused]] uint32_t m_BytesPerChannel = 1;
 
 	std::string m_Name;
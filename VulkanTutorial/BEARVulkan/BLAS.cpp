@@ -1,8 +1,11 @@
 #include "BEARHeaders/BLAS.h"
 
+#include "wVkGlobalVariables.h"
 
 BLAS::BLAS(const std::vector<BLASPrimitive*>& data, BlasQuality quality, const std::string& name)
 {
+	if (!IsSupported())
+		return;
 
 }
 
@@ -13,6 +16,12 @@ BLAS::~BLAS()
 
 void BLAS::Update()
 {
+	if (!IsSupported())
+		return;
 
 }
 
+bool BLAS::IsSupported()
+{
+	return wVkGlobals::g_DeviceCapabilities.m_RayTracing;
+}
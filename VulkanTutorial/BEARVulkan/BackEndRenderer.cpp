@@ -1,5 +1,8 @@
 #include "BEARHeaders/BackEndRenderer.h"
 
+#include <string>
+
+#include "BEARHeaders/Texture.h"
 #include "wVkGlobalVariables.h"
 #include "wVkHelpers/wVkCommands.h"
 #include "wVkHelpers/wVkImGui.h"
@@ -9,29 +12,29 @@
 #include "wVkHelpers/wVkTemp.h"
 #include "wVkHelpers/wVkTexture.h"
 #include "wVkHelpers/wVkHelpers.h"
+#include "Utils/ConsoleLogger.h"
 
 using namespace wVkGlobals;
 
+// The offscreen ring stands in for the swapchain, B8G8R8A8 isn't a TextureFormat so it's the RGBA equivalent
+constexpr TextureFormat OFFSCREEN_FORMAT = TextureFormat::R8G8B8A8_SRGB;
+constexpr VkFormat OFFSCREEN_VK_FORMAT = VK_FORMAT_R8G8B8A8_SRGB;
+
 BackEndRenderer::BackEndRenderer() {}
 
+BackEndRenderer::~BackEndRenderer() {}
+
 void destroySwapchain()
 {
 	if (g_SwapChain.swapChain != VK_NULL_HANDLE) {
 
 		for (const auto imageView : g_SwapChainImageViews) {
-			vkDestroyImageView(g_Device, imageView, nullptr);
+			vkDestroyImageView(g_Device, imageView, g_AllocationCallbacks);
 		}
-		vkDestroySwapchainKHR(g_Device, g_SwapChain.swapChain, nullptr);
-	}
-
-	for (auto& framebuffer : g_SwapChainFramebuffers) {
-		vkDestroyFramebuffer(g_Device, framebuffer, nullptr);
+		vkDestroySwapchainKHR(g_Device, g_SwapChain.swapChain, g_AllocationCallbacks);
 	}
 
-
-	vkDestroyImageView(g_Device, g_DepthImageView, nullptr);
-	vkDestroyImage(g_Device, g_DepthImage, nullptr);
-	vkFreeMemory(g_Device, g_DepthImageMemory, nullptr);
+	// Depth is a transient of the render graph, it follows the extent on its own
 }
 
 void createSwapchainData(GLFWwindow* window)
@@ -57,20 +60,60 @@ void createSwapchainData(GLFWwindow* window)
 	for (uint32_t i = 0; i < swapchainImage.size(); i++) {
 		swapchainViews[i] = wVkHelpers::createImageView(swapchainImage[i], 1, swapchain.swapChainImageFormat, VK_IMAGE_ASPECT_COLOR_BIT);
 	}
+}
 
-	const VkFormat depthFormat = wVkHelpers::findDepthFormat();
+// Headless counterpart of createSwapchainData, the swapchain globals point at the textures so frames are recorded the same way.
+// The views belong to the textures, destroySwapchain leaves them alone as there's no VkSwapchainKHR.
+void createOffscreenData(uint32_t width, uint32_t height, std::vector<std::unique_ptr<Texture>>& targets)
+{
+	destroySwapchain();
+	targets.clear();
+
+	// One per frame in flight, the fence of a frame slot is all that guards its target
+	const uint32_t numTargets = wVkConstants::g_MaxFramesInFlight;
 
-	const auto& ext = g_SwapChain.swapChainExtent;
-	wVkHelpers::createImage2D(ext.width, ext.height, 1, depthFormat, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, g_DepthImage, g_DepthImageMemory);
+	g_SwapChain.swapChain = VK_NULL_HANDLE;
+	g_SwapChain.swapChainImageFormat = OFFSCREEN_VK_FORMAT;
+	g_SwapChain.swapChainExtent = { width, height };
+	g_SwapChain.minImageCount = numTargets;
+	g_SwapChain.imageCount = numTargets;
 
-	g_DepthImageView = wVkHelpers::createImageView(g_DepthImage, 1, depthFormat, VK_IMAGE_ASPECT_DEPTH_BIT);
+	g_SwapChainImages.resize(numTargets);
+	g_SwapChainImageViews.resize(numTargets);
 
-	g_SwapChainFramebuffers.resize(g_SwapChainImageViews.size());
-	for (int i = 0; i < g_SwapChainImageViews.size(); i++) {
-		g_SwapChainFramebuffers[i] = wVkHelpers::createFramebuffer(i);
+	const TextureSpec spec = { static_cast<int>(width), static_cast<int>(height), OFFSCREEN_FORMAT, TextureType::RENDER_TARGET, TextureFlags::NONE };
+	for (uint32_t i = 0; i < numTargets; i++) {
+		targets.push_back(std::make_unique<Texture>(nullptr, spec, "Offscreen Target " + std::to_string(i), Callsite::Current()));
+
+		ASSERT(targets[i]->GetGPUHandleRef().m_Format == OFFSCREEN_VK_FORMAT, "Offscreen formats don't match");
+		g_SwapChainImages[i] = targets[i]->GetGPUHandleRef().m_TextureImage;
+		g_SwapChainImageViews[i] = targets[i]->GetGPUHandleRef().m_TextureImageView;
 	}
 }
 
+// Instance and surface have to exist
+void createDevice()
+{
+	g_PhysicalDevice = wVkHelpers::pickPhysicalDevice();
+	g_DeviceCapabilities = wVkHelpers::queryDeviceCapabilities(g_PhysicalDevice);
+
+	const wVkHelpers::QueueFamilyIndices queueIndices = wVkHelpers::findQueueFamilies(wVkGlobals::g_PhysicalDevice);
+	g_Device = createLogicalDevice(queueIndices);
+
+	vkGetDeviceQueue(g_Device, queueIndices.graphicsFamily.value(), 0, &g_GraphicsQueue);
+	vkGetDeviceQueue(g_Device, queueIndices.presentFamily.value(), 0, &g_PresentQueue);
+	vkGetDeviceQueue(g_Device, queueIndices.graphicsAndComputeFamily.value(), 0, &g_ComputeQueue);
+
+	// The defragmenter and the compute lists rely on submission order on one queue instead of semaphores
+	ASSERT(g_ComputeQueue == g_GraphicsQueue, "Graphics family %d and compute family %d have to share a queue",
+		static_cast<int>(queueIndices.graphicsFamily.value()), static_cast<int>(queueIndices.graphicsAndComputeFamily.value()));
+
+	g_RenderGraph.Initialize();
+
+	if (!g_DeviceCapabilities.m_RayTracing)
+		LOG_WARNING("The device has no ray tracing, BLAS and TLAS are left empty");
+}
+
 
 // ToDo, make this work with const uint32_t width, const uint32_t height, same comment as HWND
 void BackEndRenderer::ResizeFrameBuffers(GLFWwindow* window)
@@ -80,34 +123,58 @@ void BackEndRenderer::ResizeFrameBuffers(GLFWwindow* window)
 
 void BackEndRenderer::Initialize(GLFWwindow* window, Texture** mainRenderTargets, CommandList* cmdList)
 {
+	// Has to be picked before the instance exists, every object is destroyed with the callbacks it was created with
+	g_AllocationCallbacks = wVkConstants::g_UseTrackedHostAllocator ? g_HostAllocator.GetCallbacks() : nullptr;
 
 	g_Instance = wVkHelpers::createInstance();
 	g_DebugMessenger = wVkHelpers::setupDebugMessenger();
 
 	// Create Instance
 	// ToDo: Figure out how to do it from HWND for Ball
-	if (glfwCreateWindowSurface(g_Instance, window, nullptr, &g_Surface) != VK_SUCCESS) {
+	if (glfwCreateWindowSurface(g_Instance, window, g_AllocationCallbacks, &g_Surface) != VK_SUCCESS) {
 		throw std::runtime_error("failed to create window surface!");
 	}
 
-	g_PhysicalDevice = wVkHelpers::pickPhysicalDevice();
+	createDevice();
 
-	const wVkHelpers::QueueFamilyIndices queueIndices = wVkHelpers::findQueueFamilies(wVkGlobals::g_PhysicalDevice);
-	g_Device = createLogicalDevice(queueIndices);
-
-	vkGetDeviceQueue(g_Device, queueIndices.graphicsFamily.value(), 0, &g_GraphicsQueue);
-	vkGetDeviceQueue(g_Device, queueIndices.presentFamily.value(), 0, &g_PresentQueue);
-	vkGetDeviceQueue(g_Device, queueIndices.graphicsAndComputeFamily.value(), 0, &g_ComputeQueue);
-
-	g_RenderPass = wVkHelpers::createRenderPass();
 	createSwapchainData(window);
+	g_RenderingFormats = { { g_SwapChain.swapChainImageFormat }, wVkHelpers::findDepthFormat() };
 
 
 	g_CommandPool = wVkHelpers::createCommandPool();
+	g_UploadContext.Initialize();
+	g_Downsampler.Initialize();
+	g_MipBuilder.Initialize();
+	g_ImageDecoder.Initialize();
+
+	wVkHelpers::initImgui(window, g_RenderingFormats, g_ImguiPool);
 
-	wVkHelpers::initImgui(window, g_ImGuiRenderPass, g_ImguiPool);
 
+}
+
+void BackEndRenderer::InitializeHeadless(uint32_t width, uint32_t height)
+{
+	// Read by the helpers from here on, it decides which instance and device extensions are needed
+	g_Headless = true;
+
+	g_AllocationCallbacks = wVkConstants::g_UseTrackedHostAllocator ? g_HostAllocator.GetCallbacks() : nullptr;
+
+	g_Instance = wVkHelpers::createInstance();
+	g_DebugMessenger = wVkHelpers::setupDebugMessenger();
+
+	createDevice();
+
+	// The targets are Textures, they need the upload path before they can be made
+	g_CommandPool = wVkHelpers::createCommandPool();
+	g_UploadContext.Initialize();
+	g_Downsampler.Initialize();
+	g_MipBuilder.Initialize();
+	g_ImageDecoder.Initialize();
+
+	createOffscreenData(width, height, m_OffscreenTargets);
+	g_RenderingFormats = { { g_SwapChain.swapChainImageFormat }, wVkHelpers::findDepthFormat() };
 
+	LOG_INFO("Rendering headless at %i x %i", static_cast<int>(width), static_cast<int>(height));
 }
 
 void BackEndRenderer::EndTracing()
@@ -125,6 +192,8 @@ void BackEndRenderer::EndFrame()
 	m_FrameIndex = (m_FrameIndex + 1) % wVkConstants::g_MaxFramesInFlight;
 	m_FrameCounter++;
 
+	g_RetireQueue.AdvanceFrame();
+
 }
 
 void BackEndRenderer::BeginFrame()
@@ -140,35 +209,74 @@ void BackEndRenderer::PresentFrame()
 
 uint32_t BackEndRenderer::GetCurrentBackBufferIndex() const
 {
+	// Headless a frame slot always renders into its own target
+	if (g_Headless)
+		return m_FrameIndex;
+
 	return 0;
 }
 
+Texture* BackEndRenderer::GetOffscreenTarget(uint32_t index) const
+{
+	if (index >= m_OffscreenTargets.size())
+		return nullptr;
+
+	return m_OffscreenTargets[index].get();
+}
+
+void BackEndRenderer::ReleaseRetiredResources()
+{
+	// The fence of this frame slot was signaled, so the frame that used this slot last is done on the GPU
+	const uint64_t currentFrame = g_RetireQueue.GetCurrentFrame();
+	if (currentFrame < wVkConstants::g_MaxFramesInFlight)
+		return;
+
+	g_RetireQueue.Collect(currentFrame - wVkConstants::g_MaxFramesInFlight);
+}
+
 void BackEndRenderer::Shutdown()
 {
+	// Expects the GPU to be idle
 	destroySwapchain();
 
+	// Their images are retired, the flush below destroys them
+	m_OffscreenTargets.clear();
+	g_RenderGraph.Destroy();
+
+	g_RetireQueue.Flush();
+
 	// Shut Down ImGui
-	ImGui_ImplVulkan_Shutdown();
-	ImGui_ImplGlfw_Shutdown();
-	ImGui::DestroyContext();
+	if (!g_Headless) {
+		ImGui_ImplVulkan_Shutdown();
+		ImGui_ImplGlfw_Shutdown();
+		ImGui::DestroyContext();
 
-	vkDestroyDescriptorPool(g_Device, g_ImguiPool, nullptr);
-	vkDestroyRenderPass(g_Device, g_ImGuiRenderPass, nullptr);
+		vkDestroyDescriptorPool(g_Device, g_ImguiPool, g_AllocationCallbacks);
+	}
 
-	vkDestroyCommandPool(g_Device, g_CommandPool, nullptr);
+	g_TextureStreamer.Destroy();
+	g_ImageDecoder.Destroy();
+	g_MipBuilder.Destroy();
+	g_Downsampler.Destroy();
+	g_SamplerCache.Destroy();
+	g_UploadContext.Destroy();
+	g_DeviceAllocator.Destroy();
+	vkDestroyCommandPool(g_Device, g_CommandPool, g_AllocationCallbacks);
 
 	if (wVkConstants::enableValidationLayers) {
-		wVkHelpers::DestroyDebugUtilsMessengerEXT(g_Instance, g_DebugMessenger, nullptr);
+		wVkHelpers::DestroyDebugUtilsMessengerEXT(g_Instance, g_DebugMessenger, g_AllocationCallbacks);
 	}
 
-	vkDestroySurfaceKHR(g_Instance, g_Surface, nullptr);
-	vkDestroyRenderPass(g_Device, g_RenderPass, nullptr);
+	if (g_Surface != VK_NULL_HANDLE)
+		vkDestroySurfaceKHR(g_Instance, g_Surface, g_AllocationCallbacks);
 
 	
 
 	// Need to be last
-	vkDestroyDevice(g_Device, nullptr);
-	vkDestroyInstance(g_Instance, nullptr);
+	vkDestroyDevice(g_Device, g_AllocationCallbacks);
+	vkDestroyInstance(g_Instance, g_AllocationCallbacks);
+
+	g_HostAllocator.Destroy();
 }
 
 void BackEndRenderer::ImguiBeginFrame()
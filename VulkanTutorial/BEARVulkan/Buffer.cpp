@@ -1,43 +1,108 @@
 #include "BEARHeaders/Buffer.h"
 
 #include <stdexcept>
+#include <utility>
+#include <vector>
 
 #include "wVkGlobalVariables.h"
 #include "Utils/ConsoleLogger.h"
 #include "wVkHelpers/wVkTemp.h"
 
 
+// Host visible buffers are pinned. The CPU writes them through the new mapping as soon as a defragmentation step
+// returns, which would race the copy the step queued.
+wVkAllocationOwner GetAllocationOwner(wVkBuffer& handle)
+{
+	if ((handle.m_MemoryProperties & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) != 0)
+		return {};
+
+	return { &handle, nullptr };
+}
+
+wVkHelpers::wVkMemoryUsage DetermineMemoryUsage(BufferFlags flags)
+{
+	const bool uploadHeap = (flags & BufferFlags::UPLOAD_HEAP) == BufferFlags::UPLOAD_HEAP;
+	const bool defaultHeap = (flags & BufferFlags::DEFAULT_HEAP) == BufferFlags::DEFAULT_HEAP;
+	const bool readbackHeap = (flags & BufferFlags::READBACK_HEAP) == BufferFlags::READBACK_HEAP;
+
+	ASSERT(static_cast<int>(uploadHeap) + static_cast<int>(defaultHeap) + static_cast<int>(readbackHeap) <= 1, "Buffer with flags %i asks for more than one heap", static_cast<int>(flags));
+
+	if (readbackHeap)
+		return wVkHelpers::wVkMemoryUsage::GPU_TO_CPU;
+
+	if (uploadHeap)
+		return wVkHelpers::wVkMemoryUsage::CPU_TO_GPU;
+
+	if (defaultHeap)
+		return wVkHelpers::wVkMemoryUsage::GPU_ONLY;
+
+	// No heap specified, constant buffers get updated every frame, everything else is static
+	if ((flags & BufferFlags::CBV) == BufferFlags::CBV)
+		return wVkHelpers::wVkMemoryUsage::CPU_TO_GPU;
+
+	return wVkHelpers::wVkMemoryUsage::GPU_ONLY;
+}
+
+VkDeviceSize GetNonCoherentAtomSize()
+{
+	static VkDeviceSize atomSize = 0;
+	if (atomSize == 0) {
+		VkPhysicalDeviceProperties properties{};
+		vkGetPhysicalDeviceProperties(wVkGlobals::g_PhysicalDevice, &properties);
+		atomSize = properties.limits.nonCoherentAtomSize;
+	}
+
+	return atomSize;
+}
+
 Buffer::Buffer(const void* data, const size_t stride, const size_t count, BufferFlags flags,
-               const std::string& name)
+               const std::string& name, const Callsite& callsite)
 {
-	m_Name = name;
-	m_Stride = static_cast<uint32_t>(stride);
-	m_Count = static_cast<uint32_t>(count);
-	m_Flags = flags;
+	CreateBuffer(stride, count, flags, name, callsite, data != nullptr);
 
-	bool writeNow = true;
-	bool gpuOnly = false;
+	if (data != nullptr) {
+		UpdateData(data, GetSizeBytes());
+	}
+}
 
-	if (data == nullptr)
-	{
-		writeNow = false;
+Buffer::Buffer(const size_t stride, const size_t count, const BufferGenerator& generator, BufferFlags flags,
+               const std::string& name, const Callsite& callsite)
+{
+	CreateBuffer(stride, count, flags, name, callsite, true);
+
+	auto& handle = m_BufferHandle;
+	if (handle.m_MappedData != nullptr) {
+		generator(handle.m_MappedData, 0, m_Count);
+
+		if ((handle.m_MemoryProperties & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) == 0)
+			handle.m_DirtyRanges.Add(0, GetSizeBytes(), GetNonCoherentAtomSize());
+
+		Flush();
+		return;
 	}
 
+	// Chunks are cut on element boundaries, the generator fills the staging window directly
+	const VkDeviceSize elementStride = m_Stride;
+	wVkGlobals::g_UploadContext.UploadToBuffer(handle.m_Buffers, 0, GetSizeBytes(), elementStride, [&generator, elementStride](uint8_t* destination, VkDeviceSize offset, VkDeviceSize size)
+	{
+		generator(destination, offset / elementStride, size / elementStride);
+	});
+}
+
+void Buffer::CreateBuffer(const size_t stride, const size_t count, BufferFlags flags, const std::string& name, const Callsite& callsite, bool initialData)
+{
+	m_Name = name;
+	m_Stride = static_cast<uint32_t>(stride);
+	m_Count = static_cast<uint64_t>(count);
+	m_Flags = flags;
+
 	VkBufferUsageFlags usageFlags = 0;
-	VkMemoryPropertyFlags memoryFlags = 0;
 
-	// We always want to use it on the GPU;
-	usageFlags |= VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+	// We always want to be able to copy into and out of it (staging, readback)
+	usageFlags |= VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
 
 	if ((flags & (BufferFlags::CBV)) == (BufferFlags::CBV)) {
 		usageFlags |= VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT;
-		memoryFlags |= VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
-		gpuOnly = false;
-	}
-
-	if (((flags & (BufferFlags::SRV)) == BufferFlags::SRV) || (flags & (BufferFlags::UAV)) == BufferFlags::UAV) {
-		memoryFlags |= VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
-		gpuOnly = true;
 	}
 
 	if ((flags & (BufferFlags::VERTEX_BUFFER)) == (BufferFlags::VERTEX_BUFFER)) {
@@ -59,65 +124,173 @@ Buffer::Buffer(const void* data, const size_t stride, const size_t count, Buffer
 	// Buffer options:
 	// CBV = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT
 	// CBV = Push-Constant
-	// CBV = Host Coherent(as we will often update it)
-
-	// SRV = VK_BUFFER_USAGE_TRANSFER_DST_BIT
 
 	// UAV = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT
 
 	// VK_BUFFER_USAGE_INDEX_BUFFER_BIT 
 	// VK_BUFFER_USAGE_VERTEX_BUFFER_BIT 
 
-	const VkDeviceSize bufferSize = stride * count;
+	// Heap placement:
+	// DEFAULT_HEAP  = DEVICE_LOCAL, avoids HOST_VISIBLE. Gets staged unless the device is UMA
+	// UPLOAD_HEAP   = HOST_VISIBLE, prefers DEVICE_LOCAL (ReBAR / UMA) so the GPU reads it from VRAM
+	// READBACK_HEAP = HOST_VISIBLE, prefers HOST_CACHED for fast CPU reads
+	// No heap flag  = CBV goes to the upload heap, everything else to the default heap
+
+	const VkDeviceSize bufferSize = GetSizeBytes();
+	const wVkHelpers::wVkMemoryUsage memoryUsage = DetermineMemoryUsage(flags);
+	const wVkHelpers::wVkMemoryPolicy memoryPolicy = wVkHelpers::getMemoryPolicy(memoryUsage);
+
+	auto& handle = m_BufferHandle;
+	handle.m_Size = bufferSize;
+	handle.m_Usage = usageFlags;
+	handle.m_Buffers = wVkHelpers::createBufferObject(bufferSize, usageFlags);
+
+	VkMemoryRequirements memRequirements;
+	vkGetBufferMemoryRequirements(wVkGlobals::g_Device, handle.m_Buffers, &memRequirements);
 
-	// Both SRV and YAV flags are set - Buffer exclusively lives on GPU
-	if (gpuOnly) {
+	uint32_t heapIndex = 0;
+	handle.m_MemoryTypeIndex = wVkHelpers::findMemoryType(memRequirements.memoryTypeBits, memoryPolicy, memRequirements.size);
+	handle.m_MemoryProperties = wVkHelpers::getMemoryTypeProperties(handle.m_MemoryTypeIndex, &heapIndex);
+	handle.m_Allocation = wVkGlobals::g_DeviceAllocator.Allocate(memRequirements, handle.m_MemoryTypeIndex, wVkAllocationKind::LINEAR, GetAllocationOwner(handle));
+	vkBindBufferMemory(wVkGlobals::g_Device, handle.m_Buffers, handle.m_Allocation.m_Memory, handle.m_Allocation.m_Offset);
 
-		VkBuffer stagingBuffer;
-		VkDeviceMemory stagingBufferMemory;
-		wVkHelpers::createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory);
+	handle.m_RegistryId = wVkGlobals::g_ResourceRegistry.RegisterBuffer(handle.m_Buffers, handle.m_MemoryTypeIndex, bufferSize, wVkResourceType::BUFFER, m_Name, callsite);
 
-		void* bufferData;
-		vkMapMemory(wVkGlobals::g_Device, stagingBufferMemory, 0, bufferSize, 0, &bufferData);
-		memcpy(bufferData, data, bufferSize);
-		vkUnmapMemory(wVkGlobals::g_Device, stagingBufferMemory);
+	// Anything the CPU can see stays mapped, the allocator maps host visible blocks once
+	handle.m_MappedData = handle.m_Allocation.m_MappedData;
 
-		wVkHelpers::createBuffer(bufferSize, usageFlags, memoryFlags, m_BufferHandle.m_Buffers, m_BufferHandle.m_BuffersMemory);
+	const bool staged = initialData && handle.m_MappedData == nullptr;
 
-		wVkHelpers::copyBufferNewCmd(stagingBuffer, m_BufferHandle.m_Buffers, bufferSize);
+	LOG_INFO("Buffer \"%s\" (%s) -> %s, memory type %i [%s] on heap %i%s", m_Name.c_str(),
+		wVkHelpers::formatBytes(bufferSize).c_str(), wVkHelpers::getMemoryUsageName(memoryUsage),
+		static_cast<int>(handle.m_MemoryTypeIndex), wVkHelpers::memoryPropertiesToString(handle.m_MemoryProperties).c_str(),
+		static_cast<int>(heapIndex), staged ? ", staged" : "");
+}
+
+// Byte range [begin, end) of the buffer as a range of its memory block, rounded out to nonCoherentAtomSize.
+// Neighbouring allocations get flushed/invalidated along with it, which is harmless.
+VkMappedMemoryRange GetMappedRange(const wVkAllocation& allocation, VkDeviceSize begin, VkDeviceSize end, VkDeviceSize atomSize)
+{
+	const VkDeviceSize blockBegin = (allocation.m_Offset + begin) / atomSize * atomSize;
+	const VkDeviceSize blockEnd = (allocation.m_Offset + end + atomSize - 1) / atomSize * atomSize;
+
+	VkMappedMemoryRange range{};
+	range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+	range.memory = allocation.m_Memory;
+	range.offset = blockBegin;
+	range.size = blockEnd >= allocation.m_BlockSize ? VK_WHOLE_SIZE : blockEnd - blockBegin;
+	return range;
+}
+
+void Buffer::UpdateData(const void* data, size_t dataSizeInBytes)
+{
+	UpdateRange(0, data, dataSizeInBytes);
+	Flush();
+}
+
+void Buffer::UpdateRange(uint64_t offsetInBytes, const void* data, uint64_t dataSizeInBytes)
+{
+	ASSERT(offsetInBytes + dataSizeInBytes <= GetSizeBytes(), "Writing %s at offset %s into buffer \"%s\" of %s", wVkHelpers::formatBytes(dataSizeInBytes).c_str(),
+		wVkHelpers::formatBytes(offsetInBytes).c_str(), m_Name.c_str(), wVkHelpers::formatBytes(GetSizeBytes()).c_str());
 
-		vkDestroyBuffer(wVkGlobals::g_Device, stagingBuffer, nullptr);
-		vkFreeMemory(wVkGlobals::g_Device, stagingBufferMemory, nullptr);
+	if (dataSizeInBytes == 0)
+		return;
+
+	if (m_BufferHandle.m_MappedData != nullptr) {
+		memcpy(static_cast<char*>(m_BufferHandle.m_MappedData) + offsetInBytes, data, static_cast<size_t>(dataSizeInBytes));
+
+		if ((m_BufferHandle.m_MemoryProperties & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) == 0)
+			m_BufferHandle.m_DirtyRanges.Add(offsetInBytes, dataSizeInBytes, GetNonCoherentAtomSize());
+
+		return;
 	}
-	else if ((int)flags & (int)(BufferFlags::CBV))
-	{
-		wVkHelpers::createBuffer(bufferSize, usageFlags, memoryFlags, m_BufferHandle.m_Buffers, m_BufferHandle.m_BuffersMemory);
-
-		if (writeNow) {
-			void* bufferDataMapped;
-			vkMapMemory(wVkGlobals::g_Device, m_BufferHandle.m_BuffersMemory, 0, bufferSize, 0, &bufferDataMapped);
-			memcpy(bufferDataMapped, data, bufferSize);
-			vkUnmapMemory(wVkGlobals::g_Device, m_BufferHandle.m_BuffersMemory);
-		}
+
+	// Device local memory the CPU can't see - stream only the changed bytes through the staging window
+	wVkGlobals::g_UploadContext.UploadToBuffer(m_BufferHandle.m_Buffers, offsetInBytes, data, dataSizeInBytes);
+}
+
+void Buffer::Flush()
+{
+	auto& dirtyRanges = m_BufferHandle.m_DirtyRanges;
+	if (dirtyRanges.IsEmpty())
+		return;
+
+	// Flushed ranges have to start and end on nonCoherentAtomSize, or end at the end of the memory block
+	const VkDeviceSize atomSize = GetNonCoherentAtomSize();
+	const wVkAllocation& allocation = m_BufferHandle.m_Allocation;
+
+	std::vector<VkMappedMemoryRange> ranges;
+	ranges.reserve(dirtyRanges.GetRanges().size());
+
+	for (const auto& dirty : dirtyRanges.GetRanges()) {
+		ranges.push_back(GetMappedRange(allocation, dirty.m_Begin, dirty.m_End, atomSize));
 	}
-	else
+
+	vkFlushMappedMemoryRanges(wVkGlobals::g_Device, static_cast<uint32_t>(ranges.size()), ranges.data());
+	dirtyRanges.Clear();
+}
+
+void Buffer::ReadData(void* destination, size_t dataSizeInBytes, size_t offsetInBytes)
+{
+	ASSERT(m_BufferHandle.m_MappedData != nullptr, "Reading from buffer \"%s\" which isn't host visible", m_Name.c_str());
+	ASSERT(offsetInBytes + dataSizeInBytes <= GetSizeBytes(), "Reading out of bounds of buffer \"%s\"", m_Name.c_str());
+
+	if ((m_BufferHandle.m_MemoryProperties & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) == 0) {
+		// Only invalidate what we read, rounded out to nonCoherentAtomSize
+		const VkMappedMemoryRange range = GetMappedRange(m_BufferHandle.m_Allocation, offsetInBytes, offsetInBytes + dataSizeInBytes, GetNonCoherentAtomSize());
+		vkInvalidateMappedMemoryRanges(wVkGlobals::g_Device, 1, &range);
+	}
+
+	memcpy(destination, static_cast<const char*>(m_BufferHandle.m_MappedData) + offsetInBytes, dataSizeInBytes);
+}
+
+Buffer::Buffer(Buffer&& other) noexcept
+	: m_BufferHandle(std::exchange(other.m_BufferHandle, {}))
+	, m_Name(std::move(other.m_Name))
+	, m_Stride(std::exchange(other.m_Stride, 0))
+	, m_Count(std::exchange(other.m_Count, 0))
+	, m_Flags(std::exchange(other.m_Flags, BufferFlags::NONE))
+{
+	wVkGlobals::g_DeviceAllocator.SetOwner(m_BufferHandle.m_Allocation, GetAllocationOwner(m_BufferHandle));
+}
+
+Buffer& Buffer::operator=(Buffer&& other) noexcept
+{
+	if (this != &other)
 	{
-		ASSERT(false, "Buffer with flags %i Not Supported", static_cast<int>(flags));
+		Release();
+
+		m_BufferHandle = std::exchange(other.m_BufferHandle, {});
+		m_Name = std::move(other.m_Name);
+		m_Stride = std::exchange(other.m_Stride, 0);
+		m_Count = std::exchange(other.m_Count, 0);
+		m_Flags = std::exchange(other.m_Flags, BufferFlags::NONE);
+
+		wVkGlobals::g_DeviceAllocator.SetOwner(m_BufferHandle.m_Allocation, GetAllocationOwner(m_BufferHandle));
 	}
 
+	return *this;
 }
 
-void Buffer::UpdateData(const void* data, size_t dataSizeInBytes)
+void Buffer::Release()
 {
-	// Consider not doing this...
-	void* bufferDataMapped = nullptr;
-	vkMapMemory(wVkGlobals::g_Device, m_BufferHandle.m_BuffersMemory, 0, dataSizeInBytes, 0, &bufferDataMapped);
-	memcpy(bufferDataMapped, data, dataSizeInBytes);
-	vkUnmapMemory(wVkGlobals::g_Device, m_BufferHandle.m_BuffersMemory);
+	if (m_BufferHandle.m_Buffers == VK_NULL_HANDLE && !m_BufferHandle.m_Allocation.IsValid())
+		return;
+
+	// Pinned from here on, the defragmenter can't patch a handle that's about to go away
+	wVkGlobals::g_DeviceAllocator.SetOwner(m_BufferHandle.m_Allocation, {});
+
+	wVkGlobals::g_RetireQueue.Retire([buffer = m_BufferHandle.m_Buffers, allocation = m_BufferHandle.m_Allocation, registryId = m_BufferHandle.m_RegistryId]()
+	{
+		vkDestroyBuffer(wVkGlobals::g_Device, buffer, wVkGlobals::g_AllocationCallbacks);
+		wVkGlobals::g_DeviceAllocator.Free(allocation);
+		wVkGlobals::g_ResourceRegistry.Unregister(registryId);
+	});
+
+	m_BufferHandle = {};
 }
 
 Buffer::~Buffer()
 {
-	vkDestroyBuffer(wVkGlobals::g_Device, m_BufferHandle.m_Buffers, nullptr);
-	vkFreeMemory(wVkGlobals::g_Device, m_BufferHandle.m_BuffersMemory, nullptr);
+	Release();
 }
\ No newline at end of file
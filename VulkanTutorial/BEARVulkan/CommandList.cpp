@@ -1,5 +1,8 @@
 #include "BEARHeaders/CommandList.h"
 
+#include <algorithm>
+#include <string>
+
 #include "wVkConstants.h"
 
 #include "wVkGlobalVariables.h"
@@ -8,7 +11,9 @@
 #include "BEARHeaders/Texture.h"
 #include "Utils/ConsoleLogger.h"
 #include "wVkHelpers/wVkCommands.h"
+#include "wVkHelpers/wVkFormats.h"
 #include "wVkHelpers/wVkHelpers.h"
+#include "wVkHelpers/wVkTexture.h"
 
 static ComputePipelineDescription* g_boundPipeline;
 
@@ -37,8 +42,8 @@ void CommandList::Initialize()
 	fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT; //To make sure we get to our first frame
 
 	for (size_t i = 0; i < wVkConstants::g_MaxFramesInFlight; i++) {
-		if (vkCreateSemaphore(wVkGlobals::g_Device, &semaphoreInfo, nullptr, &m_CmdListHandle.m_FinishedSemaphores[i]) != VK_SUCCESS ||
-			vkCreateFence(wVkGlobals::g_Device, &fenceInfo, nullptr, &m_CmdListHandle.m_InFlightFences[i]) != VK_SUCCESS) {
+		if (vkCreateSemaphore(wVkGlobals::g_Device, &semaphoreInfo, wVkGlobals::g_AllocationCallbacks, &m_CmdListHandle.m_FinishedSemaphores[i]) != VK_SUCCESS ||
+			vkCreateFence(wVkGlobals::g_Device, &fenceInfo, wVkGlobals::g_AllocationCallbacks, &m_CmdListHandle.m_InFlightFences[i]) != VK_SUCCESS) {
 			throw std::runtime_error("failed to create compute synchronization objects for a frame!");
 		}
 	}
@@ -47,11 +52,14 @@ void CommandList::Initialize()
 
 void CommandList::Destroy()
 {
+	for (auto& readbackBuffer : m_ReadbackBuffers)
+		readbackBuffer.reset();
+
 	vkFreeCommandBuffers(wVkGlobals::g_Device, wVkGlobals::g_CommandPool, wVkConstants::g_MaxFramesInFlight, m_CmdListHandle.m_CommandBuffer);
 
 	for (size_t i = 0; i < wVkConstants::g_MaxFramesInFlight; i++) {
-		vkDestroySemaphore(wVkGlobals::g_Device, m_CmdListHandle.m_FinishedSemaphores[i], nullptr);
-		vkDestroyFence(wVkGlobals::g_Device, m_CmdListHandle.m_InFlightFences[i], nullptr);
+		vkDestroySemaphore(wVkGlobals::g_Device, m_CmdListHandle.m_FinishedSemaphores[i], wVkGlobals::g_AllocationCallbacks);
+		vkDestroyFence(wVkGlobals::g_Device, m_CmdListHandle.m_InFlightFences[i], wVkGlobals::g_AllocationCallbacks);
 	}
 }
 
@@ -67,6 +75,8 @@ void CommandList::BindResource32BitConstants(const uint32_t layoutLocation, cons
 
 void CommandList::BindResourceCBV(const uint32_t layoutLocation, Buffer& buffer)
 {
+	buffer.Flush(); // Pending CPU writes have to be visible before the GPU reads
+
 	auto shaderBindingData = wVkHelpers::createShaderBindingData(layoutLocation, &buffer, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER);
 
 	// ToDo checks whether there is something already bound to this slot.
@@ -75,26 +85,32 @@ void CommandList::BindResourceCBV(const uint32_t layoutLocation, Buffer& buffer)
 
 void CommandList::BindResourceSRV(const uint32_t layoutLocation, Buffer& buffer)
 {
+	buffer.Flush();
+
 	const auto  shaderBindingData = wVkHelpers::createShaderBindingData(layoutLocation, &buffer, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
 	g_boundPipeline->GetShaderLayoutRef().GetShaderLayoutHandleRef().m_CurrentDescSetBindings.push_back(shaderBindingData);
 }
 
 void CommandList::BindResourceUAV(const uint32_t layoutLocation, Buffer& buffer)
 {
+	buffer.Flush();
+
 	const auto  shaderBindingData = wVkHelpers::createShaderBindingData(layoutLocation, &buffer, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
 	g_boundPipeline->GetShaderLayoutRef().GetShaderLayoutHandleRef().m_CurrentDescSetBindings.push_back(shaderBindingData);
 }
 
 void CommandList::BindResourceSRV(const uint32_t layoutLocation, Texture& texture)
 {
-	const auto shaderBindingData = wVkHelpers::createShaderBindingData(layoutLocation, &texture, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
+	const auto shaderBindingData = wVkHelpers::createShaderBindingData(layoutLocation, &texture, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE);
 	g_boundPipeline->GetShaderLayoutRef().GetShaderLayoutHandleRef().m_CurrentDescSetBindings.push_back(shaderBindingData);
+	wVkGlobals::g_ResidencyManager.MarkUsed(texture.GetGPUHandleRef());
 }
 
 void CommandList::BindResourceUAV(const uint32_t layoutLocation, Texture& texture)
 {
 	const auto  shaderBindingData = wVkHelpers::createShaderBindingData(layoutLocation, &texture, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE);
 	g_boundPipeline->GetShaderLayoutRef().GetShaderLayoutHandleRef().m_CurrentDescSetBindings.push_back(shaderBindingData);
+	wVkGlobals::g_ResidencyManager.MarkUsed(texture.GetGPUHandleRef());
 }
 
 void CommandList::BindResourceSRV(const uint32_t layoutLocation, TLAS& tlas)
@@ -106,8 +122,14 @@ void CommandList::CopyResource(Buffer& bufferDst, Buffer& bufferSrc)
 {
 	ASSERT(bufferSrc.GetSizeBytes() == bufferDst.GetSizeBytes(), "Buffers must be equal in size");
 
-	// REMEMBER TO FIX THIS 
-	const VkCommandBuffer commandBuffer = m_CmdListHandle.m_CommandBuffer[1];
+	const VkCommandBuffer commandBuffer = m_CmdListHandle.m_CommandBuffer[m_FrameIndex];
+
+	// Anything written before has to land before we copy, and the copy has to land before anything after reads it
+	VkMemoryBarrier barrier{};
+	barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	barrier.srcAccessMask = VK_ACCESS_MEMORY_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
 
 	VkBufferCopy copyRegion{};
 	copyRegion.srcOffset = 0; // Optional
@@ -115,14 +137,198 @@ void CommandList::CopyResource(Buffer& bufferDst, Buffer& bufferSrc)
 	copyRegion.size = bufferSrc.GetSizeBytes();
 	vkCmdCopyBuffer(commandBuffer, bufferSrc.GetGPUHandleRef().m_Buffers, bufferDst.GetGPUHandleRef().m_Buffers, 1, &copyRegion);
 
-	//wVkHelpers::endSingleTimeCommand(commandBuffer);
+	barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
 }
 
 
-void CommandList::CopyResource(Texture& textureDst, Texture& textureSrc)
+void CommandList::CopyResource(Texture& textureDst, Texture& textureSrc, TextureLayout dstLayout, TextureLayout srcLayout)
 {
-	ASSERT(false, "Not Implemented");
+	ASSERT(textureDst.GetWidth() == textureSrc.GetWidth() && textureDst.GetHeight() == textureSrc.GetHeight(), "Textures must be equal in size");
+	ASSERT(textureDst.GetFormat() == textureSrc.GetFormat(), "Textures must have the same format");
+
+	auto& src = textureSrc.GetGPUHandleRef();
+	auto& dst = textureDst.GetGPUHandleRef();
+	const uint32_t mipLevels = std::min(src.m_TexMipLevels, dst.m_TexMipLevels);
+
+	const VkCommandBuffer commandBuffer = m_CmdListHandle.m_CommandBuffer[m_FrameIndex];
+	const VkImageLayout srcVkLayout = wVkHelpers::getVulkanLayout(srcLayout);
+	const VkImageLayout dstVkLayout = wVkHelpers::getVulkanLayout(dstLayout);
+
+	wVkHelpers::recordImageBarrier(commandBuffer, src.m_TextureImage, 0, src.m_TexMipLevels, srcVkLayout, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+		VK_ACCESS_MEMORY_WRITE_BIT, VK_ACCESS_TRANSFER_READ_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+	wVkHelpers::recordImageBarrier(commandBuffer, dst.m_TextureImage, 0, dst.m_TexMipLevels, dstVkLayout, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+		VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT, VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+
+	std::vector<VkImageCopy> regions(mipLevels);
+	for (uint32_t mip = 0; mip < mipLevels; mip++) {
+		VkImageCopy& region = regions[mip];
+		region.srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, mip, 0, 1 };
+		region.srcOffset = { 0, 0, 0 };
+		region.dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, mip, 0, 1 };
+		region.dstOffset = { 0, 0, 0 };
+		region.extent.width = std::max(1u, static_cast<uint32_t>(textureSrc.GetWidth()) >> mip);
+		region.extent.height = std::max(1u, static_cast<uint32_t>(textureSrc.GetHeight()) >> mip);
+		region.extent.depth = 1;
+	}
+
+	vkCmdCopyImage(commandBuffer, src.m_TextureImage, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, dst.m_TextureImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, mipLevels, regions.data());
+
+	wVkHelpers::recordImageBarrier(commandBuffer, src.m_TextureImage, 0, src.m_TexMipLevels, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, srcVkLayout,
+		VK_ACCESS_TRANSFER_READ_BIT, VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT);
+	wVkHelpers::recordImageBarrier(commandBuffer, dst.m_TextureImage, 0, dst.m_TexMipLevels, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, dstVkLayout,
+		VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT);
+}
+
+void CommandList::GenerateMips(Texture& texture, TextureLayout layout)
+{
+	ASSERT((texture.GetFlags() & TextureFlags::MIPMAP_COMPUTE) == TextureFlags::MIPMAP_COMPUTE, "GenerateMips needs a texture created with TextureFlags::MIPMAP_COMPUTE");
+
+	// RW_TEXTURE has the storage bit whatever its format, only the format tells if it fell back to blits (sRGB)
+	auto& handle = texture.GetGPUHandleRef();
+	if (!wVkDownsampler::IsSupported(handle.m_Format)) {
+		LOG_WARNING("GenerateMips on texture %s skipped, its format fell back to blitted mips", texture.GetName().c_str());
+		return;
+	}
+
+	const VkCommandBuffer commandBuffer = m_CmdListHandle.m_CommandBuffer[m_FrameIndex];
+	wVkGlobals::g_Downsampler.Record(commandBuffer, handle, texture.GetSpec().m_MipReduction, wVkHelpers::getVulkanLayout(layout));
+}
+
+void CommandList::UpdateBuffer(Buffer& buffer, uint64_t offsetInBytes, const void* data, uint64_t sizeInBytes)
+{
+	ASSERT(offsetInBytes % 4 == 0 && sizeInBytes % 4 == 0, "vkCmdUpdateBuffer needs offset and size to be multiples of 4");
+	ASSERT(sizeInBytes <= 65536, "vkCmdUpdateBuffer is limited to 65536 bytes, use Buffer::UpdateRange for \"%s\"", buffer.GetName().c_str());
+	ASSERT(offsetInBytes + sizeInBytes <= buffer.GetSizeBytes(), "Updating out of bounds of buffer \"%s\"", buffer.GetName().c_str());
+
+	const VkCommandBuffer commandBuffer = m_CmdListHandle.m_CommandBuffer[m_FrameIndex];
+
+	// Earlier reads and writes have to be done before we overwrite
+	VkMemoryBarrier barrier{};
+	barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	barrier.srcAccessMask = VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+	vkCmdUpdateBuffer(commandBuffer, buffer.GetGPUHandleRef().m_Buffers, offsetInBytes, sizeInBytes, data);
+
+	barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+}
+
+uint64_t CommandList::AllocateReadback(uint64_t sizeInBytes)
+{
+	if (m_ReadbackBuffers[m_FrameIndex] == nullptr) {
+		const std::string name = "Readback Ring " + std::to_string(m_FrameIndex);
+		m_ReadbackBuffers[m_FrameIndex] = std::make_unique<Buffer>(nullptr, 1, wVkConstants::g_ReadbackRingSize, BufferFlags::READBACK_HEAP, name);
+	}
+
+	const uint64_t offset = (m_ReadbackOffset + wVkConstants::g_ReadbackAlignment - 1) & ~(wVkConstants::g_ReadbackAlignment - 1);
+	if (offset + sizeInBytes > wVkConstants::g_ReadbackRingSize) {
+		LOG_WARNING("Readback ring of frame %i is full, dropping a readback of %i bytes", static_cast<int>(m_FrameIndex), static_cast<int>(sizeInBytes));
+		return UINT64_MAX;
+	}
+
+	m_ReadbackOffset = offset + sizeInBytes;
+	return offset;
+}
+
+ReadbackTicket CommandList::ReadbackAsync(Buffer& buffer, uint64_t offsetInBytes, uint64_t sizeInBytes)
+{
+	if (sizeInBytes == UINT64_MAX)
+		sizeInBytes = buffer.GetSizeBytes() - offsetInBytes;
+
+	ASSERT(offsetInBytes + sizeInBytes <= buffer.GetSizeBytes(), "Reading back out of bounds of buffer \"%s\"", buffer.GetName().c_str());
+
+	const uint64_t ringOffset = AllocateReadback(sizeInBytes);
+	if (ringOffset == UINT64_MAX)
+		return {};
+
+	const VkCommandBuffer commandBuffer = m_CmdListHandle.m_CommandBuffer[m_FrameIndex];
+	const VkBuffer readbackBuffer = m_ReadbackBuffers[m_FrameIndex]->GetGPUHandleRef().m_Buffers;
+
+	VkMemoryBarrier barrier{};
+	barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	barrier.srcAccessMask = VK_ACCESS_MEMORY_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
 
+	VkBufferCopy copyRegion{};
+	copyRegion.srcOffset = offsetInBytes;
+	copyRegion.dstOffset = ringOffset;
+	copyRegion.size = sizeInBytes;
+	vkCmdCopyBuffer(commandBuffer, buffer.GetGPUHandleRef().m_Buffers, readbackBuffer, 1, &copyRegion);
+
+	// Make the copy visible to the host once the fence is signaled
+	barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+	return { m_FrameIndex, m_SubmissionCounter + 1, ringOffset, sizeInBytes };
+}
+
+ReadbackTicket CommandList::ReadbackAsync(Texture& texture, uint32_t mipLevel, TextureLayout layout)
+{
+	auto& handle = texture.GetGPUHandleRef();
+	ASSERT(mipLevel < handle.m_TexMipLevels, "Reading back mip %i of texture \"%s\" which has %i mips", static_cast<int>(mipLevel), texture.GetName().c_str(), static_cast<int>(handle.m_TexMipLevels));
+
+	const uint32_t width = std::max(1u, static_cast<uint32_t>(texture.GetWidth()) >> mipLevel);
+	const uint32_t height = std::max(1u, static_cast<uint32_t>(texture.GetHeight()) >> mipLevel);
+	// Block aware, GetBytesPerPixel is 0 for BCn
+	const uint64_t sizeInBytes = wVkHelpers::getImageSize(handle.m_Format, width, height);
+
+	const uint64_t ringOffset = AllocateReadback(sizeInBytes);
+	if (ringOffset == UINT64_MAX)
+		return {};
+
+	const VkCommandBuffer commandBuffer = m_CmdListHandle.m_CommandBuffer[m_FrameIndex];
+	const VkBuffer readbackBuffer = m_ReadbackBuffers[m_FrameIndex]->GetGPUHandleRef().m_Buffers;
+
+	wVkHelpers::recordImageBarrier(commandBuffer, handle.m_TextureImage, mipLevel, 1, wVkHelpers::getVulkanLayout(layout), VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+		VK_ACCESS_MEMORY_WRITE_BIT, VK_ACCESS_TRANSFER_READ_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+
+	VkBufferImageCopy region{};
+	region.bufferOffset = ringOffset;
+	region.bufferRowLength = 0; // Tightly packed
+	region.bufferImageHeight = 0;
+	region.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, mipLevel, 0, 1 };
+	region.imageOffset = { 0, 0, 0 };
+	region.imageExtent = { width, height, 1 };
+	vkCmdCopyImageToBuffer(commandBuffer, handle.m_TextureImage, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, readbackBuffer, 1, &region);
+
+	wVkHelpers::recordImageBarrier(commandBuffer, handle.m_TextureImage, mipLevel, 1, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, wVkHelpers::getVulkanLayout(layout),
+		VK_ACCESS_TRANSFER_READ_BIT, VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT);
+
+	VkMemoryBarrier barrier{};
+	barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+	return { m_FrameIndex, m_SubmissionCounter + 1, ringOffset, sizeInBytes };
+}
+
+bool CommandList::IsReadbackReady(const ReadbackTicket& ticket) const
+{
+	if (!ticket.IsValid())
+		return false;
+
+	// Not submitted yet, or the slot has been recorded into again since
+	if (m_SlotSubmission[ticket.m_FrameSlot] != ticket.m_Submission)
+		return false;
+
+	return vkGetFenceStatus(wVkGlobals::g_Device, m_CmdListHandle.m_InFlightFences[ticket.m_FrameSlot]) == VK_SUCCESS;
+}
+
+bool CommandList::GetReadbackData(const ReadbackTicket& ticket, void* destination)
+{
+	if (!IsReadbackReady(ticket))
+		return false;
+
+	m_ReadbackBuffers[ticket.m_FrameSlot]->ReadData(destination, static_cast<size_t>(ticket.m_Size), static_cast<size_t>(ticket.m_Offset));
+	return true;
 }
 
 void CommandList::SetComputePipeline(ComputePipelineDescription& cpd)
@@ -136,6 +342,53 @@ void CommandList::Reset()
 	ASSERT(false, "Not Implemented");
 }
 
+// Sum of the relocation counters of the bound resources, changes whenever one of them was moved in memory
+uint32_t GetBindingRelocations(const std::vector<ShaderBindingData>& bindings)
+{
+	uint32_t relocations = 0;
+	for (const auto& bindingData : bindings)
+	{
+		if (bindingData.m_Type == DataType::TEXTURE)
+			relocations += static_cast<Texture*>(bindingData.m_ResourceLocation)->GetGPUHandleRef().m_Relocations;
+		else
+			relocations += static_cast<Buffer*>(bindingData.m_ResourceLocation)->GetGPUHandleRef().m_Relocations;
+	}
+
+	return relocations;
+}
+
+void WriteBufferDescriptors(VkDescriptorSet descSet, const std::vector<ShaderBindingData>& bindings)
+{
+	std::vector<VkDescriptorBufferInfo> bufferInfos(bindings.size());
+	std::vector<VkWriteDescriptorSet> descriptorWrites;
+	descriptorWrites.reserve(bindings.size());
+
+	for (size_t i = 0; i < bindings.size(); i++)
+	{
+		// For now we only work with buffers
+		ASSERT(bindings[i].m_Type == DataType::BUFFER, "Only buffers can be written to compute descriptor sets for now");
+		Buffer* buffer = static_cast<Buffer*>(bindings[i].m_ResourceLocation);
+
+		VkDescriptorBufferInfo& bufferInfo = bufferInfos[i];
+		bufferInfo.buffer = buffer->GetGPUHandleRef().m_Buffers;
+		bufferInfo.offset = 0;
+		bufferInfo.range = buffer->GetSizeBytes();
+
+		VkWriteDescriptorSet descWrite{};
+		descWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		descWrite.dstSet = descSet;
+		descWrite.dstBinding = bindings[i].m_BindingLocation;
+		descWrite.dstArrayElement = 0;
+		descWrite.descriptorType = bindings[i].m_Layout.descriptorType;
+		descWrite.descriptorCount = 1;
+		descWrite.pBufferInfo = &bufferInfo;
+
+		descriptorWrites.push_back(descWrite);
+	}
+
+	vkUpdateDescriptorSets(wVkGlobals::g_Device, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
+}
+
 void CommandList::Dispatch(const uint32_t numThreadGroupsX, const uint32_t numThreadGroupsY,
 	const uint32_t numThreadGroupsZ, bool syncBeforeDispatch)
 {
@@ -167,7 +420,7 @@ void CommandList::Dispatch(const uint32_t numThreadGroupsX, const uint32_t numTh
 		layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
 		layoutInfo.pBindings = bindings.data();
 
-		if (vkCreateDescriptorSetLayout(wVkGlobals::g_Device, &layoutInfo, nullptr, &boundPipeline.m_DescSetLayout) != VK_SUCCESS) {
+		if (vkCreateDescriptorSetLayout(wVkGlobals::g_Device, &layoutInfo, wVkGlobals::g_AllocationCallbacks, &boundPipeline.m_DescSetLayout) != VK_SUCCESS) {
 			throw std::runtime_error("failed to create compute descriptor set layout!");
 		}
 		// END CREATE DESCRIPTOR SET LAYOUT -------------
@@ -176,17 +429,17 @@ void CommandList::Dispatch(const uint32_t numThreadGroupsX, const uint32_t numTh
 		// CREATE DESCRIPTOR POOL -----------------------------
 		std::vector<VkDescriptorPoolSize> poolSizes(2);
 		poolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-		poolSizes[0].descriptorCount = static_cast<uint32_t>(wVkConstants::g_MaxFramesInFlight) * numUniformBuffers;
+		poolSizes[0].descriptorCount = wVkConstants::g_MaxDecriptorSets * numUniformBuffers;
 		poolSizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-		poolSizes[1].descriptorCount = static_cast<uint32_t>(wVkConstants::g_MaxFramesInFlight) * numStorageBuffers;
+		poolSizes[1].descriptorCount = wVkConstants::g_MaxDecriptorSets * numStorageBuffers;
 
 		VkDescriptorPoolCreateInfo poolInfo{};
 		poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
 		poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
 		poolInfo.pPoolSizes = poolSizes.data();
-		poolInfo.maxSets = static_cast<uint32_t>(wVkConstants::g_MaxFramesInFlight * 1);
+		poolInfo.maxSets = wVkConstants::g_MaxDecriptorSets; // One set per binding combination per frame slot
 
-		if (vkCreateDescriptorPool(wVkGlobals::g_Device, &poolInfo, nullptr, &boundPipeline.m_DescriptorPool) != VK_SUCCESS) {
+		if (vkCreateDescriptorPool(wVkGlobals::g_Device, &poolInfo, wVkGlobals::g_AllocationCallbacks, &boundPipeline.m_DescriptorPool) != VK_SUCCESS) {
 			throw std::runtime_error("failed to create descriptor pool!");
 		}
 		// END DESCRIPTOR POOL CREATION -----------------------------
@@ -204,7 +457,7 @@ void CommandList::Dispatch(const uint32_t numThreadGroupsX, const uint32_t numTh
 		pipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(std::size(layout));
 		pipelineLayoutInfo.pSetLayouts = layout;
 
-		if (vkCreatePipelineLayout(wVkGlobals::g_Device, &pipelineLayoutInfo, nullptr, &boundPipeline.m_PipelineLayout) != VK_SUCCESS) {
+		if (vkCreatePipelineLayout(wVkGlobals::g_Device, &pipelineLayoutInfo, wVkGlobals::g_AllocationCallbacks, &boundPipeline.m_PipelineLayout) != VK_SUCCESS) {
 			throw std::runtime_error("failed to create compute pipeline layout!");
 		}
 
@@ -214,7 +467,7 @@ void CommandList::Dispatch(const uint32_t numThreadGroupsX, const uint32_t numTh
 		pipelineInfo.stage = computeShaderStageInfo;
 
 
-		if (vkCreateComputePipelines(wVkGlobals::g_Device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &boundPipeline.m_Pipeline) != VK_SUCCESS) {
+		if (vkCreateComputePipelines(wVkGlobals::g_Device, VK_NULL_HANDLE, 1, &pipelineInfo, wVkGlobals::g_AllocationCallbacks, &boundPipeline.m_Pipeline) != VK_SUCCESS) {
 			throw std::runtime_error("failed to create compute pipeline!");
 		}
 		// END CREATE PIPELINE -----------------
@@ -225,6 +478,10 @@ void CommandList::Dispatch(const uint32_t numThreadGroupsX, const uint32_t numTh
 	auto& cache = shaderLayout.GetShaderLayoutHandleRef().m_BindingsCache;
 	auto hash = wVkHelpers::hashArrayOfShaderBindingData(shaderParams);
 
+	// Sets are cached per frame slot, so the one we touch here can only be in use by this slot's previous submission,
+	// which Begin() already waited for.
+	hash ^= std::hash<uint32_t>{}(m_FrameIndex) + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+
 	VkDescriptorSet currentFramesDescriptorSet;
 
 	auto it = cache.find(hash);
@@ -243,42 +500,13 @@ void CommandList::Dispatch(const uint32_t numThreadGroupsX, const uint32_t numTh
 			throw std::runtime_error("Failed to allocate compute descriptor sets!");
 		}
 
-		// Try to get an existing cache heap
-		std::vector<VkWriteDescriptorSet> descriptorWrites;
-
-		for (auto bindingData : shaderParams)
-		{
-			// For now we only work with buffers
-			Buffer* buffer = static_cast<Buffer*>(bindingData.m_ResourceLocation);
-
-			VkDescriptorBufferInfo* bufferInfo = new VkDescriptorBufferInfo();
-			bufferInfo->buffer = buffer->GetGPUHandleRef().m_Buffers; //deltaTime
-			bufferInfo->offset = 0;
-			bufferInfo->range = buffer->GetSizeBytes();
-
-			VkWriteDescriptorSet descWrite{};
-			descWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-			descWrite.dstSet = descSet;
-			descWrite.dstBinding = bindingData.m_BindingLocation;
-			descWrite.dstArrayElement = 0;
-			descWrite.descriptorType = bindingData.m_Layout.descriptorType;
-			descWrite.descriptorCount = 1;
-			descWrite.pBufferInfo = bufferInfo;
-
-			descriptorWrites.push_back(descWrite);
-		}
-
-		vkUpdateDescriptorSets(wVkGlobals::g_Device, (uint32_t)shaderParams.size(), descriptorWrites.data(), 0, nullptr);
-
-		for (auto& desc : descriptorWrites)
-		{
-			delete desc.pBufferInfo;
-		}
+		WriteBufferDescriptors(descSet, shaderParams);
 
 		auto& descSetCache = shaderLayout.GetShaderLayoutHandleRef().m_DescriptorSetCache;
 
 		descSetCache[hash] = descSet;
 		cache[hash] = shaderParams;
+		shaderLayout.GetShaderLayoutHandleRef().m_DescriptorSetRelocations[hash] = GetBindingRelocations(shaderParams);
 		currentFramesDescriptorSet = descSet;
 
 		// Check to make sure we're not going above our Descriptor Set Pool
@@ -287,6 +515,15 @@ void CommandList::Dispatch(const uint32_t numThreadGroupsX, const uint32_t numTh
 	}else
 	{
 		currentFramesDescriptorSet = shaderLayout.GetShaderLayoutHandleRef().m_DescriptorSetCache[hash];
+
+		// A bound resource was moved since the set was written, point it at the new one.
+		// The set belongs to this frame slot and its last use has finished, so it's safe to rewrite.
+		const uint32_t relocations = GetBindingRelocations(shaderParams);
+		uint32_t& setRelocations = shaderLayout.GetShaderLayoutHandleRef().m_DescriptorSetRelocations[hash];
+		if (setRelocations != relocations) {
+			WriteBufferDescriptors(currentFramesDescriptorSet, shaderParams);
+			setRelocations = relocations;
+		}
 	}
 	// END CREATE DESCRIPTOR SETS -------
 
@@ -312,6 +549,10 @@ void CommandList::Begin(uint32_t test)
 
 	vkResetFences(wVkGlobals::g_Device, 1, &fence);
 
+	// Readbacks of the previous submission in this slot get overwritten from here on
+	m_SlotSubmission[m_FrameIndex] = 0;
+	m_ReadbackOffset = 0;
+
 	const auto& cb = m_CmdListHandle.m_CommandBuffer[m_FrameIndex];
 	vkResetCommandBuffer(cb, /*VkCommandBufferResetFlagBits*/ 0);
 
@@ -346,5 +587,8 @@ void CommandList::Execute()
 		throw std::runtime_error("failed to submit compute command buffer!");
 	}
 
+	m_SubmissionCounter++;
+	m_SlotSubmission[m_FrameIndex] = m_SubmissionCounter;
+
 }
 
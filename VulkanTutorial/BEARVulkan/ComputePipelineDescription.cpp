@@ -1,5 +1,7 @@
 #include "BEARHeaders/ComputePipelineDescription.h"
 
+#include <utility>
+
 #include "wVkGlobalVariables.h"
 #include "wVkHelpers/wVkHelpers.h"
 
@@ -15,14 +17,48 @@ void ComputePipelineDescription::Initialize(const std::string& shaderName, Shade
 	// - Pipeline
 }
 
+ComputePipelineDescription::ComputePipelineDescription(ComputePipelineDescription&& other) noexcept
+	: m_ShaderLayout(std::move(other.m_ShaderLayout))
+	, m_PipelineHandle(std::exchange(other.m_PipelineHandle, {}))
+	, m_ShaderName(std::move(other.m_ShaderName))
+{
+}
+
+ComputePipelineDescription& ComputePipelineDescription::operator=(ComputePipelineDescription&& other) noexcept
+{
+	if (this != &other)
+	{
+		Destroy();
+
+		m_ShaderLayout = std::move(other.m_ShaderLayout);
+		m_PipelineHandle = std::exchange(other.m_PipelineHandle, {});
+		m_ShaderName = std::move(other.m_ShaderName);
+	}
+
+	return *this;
+}
+
 void ComputePipelineDescription::Destroy()
 {
-	vkDestroyShaderModule(wVkGlobals::g_Device, m_PipelineHandle.m_ShaderModule, nullptr);
-	vkDestroyPipeline(wVkGlobals::g_Device, m_PipelineHandle.m_Pipeline, nullptr);
-	vkDestroyPipelineLayout(wVkGlobals::g_Device, m_PipelineHandle.m_PipelineLayout, nullptr);
-	vkDestroyDescriptorSetLayout(wVkGlobals::g_Device, m_PipelineHandle.m_DescSetLayout, nullptr);
-	vkDestroyDescriptorPool(wVkGlobals::g_Device, m_PipelineHandle.m_DescriptorPool, nullptr);
+	if (m_PipelineHandle.m_ShaderModule == VK_NULL_HANDLE && m_PipelineHandle.m_Pipeline == VK_NULL_HANDLE)
+		return;
+
+	// Copy of the handles, the lambda runs after this object might be gone
+	wVkGlobals::g_RetireQueue.Retire([pipeline = m_PipelineHandle]()
+	{
+		vkDestroyShaderModule(wVkGlobals::g_Device, pipeline.m_ShaderModule, wVkGlobals::g_AllocationCallbacks);
+		vkDestroyPipeline(wVkGlobals::g_Device, pipeline.m_Pipeline, wVkGlobals::g_AllocationCallbacks);
+		vkDestroyPipelineLayout(wVkGlobals::g_Device, pipeline.m_PipelineLayout, wVkGlobals::g_AllocationCallbacks);
+		vkDestroyDescriptorSetLayout(wVkGlobals::g_Device, pipeline.m_DescSetLayout, wVkGlobals::g_AllocationCallbacks);
+		vkDestroyDescriptorPool(wVkGlobals::g_Device, pipeline.m_DescriptorPool, wVkGlobals::g_AllocationCallbacks);
+	});
 
+	m_PipelineHandle = {};
+}
+
+ComputePipelineDescription::~ComputePipelineDescription()
+{
+	Destroy();
 }
 
 
@@ -1,17 +1,128 @@
 #include "BEARHeaders/SamplerDescriptorHeap.h"
 
+#include <stdexcept>
+
+#include "wVkGlobalVariables.h"
+#include "Utils/ConsoleLogger.h"
+
+// Vulkan has no sampler heaps, ours is a descriptor set with one binding of maxNumberResources samplers
+void WriteSamplerDescriptor(VkDescriptorSet set, uint32_t index, VkSampler sampler)
+{
+	VkDescriptorImageInfo imageInfo{};
+	imageInfo.sampler = sampler;
+
+	VkWriteDescriptorSet write{};
+	write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	write.dstSet = set;
+	write.dstBinding = 0;
+	write.dstArrayElement = index;
+	write.descriptorCount = 1;
+	write.descriptorType = VK_DESCRIPTOR_TYPE_SAMPLER;
+	write.pImageInfo = &imageInfo;
+
+	vkUpdateDescriptorSets(wVkGlobals::g_Device, 1, &write, 0, nullptr);
+}
+
+SamplerDescriptorHeap::~SamplerDescriptorHeap()
+{
+	if (m_DescriptorHeapHandle.m_Pool == VK_NULL_HANDLE)
+		return;
+
+	for (const GPUSamplerHandle& sampler : m_Samplers)
+		wVkGlobals::g_SamplerCache.Release(sampler.m_Sampler);
+	wVkGlobals::g_SamplerCache.Release(m_FillerSampler.m_Sampler);
+
+	wVkGlobals::g_RetireQueue.Retire([pool = m_DescriptorHeapHandle.m_Pool, layout = m_DescriptorHeapHandle.m_Layout]()
+	{
+		vkDestroyDescriptorPool(wVkGlobals::g_Device, pool, wVkGlobals::g_AllocationCallbacks);
+		vkDestroyDescriptorSetLayout(wVkGlobals::g_Device, layout, wVkGlobals::g_AllocationCallbacks);
+	});
+}
 
 void SamplerDescriptorHeap::Initialize(int maxNumberResources)
 {
+	ASSERT(m_DescriptorHeapHandle.m_Pool == VK_NULL_HANDLE, "Sampler heap is already initialized");
+	ASSERT(maxNumberResources > 0, "Sampler heap needs room for at least one sampler");
+
+	m_MaxSize = maxNumberResources;
+
+	VkDescriptorSetLayoutBinding binding{};
+	binding.binding = 0;
+	binding.descriptorType = VK_DESCRIPTOR_TYPE_SAMPLER;
+	binding.descriptorCount = static_cast<uint32_t>(maxNumberResources);
+	binding.stageFlags = VK_SHADER_STAGE_ALL;
 
+	VkDescriptorSetLayoutCreateInfo layoutInfo{};
+	layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	layoutInfo.bindingCount = 1;
+	layoutInfo.pBindings = &binding;
+
+	if (vkCreateDescriptorSetLayout(wVkGlobals::g_Device, &layoutInfo, wVkGlobals::g_AllocationCallbacks, &m_DescriptorHeapHandle.m_Layout) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create sampler heap layout!");
+	}
+
+	VkDescriptorPoolSize poolSize{};
+	poolSize.type = VK_DESCRIPTOR_TYPE_SAMPLER;
+	poolSize.descriptorCount = static_cast<uint32_t>(maxNumberResources);
+
+	VkDescriptorPoolCreateInfo poolInfo{};
+	poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	poolInfo.poolSizeCount = 1;
+	poolInfo.pPoolSizes = &poolSize;
+	poolInfo.maxSets = 1;
+
+	if (vkCreateDescriptorPool(wVkGlobals::g_Device, &poolInfo, wVkGlobals::g_AllocationCallbacks, &m_DescriptorHeapHandle.m_Pool) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create sampler heap pool!");
+	}
+
+	VkDescriptorSetAllocateInfo allocInfo{};
+	allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	allocInfo.descriptorPool = m_DescriptorHeapHandle.m_Pool;
+	allocInfo.descriptorSetCount = 1;
+	allocInfo.pSetLayouts = &m_DescriptorHeapHandle.m_Layout;
+
+	if (vkAllocateDescriptorSets(wVkGlobals::g_Device, &allocInfo, &m_DescriptorHeapHandle.m_Handle) != VK_SUCCESS) {
+		throw std::runtime_error("failed to allocate sampler heap set!");
+	}
+
+	// Every slot of a statically used array has to be valid, without partially bound descriptors the empty ones get a filler
+	m_FillerSampler.m_Sampler = wVkGlobals::g_SamplerCache.Acquire(SamplerState(MinFilter::LINEAR_MIPMAP_LINEAR, MagFilter::LINEAR, WrapUV::REPEAT));
+	for (int i = 0; i < maxNumberResources; i++)
+		WriteSamplerDescriptor(m_DescriptorHeapHandle.m_Handle, static_cast<uint32_t>(i), m_FillerSampler.m_Sampler);
 }
 
 int SamplerDescriptorHeap::AddSampler(Sampler& sampler)
 {
-	return 0;
+	ASSERT(m_DescriptorHeapHandle.m_Pool != VK_NULL_HANDLE, "Sampler heap isn't initialized");
+
+	// Equal states share a VkSampler, so this also catches a different Sampler with the same state
+	const VkSampler vkSampler = sampler.GetGPUHandleRef().m_Sampler;
+	for (int i = 0; i < m_NumElements; i++) {
+		if (m_Samplers[i].m_Sampler == vkSampler)
+			return i;
+	}
+
+	ASSERT(m_NumElements < m_MaxSize, "Sampler heap is full, it holds %i samplers", m_MaxSize);
+
+	GPUSamplerHandle placed;
+	placed.m_Sampler = wVkGlobals::g_SamplerCache.Acquire(sampler.GetSamplerState());
+	WriteSamplerDescriptor(m_DescriptorHeapHandle.m_Handle, static_cast<uint32_t>(m_NumElements), placed.m_Sampler);
+
+	m_Samplers.push_back(placed);
+	m_SamplerStates.push_back(sampler.GetSamplerState());
+	return m_NumElements++;
 }
 
 void SamplerDescriptorHeap::SwitchSampler(Sampler& newSampler, int heapID)
 {
+	ASSERT(heapID >= 0 && heapID < m_NumElements, "Sampler heap has no entry %i", heapID);
+
+	// Written straight into the set, like every descriptor in the renderer, don't switch one a frame in flight samples with
+	GPUSamplerHandle placed;
+	placed.m_Sampler = wVkGlobals::g_SamplerCache.Acquire(newSampler.GetSamplerState());
+	WriteSamplerDescriptor(m_DescriptorHeapHandle.m_Handle, static_cast<uint32_t>(heapID), placed.m_Sampler);
 
-}
\ No newline at end of file
+	wVkGlobals::g_SamplerCache.Release(m_Samplers[heapID].m_Sampler);
+	m_Samplers[heapID] = placed;
+	m_SamplerStates[heapID] = newSampler.GetSamplerState();
+}
@@ -1,8 +1,11 @@
 #include "BEARHeaders/TLAS.h"
 
+#include "wVkGlobalVariables.h"
 
 TLAS::TLAS(const std::vector<TlasInstanceData*>& levelData)
 {
+	if (!IsSupported())
+		return;
 
 }
 
@@ -25,5 +28,12 @@ glm::mat4& TLAS::GetInstanceTransformRef(const uint32_t id) const
 
 void TLAS::Update()
 {
+	if (!IsSupported())
+		return;
 
 }
+
+bool TLAS::IsSupported()
+{
+	return BLAS::IsSupported();
+}
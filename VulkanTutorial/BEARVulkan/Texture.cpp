@@ -1,15 +1,22 @@
 #include "BEARHeaders/Texture.h"
 
+#include <algorithm>
 #include <stdexcept>
 #include <cmath>
+#include <memory>
+#include <utility>
 
 #include "wVkGlobalVariables.h"
+#include "wVkMipBuilder.h"
+#include "wVkPixelConverter.h"
 #include "Utils/ConsoleLogger.h"
+#include "wVkHelpers/wVkFormats.h"
 #include "wVkHelpers/wVkHelpers.h"
+#include "wVkHelpers/wVkMipmaps.h"
 #include "wVkHelpers/wVkTemp.h"
 #include "wVkHelpers/wVkTexture.h"
 
-VkImageUsageFlags DetermineImageUsageFlags(TextureType type) {
+VkImageUsageFlags DetermineImageUsageFlags(TextureType type, bool computeMips) {
 	VkImageUsageFlags flags = VK_IMAGE_USAGE_SAMPLED_BIT; // Basic flag for all textures to be readable
 
 	switch (type) {
@@ -29,6 +36,10 @@ VkImageUsageFlags DetermineImageUsageFlags(TextureType type) {
 	// Flags for creating an image and sampling it 
 	flags |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT; 
 
+	// wVkDownsampler writes the mips as storage images
+	if (computeMips)
+		flags |= VK_IMAGE_USAGE_STORAGE_BIT;
+
 	return flags;
 }
 
@@ -45,8 +56,30 @@ VkFormat GetVulkanFormat(TextureFormat format) {
 		return VK_FORMAT_R32G32_SFLOAT;
 	case TextureFormat::R32_G32_B32_A32_FLOAT:
 		return VK_FORMAT_R32G32B32A32_SFLOAT;
+	case TextureFormat::R16_FLOAT:
+		return VK_FORMAT_R16_SFLOAT;
+	case TextureFormat::R16_G16_FLOAT:
+		return VK_FORMAT_R16G16_SFLOAT;
+	case TextureFormat::R16_G16_B16_A16_FLOAT:
+		return VK_FORMAT_R16G16B16A16_SFLOAT;
 	case TextureFormat::R8G8B8A8_SRGB:
 		return VK_FORMAT_R8G8B8A8_SRGB;
+	case TextureFormat::BC1_UNORM:
+		return VK_FORMAT_BC1_RGBA_UNORM_BLOCK;
+	case TextureFormat::BC1_SRGB:
+		return VK_FORMAT_BC1_RGBA_SRGB_BLOCK;
+	case TextureFormat::BC3_UNORM:
+		return VK_FORMAT_BC3_UNORM_BLOCK;
+	case TextureFormat::BC3_SRGB:
+		return VK_FORMAT_BC3_SRGB_BLOCK;
+	case TextureFormat::BC4_UNORM:
+		return VK_FORMAT_BC4_UNORM_BLOCK;
+	case TextureFormat::BC5_UNORM:
+		return VK_FORMAT_BC5_UNORM_BLOCK;
+	case TextureFormat::BC7_UNORM:
+		return VK_FORMAT_BC7_UNORM_BLOCK;
+	case TextureFormat::BC7_SRGB:
+		return VK_FORMAT_BC7_SRGB_BLOCK;
 
 	default:
 		ASSERT(false, "Using a flag that's not supported");
@@ -55,106 +88,357 @@ VkFormat GetVulkanFormat(TextureFormat format) {
 }
 
 
-// Internal, as not to be confused with the temp one in wVkTempBuffer
-void createImage2DInternal(uint32_t width, uint32_t height, uint32_t mipLevels, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkImage& image, VkDeviceMemory& imageMemory) {
-
-	VkImageCreateInfo imageInfo{};
-	imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
-	imageInfo.imageType = VK_IMAGE_TYPE_2D;
-	imageInfo.extent.width = width;
-	imageInfo.extent.height = height;
-	imageInfo.extent.depth = 1;
-	imageInfo.mipLevels = mipLevels;
-	imageInfo.arrayLayers = 1;
-	imageInfo.format = format;
-	imageInfo.tiling = tiling;
-	imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-	imageInfo.usage = usage;
-	imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
-	imageInfo.flags = 0; // Optional
-
-	if (vkCreateImage(wVkGlobals::g_Device, &imageInfo, nullptr, &image) != VK_SUCCESS) {
-		throw std::runtime_error("failed to create image!");
-	}
+// Internal, as not to be confused with the temp one in wVkTempBuffer. The memory is sub-allocated and starts out pinned.
+void createImage2DInternal(uint32_t width, uint32_t height, uint32_t mipLevels, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkImage& image, wVkAllocation& allocation) {
+
+	image = wVkHelpers::createImage2DObject(width, height, mipLevels, format, tiling, usage);
 
 	VkMemoryRequirements memRequirements;
 	vkGetImageMemoryRequirements(wVkGlobals::g_Device, image, &memRequirements);
 
-	VkMemoryAllocateInfo allocInfo{};
-	allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-	allocInfo.allocationSize = memRequirements.size;
-	allocInfo.memoryTypeIndex = wVkHelpers::findMemoryType(memRequirements.memoryTypeBits, properties);
+	const uint32_t memoryType = wVkHelpers::findMemoryType(memRequirements.memoryTypeBits, properties);
+	const wVkAllocationKind kind = tiling == VK_IMAGE_TILING_OPTIMAL ? wVkAllocationKind::OPTIMAL : wVkAllocationKind::LINEAR;
+	allocation = wVkGlobals::g_DeviceAllocator.Allocate(memRequirements, memoryType, kind, {});
 
-	if (vkAllocateMemory(wVkGlobals::g_Device, &allocInfo, nullptr, &imageMemory) != VK_SUCCESS) {
-		throw std::runtime_error("failed to allocate image memory!");
-	}
+	vkBindImageMemory(wVkGlobals::g_Device, image, allocation.m_Memory, allocation.m_Offset);
+}
 
-	vkBindImageMemory(wVkGlobals::g_Device, image, imageMemory, 0);
+// Tightly packed size of mips firstMip and smaller, anything the driver allocates on top of that is alignment/tiling waste
+uint64_t GetMipChainSize(VkFormat format, uint32_t width, uint32_t height, uint32_t firstMip, uint32_t mipLevels) {
+	uint64_t size = 0;
+	for (uint32_t mip = firstMip; mip < mipLevels; mip++)
+		size += wVkHelpers::getImageSize(format, std::max(width >> mip, 1u), std::max(height >> mip, 1u));
+
+	return size;
 }
 
-Texture::Texture(const void* data, TextureSpec spec, const std::string& name) : m_Spec(spec), m_Name(name)
+Texture::Texture(const void* data, TextureSpec spec, const std::string& name, const Callsite& callsite) : m_Spec(spec), m_Name(name)
 {
-	const bool generateMips = (spec.m_Flags & TextureFlags::MIPMAP_GENERATE) == (TextureFlags::MIPMAP_GENERATE);
+	const bool streamed = (spec.m_Flags & TextureFlags::STREAMED) == (TextureFlags::STREAMED);
+	ASSERT(!streamed || spec.m_Type == TextureType::R_TEXTURE, "Only R_TEXTURE textures can be streamed");
+
+	auto format = GetVulkanFormat(spec.m_Format);
+
+	// Block compressed textures are encoded from RGBA8 texels on the way in, nothing can render or write into them
+	const wVkFormatInfo formatInfo = wVkHelpers::getFormatInfo(format);
+	const bool blockCompressed = formatInfo.m_BlockFormat != wVkBlockFormat::NONE;
+	ASSERT(!blockCompressed || spec.m_Type == TextureType::R_TEXTURE, "Block compressed textures can only be R_TEXTURE");
+	ASSERT(!blockCompressed || IsFormatSupported(spec.m_Format), "Texture %s uses a block compressed format the device can't sample", name.c_str());
+	ASSERT(!blockCompressed || data != nullptr || streamed, "Block compressed texture %s needs its texels up front", name.c_str());
+
+	// Formats the downsampler has no storage variant of (sRGB) get the blit chain instead
+	bool computeMips = (spec.m_Flags & TextureFlags::MIPMAP_COMPUTE) == (TextureFlags::MIPMAP_COMPUTE) && !streamed && !blockCompressed;
+	if (computeMips && !wVkDownsampler::IsSupported(format)) {
+		LOG_WARNING("Texture %s can't have its mips computed in this format, falling back to blits", name.c_str());
+		computeMips = false;
+	}
+
+	const bool generateMips = (spec.m_Flags & TextureFlags::MIPMAP_GENERATE) == (TextureFlags::MIPMAP_GENERATE)
+		|| (spec.m_Flags & TextureFlags::MIPMAP_COMPUTE) == (TextureFlags::MIPMAP_COMPUTE);
+
+	// Streamed textures always get a full chain, only the 1x1 mip is resident until the streamer has decoded the file
+	const uint32_t fullMips = generateMips || streamed ? wVkHelpers::getMipLevelCount(spec.m_Width, spec.m_Height) : 1;
+	const uint32_t firstMip = streamed ? fullMips - 1 : 0;
+	const uint32_t mips = fullMips - firstMip;
+	const uint32_t width = std::max(static_cast<uint32_t>(spec.m_Width) >> firstMip, 1u);
+	const uint32_t height = std::max(static_cast<uint32_t>(spec.m_Height) >> firstMip, 1u);
+
+	m_Channels = formatInfo.m_Channels;
+	m_BytesPerChannel = blockCompressed ? 0 : formatInfo.m_BytesPerBlock / formatInfo.m_Channels;
+	m_SizeInBytes = wVkHelpers::getImageSize(format, spec.m_Width, spec.m_Height);
+
+	auto usageFlags = DetermineImageUsageFlags(spec.m_Type, computeMips);
+
+	m_TextureHandle.m_TexMipLevels = mips;
+	m_TextureHandle.m_Width = width;
+	m_TextureHandle.m_Height = height;
+	m_TextureHandle.m_Format = format;
+	m_TextureHandle.m_Usage = usageFlags;
+	m_TextureHandle.m_Type = spec.m_Type;
+	m_TextureHandle.m_FullWidth = static_cast<uint32_t>(spec.m_Width);
+	m_TextureHandle.m_FullHeight = static_cast<uint32_t>(spec.m_Height);
+	m_TextureHandle.m_FullMipLevels = fullMips;
+	m_TextureHandle.m_FirstResidentMip = firstMip;
+	m_TextureHandle.m_BytesPerPixel = GetBytesPerPixel();
+
+	// Only owned once the image is fully uploaded and in SHADER_READ_ONLY, that's the layout the defragmenter expects
+	createImage2DInternal(width, height, mips, format, VK_IMAGE_TILING_OPTIMAL, usageFlags, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_TextureHandle.m_TextureImage, m_TextureHandle.m_Allocation);
+	const uint32_t memoryType = m_TextureHandle.m_Allocation.m_MemoryTypeIndex;
+
+	const uint64_t mipChainSize = GetMipChainSize(format, m_TextureHandle.m_FullWidth, m_TextureHandle.m_FullHeight, firstMip, fullMips);
+	m_TextureHandle.m_RegistryId = wVkGlobals::g_ResourceRegistry.RegisterImage(m_TextureHandle.m_TextureImage, memoryType, mipChainSize, wVkResourceType::TEXTURE, m_Name, callsite);
+
+	// Transition image to a state for data to get INTO it
+	wVkHelpers::transitionImageLayout(m_TextureHandle.m_TextureImage, format, mips, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
 
-	auto& mips = m_TextureHandle.m_TexMipLevels;
-	if (generateMips)
-		mips = static_cast<uint32_t>(std::floor(std::log2(std::max(spec.m_Width, spec.m_Height)))) + 1;
+	// Mid grey until the real pixels are in, as an RGBA8 texel for block compressed textures so it goes through the encoder
+	std::vector<uint8_t> placeholder(static_cast<size_t>(blockCompressed ? wVkMipChain::BYTES_PER_PIXEL : GetBytesPerPixel()), 128);
+	if (formatInfo.m_HalfFloat) {
+		const float grey[4] = { 0.5f, 0.5f, 0.5f, 1.0f };
+		wVkPixelConverter::FloatToHalf(grey, reinterpret_cast<uint16_t*>(placeholder.data()), m_Channels);
+	}
+	if (streamed)
+		data = placeholder.data();
+
+	// 8 bit colour and RGBA16F chains are built on the CPU, filtered in linear space for sRGB, and uploaded whole.
+	// The GPU blit chain is only left for the formats stb_image_resize2 doesn't do.
+	const bool halfChain = format == VK_FORMAT_R16G16B16A16_SFLOAT;
+	const bool cpuMips = generateMips && !computeMips && !streamed && mips > 1 && data != nullptr
+		&& (format == VK_FORMAT_R8G8B8A8_UNORM || format == VK_FORMAT_R8G8B8A8_SRGB || halfChain || blockCompressed);
+	std::shared_ptr<const wVkMipChain> mipChain;
+
+	if (computeMips)
+	{
+		// Mip 0 goes up like any other texture, the rest is reduced from it in one dispatch
+		if (data != nullptr)
+			wVkGlobals::g_UploadContext.UploadToImage(m_TextureHandle.m_TextureImage, 0, width, height, GetBytesPerPixel(), data);
+		wVkHelpers::transitionImageLayout(m_TextureHandle.m_TextureImage, format, mips, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+
+		if (data != nullptr && mips > 1) {
+			VkCommandBuffer commandBuffer = wVkHelpers::beginSingleTimeCommand();
+			wVkGlobals::g_Downsampler.Record(commandBuffer, m_TextureHandle, spec.m_MipReduction);
+			wVkHelpers::endSingleTimeCommand(commandBuffer);
+		}
+	}
+	else if (cpuMips || blockCompressed)
+	{
+		// Block compressed chains are built in RGBA8 and encoded level by level, the GPU can't blit them
+		const auto* texels = static_cast<const uint8_t*>(data);
+		const bool srgb = wVkHelpers::isSrgbFormat(format);
+		const uint32_t bytesPerPixel = halfChain ? wVkMipChain::BYTES_PER_HALF_PIXEL : wVkMipChain::BYTES_PER_PIXEL;
+		std::shared_ptr<const wVkMipChain> source = cpuMips ? wVkGlobals::g_MipBuilder.Build(texels, width, height, srgb, 0, bytesPerPixel) : wVkMipBuilder::WrapLevel(texels, width, height, srgb, bytesPerPixel);
+		mipChain = blockCompressed ? wVkGlobals::g_BlockEncoder.Encode(*source, wVkHelpers::getBlockFormat(format)) : std::move(source);
+
+		wVkGlobals::g_UploadContext.UploadMipChain(m_TextureHandle.m_TextureImage, *mipChain);
+		wVkHelpers::transitionImageLayout(m_TextureHandle.m_TextureImage, format, mips, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+	}
 	else
-		mips = 1;
+	{
+		// Stream the data into the image through the staging window, render targets can start out without any
+		if (data != nullptr)
+			wVkGlobals::g_UploadContext.UploadToImage(m_TextureHandle.m_TextureImage, 0, width, height, GetBytesPerPixel(), data);
+
+		// generateMipmaps Transitions the image, if not, we do it manually.
+		if (generateMips && !streamed)
+			wVkHelpers::generateMipmaps(m_TextureHandle.m_TextureImage, format, spec.m_Width, spec.m_Height, mips);
+		else
+			wVkHelpers::transitionImageLayout(m_TextureHandle.m_TextureImage, format, 1, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+	}
 
-	m_Channels = 4;
-	m_BytesPerChannel = 1;
-	m_SizeInBytes = spec.m_Width * spec.m_Height * m_Channels;
+	m_TextureHandle.m_TextureImageView = wVkHelpers::createImageView(m_TextureHandle.m_TextureImage, mips, format, VK_IMAGE_ASPECT_COLOR_BIT);
 
-	auto format = GetVulkanFormat(spec.m_Format);
-	auto usageFlags = DetermineImageUsageFlags(spec.m_Type);
+	// Render targets and RW textures change layout behind our back, they stay pinned
+	if (spec.m_Type == TextureType::R_TEXTURE)
+		wVkGlobals::g_DeviceAllocator.SetOwner(m_TextureHandle.m_Allocation, { nullptr, &m_TextureHandle });
 
+	// Sampled textures with a CPU built chain can have their top mips evicted, the chain is kept around to bring them back
+	if (spec.m_Type == TextureType::R_TEXTURE && mipChain && mipChain->GetNumLevels() > 1)
+	{
+		m_TextureHandle.m_SourceMips = std::move(mipChain);
+		wVkGlobals::g_ResidencyManager.Register(&m_TextureHandle);
+	}
+}
 
+bool Texture::IsFormatSupported(TextureFormat format)
+{
+	// BCn sampling is optional (textureCompressionBC), mostly missing on mobile GPUs
+	if (wVkHelpers::isBlockCompressed(GetVulkanFormat(format)) && !wVkGlobals::g_DeviceCapabilities.m_TextureCompressionBC)
+		return false;
 
-	VkBuffer stagingBuffer;
-	VkDeviceMemory stagingBufferMemory;
+	VkFormatProperties properties;
+	vkGetPhysicalDeviceFormatProperties(wVkGlobals::g_PhysicalDevice, GetVulkanFormat(format), &properties);
+	return (properties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT) != 0;
+}
 
-	wVkHelpers::createBuffer(m_SizeInBytes, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory);
+void Texture::UpdateTexture(const void* data)
+{
+	const uint32_t mips = m_TextureHandle.m_TexMipLevels;
+	if (mips == 1) {
+		UpdateRegion(0, 0, 0, m_TextureHandle.m_Width, m_TextureHandle.m_Height, data);
+		return;
+	}
 
-	void* dataMappedData;
-	vkMapMemory(wVkGlobals::g_Device, stagingBufferMemory, 0, m_SizeInBytes, 0, &dataMappedData);
-	memcpy(dataMappedData, data, static_cast<size_t>(m_SizeInBytes));
-	vkUnmapMemory(wVkGlobals::g_Device, stagingBufferMemory);
+	ASSERT(!wVkHelpers::isBlockCompressed(m_TextureHandle.m_Format), "Block compressed texture %s can't be updated", m_Name.c_str());
+	ASSERT((m_Spec.m_Flags & TextureFlags::STREAMED) != TextureFlags::STREAMED, "Streamed texture %s can't be updated", m_Name.c_str());
+	ASSERT(m_TextureHandle.m_FirstResidentMip == 0, "Texture %s has evicted mips, it can't be updated", m_Name.c_str());
+	DetachSourceMips();
 
-	createImage2DInternal(spec.m_Width, spec.m_Height, mips, format, VK_IMAGE_TILING_OPTIMAL, usageFlags, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_TextureHandle.m_TextureImage, m_TextureHandle.m_TextureImageMemory);
+	const bool computeMips = (m_Spec.m_Flags & TextureFlags::MIPMAP_COMPUTE) == (TextureFlags::MIPMAP_COMPUTE)
+		&& (m_TextureHandle.m_Usage & VK_IMAGE_USAGE_STORAGE_BIT) != 0 && wVkDownsampler::IsSupported(m_TextureHandle.m_Format);
 
-	// Transition image to a state for data to get INTO it
-	wVkHelpers::transitionImageLayout(m_TextureHandle.m_TextureImage, format, mips, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+	if (computeMips)
+	{
+		UpdateRegion(0, 0, 0, m_TextureHandle.m_Width, m_TextureHandle.m_Height, data);
 
-	// Copy Buffer to that image
-	wVkHelpers::copyBufferToImage(stagingBuffer, m_TextureHandle.m_TextureImage, static_cast<uint32_t>(spec.m_Width), static_cast<uint32_t>(spec.m_Height));
+		VkCommandBuffer commandBuffer = wVkHelpers::beginSingleTimeCommand();
+		wVkGlobals::g_Downsampler.Record(commandBuffer, m_TextureHandle, m_Spec.m_MipReduction);
+		wVkHelpers::endSingleTimeCommand(commandBuffer);
+		return;
+	}
 
-	// generateMipmaps Transitions the image, if not, we do it manually.
-	if (generateMips)
-		wVkHelpers::generateMipmaps(m_TextureHandle.m_TextureImage, format, spec.m_Width, spec.m_Height, mips);
-	else
-		wVkHelpers::transitionImageLayout(m_TextureHandle.m_TextureImage, format, 1, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+	// Every mip is overwritten, nothing needs to be kept. Not through the CPU mip builder like at creation,
+	// textures that get updated would fill the mip cache with chains that are never seen again.
+	VkCommandBuffer commandBuffer = wVkHelpers::beginSingleTimeCommand();
+	wVkHelpers::recordImageBarrier(commandBuffer, m_TextureHandle.m_TextureImage, 0, mips, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+		0, VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+	wVkHelpers::endSingleTimeCommand(commandBuffer);
 
-	m_TextureHandle.m_TextureImageView = wVkHelpers::createImageView(m_TextureHandle.m_TextureImage, mips, format, VK_IMAGE_ASPECT_COLOR_BIT);
+	wVkGlobals::g_UploadContext.UploadToImage(m_TextureHandle.m_TextureImage, 0, m_TextureHandle.m_Width, m_TextureHandle.m_Height, GetBytesPerPixel(), data);
+	wVkHelpers::generateMipmaps(m_TextureHandle.m_TextureImage, m_TextureHandle.m_Format, m_TextureHandle.m_Width, m_TextureHandle.m_Height, mips);
+}
 
-	vkDestroyBuffer(wVkGlobals::g_Device, stagingBuffer, nullptr);
-	vkFreeMemory(wVkGlobals::g_Device, stagingBufferMemory, nullptr);
+void Texture::UpdateRegion(uint32_t mip, uint32_t x, uint32_t y, uint32_t width, uint32_t height, const void* data)
+{
+	ASSERT(!wVkHelpers::isBlockCompressed(m_TextureHandle.m_Format), "Block compressed texture %s can't be updated", m_Name.c_str());
+	ASSERT((m_Spec.m_Flags & TextureFlags::STREAMED) != TextureFlags::STREAMED, "Streamed texture %s can't be updated", m_Name.c_str());
+	ASSERT(m_TextureHandle.m_FirstResidentMip == 0, "Texture %s has evicted mips, it can't be updated", m_Name.c_str());
+	DetachSourceMips();
+
+	wVkGlobals::g_UploadContext.UpdateImageRegion(m_TextureHandle, mip, x, y, width, height, GetBytesPerPixel(), data);
 }
 
-void Texture::UpdateTexture(const void* data)
+void Texture::ResizeTexture(int newWidth, int newHeight)
+{
+	ASSERT(newWidth > 0 && newHeight > 0, "Texture %s can't be resized to %ix%i", m_Name.c_str(), newWidth, newHeight);
+	ASSERT((m_Spec.m_Flags & TextureFlags::STREAMED) != TextureFlags::STREAMED, "Streamed texture %s can't be resized", m_Name.c_str());
+
+	if (m_TextureHandle.m_TextureImage == VK_NULL_HANDLE || (newWidth == m_Spec.m_Width && newHeight == m_Spec.m_Height))
+		return;
+
+	DetachSourceMips();
+
+	const VkFormat format = m_TextureHandle.m_Format;
+	const uint32_t width = static_cast<uint32_t>(newWidth);
+	const uint32_t height = static_cast<uint32_t>(newHeight);
+	const uint32_t mips = m_TextureHandle.m_FullMipLevels > 1 ? wVkHelpers::getMipLevelCount(newWidth, newHeight) : 1;
+
+	VkImage image = wVkHelpers::createImage2DObject(width, height, mips, format, VK_IMAGE_TILING_OPTIMAL, m_TextureHandle.m_Usage);
+
+	VkMemoryRequirements memRequirements;
+	vkGetImageMemoryRequirements(wVkGlobals::g_Device, image, &memRequirements);
+
+	// Render targets follow the window, which mostly changes by a little, so the old memory often still fits
+	const wVkAllocation current = m_TextureHandle.m_Allocation;
+	const bool reuse = memRequirements.size <= current.m_Size && current.m_Offset % memRequirements.alignment == 0
+		&& (memRequirements.memoryTypeBits & (1u << current.m_MemoryTypeIndex)) != 0;
+
+	wVkAllocation allocation = current;
+	if (!reuse) {
+		const uint32_t memoryType = wVkHelpers::findMemoryType(memRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+		allocation = wVkGlobals::g_DeviceAllocator.Allocate(memRequirements, memoryType, wVkAllocationKind::OPTIMAL, {});
+		wVkGlobals::g_DeviceAllocator.SetOwner(current, {});
+	}
+
+	vkBindImageMemory(wVkGlobals::g_Device, image, allocation.m_Memory, allocation.m_Offset);
+
+	// The old image keeps its memory until the retire queue gets to it, unless the new one lives in it now
+	wVkGlobals::g_RetireQueue.Retire([view = m_TextureHandle.m_TextureImageView, oldImage = m_TextureHandle.m_TextureImage, oldAllocation = reuse ? wVkAllocation{} : current]()
+	{
+		vkDestroyImageView(wVkGlobals::g_Device, view, wVkGlobals::g_AllocationCallbacks);
+		vkDestroyImage(wVkGlobals::g_Device, oldImage, wVkGlobals::g_AllocationCallbacks);
+		if (oldAllocation.IsValid())
+			wVkGlobals::g_DeviceAllocator.Free(oldAllocation);
+	});
+
+	// Frames in flight may still sample the old image, out of the same memory when it's reused, the barrier waits for them
+	VkCommandBuffer commandBuffer = wVkHelpers::beginSingleTimeCommand();
+	wVkHelpers::recordImageBarrier(commandBuffer, image, 0, mips, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+		0, VK_ACCESS_SHADER_READ_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT);
+	wVkHelpers::endSingleTimeCommand(commandBuffer);
+
+	m_Spec.m_Width = newWidth;
+	m_Spec.m_Height = newHeight;
+	m_SizeInBytes = wVkHelpers::getImageSize(format, width, height);
+
+	m_TextureHandle.m_TextureImage = image;
+	m_TextureHandle.m_TextureImageView = wVkHelpers::createImageView(image, mips, format, VK_IMAGE_ASPECT_COLOR_BIT);
+	m_TextureHandle.m_Allocation = allocation;
+	m_TextureHandle.m_TexMipLevels = mips;
+	m_TextureHandle.m_Width = width;
+	m_TextureHandle.m_Height = height;
+	m_TextureHandle.m_FullWidth = width;
+	m_TextureHandle.m_FullHeight = height;
+	m_TextureHandle.m_FullMipLevels = mips;
+	m_TextureHandle.m_FirstResidentMip = 0;
+	m_TextureHandle.m_Relocations++;
+
+	if (m_Spec.m_Type == TextureType::R_TEXTURE)
+		wVkGlobals::g_DeviceAllocator.SetOwner(allocation, { nullptr, &m_TextureHandle });
+	wVkGlobals::g_ResourceRegistry.UpdateImage(m_TextureHandle.m_RegistryId, image, GetMipChainSize(format, width, height, 0, mips));
+}
+
+Texture::Texture(Texture&& other) noexcept
+	: m_Spec(other.m_Spec)
+	, m_TextureHandle(std::exchange(other.m_TextureHandle, {}))
+	, m_Channels(std::exchange(other.m_Channels, 0))
+	, m_SizeInBytes(std::exchange(other.m_SizeInBytes, 0))
+	, m_BytesPerChannel(other.m_BytesPerChannel)
+	, m_Name(std::move(other.m_Name))
 {
+	if (m_Spec.m_Type == TextureType::R_TEXTURE)
+		wVkGlobals::g_DeviceAllocator.SetOwner(m_TextureHandle.m_Allocation, { nullptr, &m_TextureHandle });
 
+	if (m_TextureHandle.m_SourceMips)
+		wVkGlobals::g_ResidencyManager.Replace(&other.m_TextureHandle, &m_TextureHandle);
+	wVkGlobals::g_TextureStreamer.Replace(&other.m_TextureHandle, &m_TextureHandle);
+}
 
+Texture& Texture::operator=(Texture&& other) noexcept
+{
+	if (this != &other)
+	{
+		Release();
+
+		m_Spec = other.m_Spec;
+		m_TextureHandle = std::exchange(other.m_TextureHandle, {});
+		m_Channels = std::exchange(other.m_Channels, 0);
+		m_SizeInBytes = std::exchange(other.m_SizeInBytes, 0);
+		m_BytesPerChannel = other.m_BytesPerChannel;
+		m_Name = std::move(other.m_Name);
+
+		if (m_Spec.m_Type == TextureType::R_TEXTURE)
+			wVkGlobals::g_DeviceAllocator.SetOwner(m_TextureHandle.m_Allocation, { nullptr, &m_TextureHandle });
+
+		if (m_TextureHandle.m_SourceMips)
+			wVkGlobals::g_ResidencyManager.Replace(&other.m_TextureHandle, &m_TextureHandle);
+		wVkGlobals::g_TextureStreamer.Replace(&other.m_TextureHandle, &m_TextureHandle);
+	}
+
+	return *this;
 }
 
-void Texture::ResizeTexture(int newWidth, int newHeight)
+void Texture::Release()
+{
+	if (m_TextureHandle.m_TextureImage == VK_NULL_HANDLE)
+		return;
+
+	// Pinned from here on, the defragmenter can't patch a handle that's about to go away
+	wVkGlobals::g_DeviceAllocator.SetOwner(m_TextureHandle.m_Allocation, {});
+	wVkGlobals::g_ResidencyManager.Unregister(&m_TextureHandle);
+	wVkGlobals::g_TextureStreamer.Cancel(&m_TextureHandle);
+
+	wVkGlobals::g_RetireQueue.Retire([view = m_TextureHandle.m_TextureImageView, image = m_TextureHandle.m_TextureImage, allocation = m_TextureHandle.m_Allocation,
+		registryId = m_TextureHandle.m_RegistryId]()
+	{
+		vkDestroyImageView(wVkGlobals::g_Device, view, wVkGlobals::g_AllocationCallbacks);
+		vkDestroyImage(wVkGlobals::g_Device, image, wVkGlobals::g_AllocationCallbacks);
+		wVkGlobals::g_DeviceAllocator.Free(allocation);
+		wVkGlobals::g_ResourceRegistry.Unregister(registryId);
+	});
+
+	m_TextureHandle = {};
+}
+
+void Texture::DetachSourceMips()
 {
+	if (!m_TextureHandle.m_SourceMips)
+		return;
 
+	wVkGlobals::g_ResidencyManager.Unregister(&m_TextureHandle);
+	m_TextureHandle.m_SourceMips.reset();
 }
 
 Texture::~Texture()
 {
-	vkDestroyImageView(wVkGlobals::g_Device, m_TextureHandle.m_TextureImageView, nullptr);
-	vkDestroyImage(wVkGlobals::g_Device, m_TextureHandle.m_TextureImage, nullptr);
-	vkFreeMemory(wVkGlobals::g_Device, m_TextureHandle.m_TextureImageMemory, nullptr);
+	Release();
 }
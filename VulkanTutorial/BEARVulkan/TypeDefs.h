@@ -1,15 +1,21 @@
 #pragma once
+#include <memory>
 #include <unordered_map>
+#include <vector>
 
 #include "vulkan/vulkan.h"
 
 #include "wVkConstants.h"
+#include "wVkDeviceAllocator.h"
+#include "wVkDirtyRanges.h"
 
 // Naming convention
 // w - wrapper
 // Vk - Vulkan
 
 enum class ShaderParameter;
+enum class TextureType;
+struct wVkMipChain;
 
 struct wVkCommandList
 {
@@ -24,6 +30,7 @@ struct wVkDescriptorHeap
 {
 	VkDescriptorPool m_Pool = VK_NULL_HANDLE;
 	VkDescriptorSet m_Handle = VK_NULL_HANDLE;
+	VkDescriptorSetLayout m_Layout = VK_NULL_HANDLE; // A single arrayed binding 0, for pipelines to include
 };
 
 enum class DataType
@@ -46,8 +53,13 @@ struct ShaderBindingData
 struct wVkPipelineLayout
 {
 	std::vector<ShaderBindingData> m_CurrentDescSetBindings;
+
+	// Keyed by the hash of the bindings combined with the frame slot, every slot gets its own set
 	std::unordered_map<std::size_t, std::vector<ShaderBindingData>> m_BindingsCache;
 	std::unordered_map<std::size_t, VkDescriptorSet> m_DescriptorSetCache;
+
+	// Sum of the bound resources' relocation counters when the cached set was written, a mismatch means it needs rewriting
+	std::unordered_map<std::size_t, uint32_t> m_DescriptorSetRelocations;
 };
 
 struct wVkComputePipeline
@@ -73,16 +85,60 @@ struct wVkRenderTarget
 struct wVkBuffer
 {
 	// For uniform resources we create 2 per frame
-	VkBuffer m_Buffers;
-	VkDeviceMemory m_BuffersMemory;
+	VkBuffer m_Buffers = VK_NULL_HANDLE;
+	wVkAllocation m_Allocation;
+
+	// What the buffer was created with, the defragmenter recreates it elsewhere
+	VkDeviceSize m_Size = 0;
+	VkBufferUsageFlags m_Usage = 0;
+
+	// Placement, picked by the memory type scoring in wVkMemory.h
+	uint32_t m_MemoryTypeIndex = UINT32_MAX;
+	VkMemoryPropertyFlags m_MemoryProperties = 0;
+
+	// Host visible memory stays mapped for the lifetime of the buffer
+	void* m_MappedData = nullptr;
+
+	// Written but not yet flushed ranges, only used for non-coherent memory
+	wVkDirtyRanges m_DirtyRanges;
+
+	// Entry in wVkGlobals::g_ResourceRegistry, 0 when not registered
+	uint64_t m_RegistryId = 0;
+
+	// Bumped every time the defragmenter moves the buffer, descriptors written before that point at the old VkBuffer
+	uint32_t m_Relocations = 0;
 };
 
 struct wVkTexture2D
 {
 	uint32_t m_TexMipLevels = 0;
 	VkImage m_TextureImage = VK_NULL_HANDLE;
-	VkDeviceMemory m_TextureImageMemory = VK_NULL_HANDLE;
+	wVkAllocation m_Allocation;
 	VkImageView m_TextureImageView = VK_NULL_HANDLE;
+
+	// What the image was created with, the defragmenter recreates it elsewhere
+	uint32_t m_Width = 0;
+	uint32_t m_Height = 0;
+	VkFormat m_Format = VK_FORMAT_UNDEFINED;
+	VkImageUsageFlags m_Usage = 0;
+	TextureType m_Type{};
+	uint32_t m_ArrayLayers = 1;
+
+	// Entry in wVkGlobals::g_ResourceRegistry, 0 when not registered
+	uint64_t m_RegistryId = 0;
+
+	// Bumped every time the texture gets a new VkImageView (defragmentation, mip residency changes),
+	// descriptors written before that point at the old one
+	uint32_t m_Relocations = 0;
+
+	// Residency, see wVkResidencyManager. m_Width, m_Height and m_TexMipLevels above describe what's resident.
+	uint32_t m_FullWidth = 0;
+	uint32_t m_FullHeight = 0;
+	uint32_t m_FullMipLevels = 0;
+	uint32_t m_FirstResidentMip = 0;
+	uint32_t m_BytesPerPixel = 0; // 0 for block compressed formats
+	uint64_t m_LastUsedFrame = 0;
+	std::shared_ptr<const wVkMipChain> m_SourceMips; // CPU built chain, only kept for textures the residency manager handles
 };
 
 struct wVkSampler
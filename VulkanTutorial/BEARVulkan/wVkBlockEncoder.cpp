@@ -0,0 +1,593 @@
+#include "wVkBlockEncoder.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#include "wVkConstants.h"
+#include "Utils/ConsoleLogger.h"
+
+constexpr uint32_t TEXELS_PER_BLOCK = 16;
+
+// One 4x4 block, a float array per channel
+struct BlockTexels
+{
+	float m_Channels[4][TEXELS_PER_BLOCK];
+};
+
+// Appends bit fields least significant bit first, the way BC7 blocks are laid out
+struct BlockBitWriter
+{
+	uint8_t* m_Data = nullptr;
+	uint32_t m_Position = 0;
+
+	void Write(uint32_t value, uint32_t numBits)
+	{
+		for (uint32_t bit = 0; bit < numBits; bit++, m_Position++) {
+			if ((value >> bit) & 1)
+				m_Data[m_Position / 8] |= static_cast<uint8_t>(1u << (m_Position % 8));
+		}
+	}
+};
+
+void LoadBlockTexels(const uint8_t* texels, BlockTexels& block)
+{
+	for (uint32_t t = 0; t < TEXELS_PER_BLOCK; t++) {
+		for (uint32_t c = 0; c < 4; c++)
+			block.m_Channels[c][t] = static_cast<float>(texels[t * 4 + c]);
+	}
+}
+
+// Mean and the direction the texels vary most in, over the first numChannels channels of the texels in mask
+void FindPrincipalAxis(const BlockTexels& block, uint32_t numChannels, const bool* mask, float* mean, float* axis)
+{
+	float count = 0.0f;
+	for (uint32_t c = 0; c < numChannels; c++)
+		mean[c] = 0.0f;
+
+	for (uint32_t t = 0; t < TEXELS_PER_BLOCK; t++) {
+		if (!mask[t])
+			continue;
+		for (uint32_t c = 0; c < numChannels; c++)
+			mean[c] += block.m_Channels[c][t];
+		count += 1.0f;
+	}
+
+	for (uint32_t c = 0; c < numChannels; c++)
+		mean[c] = count > 0.0f ? mean[c] / count : 0.0f;
+
+	float covariance[4][4] = {};
+	for (uint32_t t = 0; t < TEXELS_PER_BLOCK; t++) {
+		if (!mask[t])
+			continue;
+		for (uint32_t i = 0; i < numChannels; i++) {
+			for (uint32_t j = 0; j < numChannels; j++)
+				covariance[i][j] += (block.m_Channels[i][t] - mean[i]) * (block.m_Channels[j][t] - mean[j]);
+		}
+	}
+
+	// Power iteration, a handful of steps is plenty for a 4x4 block
+	for (uint32_t c = 0; c < numChannels; c++)
+		axis[c] = 1.0f;
+
+	for (uint32_t iteration = 0; iteration < 8; iteration++) {
+		float next[4] = {};
+		float length = 0.0f;
+		for (uint32_t i = 0; i < numChannels; i++) {
+			for (uint32_t j = 0; j < numChannels; j++)
+				next[i] += covariance[i][j] * axis[j];
+			length = std::max(length, std::fabs(next[i]));
+		}
+
+		// Flat block, any axis will do
+		if (length < 1e-6f)
+			return;
+
+		for (uint32_t c = 0; c < numChannels; c++)
+			axis[c] = next[c] / length;
+	}
+}
+
+// Endpoints at the extremes of the texels in mask along the axis
+void FindAxisEndpoints(const BlockTexels& block, uint32_t numChannels, const bool* mask, const float* mean, const float* axis, float* low, float* high)
+{
+	float axisLengthSquared = 0.0f;
+	for (uint32_t c = 0; c < numChannels; c++)
+		axisLengthSquared += axis[c] * axis[c];
+
+	float minT = 0.0f;
+	float maxT = 0.0f;
+	for (uint32_t t = 0; t < TEXELS_PER_BLOCK; t++) {
+		if (!mask[t])
+			continue;
+
+		float projection = 0.0f;
+		for (uint32_t c = 0; c < numChannels; c++)
+			projection += (block.m_Channels[c][t] - mean[c]) * axis[c];
+		projection /= axisLengthSquared;
+
+		minT = std::min(minT, projection);
+		maxT = std::max(maxT, projection);
+	}
+
+	for (uint32_t c = 0; c < numChannels; c++) {
+		low[c] = std::clamp(mean[c] + axis[c] * minT, 0.0f, 255.0f);
+		high[c] = std::clamp(mean[c] + axis[c] * maxT, 0.0f, 255.0f);
+	}
+}
+
+// Least squares endpoints for the texels in mask, given how far along from low (weight 0) to high (weight 1) each one is.
+// False when every texel got the same weight and there's nothing to solve.
+bool RefitEndpoints(const BlockTexels& block, uint32_t numChannels, const bool* mask, const float* weights, float* low, float* high)
+{
+	float lowLow = 0.0f, lowHigh = 0.0f, highHigh = 0.0f;
+	float lowX[4] = {}, highX[4] = {};
+
+	for (uint32_t t = 0; t < TEXELS_PER_BLOCK; t++) {
+		if (!mask[t])
+			continue;
+
+		const float w = weights[t];
+		lowLow += (1.0f - w) * (1.0f - w);
+		lowHigh += (1.0f - w) * w;
+		highHigh += w * w;
+		for (uint32_t c = 0; c < numChannels; c++) {
+			lowX[c] += (1.0f - w) * block.m_Channels[c][t];
+			highX[c] += w * block.m_Channels[c][t];
+		}
+	}
+
+	const float determinant = lowLow * highHigh - lowHigh * lowHigh;
+	if (std::fabs(determinant) < 1e-6f)
+		return false;
+
+	for (uint32_t c = 0; c < numChannels; c++) {
+		low[c] = std::clamp((lowX[c] * highHigh - highX[c] * lowHigh) / determinant, 0.0f, 255.0f);
+		high[c] = std::clamp((highX[c] * lowLow - lowX[c] * lowHigh) / determinant, 0.0f, 255.0f);
+	}
+
+	return true;
+}
+
+// BC1/BC3 colour ----------------------------------------------------------------------------------------------------
+
+uint16_t PackColor565(const float* rgb)
+{
+	const uint32_t r = static_cast<uint32_t>(std::lround(rgb[0] * 31.0f / 255.0f));
+	const uint32_t g = static_cast<uint32_t>(std::lround(rgb[1] * 63.0f / 255.0f));
+	const uint32_t b = static_cast<uint32_t>(std::lround(rgb[2] * 31.0f / 255.0f));
+	return static_cast<uint16_t>((r << 11) | (g << 5) | b);
+}
+
+void UnpackColor565(uint16_t color, float* rgb)
+{
+	const uint32_t r = (color >> 11) & 31;
+	const uint32_t g = (color >> 5) & 63;
+	const uint32_t b = color & 31;
+	rgb[0] = static_cast<float>((r << 3) | (r >> 2));
+	rgb[1] = static_cast<float>((g << 2) | (g >> 4));
+	rgb[2] = static_cast<float>((b << 3) | (b >> 2));
+}
+
+struct ColorBlockFit
+{
+	uint16_t m_Color0 = 0;
+	uint16_t m_Color1 = 0;
+	uint8_t m_Indices[TEXELS_PER_BLOCK] = {};
+	float m_Error = 0.0f;
+};
+
+// Quantizes the endpoints and picks the closest palette entry for every texel, the palette as the decoder builds it.
+// BC3 colour blocks always decode with 4 colours, BC1 only when color0 > color1 and with 3 and transparent otherwise.
+ColorBlockFit FitColorBlock(const BlockTexels& block, const bool* opaque, bool hasTransparent, bool alwaysFourColors, const float* endpoint0, const float* endpoint1)
+{
+	ColorBlockFit fit;
+	fit.m_Color0 = PackColor565(endpoint0);
+	fit.m_Color1 = PackColor565(endpoint1);
+
+	// Transparent texels need 3 colour mode, everything else is better off with 4
+	if (hasTransparent ? fit.m_Color0 > fit.m_Color1 : fit.m_Color0 < fit.m_Color1)
+		std::swap(fit.m_Color0, fit.m_Color1);
+
+	const bool fourColors = alwaysFourColors || fit.m_Color0 > fit.m_Color1;
+
+	float palette[4][3];
+	UnpackColor565(fit.m_Color0, palette[0]);
+	UnpackColor565(fit.m_Color1, palette[1]);
+	for (uint32_t c = 0; c < 3; c++) {
+		if (fourColors) {
+			palette[2][c] = (2.0f * palette[0][c] + palette[1][c]) / 3.0f;
+			palette[3][c] = (palette[0][c] + 2.0f * palette[1][c]) / 3.0f;
+		}
+		else {
+			palette[2][c] = (palette[0][c] + palette[1][c]) / 2.0f;
+			palette[3][c] = 0.0f;
+		}
+	}
+
+	// In 3 colour mode entry 3 is transparent black, only used for transparent texels
+	const uint32_t numOpaqueEntries = fourColors ? 4 : 3;
+
+	for (uint32_t t = 0; t < TEXELS_PER_BLOCK; t++) {
+		if (!opaque[t]) {
+			fit.m_Indices[t] = 3;
+			continue;
+		}
+
+		float bestError = FLT_MAX;
+		for (uint32_t entry = 0; entry < numOpaqueEntries; entry++) {
+			float error = 0.0f;
+			for (uint32_t c = 0; c < 3; c++) {
+				const float difference = block.m_Channels[c][t] - palette[entry][c];
+				error += difference * difference;
+			}
+
+			if (error < bestError) {
+				bestError = error;
+				fit.m_Indices[t] = static_cast<uint8_t>(entry);
+			}
+		}
+
+		fit.m_Error += bestError;
+	}
+
+	return fit;
+}
+
+void EncodeColorBlock(const BlockTexels& block, bool allowTransparent, uint8_t* output)
+{
+	bool opaque[TEXELS_PER_BLOCK];
+	bool hasTransparent = false;
+	bool hasOpaque = false;
+	for (uint32_t t = 0; t < TEXELS_PER_BLOCK; t++) {
+		opaque[t] = !allowTransparent || block.m_Channels[3][t] >= 128.0f;
+		hasTransparent |= !opaque[t];
+		hasOpaque |= opaque[t];
+	}
+
+	ColorBlockFit best;
+	if (hasOpaque) {
+		float mean[3], axis[3], low[3], high[3];
+		FindPrincipalAxis(block, 3, opaque, mean, axis);
+		FindAxisEndpoints(block, 3, opaque, mean, axis, low, high);
+
+		// Pulled in a little, the extremes are usually outliers and the interpolated entries then land better
+		for (uint32_t c = 0; c < 3; c++) {
+			const float inset = (high[c] - low[c]) / 16.0f;
+			low[c] += inset;
+			high[c] -= inset;
+		}
+
+		best = FitColorBlock(block, opaque, hasTransparent, !allowTransparent, high, low);
+
+		// Where each index sits between color1 (0) and color0 (1), as laid out by FitColorBlock
+		const bool fourColors = !allowTransparent || best.m_Color0 > best.m_Color1;
+		const float indexWeights[4] = { 1.0f, 0.0f, fourColors ? 2.0f / 3.0f : 0.5f, 1.0f / 3.0f };
+
+		float weights[TEXELS_PER_BLOCK];
+		for (uint32_t t = 0; t < TEXELS_PER_BLOCK; t++)
+			weights[t] = indexWeights[best.m_Indices[t]];
+
+		float color1[3], color0[3];
+		if (best.m_Error > 0.0f && RefitEndpoints(block, 3, opaque, weights, color1, color0)) {
+			const ColorBlockFit refit = FitColorBlock(block, opaque, hasTransparent, !allowTransparent, color0, color1);
+			if (refit.m_Error < best.m_Error)
+				best = refit;
+		}
+	}
+	else {
+		// Fully transparent, equal endpoints are 3 colour mode
+		for (uint8_t& index : best.m_Indices)
+			index = 3;
+	}
+
+	uint32_t indices = 0;
+	for (uint32_t t = 0; t < TEXELS_PER_BLOCK; t++)
+		indices |= static_cast<uint32_t>(best.m_Indices[t]) << (t * 2);
+
+	memcpy(output, &best.m_Color0, sizeof(uint16_t));
+	memcpy(output + 2, &best.m_Color1, sizeof(uint16_t));
+	memcpy(output + 4, &indices, sizeof(uint32_t));
+}
+
+// BC4/BC5 single channel ---------------------------------------------------------------------------------------------
+
+void EncodeSingleChannelBlock(const float* values, uint8_t* output)
+{
+	float minValue = 255.0f;
+	float maxValue = 0.0f;
+	for (uint32_t t = 0; t < TEXELS_PER_BLOCK; t++) {
+		minValue = std::min(minValue, values[t]);
+		maxValue = std::max(maxValue, values[t]);
+	}
+
+	const uint8_t value0 = static_cast<uint8_t>(std::lround(maxValue));
+	const uint8_t value1 = static_cast<uint8_t>(std::lround(minValue));
+	output[0] = value0;
+	output[1] = value1;
+
+	// value0 > value1 is the 8 value mode: the endpoints and 6 steps in between. Equal endpoints only need index 0.
+	float palette[8] = { static_cast<float>(value0), static_cast<float>(value1) };
+	for (uint32_t entry = 2; entry < 8; entry++)
+		palette[entry] = ((8.0f - entry) * value0 + (entry - 1.0f) * value1) / 7.0f;
+
+	uint64_t indices = 0;
+	if (value0 > value1) {
+		for (uint32_t t = 0; t < TEXELS_PER_BLOCK; t++) {
+			uint32_t bestEntry = 0;
+			float bestError = FLT_MAX;
+			for (uint32_t entry = 0; entry < 8; entry++) {
+				const float error = std::fabs(values[t] - palette[entry]);
+				if (error < bestError) {
+					bestError = error;
+					bestEntry = entry;
+				}
+			}
+
+			indices |= static_cast<uint64_t>(bestEntry) << (t * 3);
+		}
+	}
+
+	for (uint32_t byte = 0; byte < 6; byte++)
+		output[2 + byte] = static_cast<uint8_t>(indices >> (byte * 8));
+}
+
+// BC7 mode 6 ---------------------------------------------------------------------------------------------------------
+
+constexpr uint32_t BC7_WEIGHTS_4[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+struct Bc7BlockFit
+{
+	uint32_t m_Endpoints[2][4] = {}; // 7 bits per channel
+	uint32_t m_PBits[2] = {};
+	uint8_t m_Indices[TEXELS_PER_BLOCK] = {};
+	float m_Error = FLT_MAX;
+};
+
+// Tries all four p-bit pairs for the endpoints and keeps the one that decodes closest
+Bc7BlockFit FitBc7Block(const BlockTexels& block, const float* endpoint0, const float* endpoint1)
+{
+	Bc7BlockFit best;
+	for (uint32_t pBits = 0; pBits < 4; pBits++) {
+		Bc7BlockFit fit;
+		fit.m_PBits[0] = pBits & 1;
+		fit.m_PBits[1] = pBits >> 1;
+
+		// Decoded endpoints are the 7 bits followed by the p-bit
+		float decoded[2][4];
+		for (uint32_t c = 0; c < 4; c++) {
+			const float* endpoints[2] = { endpoint0, endpoint1 };
+			for (uint32_t e = 0; e < 2; e++) {
+				const float quantized = std::round((endpoints[e][c] - static_cast<float>(fit.m_PBits[e])) / 2.0f);
+				fit.m_Endpoints[e][c] = static_cast<uint32_t>(std::clamp(quantized, 0.0f, 127.0f));
+				decoded[e][c] = static_cast<float>((fit.m_Endpoints[e][c] << 1) | fit.m_PBits[e]);
+			}
+		}
+
+		float palette[16][4];
+		for (uint32_t entry = 0; entry < 16; entry++) {
+			for (uint32_t c = 0; c < 4; c++) {
+				const uint32_t e0 = static_cast<uint32_t>(decoded[0][c]);
+				const uint32_t e1 = static_cast<uint32_t>(decoded[1][c]);
+				palette[entry][c] = static_cast<float>(((64 - BC7_WEIGHTS_4[entry]) * e0 + BC7_WEIGHTS_4[entry] * e1 + 32) >> 6);
+			}
+		}
+
+		float direction[4];
+		float directionLengthSquared = 0.0f;
+		for (uint32_t c = 0; c < 4; c++) {
+			direction[c] = decoded[1][c] - decoded[0][c];
+			directionLengthSquared += direction[c] * direction[c];
+		}
+
+		// The projection onto the endpoint line gives the index to within one, the neighbours are checked for real
+		fit.m_Error = 0.0f;
+		for (uint32_t t = 0; t < TEXELS_PER_BLOCK; t++) {
+			uint32_t guess = 0;
+			if (directionLengthSquared > 0.0f) {
+				float projection = 0.0f;
+				for (uint32_t c = 0; c < 4; c++)
+					projection += (block.m_Channels[c][t] - decoded[0][c]) * direction[c];
+				guess = static_cast<uint32_t>(std::clamp(std::lround(projection / directionLengthSquared * 15.0f), 0l, 15l));
+			}
+
+			float bestError = FLT_MAX;
+			const uint32_t first = guess > 0 ? guess - 1 : 0;
+			const uint32_t last = std::min(guess + 1, 15u);
+			for (uint32_t entry = first; entry <= last; entry++) {
+				float error = 0.0f;
+				for (uint32_t c = 0; c < 4; c++) {
+					const float difference = block.m_Channels[c][t] - palette[entry][c];
+					error += difference * difference;
+				}
+
+				if (error < bestError) {
+					bestError = error;
+					fit.m_Indices[t] = static_cast<uint8_t>(entry);
+				}
+			}
+
+			fit.m_Error += bestError;
+		}
+
+		if (fit.m_Error < best.m_Error)
+			best = fit;
+	}
+
+	return best;
+}
+
+void EncodeBc7Block(const BlockTexels& block, uint8_t* output)
+{
+	static const bool allTexels[TEXELS_PER_BLOCK] = { true, true, true, true, true, true, true, true, true, true, true, true, true, true, true, true };
+
+	float mean[4], axis[4], low[4], high[4];
+	FindPrincipalAxis(block, 4, allTexels, mean, axis);
+	FindAxisEndpoints(block, 4, allTexels, mean, axis, low, high);
+
+	Bc7BlockFit best = FitBc7Block(block, low, high);
+
+	if (best.m_Error > 0.0f) {
+		float weights[TEXELS_PER_BLOCK];
+		for (uint32_t t = 0; t < TEXELS_PER_BLOCK; t++)
+			weights[t] = static_cast<float>(BC7_WEIGHTS_4[best.m_Indices[t]]) / 64.0f;
+
+		if (RefitEndpoints(block, 4, allTexels, weights, low, high)) {
+			const Bc7BlockFit refit = FitBc7Block(block, low, high);
+			if (refit.m_Error < best.m_Error)
+				best = refit;
+		}
+	}
+
+	// The index of texel 0 is stored without its top bit, which has to be 0. If it isn't, flip the endpoints around.
+	if (best.m_Indices[0] & 8) {
+		for (uint32_t c = 0; c < 4; c++)
+			std::swap(best.m_Endpoints[0][c], best.m_Endpoints[1][c]);
+		std::swap(best.m_PBits[0], best.m_PBits[1]);
+		for (uint8_t& index : best.m_Indices)
+			index = static_cast<uint8_t>(15 - index);
+	}
+
+	memset(output, 0, 16);
+	BlockBitWriter writer{ output, 0 };
+	writer.Write(1u << 6, 7); // Mode 6
+	for (uint32_t c = 0; c < 4; c++) {
+		writer.Write(best.m_Endpoints[0][c], 7);
+		writer.Write(best.m_Endpoints[1][c], 7);
+	}
+	writer.Write(best.m_PBits[0], 1);
+	writer.Write(best.m_PBits[1], 1);
+	writer.Write(best.m_Indices[0], 3);
+	for (uint32_t t = 1; t < TEXELS_PER_BLOCK; t++)
+		writer.Write(best.m_Indices[t], 4);
+}
+
+// wVkBlockEncoder ----------------------------------------------------------------------------------------------------
+
+uint32_t wVkBlockEncoder::GetBytesPerBlock(wVkBlockFormat format)
+{
+	switch (format) {
+	case wVkBlockFormat::BC1:
+	case wVkBlockFormat::BC4:
+		return 8;
+	case wVkBlockFormat::BC3:
+	case wVkBlockFormat::BC5:
+	case wVkBlockFormat::BC7:
+		return 16;
+	default:
+		return 0;
+	}
+}
+
+void wVkBlockEncoder::EncodeBlock(const uint8_t* texels, wVkBlockFormat format, uint8_t* output)
+{
+	BlockTexels block;
+	LoadBlockTexels(texels, block);
+
+	switch (format) {
+	case wVkBlockFormat::BC1:
+		EncodeColorBlock(block, true, output);
+		break;
+	case wVkBlockFormat::BC3:
+		EncodeSingleChannelBlock(block.m_Channels[3], output);
+		EncodeColorBlock(block, false, output + 8);
+		break;
+	case wVkBlockFormat::BC4:
+		EncodeSingleChannelBlock(block.m_Channels[0], output);
+		break;
+	case wVkBlockFormat::BC5:
+		EncodeSingleChannelBlock(block.m_Channels[0], output);
+		EncodeSingleChannelBlock(block.m_Channels[1], output + 8);
+		break;
+	case wVkBlockFormat::BC7:
+		EncodeBc7Block(block, output);
+		break;
+	default:
+		ASSERT(false, "Encoding to a block format that's not supported");
+	}
+}
+
+std::shared_ptr<const wVkMipChain> wVkBlockEncoder::Encode(const wVkMipChain& source, wVkBlockFormat format, uint32_t maxThreads)
+{
+	ASSERT(source.m_BlockDimension == 1, "Only RGBA8 chains can be block compressed");
+
+	if (maxThreads == 0)
+		maxThreads = std::max(std::thread::hardware_concurrency(), 1u);
+
+	auto encoded = std::make_shared<wVkMipChain>();
+	encoded->m_BlockDimension = BLOCK_DIMENSION;
+	encoded->m_BytesPerBlock = GetBytesPerBlock(format);
+	encoded->Allocate(source.m_Width, source.m_Height, source.m_Srgb, source.GetNumLevels());
+
+	const auto start = std::chrono::steady_clock::now();
+
+	for (uint32_t mip = 0; mip < source.GetNumLevels(); mip++)
+		EncodeLevel(source, *encoded, format, mip, maxThreads);
+
+	const double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	m_Stats.m_NumEncoded++;
+	m_Stats.m_SourceBytes += source.GetSize();
+	m_Stats.m_EncodedBytes += encoded->GetSize();
+	m_Stats.m_EncodeMilliseconds += milliseconds;
+
+	return encoded;
+}
+
+wVkBlockEncoder::Stats wVkBlockEncoder::GetStats()
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	return m_Stats;
+}
+
+void wVkBlockEncoder::EncodeLevel(const wVkMipChain& source, wVkMipChain& encoded, wVkBlockFormat format, uint32_t mip, uint32_t maxThreads)
+{
+	const uint32_t blocksHigh = encoded.GetLevelBlocksHigh(mip);
+	const uint32_t numBlocks = encoded.GetLevelBlocksWide(mip) * blocksHigh;
+
+	const uint32_t splits = numBlocks >= wVkConstants::g_BlockEncoderMinSplitBlocks ? std::min(maxThreads, blocksHigh) : 1;
+
+	// Every split is a band of block rows, the calling thread takes the first one
+	std::vector<std::thread> helpers;
+	for (uint32_t split = 1; split < splits; split++) {
+		helpers.emplace_back([&source, &encoded, format, mip, split, splits, blocksHigh]()
+		{
+			EncodeBlockRows(source, encoded, format, mip, blocksHigh * split / splits, blocksHigh * (split + 1) / splits);
+		});
+	}
+
+	EncodeBlockRows(source, encoded, format, mip, 0, blocksHigh / splits);
+
+	for (std::thread& helper : helpers)
+		helper.join();
+}
+
+void wVkBlockEncoder::EncodeBlockRows(const wVkMipChain& source, wVkMipChain& encoded, wVkBlockFormat format, uint32_t mip, uint32_t firstRow, uint32_t endRow)
+{
+	const uint32_t width = source.GetLevelWidth(mip);
+	const uint32_t height = source.GetLevelHeight(mip);
+	const uint32_t blocksWide = encoded.GetLevelBlocksWide(mip);
+	const uint8_t* pixels = source.GetLevel(mip);
+	uint8_t* output = encoded.m_Data.data() + encoded.m_LevelOffsets[mip];
+
+	uint8_t texels[TEXELS_PER_BLOCK * wVkMipChain::BYTES_PER_PIXEL];
+	for (uint32_t blockY = firstRow; blockY < endRow; blockY++) {
+		for (uint32_t blockX = 0; blockX < blocksWide; blockX++) {
+			// Levels that don't fill the last block repeat their edge texels into it
+			for (uint32_t y = 0; y < BLOCK_DIMENSION; y++) {
+				const uint32_t sourceY = std::min(blockY * BLOCK_DIMENSION + y, height - 1);
+				for (uint32_t x = 0; x < BLOCK_DIMENSION; x++) {
+					const uint32_t sourceX = std::min(blockX * BLOCK_DIMENSION + x, width - 1);
+					memcpy(texels + (y * BLOCK_DIMENSION + x) * wVkMipChain::BYTES_PER_PIXEL, pixels + (static_cast<size_t>(sourceY) * width + sourceX) * wVkMipChain::BYTES_PER_PIXEL, wVkMipChain::BYTES_PER_PIXEL);
+				}
+			}
+
+			EncodeBlock(texels, format, output + (static_cast<size_t>(blockY) * blocksWide + blockX) * encoded.m_BytesPerBlock);
+		}
+	}
+}
@@ -0,0 +1,53 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <mutex>
+
+#include "wVkMipBuilder.h"
+
+// What wVkBlockEncoder compresses to, NONE leaves a chain RGBA8
+enum class wVkBlockFormat
+{
+	NONE,
+	BC1, // RGB with 1 bit alpha, 8 bytes per block
+	BC3, // RGBA, a BC1 colour block and a BC4 alpha block, 16 bytes
+	BC4, // R, 8 bytes
+	BC5, // RG, two BC4 blocks, 16 bytes
+	BC7, // RGBA, always mode 6 (one subset, 7777 endpoints with p-bits, 4 bit indices), 16 bytes
+};
+
+// Compresses RGBA8 mip chains to BCn on the CPU, in the image decoder's workers for streamed textures and in Texture
+// for block compressed textures that are created from RGBA8 texels.
+// Every 4x4 block is fit along the principal axis of its texels and refit once with least squares on the indices that
+// gives. Texels are kept per channel in float arrays so the per block loops vectorize. Levels with enough blocks are
+// split over threads in bands of block rows. Safe to call from several threads at once.
+class wVkBlockEncoder
+{
+public:
+	struct Stats
+	{
+		uint64_t m_NumEncoded = 0;
+		uint64_t m_SourceBytes = 0; // RGBA8 chains that went in
+		uint64_t m_EncodedBytes = 0;
+		double m_EncodeMilliseconds = 0.0;
+	};
+
+	static constexpr uint32_t BLOCK_DIMENSION = 4;
+
+	static uint32_t GetBytesPerBlock(wVkBlockFormat format);
+
+	// maxThreads 0 uses every core, callers already running on a worker of their own pass 1
+	std::shared_ptr<const wVkMipChain> Encode(const wVkMipChain& source, wVkBlockFormat format, uint32_t maxThreads = 0);
+
+	// 16 RGBA8 texels, row by row, to one block of GetBytesPerBlock(format) bytes
+	static void EncodeBlock(const uint8_t* texels, wVkBlockFormat format, uint8_t* output);
+
+	Stats GetStats();
+
+private:
+	static void EncodeLevel(const wVkMipChain& source, wVkMipChain& encoded, wVkBlockFormat format, uint32_t mip, uint32_t maxThreads);
+	static void EncodeBlockRows(const wVkMipChain& source, wVkMipChain& encoded, wVkBlockFormat format, uint32_t mip, uint32_t firstRow, uint32_t endRow);
+
+	std::mutex m_Mutex;
+	Stats m_Stats; // Guarded by m_Mutex
+};
@@ -10,15 +10,69 @@ namespace wVkConstants {
 	constexpr uint32_t g_NumSwapChainImages = 3;
 	constexpr uint32_t g_MaxDecriptorSets = 20;
 
+	// Size of the readback ring each CommandList keeps per frame in flight, fits a 1080p RGBA8 screenshot
+	constexpr uint64_t g_ReadbackRingSize = 16ull * 1024 * 1024;
+	constexpr uint64_t g_ReadbackAlignment = 256;
+
+	// All uploads stream through this much host visible memory, regardless of the resource size
+	constexpr uint64_t g_StagingWindowSize = 32ull * 1024 * 1024;
+
+	// Buffers and Textures are sub-allocated from blocks of this size, capped to an eighth of the heap
+	constexpr uint64_t g_DeviceMemoryBlockSize = 64ull * 1024 * 1024;
+
+	// Upper bound on what a single defragmentation step copies, on top of its time budget
+	constexpr uint64_t g_DefragMaxBytesPerStep = 16ull * 1024 * 1024;
+
+	// VRAM the residency manager lets sampled textures take before it starts dropping mips of unused ones
+	constexpr uint64_t g_TextureResidencyBudget = 256ull * 1024 * 1024;
+	// Fraction of a heap's VK_EXT_memory_budget we allow before evicting regardless of the texture budget
+	constexpr float g_ResidencyHeapPressure = 0.9f;
+	// Evictions and promotions both recreate an image, this many per frame at most
+	constexpr uint32_t g_ResidencyMaxChangesPerFrame = 2;
+
+	// Mips the texture streamer uploads per frame, the first step of a frame always goes through
+	constexpr uint64_t g_StreamingBytesPerFrame = 8ull * 1024 * 1024;
+	// Streamed textures show up with their mips of this size and smaller first
+	constexpr uint32_t g_StreamingTailSize = 64;
+
+	// CPU built mip chains are written here, keyed by a hash of the top level, and read back instead of rebuilt
+	constexpr bool g_UseMipCache = true;
+	const std::string g_MipCacheDirectory = "Cache/Mips/";
+	// Everything the image decoder decodes is baked here in its final format, keyed by a hash of the source bytes,
+	// and memory mapped instead of decoded the next time. Supercompressing trades disk space for a copy of every chain on load.
+	constexpr bool g_UseBakedTextures = true;
+	const std::string g_BakedTextureDirectory = "Cache/Textures/";
+	constexpr bool g_SupercompressBakedTextures = false;
+	// Output levels smaller than this many pixels are built on one thread, splitting them costs more than it saves
+	constexpr uint32_t g_MipBuilderMinSplitPixels = 256 * 256;
+	// Same for block compression, levels with fewer 4x4 blocks than this are encoded on one thread
+	constexpr uint32_t g_BlockEncoderMinSplitBlocks = 64 * 64;
+
+	// Compute downsample dispatches that can be in flight at once, each holds a descriptor set until its frame is done
+	constexpr uint32_t g_DownsamplerMaxDescriptorSets = 64;
+
+	// Route the driver's host allocations through wVkHostAllocator instead of its own heap
+	constexpr bool g_UseTrackedHostAllocator = true;
+
 	// Validation Layers
 	const std::vector<const char*> validationLayers = {
 		"VK_LAYER_KHRONOS_validation"
 	};
 	
 
+	// Required, devices without these aren't considered. Nothing is presented headless, the swapchain is left out there.
 	const std::vector<const char*> deviceExtensions = {
 		VK_KHR_SWAPCHAIN_EXTENSION_NAME,
 
+		// The render graph draws without render passes or framebuffers, core in 1.3. Its dependencies past 1.1:
+		VK_KHR_CREATE_RENDERPASS_2_EXTENSION_NAME,
+		VK_KHR_DEPTH_STENCIL_RESOLVE_EXTENSION_NAME,
+		VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME,
+	};
+
+	// Enabled all together or not at all, see wVkDeviceCapabilities::m_RayTracing.
+	// Devices without them still run everything that isn't ray traced.
+	const std::vector<const char*> rayTracingDeviceExtensions = {
 		// Dependencies for Hardware RT Support:
 		VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME,
 		VK_KHR_DEFERRED_HOST_OPERATIONS_EXTENSION_NAME,
@@ -32,6 +86,11 @@ namespace wVkConstants {
 		VK_KHR_RAY_QUERY_EXTENSION_NAME,
 	};
 
+	// Enabled when the device has them, nothing breaks without them
+	const std::vector<const char*> optionalDeviceExtensions = {
+		VK_EXT_MEMORY_BUDGET_EXTENSION_NAME,
+	};
+
 
 #ifdef NDEBUG
 	const bool enableValidationLayers = false;
@@ -0,0 +1,266 @@
+#include "wVkDefragmenter.h"
+
+#include <algorithm>
+#include <chrono>
+#include <stdexcept>
+#include <string>
+
+#include "imgui.h"
+
+#include "TypeDefs.h"
+#include "wVkGlobalVariables.h"
+#include "Utils/ConsoleLogger.h"
+#include "wVkHelpers/wVkMemory.h"
+#include "wVkHelpers/wVkTemp.h"
+#include "wVkHelpers/wVkTexture.h"
+
+bool wVkDefragmenter::Step()
+{
+	if (!m_Enabled)
+		return false;
+
+	if (m_Cooldown > 0) {
+		m_Cooldown--;
+		return false;
+	}
+
+	wVkDeviceAllocator& allocator = wVkGlobals::g_DeviceAllocator;
+	const uint32_t blockId = allocator.FindEvacuationCandidate();
+	if (blockId == 0)
+		return false;
+
+	const auto start = std::chrono::high_resolution_clock::now();
+
+	VkCommandBuffer commandBuffer = wVkHelpers::beginSingleTimeCommand();
+
+	// Frames in flight may still write what we copy, same queue and submitted earlier so the barrier waits for them
+	VkMemoryBarrier barrier{};
+	barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	barrier.srcAccessMask = VK_ACCESS_MEMORY_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+	std::vector<MovedResource> moved;
+	uint64_t bytesMoved = 0;
+
+	for (const wVkBlockAllocation& source : allocator.GetBlockAllocations(blockId)) {
+		const float elapsedMs = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+		if (elapsedMs > m_BudgetMs)
+			break;
+
+		// Always allow one move, a resource bigger than the byte budget would block the block forever otherwise
+		if (!moved.empty() && bytesMoved + source.m_Allocation.m_Size > wVkConstants::g_DefragMaxBytesPerStep)
+			break;
+
+		bool success = false;
+		if (source.m_Owner.m_Buffer != nullptr) {
+			success = MoveBuffer(commandBuffer, source, moved);
+		}
+		else if (source.m_Owner.m_Texture != nullptr) {
+			success = MoveTexture(commandBuffer, source, moved);
+		}
+
+		if (!success) {
+			m_Stats.m_FailedMoves++;
+			break;
+		}
+
+		bytesMoved += source.m_Allocation.m_Size;
+	}
+
+	// The copies have to land before the frames after them read the new locations
+	barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+	// Not waited on, the next frame's fence covers it since it's submitted ahead of that frame.
+	// Compute lists go to the same queue (asserted at device creation), so no semaphore is needed either.
+	vkEndCommandBuffer(commandBuffer);
+
+	VkSubmitInfo submitInfo{};
+	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submitInfo.commandBufferCount = 1;
+	submitInfo.pCommandBuffers = &commandBuffer;
+	if (vkQueueSubmit(wVkGlobals::g_GraphicsQueue, 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS) {
+		throw std::runtime_error("failed to submit defragmentation command buffer!");
+	}
+
+	if (moved.empty())
+		m_Cooldown = FAILED_STEP_COOLDOWN;
+
+	m_Stats.m_NumSteps++;
+	m_Stats.m_BytesMoved += bytesMoved;
+	m_Stats.m_AllocationsMoved += moved.size();
+	m_Stats.m_LastStepMs = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+	// Frames in flight still use the old resources, and the copy reads them. The block goes back to the driver once
+	// they're freed, g_MaxFramesInFlight frames from now.
+	wVkGlobals::g_RetireQueue.Retire([this, commandBuffer, moved, bytesMoved]()
+	{
+		wVkDeviceAllocator& allocator = wVkGlobals::g_DeviceAllocator;
+		const uint64_t blocksFreedBefore = allocator.GetNumBlocksFreed();
+
+		for (const MovedResource& resource : moved) {
+			vkDestroyImageView(wVkGlobals::g_Device, resource.m_OldImageView, wVkGlobals::g_AllocationCallbacks);
+			vkDestroyImage(wVkGlobals::g_Device, resource.m_OldImage, wVkGlobals::g_AllocationCallbacks);
+			vkDestroyBuffer(wVkGlobals::g_Device, resource.m_OldBuffer, wVkGlobals::g_AllocationCallbacks);
+			allocator.Free(resource.m_OldAllocation);
+		}
+
+		vkFreeCommandBuffers(wVkGlobals::g_Device, wVkGlobals::g_CommandPool, 1, &commandBuffer);
+
+		const uint64_t blocksFreed = allocator.GetNumBlocksFreed() - blocksFreedBefore;
+		m_Stats.m_BlocksFreed += blocksFreed;
+
+		if (blocksFreed > 0)
+			LOG_INFO("Defragmentation freed %i block(s), moved %i allocations (%s)", static_cast<int>(blocksFreed), static_cast<int>(moved.size()),
+				wVkHelpers::formatBytes(bytesMoved).c_str());
+	});
+
+	return !moved.empty();
+}
+
+bool wVkDefragmenter::MoveBuffer(VkCommandBuffer commandBuffer, const wVkBlockAllocation& source, std::vector<MovedResource>& moved)
+{
+	wVkBuffer& buffer = *source.m_Owner.m_Buffer;
+
+	VkBuffer newBuffer = wVkHelpers::createBufferObject(buffer.m_Size, buffer.m_Usage);
+
+	VkMemoryRequirements memRequirements;
+	vkGetBufferMemoryRequirements(wVkGlobals::g_Device, newBuffer, &memRequirements);
+
+	const wVkAllocation allocation = wVkGlobals::g_DeviceAllocator.AllocateInExistingBlocks(memRequirements, source.m_Allocation.m_MemoryTypeIndex,
+		wVkAllocationKind::LINEAR, source.m_Owner, source.m_Allocation.m_BlockId);
+
+	if (!allocation.IsValid()) {
+		vkDestroyBuffer(wVkGlobals::g_Device, newBuffer, wVkGlobals::g_AllocationCallbacks);
+		return false;
+	}
+
+	vkBindBufferMemory(wVkGlobals::g_Device, newBuffer, allocation.m_Memory, allocation.m_Offset);
+
+	VkBufferCopy copyRegion{};
+	copyRegion.size = buffer.m_Size;
+	vkCmdCopyBuffer(commandBuffer, buffer.m_Buffers, newBuffer, 1, &copyRegion);
+
+	MovedResource resource;
+	resource.m_OldBuffer = buffer.m_Buffers;
+	resource.m_OldAllocation = buffer.m_Allocation;
+	moved.push_back(resource);
+
+	// Pinned until it's freed, so the block isn't picked again while it's retiring
+	wVkGlobals::g_DeviceAllocator.SetOwner(resource.m_OldAllocation, {});
+
+	buffer.m_Buffers = newBuffer;
+	buffer.m_Allocation = allocation;
+	buffer.m_MappedData = allocation.m_MappedData;
+	buffer.m_Relocations++;
+
+	return true;
+}
+
+bool wVkDefragmenter::MoveTexture(VkCommandBuffer commandBuffer, const wVkBlockAllocation& source, std::vector<MovedResource>& moved)
+{
+	wVkTexture2D& texture = *source.m_Owner.m_Texture;
+	const uint32_t mips = texture.m_TexMipLevels;
+
+	// Only these are ever given an owner, anything else could be in a layout we don't know about
+	ASSERT(texture.m_Type == TextureType::R_TEXTURE, "Only R_TEXTURE textures can be moved");
+	ASSERT(texture.m_ArrayLayers == 1, "Texture arrays can't be moved, got %d layers", static_cast<int>(texture.m_ArrayLayers));
+
+	VkImage newImage = wVkHelpers::createImage2DObject(texture.m_Width, texture.m_Height, mips, texture.m_Format, VK_IMAGE_TILING_OPTIMAL, texture.m_Usage);
+
+	VkMemoryRequirements memRequirements;
+	vkGetImageMemoryRequirements(wVkGlobals::g_Device, newImage, &memRequirements);
+
+	const wVkAllocation allocation = wVkGlobals::g_DeviceAllocator.AllocateInExistingBlocks(memRequirements, source.m_Allocation.m_MemoryTypeIndex,
+		wVkAllocationKind::OPTIMAL, source.m_Owner, source.m_Allocation.m_BlockId);
+
+	if (!allocation.IsValid()) {
+		vkDestroyImage(wVkGlobals::g_Device, newImage, wVkGlobals::g_AllocationCallbacks);
+		return false;
+	}
+
+	vkBindImageMemory(wVkGlobals::g_Device, newImage, allocation.m_Memory, allocation.m_Offset);
+
+	// Textures rest in SHADER_READ between command lists (see TextureLayout), the old image doesn't need to go back.
+	// Frames in flight may still sample it, the transition waits for them.
+	const VkImageLayout restingLayout = wVkHelpers::getVulkanLayout(TextureLayout::SHADER_READ);
+	wVkHelpers::recordImageBarrier(commandBuffer, texture.m_TextureImage, 0, mips, restingLayout, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+		VK_ACCESS_MEMORY_WRITE_BIT, VK_ACCESS_TRANSFER_READ_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+	wVkHelpers::recordImageBarrier(commandBuffer, newImage, 0, mips, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+		0, VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+
+	std::vector<VkImageCopy> regions(mips);
+	for (uint32_t mip = 0; mip < mips; mip++) {
+		VkImageCopy& region = regions[mip];
+		region = {};
+		region.srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, mip, 0, 1 };
+		region.dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, mip, 0, 1 };
+		region.extent = { std::max(texture.m_Width >> mip, 1u), std::max(texture.m_Height >> mip, 1u), 1 };
+	}
+
+	vkCmdCopyImage(commandBuffer, texture.m_TextureImage, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, newImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, mips, regions.data());
+
+	wVkHelpers::recordImageBarrier(commandBuffer, newImage, 0, mips, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, restingLayout,
+		VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT);
+
+	MovedResource resource;
+	resource.m_OldImage = texture.m_TextureImage;
+	resource.m_OldImageView = texture.m_TextureImageView;
+	resource.m_OldAllocation = texture.m_Allocation;
+	moved.push_back(resource);
+
+	wVkGlobals::g_DeviceAllocator.SetOwner(resource.m_OldAllocation, {});
+
+	texture.m_TextureImage = newImage;
+	texture.m_TextureImageView = wVkHelpers::createImageView(newImage, mips, texture.m_Format, VK_IMAGE_ASPECT_COLOR_BIT);
+	texture.m_Allocation = allocation;
+	texture.m_Relocations++;
+
+	return true;
+}
+
+void wVkDefragmenter::DrawImGuiPanel()
+{
+	ImGui::Begin("Defragmenter");
+
+	ImGui::Checkbox("Enabled", &m_Enabled);
+	ImGui::SliderFloat("Budget (ms)", &m_BudgetMs, 0.1f, 8.0f, "%.1f");
+
+	ImGui::Text("Steps: %llu, last step %.3f ms", static_cast<unsigned long long>(m_Stats.m_NumSteps), m_Stats.m_LastStepMs);
+	ImGui::Text("Moved: %llu allocations, %s", static_cast<unsigned long long>(m_Stats.m_AllocationsMoved), wVkHelpers::formatBytes(m_Stats.m_BytesMoved).c_str());
+	ImGui::Text("Blocks freed: %llu, failed moves: %llu", static_cast<unsigned long long>(m_Stats.m_BlocksFreed), static_cast<unsigned long long>(m_Stats.m_FailedMoves));
+	ImGui::Text("Fragmentation: %.1f%%", wVkGlobals::g_DeviceAllocator.GetFragmentation() * 100.0f);
+
+	const std::vector<wVkMemoryBlockInfo> blocks = wVkGlobals::g_DeviceAllocator.GetBlocks();
+
+	if (ImGui::BeginTable("DeviceMemoryBlocks", 6, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg | ImGuiTableFlags_SizingFixedFit))
+	{
+		ImGui::TableSetupColumn("Block");
+		ImGui::TableSetupColumn("Memory type");
+		ImGui::TableSetupColumn("Kind");
+		ImGui::TableSetupColumn("Allocations");
+		ImGui::TableSetupColumn("Largest free");
+		ImGui::TableSetupColumn("Usage", ImGuiTableColumnFlags_WidthStretch);
+		ImGui::TableHeadersRow();
+
+		for (const wVkMemoryBlockInfo& block : blocks)
+		{
+			const float fraction = block.m_Size != 0 ? static_cast<float>(static_cast<double>(block.m_UsedBytes) / static_cast<double>(block.m_Size)) : 0.0f;
+			const std::string overlay = wVkHelpers::formatBytes(block.m_UsedBytes) + " / " + wVkHelpers::formatBytes(block.m_Size);
+
+			ImGui::TableNextRow();
+			ImGui::TableNextColumn(); ImGui::Text("%u%s", block.m_Id, block.m_Dedicated ? " (dedicated)" : "");
+			ImGui::TableNextColumn(); ImGui::Text("%u", block.m_MemoryTypeIndex);
+			ImGui::TableNextColumn(); ImGui::TextUnformatted(block.m_Kind == wVkAllocationKind::LINEAR ? "Linear" : "Optimal");
+			ImGui::TableNextColumn(); ImGui::Text("%u", block.m_NumAllocations);
+			ImGui::TableNextColumn(); ImGui::TextUnformatted(wVkHelpers::formatBytes(block.m_LargestFreeRange).c_str());
+			ImGui::TableNextColumn(); ImGui::ProgressBar(fraction, ImVec2(-1.0f, 0.0f), overlay.c_str());
+		}
+
+		ImGui::EndTable();
+	}
+
+	ImGui::End();
+}
@@ -0,0 +1,61 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+#include "vulkan/vulkan.h"
+
+#include "wVkDeviceAllocator.h"
+
+struct wVkDefragmentationStats
+{
+	uint64_t m_NumSteps = 0;
+	uint64_t m_BytesMoved = 0;
+	uint64_t m_AllocationsMoved = 0;
+	uint64_t m_BlocksFreed = 0;
+	uint64_t m_FailedMoves = 0; // Nothing else had room, the step gave up on its block
+	float m_LastStepMs = 0.0f;
+};
+
+// Incremental compaction of wVkGlobals::g_DeviceAllocator.
+// Each step picks the least used block, copies the resources in it into the other blocks of the same memory type
+// on the GPU and swaps the handles on their owners. Once the block is empty the allocator gives it back to the driver.
+// Moved resources bump their m_Relocations, whoever caches descriptors for them compares that to know when to rewrite.
+// A step never waits on the GPU. Its copies are ordered after the frames in flight and the old resources are retired,
+// call it between frames once the frame's fence has been waited on. Host visible buffers are pinned, see Buffer.cpp.
+class wVkDefragmenter
+{
+public:
+	// Stops moving once the time budget or wVkConstants::g_DefragMaxBytesPerStep is reached, whatever is left goes next step.
+	// Returns true if anything was moved.
+	bool Step();
+
+	void SetEnabled(bool enabled) { m_Enabled = enabled; }
+	bool IsEnabled() const { return m_Enabled; }
+	void SetBudgetMs(float budgetMs) { m_BudgetMs = budgetMs; }
+	float GetBudgetMs() const { return m_BudgetMs; }
+
+	const wVkDefragmentationStats& GetStats() const { return m_Stats; }
+
+	void DrawImGuiPanel();
+
+private:
+	// What a move replaced, retired once the copies are recorded
+	struct MovedResource
+	{
+		VkBuffer m_OldBuffer = VK_NULL_HANDLE;
+		VkImage m_OldImage = VK_NULL_HANDLE;
+		VkImageView m_OldImageView = VK_NULL_HANDLE;
+		wVkAllocation m_OldAllocation;
+	};
+
+	bool MoveBuffer(VkCommandBuffer commandBuffer, const wVkBlockAllocation& source, std::vector<MovedResource>& moved);
+	bool MoveTexture(VkCommandBuffer commandBuffer, const wVkBlockAllocation& source, std::vector<MovedResource>& moved);
+
+	// Steps skipped after one that couldn't move anything, so a stuck block doesn't cost a submit every frame
+	static constexpr uint32_t FAILED_STEP_COOLDOWN = 120;
+
+	bool m_Enabled = true;
+	float m_BudgetMs = 1.0f;
+	uint32_t m_Cooldown = 0;
+	wVkDefragmentationStats m_Stats;
+};
@@ -0,0 +1,349 @@
+#include "wVkDeviceAllocator.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <utility>
+
+#include "wVkGlobalVariables.h"
+#include "Utils/ConsoleLogger.h"
+#include "wVkHelpers/wVkMemory.h"
+
+VkDeviceSize AlignUp(VkDeviceSize value, VkDeviceSize alignment)
+{
+	return alignment == 0 ? value : (value + alignment - 1) / alignment * alignment;
+}
+
+wVkAllocation wVkDeviceAllocator::Allocate(const VkMemoryRequirements& requirements, uint32_t memoryTypeIndex, wVkAllocationKind kind, const wVkAllocationOwner& owner)
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+
+	wVkAllocation allocation;
+	const VkDeviceSize blockSize = GetBlockSize(memoryTypeIndex);
+
+	if (requirements.size > blockSize / 2) {
+		Block& block = CreateBlock(requirements.size, memoryTypeIndex, kind, true);
+		TryAllocateInBlock(block, requirements, owner, allocation);
+		return allocation;
+	}
+
+	for (auto& [id, block] : m_Blocks) {
+		if (block.m_Dedicated || block.m_MemoryTypeIndex != memoryTypeIndex || block.m_Kind != kind)
+			continue;
+
+		if (TryAllocateInBlock(block, requirements, owner, allocation))
+			return allocation;
+	}
+
+	Block& block = CreateBlock(blockSize, memoryTypeIndex, kind, false);
+	TryAllocateInBlock(block, requirements, owner, allocation);
+	return allocation;
+}
+
+wVkAllocation wVkDeviceAllocator::AllocateInExistingBlocks(const VkMemoryRequirements& requirements, uint32_t memoryTypeIndex, wVkAllocationKind kind, const wVkAllocationOwner& owner, uint32_t excludedBlockId)
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+
+	// Fullest block first, that's what keeps the others emptying out
+	std::vector<Block*> candidates;
+	for (auto& [id, block] : m_Blocks) {
+		if (id != excludedBlockId && !block.m_Dedicated && block.m_MemoryTypeIndex == memoryTypeIndex && block.m_Kind == kind)
+			candidates.push_back(&block);
+	}
+
+	std::sort(candidates.begin(), candidates.end(), [](const Block* a, const Block* b) { return a->m_UsedBytes > b->m_UsedBytes; });
+
+	wVkAllocation allocation;
+	for (Block* block : candidates) {
+		if (TryAllocateInBlock(*block, requirements, owner, allocation))
+			break;
+	}
+
+	return allocation;
+}
+
+void wVkDeviceAllocator::Free(const wVkAllocation& allocation)
+{
+	if (!allocation.IsValid())
+		return;
+
+	std::lock_guard<std::mutex> lock(m_Mutex);
+
+	auto blockIt = m_Blocks.find(allocation.m_BlockId);
+	if (blockIt == m_Blocks.end())
+		return;
+
+	Block& block = blockIt->second;
+	auto it = block.m_Allocations.find(allocation.m_Offset);
+	ASSERT(it != block.m_Allocations.end(), "Freeing an allocation at offset %i that isn't in block %i", static_cast<int>(allocation.m_Offset), static_cast<int>(block.m_Id));
+	if (it == block.m_Allocations.end())
+		return;
+
+	block.m_UsedBytes -= it->second.m_Size;
+	block.m_Allocations.erase(it);
+
+	if (!block.m_Allocations.empty())
+		return;
+
+	// Keep one empty block around per memory type, so a resource that's recreated every frame doesn't hit vkAllocateMemory
+	if (block.m_Dedicated || CountSiblingBlocks(block) > 0) {
+		DestroyBlock(block);
+		m_Blocks.erase(blockIt);
+		m_NumBlocksFreed++;
+	}
+}
+
+void wVkDeviceAllocator::SetOwner(const wVkAllocation& allocation, const wVkAllocationOwner& owner)
+{
+	if (!allocation.IsValid())
+		return;
+
+	std::lock_guard<std::mutex> lock(m_Mutex);
+
+	auto blockIt = m_Blocks.find(allocation.m_BlockId);
+	if (blockIt == m_Blocks.end())
+		return;
+
+	auto it = blockIt->second.m_Allocations.find(allocation.m_Offset);
+	if (it != blockIt->second.m_Allocations.end())
+		it->second.m_Owner = owner;
+}
+
+uint32_t wVkDeviceAllocator::FindEvacuationCandidate() const
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+
+	const Block* best = nullptr;
+	for (const auto& [id, block] : m_Blocks) {
+		if (block.m_Dedicated || block.m_Allocations.empty() || CountSiblingBlocks(block) == 0)
+			continue;
+
+		if (best != nullptr && block.m_UsedBytes >= best->m_UsedBytes)
+			continue;
+
+		// Pinned allocations keep the block alive anyway, moving the rest out gains nothing
+		bool allMovable = true;
+		for (const auto& [offset, subAllocation] : block.m_Allocations)
+			allMovable &= subAllocation.m_Owner.IsMovable();
+
+		if (!allMovable)
+			continue;
+
+		// Only worth it if the siblings can take everything, checked on total free space.
+		// Alignment or scattered free ranges can still make a move fail, the defragmenter stops the step when that happens.
+		VkDeviceSize siblingFreeBytes = 0;
+		for (const auto& [otherId, other] : m_Blocks) {
+			if (otherId != id && !other.m_Dedicated && other.m_MemoryTypeIndex == block.m_MemoryTypeIndex && other.m_Kind == block.m_Kind)
+				siblingFreeBytes += other.m_Size - other.m_UsedBytes;
+		}
+
+		if (siblingFreeBytes >= block.m_UsedBytes)
+			best = &block;
+	}
+
+	return best != nullptr ? best->m_Id : 0;
+}
+
+std::vector<wVkBlockAllocation> wVkDeviceAllocator::GetBlockAllocations(uint32_t blockId) const
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+
+	std::vector<wVkBlockAllocation> allocations;
+
+	auto blockIt = m_Blocks.find(blockId);
+	if (blockIt == m_Blocks.end())
+		return allocations;
+
+	const Block& block = blockIt->second;
+	allocations.reserve(block.m_Allocations.size());
+
+	for (const auto& [offset, subAllocation] : block.m_Allocations) {
+		wVkBlockAllocation entry;
+		entry.m_Allocation.m_Memory = block.m_Memory;
+		entry.m_Allocation.m_Offset = offset;
+		entry.m_Allocation.m_Size = subAllocation.m_Size;
+		entry.m_Allocation.m_BlockSize = block.m_Size;
+		entry.m_Allocation.m_MemoryTypeIndex = block.m_MemoryTypeIndex;
+		entry.m_Allocation.m_BlockId = block.m_Id;
+		entry.m_Allocation.m_MappedData = block.m_MappedData != nullptr ? static_cast<char*>(block.m_MappedData) + offset : nullptr;
+		entry.m_Owner = subAllocation.m_Owner;
+		allocations.push_back(entry);
+	}
+
+	return allocations;
+}
+
+std::vector<wVkMemoryBlockInfo> wVkDeviceAllocator::GetBlocks() const
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+
+	std::vector<wVkMemoryBlockInfo> blocks;
+	blocks.reserve(m_Blocks.size());
+
+	for (const auto& [id, block] : m_Blocks) {
+		wVkMemoryBlockInfo info;
+		info.m_Id = id;
+		info.m_MemoryTypeIndex = block.m_MemoryTypeIndex;
+		info.m_Kind = block.m_Kind;
+		info.m_Dedicated = block.m_Dedicated;
+		info.m_Size = block.m_Size;
+		info.m_UsedBytes = block.m_UsedBytes;
+		info.m_LargestFreeRange = GetLargestFreeRange(block);
+		info.m_NumAllocations = static_cast<uint32_t>(block.m_Allocations.size());
+		blocks.push_back(info);
+	}
+
+	std::sort(blocks.begin(), blocks.end(), [](const wVkMemoryBlockInfo& a, const wVkMemoryBlockInfo& b) { return a.m_Id < b.m_Id; });
+	return blocks;
+}
+
+uint64_t wVkDeviceAllocator::GetNumBlocksFreed() const
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	return m_NumBlocksFreed;
+}
+
+float wVkDeviceAllocator::GetFragmentation() const
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+
+	// Free space that isn't part of the largest free range of its block is the fragmented part
+	VkDeviceSize totalFree = 0;
+	VkDeviceSize largestFree = 0;
+	for (const auto& [id, block] : m_Blocks) {
+		if (block.m_Dedicated)
+			continue;
+
+		totalFree += block.m_Size - block.m_UsedBytes;
+		largestFree += GetLargestFreeRange(block);
+	}
+
+	if (totalFree == 0)
+		return 0.0f;
+
+	return 1.0f - static_cast<float>(static_cast<double>(largestFree) / static_cast<double>(totalFree));
+}
+
+void wVkDeviceAllocator::Destroy()
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+
+	for (auto& [id, block] : m_Blocks) {
+		if (!block.m_Allocations.empty())
+			LOG_WARNING("Device memory block %i still has %i allocations on shutdown", static_cast<int>(id), static_cast<int>(block.m_Allocations.size()));
+
+		DestroyBlock(block);
+	}
+
+	m_Blocks.clear();
+}
+
+wVkDeviceAllocator::Block& wVkDeviceAllocator::CreateBlock(VkDeviceSize size, uint32_t memoryTypeIndex, wVkAllocationKind kind, bool dedicated)
+{
+	VkMemoryAllocateInfo allocInfo{};
+	allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+	allocInfo.allocationSize = size;
+	allocInfo.memoryTypeIndex = memoryTypeIndex;
+
+	Block block;
+	if (vkAllocateMemory(wVkGlobals::g_Device, &allocInfo, wVkGlobals::g_AllocationCallbacks, &block.m_Memory) != VK_SUCCESS) {
+		throw std::runtime_error("failed to allocate device memory block!");
+	}
+
+	block.m_Id = m_NextBlockId++;
+	block.m_Size = size;
+	block.m_MemoryTypeIndex = memoryTypeIndex;
+	block.m_Kind = kind;
+	block.m_Dedicated = dedicated;
+
+	if (wVkHelpers::getMemoryTypeProperties(memoryTypeIndex) & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
+		if (vkMapMemory(wVkGlobals::g_Device, block.m_Memory, 0, VK_WHOLE_SIZE, 0, &block.m_MappedData) != VK_SUCCESS) {
+			throw std::runtime_error("failed to map device memory block!");
+		}
+	}
+
+	return m_Blocks.emplace(block.m_Id, std::move(block)).first->second;
+}
+
+void wVkDeviceAllocator::DestroyBlock(Block& block)
+{
+	if (block.m_MappedData != nullptr)
+		vkUnmapMemory(wVkGlobals::g_Device, block.m_Memory);
+
+	vkFreeMemory(wVkGlobals::g_Device, block.m_Memory, wVkGlobals::g_AllocationCallbacks);
+	block.m_Memory = VK_NULL_HANDLE;
+	block.m_MappedData = nullptr;
+}
+
+bool wVkDeviceAllocator::TryAllocateInBlock(Block& block, const VkMemoryRequirements& requirements, const wVkAllocationOwner& owner, wVkAllocation& allocation)
+{
+	if (block.m_Size - block.m_UsedBytes < requirements.size)
+		return false;
+
+	// First fit, walk the gaps between allocations in offset order
+	VkDeviceSize cursor = 0;
+	VkDeviceSize offset = UINT64_MAX;
+	for (const auto& [allocationOffset, subAllocation] : block.m_Allocations) {
+		const VkDeviceSize candidate = AlignUp(cursor, requirements.alignment);
+		if (candidate + requirements.size <= allocationOffset) {
+			offset = candidate;
+			break;
+		}
+
+		cursor = allocationOffset + subAllocation.m_Size;
+	}
+
+	if (offset == UINT64_MAX) {
+		const VkDeviceSize candidate = AlignUp(cursor, requirements.alignment);
+		if (candidate + requirements.size > block.m_Size)
+			return false;
+
+		offset = candidate;
+	}
+
+	block.m_Allocations[offset] = { requirements.size, owner };
+	block.m_UsedBytes += requirements.size;
+
+	allocation.m_Memory = block.m_Memory;
+	allocation.m_Offset = offset;
+	allocation.m_Size = requirements.size;
+	allocation.m_BlockSize = block.m_Size;
+	allocation.m_MemoryTypeIndex = block.m_MemoryTypeIndex;
+	allocation.m_BlockId = block.m_Id;
+	allocation.m_MappedData = block.m_MappedData != nullptr ? static_cast<char*>(block.m_MappedData) + offset : nullptr;
+	return true;
+}
+
+uint32_t wVkDeviceAllocator::CountSiblingBlocks(const Block& block) const
+{
+	uint32_t count = 0;
+	for (const auto& [id, other] : m_Blocks) {
+		if (id != block.m_Id && !other.m_Dedicated && other.m_MemoryTypeIndex == block.m_MemoryTypeIndex && other.m_Kind == block.m_Kind)
+			count++;
+	}
+
+	return count;
+}
+
+VkDeviceSize wVkDeviceAllocator::GetLargestFreeRange(const Block& block)
+{
+	VkDeviceSize largest = 0;
+	VkDeviceSize cursor = 0;
+	for (const auto& [offset, subAllocation] : block.m_Allocations) {
+		largest = std::max(largest, offset - cursor);
+		cursor = offset + subAllocation.m_Size;
+	}
+
+	return std::max(largest, block.m_Size - cursor);
+}
+
+VkDeviceSize wVkDeviceAllocator::GetBlockSize(uint32_t memoryTypeIndex)
+{
+	uint32_t heapIndex = 0;
+	wVkHelpers::getMemoryTypeProperties(memoryTypeIndex, &heapIndex);
+
+	VkPhysicalDeviceMemoryProperties memProperties;
+	vkGetPhysicalDeviceMemoryProperties(wVkGlobals::g_PhysicalDevice, &memProperties);
+
+	// Small heaps (the 256MB BAR window) would be eaten by a couple of blocks
+	return std::min(wVkConstants::g_DeviceMemoryBlockSize, memProperties.memoryHeaps[heapIndex].size / 8);
+}
@@ -0,0 +1,129 @@
+#pragma once
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "vulkan/vulkan.h"
+
+struct wVkBuffer;
+struct wVkTexture2D;
+
+// Buffers and optimal tiled images never share a block, so bufferImageGranularity can't bite us
+enum class wVkAllocationKind
+{
+	LINEAR,
+	OPTIMAL,
+};
+
+// A range inside one of the allocator's memory blocks, bind with m_Memory + m_Offset
+struct wVkAllocation
+{
+	VkDeviceMemory m_Memory = VK_NULL_HANDLE;
+	VkDeviceSize m_Offset = 0;
+	VkDeviceSize m_Size = 0;
+	VkDeviceSize m_BlockSize = 0;
+	uint32_t m_MemoryTypeIndex = UINT32_MAX;
+	uint32_t m_BlockId = 0;
+
+	// Points at m_Offset inside the persistently mapped block, nullptr when the memory isn't host visible
+	void* m_MappedData = nullptr;
+
+	bool IsValid() const { return m_Memory != VK_NULL_HANDLE; }
+};
+
+// The resource living in an allocation, the defragmenter moves it and patches the handles.
+// Allocations without an owner are pinned.
+struct wVkAllocationOwner
+{
+	wVkBuffer* m_Buffer = nullptr;
+	wVkTexture2D* m_Texture = nullptr;
+
+	bool IsMovable() const { return m_Buffer != nullptr || m_Texture != nullptr; }
+};
+
+struct wVkBlockAllocation
+{
+	wVkAllocation m_Allocation;
+	wVkAllocationOwner m_Owner;
+};
+
+struct wVkMemoryBlockInfo
+{
+	uint32_t m_Id = 0;
+	uint32_t m_MemoryTypeIndex = 0;
+	wVkAllocationKind m_Kind = wVkAllocationKind::LINEAR;
+	bool m_Dedicated = false;
+	VkDeviceSize m_Size = 0;
+	VkDeviceSize m_UsedBytes = 0;
+	VkDeviceSize m_LargestFreeRange = 0;
+	uint32_t m_NumAllocations = 0;
+};
+
+// Sub-allocates Buffer and Texture memory out of large blocks per memory type.
+// Placement is first fit, freed ranges merge with their neighbours simply by not being in the block's map anymore.
+// Resources bigger than half a block get a dedicated block of their own, those are never defragmented.
+// Host visible blocks stay mapped for their whole lifetime.
+class wVkDeviceAllocator
+{
+public:
+	wVkAllocation Allocate(const VkMemoryRequirements& requirements, uint32_t memoryTypeIndex, wVkAllocationKind kind, const wVkAllocationOwner& owner);
+
+	// Only places into blocks that already exist, skipping excludedBlockId. Returns an invalid allocation when nothing fits.
+	wVkAllocation AllocateInExistingBlocks(const VkMemoryRequirements& requirements, uint32_t memoryTypeIndex, wVkAllocationKind kind, const wVkAllocationOwner& owner, uint32_t excludedBlockId);
+
+	// Empty blocks are given back to the driver, except the last block of a memory type and kind
+	void Free(const wVkAllocation& allocation);
+
+	// Resources re-point their allocation when they are moved in memory (C++ moves, not defragmentation)
+	void SetOwner(const wVkAllocation& allocation, const wVkAllocationOwner& owner);
+
+	// The least used block of a memory type and kind that has siblings, as long as all of its allocations
+	// are movable and fit into the free space of those siblings. 0 when there's nothing worth compacting.
+	uint32_t FindEvacuationCandidate() const;
+	std::vector<wVkBlockAllocation> GetBlockAllocations(uint32_t blockId) const;
+
+	std::vector<wVkMemoryBlockInfo> GetBlocks() const;
+	uint64_t GetNumBlocksFreed() const;
+
+	// 0 when all free space is one range per block, towards 1 the more it's scattered
+	float GetFragmentation() const;
+
+	// Frees all blocks. Call after the retire queue has been flushed, before the device is destroyed.
+	void Destroy();
+
+private:
+	struct SubAllocation
+	{
+		VkDeviceSize m_Size = 0;
+		wVkAllocationOwner m_Owner;
+	};
+
+	struct Block
+	{
+		uint32_t m_Id = 0;
+		VkDeviceMemory m_Memory = VK_NULL_HANDLE;
+		VkDeviceSize m_Size = 0;
+		uint32_t m_MemoryTypeIndex = 0;
+		wVkAllocationKind m_Kind = wVkAllocationKind::LINEAR;
+		bool m_Dedicated = false;
+		void* m_MappedData = nullptr;
+
+		VkDeviceSize m_UsedBytes = 0;
+		std::map<VkDeviceSize, SubAllocation> m_Allocations; // By offset
+	};
+
+	Block& CreateBlock(VkDeviceSize size, uint32_t memoryTypeIndex, wVkAllocationKind kind, bool dedicated);
+	void DestroyBlock(Block& block);
+	bool TryAllocateInBlock(Block& block, const VkMemoryRequirements& requirements, const wVkAllocationOwner& owner, wVkAllocation& allocation);
+	uint32_t CountSiblingBlocks(const Block& block) const;
+
+	static VkDeviceSize GetLargestFreeRange(const Block& block);
+	static VkDeviceSize GetBlockSize(uint32_t memoryTypeIndex);
+
+	mutable std::mutex m_Mutex;
+	std::unordered_map<uint32_t, Block> m_Blocks;
+	uint32_t m_NextBlockId = 1;
+	uint64_t m_NumBlocksFreed = 0;
+};
@@ -0,0 +1,49 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+// Tracks which byte ranges of a mapped allocation were written since the last flush.
+// Overlapping and touching ranges are merged on insert, so a flush covers each byte at most once.
+class wVkDirtyRanges
+{
+public:
+	struct Range
+	{
+		uint64_t m_Begin = 0;
+		uint64_t m_End = 0; // Exclusive
+	};
+
+	// Ranges closer than mergeDistance get merged, pass the flush granularity to avoid flushing the same atom twice
+	void Add(uint64_t offset, uint64_t size, uint64_t mergeDistance = 0)
+	{
+		if (size == 0)
+			return;
+
+		Range added{ offset, offset + size };
+
+		// First range that could touch the new one
+		auto it = std::lower_bound(m_Ranges.begin(), m_Ranges.end(), added.m_Begin, [mergeDistance](const Range& range, uint64_t begin)
+		{
+			return range.m_End + mergeDistance < begin;
+		});
+
+		// Swallow every range it touches
+		auto last = it;
+		while (last != m_Ranges.end() && last->m_Begin <= added.m_End + mergeDistance) {
+			added.m_Begin = std::min(added.m_Begin, last->m_Begin);
+			added.m_End = std::max(added.m_End, last->m_End);
+			++last;
+		}
+
+		it = m_Ranges.erase(it, last);
+		m_Ranges.insert(it, added);
+	}
+
+	void Clear() { m_Ranges.clear(); }
+	bool IsEmpty() const { return m_Ranges.empty(); }
+	const std::vector<Range>& GetRanges() const { return m_Ranges; }
+
+private:
+	std::vector<Range> m_Ranges; // Sorted, non-overlapping
+};
@@ -0,0 +1,332 @@
+#include "wVkDownsampler.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <vector>
+
+#include "wVkConstants.h"
+#include "wVkGlobalVariables.h"
+#include "Utils/ConsoleLogger.h"
+#include "wVkHelpers/wVkCommands.h"
+#include "wVkHelpers/wVkHelpers.h"
+#include "wVkHelpers/wVkMemory.h"
+#include "wVkHelpers/wVkTemp.h"
+#include "wVkHelpers/wVkTexture.h"
+
+// Matches the push constants of downsample.comp
+struct DownsampleConstants
+{
+	uint32_t m_SrcWidth = 0;
+	uint32_t m_SrcHeight = 0;
+	uint32_t m_NumMips = 0;
+	uint32_t m_NumWorkGroups = 0;
+};
+
+// Storage image format the shader variant was compiled with, nullptr when there's none
+const char* GetDownsampleShaderFormat(VkFormat format)
+{
+	switch (format) {
+	case VK_FORMAT_R8G8B8A8_UNORM:
+		return "rgba8";
+	case VK_FORMAT_R8G8B8A8_SNORM:
+		return "rgba8_snorm";
+	case VK_FORMAT_R32_SFLOAT:
+		return "r32f";
+	case VK_FORMAT_R32G32_SFLOAT:
+		return "rg32f";
+	case VK_FORMAT_R32G32B32A32_SFLOAT:
+		return "rgba32f";
+	default:
+		// sRGB can't be a storage image, those stay on the blit chain
+		return nullptr;
+	}
+}
+
+VkImageView CreateMipView(VkImage image, VkFormat format, uint32_t mip)
+{
+	VkImageViewCreateInfo viewInfo{};
+	viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+	viewInfo.image = image;
+	viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+	viewInfo.format = format;
+	viewInfo.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, mip, 1, 0, 1 };
+
+	VkImageView imageView;
+	if (vkCreateImageView(wVkGlobals::g_Device, &viewInfo, wVkGlobals::g_AllocationCallbacks, &imageView) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create downsample mip view!");
+	}
+
+	return imageView;
+}
+
+void wVkDownsampler::Initialize()
+{
+	// The first reduction step swaps across quads, lanes 4n..4n+3 have to be one 2x2 block
+	VkPhysicalDeviceSubgroupProperties subgroupProperties{};
+	subgroupProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SUBGROUP_PROPERTIES;
+
+	VkPhysicalDeviceProperties2 properties{};
+	properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+	properties.pNext = &subgroupProperties;
+	vkGetPhysicalDeviceProperties2(wVkGlobals::g_PhysicalDevice, &properties);
+
+	m_UseSubgroupQuad = (subgroupProperties.supportedStages & VK_SHADER_STAGE_COMPUTE_BIT) != 0
+		&& (subgroupProperties.supportedOperations & VK_SUBGROUP_FEATURE_QUAD_BIT) != 0 && subgroupProperties.subgroupSize >= 4;
+
+	// 0 src mip, 1 dst mips, 2 mip 6 again (coherent), 3 atomic counter
+	VkDescriptorSetLayoutBinding bindings[4] = {};
+	bindings[0] = { 0, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr };
+	bindings[1] = { 1, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, MAX_MIPS_PER_DISPATCH, VK_SHADER_STAGE_COMPUTE_BIT, nullptr };
+	bindings[2] = { 2, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr };
+	bindings[3] = { 3, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr };
+
+	VkDescriptorSetLayoutCreateInfo layoutInfo{};
+	layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	layoutInfo.bindingCount = 4;
+	layoutInfo.pBindings = bindings;
+
+	if (vkCreateDescriptorSetLayout(wVkGlobals::g_Device, &layoutInfo, wVkGlobals::g_AllocationCallbacks, &m_SetLayout) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create downsample descriptor set layout!");
+	}
+
+	VkPushConstantRange pushConstants{};
+	pushConstants.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	pushConstants.size = sizeof(DownsampleConstants);
+
+	VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+	pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	pipelineLayoutInfo.setLayoutCount = 1;
+	pipelineLayoutInfo.pSetLayouts = &m_SetLayout;
+	pipelineLayoutInfo.pushConstantRangeCount = 1;
+	pipelineLayoutInfo.pPushConstantRanges = &pushConstants;
+
+	if (vkCreatePipelineLayout(wVkGlobals::g_Device, &pipelineLayoutInfo, wVkGlobals::g_AllocationCallbacks, &m_PipelineLayout) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create downsample pipeline layout!");
+	}
+
+	// Sets live until the frame they were recorded in is done, they're freed through the retire queue
+	const uint32_t maxSets = wVkConstants::g_DownsamplerMaxDescriptorSets;
+	VkDescriptorPoolSize poolSizes[2] = {
+		{ VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, maxSets * (MAX_MIPS_PER_DISPATCH + 2) },
+		{ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, maxSets },
+	};
+
+	VkDescriptorPoolCreateInfo poolInfo{};
+	poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	poolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT;
+	poolInfo.maxSets = maxSets;
+	poolInfo.poolSizeCount = 2;
+	poolInfo.pPoolSizes = poolSizes;
+
+	if (vkCreateDescriptorPool(wVkGlobals::g_Device, &poolInfo, wVkGlobals::g_AllocationCallbacks, &m_DescriptorPool) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create downsample descriptor pool!");
+	}
+
+	constexpr VkDeviceSize counterSize = sizeof(uint32_t);
+	const wVkHelpers::wVkMemoryPolicy policy = wVkHelpers::getMemoryPolicy(wVkHelpers::wVkMemoryUsage::GPU_ONLY);
+	const uint32_t memoryType = wVkHelpers::createBuffer(counterSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, policy, m_CounterBuffer, m_CounterMemory);
+	m_CounterRegistryId = wVkGlobals::g_ResourceRegistry.RegisterBuffer(m_CounterBuffer, memoryType, counterSize, wVkResourceType::BUFFER, "Downsampler Counter", Callsite::Current());
+
+	VkCommandBuffer commandBuffer = wVkHelpers::beginSingleTimeCommand();
+	vkCmdFillBuffer(commandBuffer, m_CounterBuffer, 0, counterSize, 0);
+	wVkHelpers::endSingleTimeCommand(commandBuffer);
+
+	LOG_INFO("Downsampler: subgroup quad operations %s", m_UseSubgroupQuad ? "on" : "off");
+}
+
+void wVkDownsampler::Destroy()
+{
+	for (auto& [key, pipeline] : m_Pipelines)
+		vkDestroyPipeline(wVkGlobals::g_Device, pipeline, wVkGlobals::g_AllocationCallbacks);
+	for (auto& [format, shaderModule] : m_ShaderModules)
+		vkDestroyShaderModule(wVkGlobals::g_Device, shaderModule, wVkGlobals::g_AllocationCallbacks);
+
+	m_Pipelines.clear();
+	m_ShaderModules.clear();
+
+	vkDestroyDescriptorPool(wVkGlobals::g_Device, m_DescriptorPool, wVkGlobals::g_AllocationCallbacks);
+	vkDestroyPipelineLayout(wVkGlobals::g_Device, m_PipelineLayout, wVkGlobals::g_AllocationCallbacks);
+	vkDestroyDescriptorSetLayout(wVkGlobals::g_Device, m_SetLayout, wVkGlobals::g_AllocationCallbacks);
+	vkDestroyBuffer(wVkGlobals::g_Device, m_CounterBuffer, wVkGlobals::g_AllocationCallbacks);
+	vkFreeMemory(wVkGlobals::g_Device, m_CounterMemory, wVkGlobals::g_AllocationCallbacks);
+	wVkGlobals::g_ResourceRegistry.Unregister(m_CounterRegistryId);
+
+	m_DescriptorPool = VK_NULL_HANDLE;
+	m_PipelineLayout = VK_NULL_HANDLE;
+	m_SetLayout = VK_NULL_HANDLE;
+	m_CounterBuffer = VK_NULL_HANDLE;
+	m_CounterMemory = VK_NULL_HANDLE;
+	m_CounterRegistryId = 0;
+}
+
+bool wVkDownsampler::IsSupported(VkFormat format)
+{
+	if (GetDownsampleShaderFormat(format) == nullptr)
+		return false;
+
+	VkFormatProperties formatProperties;
+	vkGetPhysicalDeviceFormatProperties(wVkGlobals::g_PhysicalDevice, format, &formatProperties);
+
+	return (formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_STORAGE_IMAGE_BIT) != 0;
+}
+
+void wVkDownsampler::Record(VkCommandBuffer commandBuffer, wVkTexture2D& texture, MipReduction reduction, VkImageLayout mip0Layout)
+{
+	ASSERT((texture.m_Usage & VK_IMAGE_USAGE_STORAGE_BIT) != 0, "Downsampling a texture that wasn't created with TextureFlags::MIPMAP_COMPUTE");
+
+	const uint32_t mipLevels = texture.m_TexMipLevels;
+	if (mipLevels < 2)
+		return;
+
+	const VkPipeline pipeline = GetPipeline(texture.m_Format, reduction);
+
+	// Mip 0 is read and the rest written as storage images, all of it in GENERAL for the duration.
+	// Whatever the other mips held is replaced, they don't need their content carried over.
+	wVkHelpers::recordImageBarrier(commandBuffer, texture.m_TextureImage, 0, 1, mip0Layout, VK_IMAGE_LAYOUT_GENERAL,
+		VK_ACCESS_MEMORY_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+	wVkHelpers::recordImageBarrier(commandBuffer, texture.m_TextureImage, 1, mipLevels - 1, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL,
+		0, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+
+	uint32_t numMips = 0;
+	for (uint32_t baseMip = 0; baseMip + 1 < mipLevels; baseMip += numMips) {
+		numMips = std::min(mipLevels - 1 - baseMip, MAX_MIPS_PER_DISPATCH);
+
+		const uint32_t srcExtent = std::max(std::max(texture.m_Width >> baseMip, texture.m_Height >> baseMip), 1u);
+		if (srcExtent > MAX_SINGLE_GROUP_EXTENT)
+			numMips = std::min(numMips, 6u);
+
+		// The counter is shared by every dispatch, and past the first pass the source mip is what the last pass wrote
+		VkMemoryBarrier barrier{};
+		barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+		std::vector<VkImageView> views(numMips + 1);
+		for (uint32_t i = 0; i <= numMips; i++)
+			views[i] = CreateMipView(texture.m_TextureImage, texture.m_Format, baseMip + i);
+
+		// Every descriptor has to be valid, slots past the last mip get the last mip again but are never written
+		std::vector<VkDescriptorImageInfo> imageInfos(MAX_MIPS_PER_DISPATCH + 2);
+		for (uint32_t i = 0; i < MAX_MIPS_PER_DISPATCH + 2; i++)
+			imageInfos[i] = { VK_NULL_HANDLE, views[numMips], VK_IMAGE_LAYOUT_GENERAL };
+		imageInfos[0].imageView = views[0];
+		for (uint32_t i = 0; i < numMips; i++)
+			imageInfos[1 + i].imageView = views[i + 1];
+		if (numMips >= 6)
+			imageInfos[MAX_MIPS_PER_DISPATCH + 1].imageView = views[6];
+
+		const VkDescriptorBufferInfo counterInfo = { m_CounterBuffer, 0, VK_WHOLE_SIZE };
+
+		const VkDescriptorSet descriptorSet = AllocateDescriptorSet();
+		VkWriteDescriptorSet writes[4] = {};
+		for (VkWriteDescriptorSet& write : writes) {
+			write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			write.dstSet = descriptorSet;
+			write.descriptorCount = 1;
+			write.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+		}
+		writes[0].dstBinding = 0;
+		writes[0].pImageInfo = &imageInfos[0];
+		writes[1].dstBinding = 1;
+		writes[1].descriptorCount = MAX_MIPS_PER_DISPATCH;
+		writes[1].pImageInfo = &imageInfos[1];
+		writes[2].dstBinding = 2;
+		writes[2].pImageInfo = &imageInfos[MAX_MIPS_PER_DISPATCH + 1];
+		writes[3].dstBinding = 3;
+		writes[3].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		writes[3].pBufferInfo = &counterInfo;
+		vkUpdateDescriptorSets(wVkGlobals::g_Device, 4, writes, 0, nullptr);
+
+		// Each workgroup covers 64x64 texels of the source
+		DownsampleConstants constants;
+		constants.m_SrcWidth = std::max(texture.m_Width >> baseMip, 1u);
+		constants.m_SrcHeight = std::max(texture.m_Height >> baseMip, 1u);
+		constants.m_NumMips = numMips;
+		const uint32_t groupsX = (constants.m_SrcWidth + 63) / 64;
+		const uint32_t groupsY = (constants.m_SrcHeight + 63) / 64;
+		constants.m_NumWorkGroups = groupsX * groupsY;
+
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_PipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
+		vkCmdPushConstants(commandBuffer, m_PipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(constants), &constants);
+		vkCmdDispatch(commandBuffer, groupsX, groupsY, 1);
+		m_Stats.m_NumDispatches++;
+
+		wVkGlobals::g_RetireQueue.Retire([views, descriptorSet, pool = m_DescriptorPool]()
+		{
+			for (VkImageView view : views)
+				vkDestroyImageView(wVkGlobals::g_Device, view, wVkGlobals::g_AllocationCallbacks);
+			vkFreeDescriptorSets(wVkGlobals::g_Device, pool, 1, &descriptorSet);
+		});
+	}
+
+	wVkHelpers::recordImageBarrier(commandBuffer, texture.m_TextureImage, 0, mipLevels, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+		VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT);
+
+	m_Stats.m_NumTextures++;
+}
+
+VkPipeline wVkDownsampler::GetPipeline(VkFormat format, MipReduction reduction)
+{
+	const uint64_t key = static_cast<uint64_t>(format) << 8 | static_cast<uint64_t>(reduction);
+	auto existing = m_Pipelines.find(key);
+	if (existing != m_Pipelines.end())
+		return existing->second;
+
+	const char* shaderFormat = GetDownsampleShaderFormat(format);
+	ASSERT(shaderFormat != nullptr, "The downsampler has no shader for this format, check wVkDownsampler::IsSupported first");
+
+	VkShaderModule& shaderModule = m_ShaderModules[format];
+	if (shaderModule == VK_NULL_HANDLE) {
+		const std::string shaderName = wVkConstants::shaderDir + "downsample_" + shaderFormat + (m_UseSubgroupQuad ? "" : "_noquad") + ".spv";
+		shaderModule = wVkHelpers::createShaderModule(wVkHelpers::readFile(shaderName));
+	}
+
+	// The reduction is a specialization constant, the compiler drops the other two
+	const uint32_t reductionValue = static_cast<uint32_t>(reduction);
+	const VkSpecializationMapEntry specializationEntry = { 0, 0, sizeof(uint32_t) };
+
+	VkSpecializationInfo specializationInfo{};
+	specializationInfo.mapEntryCount = 1;
+	specializationInfo.pMapEntries = &specializationEntry;
+	specializationInfo.dataSize = sizeof(uint32_t);
+	specializationInfo.pData = &reductionValue;
+
+	VkPipelineShaderStageCreateInfo stageInfo{};
+	stageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	stageInfo.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+	stageInfo.module = shaderModule;
+	stageInfo.pName = "main";
+	stageInfo.pSpecializationInfo = &specializationInfo;
+
+	VkComputePipelineCreateInfo pipelineInfo{};
+	pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+	pipelineInfo.layout = m_PipelineLayout;
+	pipelineInfo.stage = stageInfo;
+
+	VkPipeline pipeline;
+	if (vkCreateComputePipelines(wVkGlobals::g_Device, VK_NULL_HANDLE, 1, &pipelineInfo, wVkGlobals::g_AllocationCallbacks, &pipeline) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create downsample pipeline!");
+	}
+
+	m_Pipelines[key] = pipeline;
+	return pipeline;
+}
+
+VkDescriptorSet wVkDownsampler::AllocateDescriptorSet()
+{
+	VkDescriptorSetAllocateInfo allocInfo{};
+	allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	allocInfo.descriptorPool = m_DescriptorPool;
+	allocInfo.descriptorSetCount = 1;
+	allocInfo.pSetLayouts = &m_SetLayout;
+
+	VkDescriptorSet descriptorSet;
+	if (vkAllocateDescriptorSets(wVkGlobals::g_Device, &allocInfo, &descriptorSet) != VK_SUCCESS) {
+		throw std::runtime_error("failed to allocate downsample descriptor set, more than g_DownsamplerMaxDescriptorSets in flight!");
+	}
+
+	return descriptorSet;
+}
@@ -0,0 +1,63 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+
+#include "vulkan/vulkan.h"
+
+#include "BEARHeaders/Texture.h"
+
+// Compute replacement for the blit chain of generateMipmaps, for textures that are produced on the GPU.
+// Single pass downsampling (downsample.comp): one dispatch writes up to 12 mips, every workgroup reduces a 64x64
+// tile down to mip 6 in shared memory (subgroup quad operations for the first step when the device has them) and
+// the last workgroup to finish, found through an atomic counter, reduces mip 6 down to mip 12. Two barriers per
+// texture instead of two per level. Odd sized levels are reduced 2x2 with the edge clamped, like the blit does.
+class wVkDownsampler
+{
+public:
+	static constexpr uint32_t MAX_MIPS_PER_DISPATCH = 12;
+	// Past mip 6 only one workgroup is left, mip 6 of the dispatch's source has to fit in its 64x64 tile
+	static constexpr uint32_t MAX_SINGLE_GROUP_EXTENT = 64 << 6;
+
+	struct Stats
+	{
+		uint64_t m_NumTextures = 0;
+		uint64_t m_NumDispatches = 0;
+	};
+
+	void Initialize();
+	void Destroy();
+
+	// There's a shader variant for the format and the device can use it as a storage image
+	static bool IsSupported(VkFormat format);
+
+	// Records mips 1 and up of the texture from mip 0. A dispatch writes up to 12 mips, 6 while the source is over 4096
+	// texels on a side since the last workgroup only reduces a single 64x64 tile of mip 6.
+	// The texture needs VK_IMAGE_USAGE_STORAGE_BIT. Mip 0 is in mip0Layout, the rest are overwritten whatever layout
+	// they're in, and every mip is left in SHADER_READ_ONLY_OPTIMAL.
+	void Record(VkCommandBuffer commandBuffer, wVkTexture2D& texture, MipReduction reduction, VkImageLayout mip0Layout);
+
+	bool UsesSubgroupQuad() const { return m_UseSubgroupQuad; }
+	const Stats& GetStats() const { return m_Stats; }
+
+private:
+	VkPipeline GetPipeline(VkFormat format, MipReduction reduction);
+	VkDescriptorSet AllocateDescriptorSet();
+
+	VkDescriptorSetLayout m_SetLayout = VK_NULL_HANDLE;
+	VkPipelineLayout m_PipelineLayout = VK_NULL_HANDLE;
+	VkDescriptorPool m_DescriptorPool = VK_NULL_HANDLE;
+
+	// Reset to 0 by the last workgroup of every dispatch
+	VkBuffer m_CounterBuffer = VK_NULL_HANDLE;
+	VkDeviceMemory m_CounterMemory = VK_NULL_HANDLE;
+	uint64_t m_CounterRegistryId = 0;
+
+	bool m_UseSubgroupQuad = false;
+
+	// Created the first time a format/reduction is used
+	std::unordered_map<VkFormat, VkShaderModule> m_ShaderModules;
+	std::unordered_map<uint64_t, VkPipeline> m_Pipelines;
+
+	Stats m_Stats;
+};
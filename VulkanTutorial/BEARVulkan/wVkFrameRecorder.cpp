@@ -0,0 +1,217 @@
+#include "wVkFrameRecorder.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+
+#include "stb/stb_image_write.h"
+
+#include "BEARHeaders/Buffer.h"
+#include "wVkGlobalVariables.h"
+#include "Utils/ConsoleLogger.h"
+
+wVkFrameRecorder::~wVkFrameRecorder()
+{
+	Destroy();
+}
+
+void wVkFrameRecorder::Initialize(uint32_t width, uint32_t height, const std::string& directory, uint32_t numWorkers, uint32_t maxQueued)
+{
+	ASSERT(!IsInitialized(), "Frame recorder is already initialized");
+	ASSERT(width > 0 && height > 0, "Can't record %i x %i frames", static_cast<int>(width), static_cast<int>(height));
+
+	m_Width = width;
+	m_Height = height;
+	m_Directory = directory;
+
+	std::error_code error;
+	std::filesystem::create_directories(m_Directory, error);
+	if (error)
+		LOG_WARNING("Can't create frame directory \"%s\", frames will fail to write", m_Directory.c_str());
+
+	const size_t frameSize = static_cast<size_t>(width) * height * 4;
+	for (uint32_t i = 0; i < wVkConstants::g_MaxFramesInFlight; i++) {
+		m_Readbacks[i] = std::make_unique<Buffer>(nullptr, 1, frameSize, BufferFlags::READBACK_HEAP, "Frame Readback " + std::to_string(i));
+		m_Pending[i] = false;
+	}
+
+	if (numWorkers == 0)
+		numWorkers = std::max(std::thread::hardware_concurrency(), 2u) - 1;
+	m_MaxQueued = maxQueued == 0 ? numWorkers * 2 : maxQueued;
+
+	m_Stats = {};
+	m_Stats.m_NumWorkers = numWorkers;
+
+	m_StopWorkers = false;
+	for (uint32_t i = 0; i < numWorkers; i++)
+		m_Workers.emplace_back(&wVkFrameRecorder::WorkerLoop, this);
+
+	LOG_INFO("Frame recorder: %i x %i into \"%s\", %i encode threads", static_cast<int>(width), static_cast<int>(height), m_Directory.c_str(), static_cast<int>(numWorkers));
+}
+
+void wVkFrameRecorder::Destroy()
+{
+	if (!IsInitialized())
+		return;
+
+	// Workers only stop once the queue is empty, nothing that was collected is lost
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		m_StopWorkers = true;
+	}
+	m_Condition.notify_all();
+
+	for (std::thread& worker : m_Workers)
+		worker.join();
+
+	m_Workers.clear();
+	m_FreePixels.clear();
+
+	for (uint32_t i = 0; i < wVkConstants::g_MaxFramesInFlight; i++) {
+		if (m_Pending[i])
+			LOG_WARNING("Frame %i was recorded but never collected", static_cast<int>(m_PendingFrames[i]));
+
+		m_Readbacks[i].reset();
+		m_Pending[i] = false;
+	}
+}
+
+void wVkFrameRecorder::Record(VkCommandBuffer commandBuffer, VkImage image, uint32_t frameSlot, uint64_t frameNumber)
+{
+	ASSERT(IsInitialized(), "Frame recorder isn't initialized");
+	ASSERT(frameSlot < wVkConstants::g_MaxFramesInFlight, "Frame slot %i out of range", static_cast<int>(frameSlot));
+	ASSERT(!m_Pending[frameSlot], "Frame slot %i still holds frame %i, collect it first", static_cast<int>(frameSlot), static_cast<int>(m_PendingFrames[frameSlot]));
+
+	VkBufferImageCopy region{};
+	region.bufferOffset = 0;
+	region.bufferRowLength = 0; // Tightly packed
+	region.bufferImageHeight = 0;
+	region.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+	region.imageOffset = { 0, 0, 0 };
+	region.imageExtent = { m_Width, m_Height, 1 };
+	vkCmdCopyImageToBuffer(commandBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, m_Readbacks[frameSlot]->GetGPUHandleRef().m_Buffers, 1, &region);
+
+	// Make the copy visible to the host once the fence is signaled
+	VkMemoryBarrier barrier{};
+	barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+	m_Pending[frameSlot] = true;
+	m_PendingFrames[frameSlot] = frameNumber;
+
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	m_Stats.m_NumRecorded++;
+}
+
+void wVkFrameRecorder::Collect(uint32_t frameSlot)
+{
+	ASSERT(frameSlot < wVkConstants::g_MaxFramesInFlight, "Frame slot %i out of range", static_cast<int>(frameSlot));
+	if (!m_Pending[frameSlot])
+		return;
+
+	Frame frame;
+	frame.m_Number = m_PendingFrames[frameSlot];
+	m_Pending[frameSlot] = false;
+
+	const size_t frameSize = static_cast<size_t>(m_Width) * m_Height * 4;
+	{
+		std::unique_lock<std::mutex> lock(m_Mutex);
+
+		// A full queue means encoding can't keep up, the frame loop has to wait for it
+		if (m_Queue.size() >= m_MaxQueued) {
+			const auto stallStart = std::chrono::steady_clock::now();
+			m_SpaceCondition.wait(lock, [this]() { return m_Queue.size() < m_MaxQueued; });
+			m_Stats.m_StallSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - stallStart).count();
+		}
+
+		if (!m_FreePixels.empty()) {
+			frame.m_Pixels = std::move(m_FreePixels.back());
+			m_FreePixels.pop_back();
+		}
+	}
+
+	// Host cached memory, copying out is cheap compared to encoding straight from it
+	frame.m_Pixels.resize(frameSize);
+	m_Readbacks[frameSlot]->ReadData(frame.m_Pixels.data(), frameSize);
+
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		m_Queue.push_back(std::move(frame));
+	}
+	m_Condition.notify_one();
+}
+
+void wVkFrameRecorder::Flush()
+{
+	// Oldest first so the queue stays in frame order
+	uint32_t order[wVkConstants::g_MaxFramesInFlight];
+	for (uint32_t i = 0; i < wVkConstants::g_MaxFramesInFlight; i++)
+		order[i] = i;
+
+	std::sort(std::begin(order), std::end(order), [this](uint32_t a, uint32_t b) { return m_PendingFrames[a] < m_PendingFrames[b]; });
+
+	for (uint32_t slot : order)
+		Collect(slot);
+}
+
+wVkFrameRecorder::Stats wVkFrameRecorder::GetStats()
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	return m_Stats;
+}
+
+void wVkFrameRecorder::WorkerLoop()
+{
+	while (true) {
+		Frame frame;
+		{
+			std::unique_lock<std::mutex> lock(m_Mutex);
+			m_Condition.wait(lock, [this]() { return m_StopWorkers || !m_Queue.empty(); });
+			if (m_Queue.empty())
+				return;
+
+			frame = std::move(m_Queue.front());
+			m_Queue.pop_front();
+		}
+		m_SpaceCondition.notify_one();
+
+		const auto encodeStart = std::chrono::steady_clock::now();
+		const bool written = Encode(frame);
+		const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - encodeStart).count();
+
+		if (!written)
+			LOG_ERROR("Failed to write frame %i", static_cast<int>(frame.m_Number));
+
+		{
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			m_Stats.m_EncodeSeconds += seconds;
+			if (written)
+				m_Stats.m_NumEncoded++;
+			else
+				m_Stats.m_NumFailed++;
+
+			m_FreePixels.push_back(std::move(frame.m_Pixels));
+		}
+	}
+}
+
+bool wVkFrameRecorder::Encode(const Frame& frame) const
+{
+	// The clear colour's alpha is 0, written as RGBA most viewers would show the background as transparent
+	const size_t numPixels = static_cast<size_t>(m_Width) * m_Height;
+	std::vector<uint8_t> rgb(numPixels * 3);
+	for (size_t i = 0; i < numPixels; i++) {
+		rgb[i * 3 + 0] = frame.m_Pixels[i * 4 + 0];
+		rgb[i * 3 + 1] = frame.m_Pixels[i * 4 + 1];
+		rgb[i * 3 + 2] = frame.m_Pixels[i * 4 + 2];
+	}
+
+	char fileName[32];
+	snprintf(fileName, sizeof(fileName), "frame_%05llu.png", static_cast<unsigned long long>(frame.m_Number));
+	const std::string path = (std::filesystem::path(m_Directory) / fileName).string();
+
+	return stbi_write_png(path.c_str(), static_cast<int>(m_Width), static_cast<int>(m_Height), 3, rgb.data(), static_cast<int>(m_Width * 3)) != 0;
+}
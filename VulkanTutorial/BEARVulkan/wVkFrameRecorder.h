@@ -0,0 +1,84 @@
+#pragma once
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "vulkan/vulkan.h"
+
+#include "wVkConstants.h"
+
+class Buffer;
+
+// Writes rendered frames out as numbered PNGs without stalling the frame loop.
+// Every frame slot has a host cached readback buffer, the copy into it is recorded at the end of the frame and read on
+// the CPU once the slot's fence says it's done, g_MaxFramesInFlight frames later. The pixels are then handed to worker
+// threads that encode with stb_image_write, the frame loop only waits on them when m_MaxQueued frames are already queued.
+// Only for R8G8B8A8 images, alpha is dropped.
+class wVkFrameRecorder
+{
+public:
+	struct Stats
+	{
+		uint32_t m_NumWorkers = 0;
+		uint64_t m_NumRecorded = 0; // Copies recorded into a command buffer
+		uint64_t m_NumEncoded = 0; // Written to disk
+		uint64_t m_NumFailed = 0;
+		double m_EncodeSeconds = 0.0; // Summed over the workers
+		double m_StallSeconds = 0.0; // Frame loop waiting for room in the queue
+	};
+
+	~wVkFrameRecorder();
+
+	// 0 workers is one per core but the one recording, 0 queued frames is two per worker
+	void Initialize(uint32_t width, uint32_t height, const std::string& directory, uint32_t numWorkers = 0, uint32_t maxQueued = 0);
+
+	// Writes every queued frame before stopping the workers
+	void Destroy();
+
+	// The image has to be in TRANSFER_SRC_OPTIMAL, record from a render graph pass that reads it as a transfer source
+	void Record(VkCommandBuffer commandBuffer, VkImage image, uint32_t frameSlot, uint64_t frameNumber);
+
+	// Once the slot's fence has been waited on, queues the frame last recorded in it for encoding
+	void Collect(uint32_t frameSlot);
+
+	// Collects every slot, the device has to be idle
+	void Flush();
+
+	bool IsInitialized() const { return !m_Workers.empty(); }
+	Stats GetStats();
+
+private:
+	struct Frame
+	{
+		std::vector<uint8_t> m_Pixels;
+		uint64_t m_Number = 0;
+	};
+
+	void WorkerLoop();
+	bool Encode(const Frame& frame) const;
+
+	uint32_t m_Width = 0;
+	uint32_t m_Height = 0;
+	std::string m_Directory;
+
+	// Readback per frame slot, and the frame whose copy it holds
+	std::unique_ptr<Buffer> m_Readbacks[wVkConstants::g_MaxFramesInFlight];
+	uint64_t m_PendingFrames[wVkConstants::g_MaxFramesInFlight] = {};
+	bool m_Pending[wVkConstants::g_MaxFramesInFlight] = {};
+
+	std::vector<std::thread> m_Workers;
+	std::mutex m_Mutex;
+	std::condition_variable m_Condition; // Workers wait for frames
+	std::condition_variable m_SpaceCondition; // Frame loop waits for room
+	std::deque<Frame> m_Queue; // Guarded by m_Mutex
+	std::vector<std::vector<uint8_t>> m_FreePixels; // Guarded by m_Mutex, reused between frames
+	uint32_t m_MaxQueued = 0;
+	bool m_StopWorkers = false;
+
+	Stats m_Stats; // Guarded by m_Mutex
+};
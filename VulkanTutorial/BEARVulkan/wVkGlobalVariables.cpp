@@ -3,6 +3,9 @@
 
 namespace wVkGlobals
 {
+	wVkHostAllocator g_HostAllocator;
+	const VkAllocationCallbacks* g_AllocationCallbacks = nullptr;
+
 	// Vulkan setup
 	VkInstance g_Instance = VK_NULL_HANDLE;
 	VkDevice g_Device = VK_NULL_HANDLE;
@@ -10,11 +13,11 @@ namespace wVkGlobals
 	VkQueue g_Queue = VK_NULL_HANDLE;
 	VkCommandPool g_CommandPool = VK_NULL_HANDLE;
 	VkCommandBuffer g_CommandBuffer = VK_NULL_HANDLE;
-	VkRenderPass g_RenderPass = VK_NULL_HANDLE;
 	VkFormat g_ColorFormat = {};
 
 	VkDebugUtilsMessengerEXT g_DebugMessenger = VK_NULL_HANDLE;
 	VkSurfaceKHR g_Surface = VK_NULL_HANDLE;
+	bool g_Headless = false;
 
 	uint32_t g_CurrentImageIndex = 0;
 
@@ -25,16 +28,33 @@ namespace wVkGlobals
 	wVkHelpers::wVkSwapchain g_SwapChain = {};
 	std::vector<VkImage> g_SwapChainImages;
 	std::vector<VkImageView> g_SwapChainImageViews;
-	std::vector<VkFramebuffer> g_SwapChainFramebuffers;
 
-	// ToDo Support depth as texture
-	VkImage g_DepthImage = VK_NULL_HANDLE;;
-	VkDeviceMemory g_DepthImageMemory = VK_NULL_HANDLE;;
-	VkImageView g_DepthImageView = VK_NULL_HANDLE;;
+	wVkRenderGraph g_RenderGraph;
+	wVkRenderingFormats g_RenderingFormats;
 
 	// ImGui
 	ImGui_ImplVulkanH_Window g_ImGuiWindow;
 	VkDescriptorPool g_ImguiPool = VK_NULL_HANDLE;
-	VkRenderPass g_ImGuiRenderPass = VK_NULL_HANDLE;
+
+	wVkRetireQueue g_RetireQueue;
+	wVkUploadContext g_UploadContext;
+
+	wVkResourceRegistry g_ResourceRegistry;
+
+	wVkDeviceCapabilities g_DeviceCapabilities;
+
+	wVkDeviceAllocator g_DeviceAllocator;
+	wVkDefragmenter g_Defragmenter;
+	wVkResidencyManager g_ResidencyManager;
+
+	wVkMipBuilder g_MipBuilder;
+	wVkBlockEncoder g_BlockEncoder;
+	wVkTextureBaker g_TextureBaker;
+	wVkImageDecoder g_ImageDecoder;
+	wVkTextureStreamer g_TextureStreamer;
+
+	wVkDownsampler g_Downsampler;
+
+	wVkSamplerCache g_SamplerCache;
 
 } // namespace Ball::GlobalDX12
\ No newline at end of file
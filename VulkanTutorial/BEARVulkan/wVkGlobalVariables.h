@@ -4,6 +4,22 @@
 #include "imgui_impl_vulkan.h"
 #include "vulkan/vulkan.h"
 
+#include "wVkBlockEncoder.h"
+#include "wVkDefragmenter.h"
+#include "wVkDeviceAllocator.h"
+#include "wVkDownsampler.h"
+#include "wVkHostAllocator.h"
+#include "wVkImageDecoder.h"
+#include "wVkMipBuilder.h"
+#include "wVkRenderGraph.h"
+#include "wVkResidencyManager.h"
+#include "wVkResourceRegistry.h"
+#include "wVkRetireQueue.h"
+#include "wVkSamplerCache.h"
+#include "wVkTextureBaker.h"
+#include "wVkTextureStreamer.h"
+#include "wVkUploadContext.h"
+
 
 namespace wVkHelpers
 {
@@ -19,12 +35,27 @@ namespace wVkHelpers
 	};
 }
 
+// What the picked device can do past the required tier (wVkConstants::deviceExtensions), features check these and
+// turn themselves off rather than failing on devices without them
+struct wVkDeviceCapabilities
+{
+	bool m_RayTracing = false; // All of wVkConstants::rayTracingDeviceExtensions, with their features
+	bool m_MemoryBudget = false; // VK_EXT_memory_budget, heap budgets reported by the driver
+	bool m_SamplerAnisotropy = false;
+	bool m_TextureCompressionBC = false;
+};
+
 namespace wVkGlobals
 {
 
 	// Break the program at the start of the new frame if an issue has been found
 	static bool g_errorValidationLayerTriggered = false;
 
+	// Host allocations of the driver, every vkCreate*/vkDestroy* call passes these.
+	// nullptr when wVkConstants::g_UseTrackedHostAllocator is off.
+	extern wVkHostAllocator g_HostAllocator;
+	extern const VkAllocationCallbacks* g_AllocationCallbacks;
+
 	// Vulkan setup
 	extern VkDevice g_Device;
 	extern VkPhysicalDevice g_PhysicalDevice; // Assuming you need access to the physical device
@@ -32,13 +63,16 @@ namespace wVkGlobals
 	extern VkCommandPool g_CommandPool;
 	extern VkCommandBuffer g_CommandBuffer;
 	extern uint32_t g_CurrentImageIndex;
-	extern VkRenderPass g_RenderPass;
 	extern VkFormat g_ColorFormat;
 
 	extern VkDebugUtilsMessengerEXT g_DebugMessenger;
 
 	extern VkSurfaceKHR g_Surface;
 
+	// No window, surface or swapchain, see BackEndRenderer::InitializeHeadless. The swapchain globals below describe
+	// the offscreen ring that stands in for it.
+	extern bool g_Headless;
+
 	// These all evaluate to the same queue on my machine
 	extern VkQueue g_GraphicsQueue;
 	extern VkQueue g_PresentQueue;
@@ -47,18 +81,47 @@ namespace wVkGlobals
 	extern wVkHelpers::wVkSwapchain g_SwapChain;
 	extern std::vector<VkImage> g_SwapChainImages;
 	extern std::vector<VkImageView> g_SwapChainImageViews;
-	extern std::vector<VkFramebuffer> g_SwapChainFramebuffers;
 
-	// Depth
-	extern VkImage g_DepthImage;
-	extern VkDeviceMemory g_DepthImageMemory;
-	extern VkImageView g_DepthImageView;
+	// The frame's passes, their rendering scopes, and the transient attachments like depth.
+	// The scene and ImGui draw in one scope, their pipelines are created for g_RenderingFormats.
+	extern wVkRenderGraph g_RenderGraph;
+	extern wVkRenderingFormats g_RenderingFormats;
 
 	// ImGui
 	extern ImGui_ImplVulkanH_Window g_ImGuiWindow;
 	extern VkDescriptorPool g_ImguiPool;
-	extern VkRenderPass g_ImGuiRenderPass;
 
 	// Rasterization
 	extern VkRenderPass g_StandardRenderPass;
+
+	// Deferred destruction of resources that might still be in use by the GPU
+	extern wVkRetireQueue g_RetireQueue;
+
+	// Chunked staging window for CPU -> GPU uploads
+	extern wVkUploadContext g_UploadContext;
+
+	// Every GPU allocation by name
+	extern wVkResourceRegistry g_ResourceRegistry;
+
+	// Filled in when the device is picked, before it's created
+	extern wVkDeviceCapabilities g_DeviceCapabilities;
+
+	// Block sub-allocation of Buffer and Texture memory, and the pass that compacts it
+	extern wVkDeviceAllocator g_DeviceAllocator;
+	extern wVkDefragmenter g_Defragmenter;
+	extern wVkResidencyManager g_ResidencyManager;
+
+	// Decodes images on every core but the main thread, and grows streamed textures a mip at a time from the results.
+	// Mip chains of both are built on the CPU, and encoded to BCn there for block compressed textures.
+	extern wVkMipBuilder g_MipBuilder;
+	extern wVkBlockEncoder g_BlockEncoder;
+	extern wVkTextureBaker g_TextureBaker;
+	extern wVkImageDecoder g_ImageDecoder;
+	extern wVkTextureStreamer g_TextureStreamer;
+
+	// Mips of textures that are written on the GPU, see TextureFlags::MIPMAP_COMPUTE
+	extern wVkDownsampler g_Downsampler;
+
+	// One VkSampler per distinct SamplerState, shared by every Sampler and SamplerDescriptorHeap using it
+	extern wVkSamplerCache g_SamplerCache;
 }
@@ -52,7 +52,7 @@ namespace wVkHelpers
 		poolInfo.queueFamilyIndex = queueFamilyIndices.graphicsFamily.value();
 
 		VkCommandPool cmdPool;
-		if (vkCreateCommandPool(wVkGlobals::g_Device, &poolInfo, nullptr, &cmdPool) != VK_SUCCESS) {
+		if (vkCreateCommandPool(wVkGlobals::g_Device, &poolInfo, wVkGlobals::g_AllocationCallbacks, &cmdPool) != VK_SUCCESS) {
 			throw std::runtime_error("failed to create command pool!");
 		}
 
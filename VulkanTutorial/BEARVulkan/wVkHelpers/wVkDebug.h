@@ -103,7 +103,7 @@ namespace wVkHelpers {
 		wVkHelpers::populateDebugMessengerCreateInfo(createInfo);
 
 		VkDebugUtilsMessengerEXT debugMessenger;
-		if (CreateDebugUtilsMessengerEXT(wVkGlobals::g_Instance, &createInfo, nullptr, &debugMessenger) != VK_SUCCESS) {
+		if (CreateDebugUtilsMessengerEXT(wVkGlobals::g_Instance, &createInfo, wVkGlobals::g_AllocationCallbacks, &debugMessenger) != VK_SUCCESS) {
 			throw std::runtime_error("failed to set up debug messenger!");
 		}
 
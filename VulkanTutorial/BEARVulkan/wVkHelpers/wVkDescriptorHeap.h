@@ -16,7 +16,7 @@ namespace wVkHelpers
 		pipelineLayoutInfo.setLayoutCount = 1;
 		pipelineLayoutInfo.pSetLayouts = layout;
 
-		if (vkCreatePipelineLayout(wVkGlobals::g_Device, &pipelineLayoutInfo, nullptr, &test) != VK_SUCCESS) {
+		if (vkCreatePipelineLayout(wVkGlobals::g_Device, &pipelineLayoutInfo, wVkGlobals::g_AllocationCallbacks, &test) != VK_SUCCESS) {
 			throw std::runtime_error("failed to create compute pipeline layout!");
 		}
 
@@ -25,7 +25,7 @@ namespace wVkHelpers
 		pipelineInfo.layout = test;
 		pipelineInfo.stage = shader;
 
-		if (vkCreateComputePipelines(wVkGlobals::g_Device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &pipeline) != VK_SUCCESS) {
+		if (vkCreateComputePipelines(wVkGlobals::g_Device, VK_NULL_HANDLE, 1, &pipelineInfo, wVkGlobals::g_AllocationCallbacks, &pipeline) != VK_SUCCESS) {
 			throw std::runtime_error("failed to create compute pipeline!");
 		}
 
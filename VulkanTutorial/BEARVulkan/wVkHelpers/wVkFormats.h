@@ -0,0 +1,99 @@
+#pragma once
+
+#include <cstdint>
+
+#include "BEARVulkan/wVkBlockEncoder.h"
+#include "vulkan/vulkan.h"
+
+// Layout of a format, what sizes and conversions are worked out from
+struct wVkFormatInfo
+{
+	uint32_t m_Channels = 4;
+	uint32_t m_BlockDimension = 1; // Texels along a block edge, 1 for uncompressed formats
+	uint32_t m_BytesPerBlock = 4; // Bytes per texel for uncompressed formats
+	bool m_Srgb = false;
+	bool m_HalfFloat = false;
+	wVkBlockFormat m_BlockFormat = wVkBlockFormat::NONE;
+};
+
+namespace wVkHelpers
+{
+	// Every format Texture can be created in. Anything else (swapchain, depth) is taken as 4 bytes per texel.
+	inline wVkFormatInfo getFormatInfo(VkFormat format)
+	{
+		switch (format) {
+		case VK_FORMAT_R8G8B8A8_UNORM:
+		case VK_FORMAT_R8G8B8A8_SNORM:
+			return { 4, 1, 4, false, false, wVkBlockFormat::NONE };
+		case VK_FORMAT_R8G8B8A8_SRGB:
+			return { 4, 1, 4, true, false, wVkBlockFormat::NONE };
+		case VK_FORMAT_R16_SFLOAT:
+			return { 1, 1, 2, false, true, wVkBlockFormat::NONE };
+		case VK_FORMAT_R16G16_SFLOAT:
+			return { 2, 1, 4, false, true, wVkBlockFormat::NONE };
+		case VK_FORMAT_R16G16B16A16_SFLOAT:
+			return { 4, 1, 8, false, true, wVkBlockFormat::NONE };
+		case VK_FORMAT_R32_SFLOAT:
+			return { 1, 1, 4, false, false, wVkBlockFormat::NONE };
+		case VK_FORMAT_R32G32_SFLOAT:
+			return { 2, 1, 8, false, false, wVkBlockFormat::NONE };
+		case VK_FORMAT_R32G32B32A32_SFLOAT:
+			return { 4, 1, 16, false, false, wVkBlockFormat::NONE };
+		case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+			return { 4, 4, 8, false, false, wVkBlockFormat::BC1 };
+		case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+			return { 4, 4, 8, true, false, wVkBlockFormat::BC1 };
+		case VK_FORMAT_BC3_UNORM_BLOCK:
+			return { 4, 4, 16, false, false, wVkBlockFormat::BC3 };
+		case VK_FORMAT_BC3_SRGB_BLOCK:
+			return { 4, 4, 16, true, false, wVkBlockFormat::BC3 };
+		case VK_FORMAT_BC4_UNORM_BLOCK:
+			return { 1, 4, 8, false, false, wVkBlockFormat::BC4 };
+		case VK_FORMAT_BC5_UNORM_BLOCK:
+			return { 2, 4, 16, false, false, wVkBlockFormat::BC5 };
+		case VK_FORMAT_BC7_UNORM_BLOCK:
+			return { 4, 4, 16, false, false, wVkBlockFormat::BC7 };
+		case VK_FORMAT_BC7_SRGB_BLOCK:
+			return { 4, 4, 16, true, false, wVkBlockFormat::BC7 };
+		default:
+			return {};
+		}
+	}
+
+	// NONE for anything that isn't one of the BCn formats Texture supports
+	inline wVkBlockFormat getBlockFormat(VkFormat format)
+	{
+		return getFormatInfo(format).m_BlockFormat;
+	}
+
+	inline bool isBlockCompressed(VkFormat format)
+	{
+		return getBlockFormat(format) != wVkBlockFormat::NONE;
+	}
+
+	inline bool isSrgbFormat(VkFormat format)
+	{
+		return getFormatInfo(format).m_Srgb;
+	}
+
+	// Texels along the edge of a block, 1 for uncompressed formats
+	inline uint32_t getBlockDimension(VkFormat format)
+	{
+		return getFormatInfo(format).m_BlockDimension;
+	}
+
+	// Bytes per block, which is a texel for uncompressed formats
+	inline uint32_t getBytesPerBlock(VkFormat format)
+	{
+		return getFormatInfo(format).m_BytesPerBlock;
+	}
+
+	// Tightly packed size of a width x height image, partial blocks at the edges count as whole ones
+	inline uint64_t getImageSize(VkFormat format, uint32_t width, uint32_t height)
+	{
+		const wVkFormatInfo info = getFormatInfo(format);
+		const uint64_t blocksWide = (width + info.m_BlockDimension - 1) / info.m_BlockDimension;
+		const uint64_t blocksHigh = (height + info.m_BlockDimension - 1) / info.m_BlockDimension;
+		return blocksWide * blocksHigh * info.m_BytesPerBlock;
+	}
+}
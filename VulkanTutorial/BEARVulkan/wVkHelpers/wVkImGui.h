@@ -5,18 +5,17 @@
 #pragma once
 
 #include <stdexcept>
-#include <array>
 
 #include "imgui.h"
 #include "imgui_impl_glfw.h"
-#include "wVkDepth.h"
 #include "wVkQueueFamilies.h"
 #include "BEARVulkan/wVkGlobalVariables.h"
 #include "vulkan/vulkan.h"
 
 namespace wVkHelpers {
 
-	inline void initImgui(GLFWwindow* window, VkRenderPass& imguiRenderPass, VkDescriptorPool& imguiDescPool)
+	// ImGui draws in the scene's rendering scope, its pipeline has the scene's formats, depth included
+	inline void initImgui(GLFWwindow* window, const wVkRenderingFormats& formats, VkDescriptorPool& imguiDescPool)
 	{
 		// Setup Dear ImGui context
 		IMGUI_CHECKVERSION();
@@ -28,63 +27,6 @@ namespace wVkHelpers {
 		// Setup Dear ImGui style
 		ImGui::StyleColorsDark();
 
-		// ToDo, make the render pass set-up here same as in Swapchain
-		VkAttachmentDescription colAttachment = {};
-		colAttachment.format = wVkGlobals::g_SwapChain.swapChainImageFormat;
-		colAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
-		colAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
-		colAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
-		colAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-		colAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-		colAttachment.initialLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-		colAttachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
-
-		VkAttachmentReference colorAttackmentRef = {};
-		colorAttackmentRef.attachment = 0;
-		colorAttackmentRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-
-		VkAttachmentDescription depthAttachment{};
-		depthAttachment.format = findDepthFormat();
-		depthAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
-		depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-		depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-		depthAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-		depthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-		depthAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-		depthAttachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
-
-		VkAttachmentReference depthAttachmentRef{};
-		depthAttachmentRef.attachment = 1;
-		depthAttachmentRef.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
-
-		VkSubpassDescription subpass = {};
-		subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
-		subpass.colorAttachmentCount = 1;
-		subpass.pColorAttachments = &colorAttackmentRef;
-		subpass.pDepthStencilAttachment = &depthAttachmentRef;
-
-		VkSubpassDependency dependency = {};
-		dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
-		dependency.dstSubpass = 0;
-		dependency.srcAccessMask = 0;  // or VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-		dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
-		dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
-		dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
-
-		std::array<VkAttachmentDescription, 2> attachments = { colAttachment, depthAttachment };
-		VkRenderPassCreateInfo info = {};
-		info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
-		info.attachmentCount = static_cast<uint32_t>(attachments.size());
-		info.pAttachments = attachments.data();
-		info.subpassCount = 1;
-		info.pSubpasses = &subpass;
-		info.dependencyCount = 1;
-		info.pDependencies = &dependency;
-
-		if (vkCreateRenderPass(wVkGlobals::g_Device, &info, nullptr, &imguiRenderPass) != VK_SUCCESS) {
-			throw std::runtime_error("Could not create Dear ImGui's render pass");
-		}
-
 		QueueFamilyIndices indices = findQueueFamilies(wVkGlobals::g_PhysicalDevice);
 		assert(indices.isComplete());
 
@@ -112,7 +54,7 @@ namespace wVkHelpers {
 		pool_info.poolSizeCount = static_cast<uint32_t>(std::size(pool_sizes));
 		pool_info.pPoolSizes = pool_sizes;
 
-		if (vkCreateDescriptorPool(wVkGlobals::g_Device, &pool_info, nullptr, &imguiDescPool)) {
+		if (vkCreateDescriptorPool(wVkGlobals::g_Device, &pool_info, wVkGlobals::g_AllocationCallbacks, &imguiDescPool)) {
 			throw std::runtime_error("Could not create Dear ImGui's Descriptor Pool");
 		}
 
@@ -126,11 +68,12 @@ namespace wVkHelpers {
 		init_info.Queue = wVkGlobals::g_GraphicsQueue;
 		init_info.PipelineCache = VK_NULL_HANDLE;
 		init_info.DescriptorPool = imguiDescPool;
-		init_info.Allocator = VK_NULL_HANDLE;
+		init_info.Allocator = wVkGlobals::g_AllocationCallbacks;
 		init_info.MinImageCount = wVkGlobals::g_SwapChain.minImageCount;
 		init_info.ImageCount = wVkGlobals::g_SwapChain.imageCount;
 		init_info.CheckVkResultFn = VK_NULL_HANDLE;
-		init_info.RenderPass = imguiRenderPass;
+		init_info.UseDynamicRendering = true;
+		init_info.PipelineRenderingCreateInfo = formats.GetCreateInfo();
 		ImGui_ImplVulkan_Init(&init_info);
 
 		ImGui_ImplVulkan_CreateFontsTexture();
@@ -11,11 +11,16 @@
 namespace wVkHelpers {
 
 	inline std::vector<const char*> getRequiredExtensions() {
-		uint32_t glfwExtensionCount = 0;
-		const char** glfwExtensions;
-		glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+		std::vector<const char*> extensions;
 
-		std::vector<const char*> extensions(glfwExtensions, glfwExtensions + glfwExtensionCount);
+		// GLFW isn't initialized headless, and without a surface there's nothing it needs
+		if (!wVkGlobals::g_Headless) {
+			uint32_t glfwExtensionCount = 0;
+			const char** glfwExtensions;
+			glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+
+			extensions.assign(glfwExtensions, glfwExtensions + glfwExtensionCount);
+		}
 
 		if (wVkConstants::enableValidationLayers) {
 			extensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
@@ -51,7 +56,7 @@ namespace wVkHelpers {
 		appInfo.applicationVersion = VK_MAKE_VERSION(1, 0, 0);
 		appInfo.pEngineName = "No Engine";
 		appInfo.engineVersion = VK_MAKE_VERSION(1, 0, 0);
-		appInfo.apiVersion = VK_API_VERSION_1_0;
+		appInfo.apiVersion = VK_API_VERSION_1_1; // vkGetPhysicalDeviceMemoryProperties2 for the memory budget
 
 		VkInstanceCreateInfo createInfo{};
 		createInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
@@ -88,7 +93,7 @@ namespace wVkHelpers {
 		}
 
 
-		VkResult res = vkCreateInstance(&createInfo, nullptr, &instance);
+		VkResult res = vkCreateInstance(&createInfo, wVkGlobals::g_AllocationCallbacks, &instance);
 		if (res != VK_SUCCESS) {
 			throw std::runtime_error("failed to create instance!");
 		}
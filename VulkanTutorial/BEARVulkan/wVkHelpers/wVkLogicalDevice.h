@@ -1,7 +1,9 @@
 #pragma once
 
+#include <cstring>
 #include <set>
 #include <stdexcept>
+#include <vector>
 
 #include "wVkQueueFamilies.h"
 #include "BEARVulkan/wVkConstants.h"
@@ -11,6 +13,33 @@
 
 namespace wVkHelpers {
 
+	inline bool isDeviceExtensionSupported(VkPhysicalDevice device, const char* extensionName) {
+		uint32_t extensionCount;
+		vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, nullptr);
+
+		std::vector<VkExtensionProperties> availableExtensions(extensionCount);
+		vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, availableExtensions.data());
+
+		for (const auto& extension : availableExtensions) {
+			if (strcmp(extension.extensionName, extensionName) == 0)
+				return true;
+		}
+
+		return false;
+	}
+
+	// Headless nothing is presented, the swapchain extension isn't needed
+	inline std::vector<const char*> getRequiredDeviceExtensions() {
+		std::vector<const char*> extensions;
+		for (const char* extension : wVkConstants::deviceExtensions) {
+			if (wVkGlobals::g_Headless && strcmp(extension, VK_KHR_SWAPCHAIN_EXTENSION_NAME) == 0)
+				continue;
+
+			extensions.push_back(extension);
+		}
+
+		return extensions;
+	}
 
 	inline VkDevice createLogicalDevice(QueueFamilyIndices indices) {
 
@@ -23,16 +52,60 @@ namespace wVkHelpers {
 		float queuePriority = 1.0f;
 		queueCreateInfo.pQueuePriorities = &queuePriority;
 
+		// Everything past the required tier is enabled as far as wVkGlobals::g_DeviceCapabilities says the device has it
+		const wVkDeviceCapabilities& capabilities = wVkGlobals::g_DeviceCapabilities;
+
 		VkPhysicalDeviceFeatures deviceFeatures{};
-		deviceFeatures.samplerAnisotropy = VK_TRUE;
+		// Without it the sampler cache leaves anisotropic filtering off
+		deviceFeatures.samplerAnisotropy = capabilities.m_SamplerAnisotropy ? VK_TRUE : VK_FALSE;
+		// BCn textures, every desktop GPU has them. Without it Texture::IsFormatSupported turns them down.
+		deviceFeatures.textureCompressionBC = capabilities.m_TextureCompressionBC ? VK_TRUE : VK_FALSE;
 
 		VkDeviceCreateInfo createInfo{};
 		createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
 		createInfo.pQueueCreateInfos = &queueCreateInfo;
 		createInfo.queueCreateInfoCount = 1;
 		createInfo.pEnabledFeatures = &deviceFeatures;
-		createInfo.enabledExtensionCount = static_cast<uint32_t>(wVkConstants::deviceExtensions.size());
-		createInfo.ppEnabledExtensionNames = wVkConstants::deviceExtensions.data();
+
+		std::vector<const char*> extensions = getRequiredDeviceExtensions();
+		for (const char* extension : wVkConstants::optionalDeviceExtensions) {
+			if (isDeviceExtensionSupported(wVkGlobals::g_PhysicalDevice, extension))
+				extensions.push_back(extension);
+		}
+
+		// The ray tracing tier, extensions and the features queryDeviceCapabilities checked
+		VkPhysicalDeviceBufferDeviceAddressFeatures bufferDeviceAddress{};
+		bufferDeviceAddress.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_BUFFER_DEVICE_ADDRESS_FEATURES;
+		bufferDeviceAddress.bufferDeviceAddress = VK_TRUE;
+
+		VkPhysicalDeviceAccelerationStructureFeaturesKHR accelerationStructure{};
+		accelerationStructure.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ACCELERATION_STRUCTURE_FEATURES_KHR;
+		accelerationStructure.accelerationStructure = VK_TRUE;
+		accelerationStructure.pNext = &bufferDeviceAddress;
+
+		VkPhysicalDeviceRayTracingPipelineFeaturesKHR rayTracingPipeline{};
+		rayTracingPipeline.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_RAY_TRACING_PIPELINE_FEATURES_KHR;
+		rayTracingPipeline.rayTracingPipeline = VK_TRUE;
+		rayTracingPipeline.pNext = &accelerationStructure;
+
+		VkPhysicalDeviceRayQueryFeaturesKHR rayQuery{};
+		rayQuery.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_RAY_QUERY_FEATURES_KHR;
+		rayQuery.rayQuery = VK_TRUE;
+		rayQuery.pNext = &rayTracingPipeline;
+
+		// Required, isDeviceSuitable checked the feature
+		VkPhysicalDeviceDynamicRenderingFeaturesKHR dynamicRendering{};
+		dynamicRendering.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_FEATURES_KHR;
+		dynamicRendering.dynamicRendering = VK_TRUE;
+		createInfo.pNext = &dynamicRendering;
+
+		if (capabilities.m_RayTracing) {
+			extensions.insert(extensions.end(), wVkConstants::rayTracingDeviceExtensions.begin(), wVkConstants::rayTracingDeviceExtensions.end());
+			dynamicRendering.pNext = &rayQuery;
+		}
+
+		createInfo.enabledExtensionCount = static_cast<uint32_t>(extensions.size());
+		createInfo.ppEnabledExtensionNames = extensions.data();
 
 		if (wVkConstants::enableValidationLayers) {
 			createInfo.enabledLayerCount = static_cast<uint32_t>(wVkConstants::validationLayers.size());
@@ -61,7 +134,7 @@ namespace wVkHelpers {
 
 
 		VkDevice device;
-		if (vkCreateDevice(wVkGlobals::g_PhysicalDevice, &createInfo, nullptr, &device) != VK_SUCCESS) {
+		if (vkCreateDevice(wVkGlobals::g_PhysicalDevice, &createInfo, wVkGlobals::g_AllocationCallbacks, &device) != VK_SUCCESS) {
 			throw std::runtime_error("failed to create logical device!");
 		}
 
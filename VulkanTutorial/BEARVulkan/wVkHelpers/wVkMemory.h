@@ -0,0 +1,193 @@
+#pragma once
+
+#include <cstdio>
+#include <stdexcept>
+#include <string>
+
+#include "BEARVulkan/wVkGlobalVariables.h"
+#include "vulkan/vulkan.h"
+
+namespace wVkHelpers
+{
+	// Where a resource should live, mirrors the D3D12 heap types BEAR was designed around
+	enum class wVkMemoryUsage
+	{
+		GPU_ONLY, // DEFAULT_HEAP - only touched by the GPU after creation
+		CPU_TO_GPU, // UPLOAD_HEAP - written by the CPU regularly, read by the GPU
+		GPU_TO_CPU, // READBACK_HEAP - written by the GPU, read back by the CPU
+		CPU_ONLY, // Staging - written by the CPU, only ever the source of a copy
+	};
+
+	// Required flags must all be present, preferred ones add to the score and avoided ones subtract from it
+	struct wVkMemoryPolicy
+	{
+		VkMemoryPropertyFlags m_Required = 0;
+		VkMemoryPropertyFlags m_Preferred = 0;
+		VkMemoryPropertyFlags m_Avoided = 0;
+	};
+
+	// A DEVICE_LOCAL | HOST_VISIBLE heap of this size or smaller is the legacy 256MB BAR window, not ReBAR.
+	constexpr VkDeviceSize g_SmallBarHeapSize = 256ull * 1024 * 1024;
+
+	inline wVkMemoryPolicy getMemoryPolicy(wVkMemoryUsage usage)
+	{
+		wVkMemoryPolicy policy{};
+
+		switch (usage)
+		{
+		case wVkMemoryUsage::GPU_ONLY:
+			// Keep host visible device memory free for data that actually needs it
+			policy.m_Required = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+			policy.m_Avoided = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+			break;
+		case wVkMemoryUsage::CPU_TO_GPU:
+			// ReBAR / UMA lets the CPU write straight into VRAM, skipping the staging copy.
+			// Cached memory is useless for write-combined uploads. Non-coherent memory is fine, Buffer flushes dirty ranges.
+			policy.m_Required = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+			policy.m_Preferred = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+			policy.m_Avoided = VK_MEMORY_PROPERTY_HOST_CACHED_BIT;
+			break;
+		case wVkMemoryUsage::GPU_TO_CPU:
+			// Reading uncached memory from the CPU is painfully slow
+			policy.m_Required = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+			policy.m_Preferred = VK_MEMORY_PROPERTY_HOST_CACHED_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+			policy.m_Avoided = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+			break;
+		case wVkMemoryUsage::CPU_ONLY:
+			// Plain system memory, the copy engine reads it over PCIe anyway
+			policy.m_Required = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+			policy.m_Preferred = VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+			policy.m_Avoided = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT;
+			break;
+		}
+
+		return policy;
+	}
+
+	inline int countBits(uint32_t value)
+	{
+		int count = 0;
+		for (; value != 0; value &= value - 1)
+			count++;
+
+		return count;
+	}
+
+	// Returns a negative score if the memory type can't be used at all
+	inline int scoreMemoryType(const VkPhysicalDeviceMemoryProperties& memProperties, uint32_t typeIndex, const wVkMemoryPolicy& policy, VkDeviceSize size)
+	{
+		const VkMemoryType& type = memProperties.memoryTypes[typeIndex];
+		const VkMemoryHeap& heap = memProperties.memoryHeaps[type.heapIndex];
+
+		if ((type.propertyFlags & policy.m_Required) != policy.m_Required)
+			return -1;
+
+		// Lazily allocated and protected memory can't be used for buffers we want to read or write
+		if (type.propertyFlags & (VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT | VK_MEMORY_PROPERTY_PROTECTED_BIT))
+			return -1;
+
+		if (size > heap.size)
+			return -1;
+
+		int score = 100;
+		score += 10 * countBits(type.propertyFlags & policy.m_Preferred);
+		score -= 10 * countBits(type.propertyFlags & policy.m_Avoided);
+
+		// The small BAR window fills up quickly, don't spend it on large allocations
+		const VkMemoryPropertyFlags barFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+		const bool isSmallBar = (type.propertyFlags & barFlags) == barFlags && heap.size <= g_SmallBarHeapSize;
+		if (isSmallBar && size > heap.size / 16)
+			score -= 20;
+
+		return score;
+	}
+
+	// Picks the best scoring memory type, ties go to the lowest index as the driver orders them by preference
+	inline uint32_t findMemoryType(uint32_t typeFilter, const wVkMemoryPolicy& policy, VkDeviceSize size)
+	{
+		VkPhysicalDeviceMemoryProperties memProperties;
+		vkGetPhysicalDeviceMemoryProperties(wVkGlobals::g_PhysicalDevice, &memProperties);
+
+		uint32_t bestType = UINT32_MAX;
+		int bestScore = -1;
+
+		for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++) {
+			if ((typeFilter & (1 << i)) == 0)
+				continue;
+
+			const int score = scoreMemoryType(memProperties, i, policy, size);
+			if (score > bestScore) {
+				bestScore = score;
+				bestType = i;
+			}
+		}
+
+		if (bestType == UINT32_MAX) {
+			throw std::runtime_error("failed to find suitable memory type!");
+		}
+
+		return bestType;
+	}
+
+	inline VkMemoryPropertyFlags getMemoryTypeProperties(uint32_t typeIndex, uint32_t* heapIndex = nullptr)
+	{
+		VkPhysicalDeviceMemoryProperties memProperties;
+		vkGetPhysicalDeviceMemoryProperties(wVkGlobals::g_PhysicalDevice, &memProperties);
+
+		if (heapIndex != nullptr)
+			*heapIndex = memProperties.memoryTypes[typeIndex].heapIndex;
+
+		return memProperties.memoryTypes[typeIndex].propertyFlags;
+	}
+
+	inline const char* getMemoryUsageName(wVkMemoryUsage usage)
+	{
+		switch (usage)
+		{
+		case wVkMemoryUsage::GPU_ONLY: return "Default Heap";
+		case wVkMemoryUsage::CPU_TO_GPU: return "Upload Heap";
+		case wVkMemoryUsage::GPU_TO_CPU: return "Readback Heap";
+		case wVkMemoryUsage::CPU_ONLY: return "Staging";
+		}
+
+		return "Unknown Heap";
+	}
+
+	inline std::string memoryPropertiesToString(VkMemoryPropertyFlags flags)
+	{
+		std::string result;
+		auto append = [&](VkMemoryPropertyFlags bit, const char* name)
+		{
+			if ((flags & bit) == 0)
+				return;
+
+			if (!result.empty())
+				result += " | ";
+			result += name;
+		};
+
+		append(VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, "DEVICE_LOCAL");
+		append(VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, "HOST_VISIBLE");
+		append(VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, "HOST_COHERENT");
+		append(VK_MEMORY_PROPERTY_HOST_CACHED_BIT, "HOST_CACHED");
+		append(VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT, "LAZILY_ALLOCATED");
+
+		return result.empty() ? "NONE" : result;
+	}
+
+	// The logger only knows %d/%i, sizes are formatted up front
+	inline std::string formatBytes(VkDeviceSize bytes)
+	{
+		char text[32];
+		if (bytes >= 1024ull * 1024 * 1024)
+			snprintf(text, sizeof(text), "%.2f GB", static_cast<double>(bytes) / (1024.0 * 1024.0 * 1024.0));
+		else if (bytes >= 1024ull * 1024)
+			snprintf(text, sizeof(text), "%.2f MB", static_cast<double>(bytes) / (1024.0 * 1024.0));
+		else if (bytes >= 1024ull)
+			snprintf(text, sizeof(text), "%.2f KB", static_cast<double>(bytes) / 1024.0);
+		else
+			snprintf(text, sizeof(text), "%llu B", static_cast<unsigned long long>(bytes));
+
+		return text;
+	}
+}
@@ -0,0 +1,14 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+namespace wVkHelpers
+{
+	// Mip levels of a full chain down to 1x1, same count Texture uses for MIPMAP_GENERATE
+	inline uint32_t getMipLevelCount(uint32_t width, uint32_t height)
+	{
+		return static_cast<uint32_t>(std::floor(std::log2(std::max(width, height)))) + 1;
+	}
+}
@@ -1,9 +1,11 @@
 #pragma once
+#include <algorithm>
 #include <set>
 #include <stdexcept>
 #include <vector>
 #include <vulkan/vulkan.h>
 
+#include "wVkLogicalDevice.h"
 #include "wVkQueueFamilies.h"
 #include "wVkSwapchain.h"
 #include "BEARVulkan/wVkGlobalVariables.h"
@@ -11,15 +13,14 @@
 
 namespace wVkHelpers {
 
-	bool checkDeviceExtensionSupport(VkPhysicalDevice device) {
+	inline bool checkDeviceExtensionSupport(VkPhysicalDevice device, const std::vector<const char*>& extensions) {
 		uint32_t extensionCount;
 		vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, nullptr);
 
 		std::vector<VkExtensionProperties> availableExtensions(extensionCount);
 		vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, availableExtensions.data());
 
-		//checking for swapchain support
-		std::set<std::string> requiredExtensions(wVkConstants::deviceExtensions.begin(), wVkConstants::deviceExtensions.end());
+		std::set<std::string> requiredExtensions(extensions.begin(), extensions.end());
 
 		for (const auto& extension : availableExtensions) {
 			requiredExtensions.erase(extension.extensionName);
@@ -28,22 +29,101 @@ namespace wVkHelpers {
 		return requiredExtensions.empty();
 	}
 
+	// Everything past the required tier, only call it for suitable devices
+	inline wVkDeviceCapabilities queryDeviceCapabilities(VkPhysicalDevice device) {
+		wVkDeviceCapabilities capabilities;
 
+		VkPhysicalDeviceFeatures supportedFeatures;
+		vkGetPhysicalDeviceFeatures(device, &supportedFeatures);
+		capabilities.m_SamplerAnisotropy = supportedFeatures.samplerAnisotropy == VK_TRUE;
+		capabilities.m_TextureCompressionBC = supportedFeatures.textureCompressionBC == VK_TRUE;
+		capabilities.m_MemoryBudget = isDeviceExtensionSupported(device, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+
+		// Feature structs of extensions the device doesn't have can't be queried, the extensions go first
+		if (checkDeviceExtensionSupport(device, wVkConstants::rayTracingDeviceExtensions)) {
+			VkPhysicalDeviceBufferDeviceAddressFeatures bufferDeviceAddress{};
+			bufferDeviceAddress.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_BUFFER_DEVICE_ADDRESS_FEATURES;
+
+			VkPhysicalDeviceAccelerationStructureFeaturesKHR accelerationStructure{};
+			accelerationStructure.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ACCELERATION_STRUCTURE_FEATURES_KHR;
+			accelerationStructure.pNext = &bufferDeviceAddress;
+
+			VkPhysicalDeviceRayTracingPipelineFeaturesKHR rayTracingPipeline{};
+			rayTracingPipeline.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_RAY_TRACING_PIPELINE_FEATURES_KHR;
+			rayTracingPipeline.pNext = &accelerationStructure;
+
+			VkPhysicalDeviceRayQueryFeaturesKHR rayQuery{};
+			rayQuery.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_RAY_QUERY_FEATURES_KHR;
+			rayQuery.pNext = &rayTracingPipeline;
+
+			VkPhysicalDeviceFeatures2 features2{};
+			features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+			features2.pNext = &rayQuery;
+			vkGetPhysicalDeviceFeatures2(device, &features2);
+
+			capabilities.m_RayTracing = bufferDeviceAddress.bufferDeviceAddress && accelerationStructure.accelerationStructure
+				&& rayTracingPipeline.rayTracingPipeline && rayQuery.rayQuery;
+		}
+
+		return capabilities;
+	}
+
+	// Having the extension doesn't mean the feature is there, only call it when it has
+	inline bool isDynamicRenderingSupported(VkPhysicalDevice device) {
+		VkPhysicalDeviceDynamicRenderingFeaturesKHR dynamicRendering{};
+		dynamicRendering.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_FEATURES_KHR;
+
+		VkPhysicalDeviceFeatures2 features2{};
+		features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+		features2.pNext = &dynamicRendering;
+		vkGetPhysicalDeviceFeatures2(device, &features2);
+
+		return dynamicRendering.dynamicRendering == VK_TRUE;
+	}
+
+	// Only what nothing runs without, the rest is in wVkDeviceCapabilities
 	inline bool isDeviceSuitable(VkPhysicalDevice device) {
 		QueueFamilyIndices indices = findQueueFamilies(device);
 
-		const bool extensionsSupported = checkDeviceExtensionSupport(device);
-
-		VkPhysicalDeviceFeatures supportedFeatures;
-		vkGetPhysicalDeviceFeatures(device, &supportedFeatures);
+		const bool extensionsSupported = checkDeviceExtensionSupport(device, getRequiredDeviceExtensions()) && isDynamicRenderingSupported(device);
 
-		bool swapChainAdequate = false;
-		if (extensionsSupported) {
+		// Headless there's no surface to check against
+		bool swapChainAdequate = wVkGlobals::g_Headless;
+		if (extensionsSupported && !wVkGlobals::g_Headless) {
 			const SwapChainSupportDetails swapChainSupport = querySwapChainSupport(device);
 			swapChainAdequate = !swapChainSupport.formats.empty() && !swapChainSupport.presentModes.empty();
 		}
 
-		return indices.isComplete() && extensionsSupported && swapChainAdequate && supportedFeatures.samplerAnisotropy;
+		return indices.isComplete() && extensionsSupported && swapChainAdequate;
+	}
+
+	// Higher is better. The kind of device counts most, then ray tracing, then device local memory in MB,
+	// so a discrete GPU without RT still beats an integrated one with it.
+	inline uint64_t scorePhysicalDevice(VkPhysicalDevice device, const wVkDeviceCapabilities& capabilities) {
+		VkPhysicalDeviceProperties properties;
+		vkGetPhysicalDeviceProperties(device, &properties);
+
+		uint64_t typeRank = 0;
+		switch (properties.deviceType) {
+		case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU: typeRank = 4; break;
+		case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU: typeRank = 3; break;
+		case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU: typeRank = 2; break;
+		case VK_PHYSICAL_DEVICE_TYPE_CPU: typeRank = 1; break;
+		default: break;
+		}
+
+		VkPhysicalDeviceMemoryProperties memProperties;
+		vkGetPhysicalDeviceMemoryProperties(device, &memProperties);
+
+		uint64_t deviceLocalBytes = 0;
+		for (uint32_t i = 0; i < memProperties.memoryHeapCount; i++) {
+			if (memProperties.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT)
+				deviceLocalBytes += memProperties.memoryHeaps[i].size;
+		}
+
+		// Heaps are capped to 1M MB, the tiers above stay apart
+		const uint64_t deviceLocalMB = std::min<uint64_t>(deviceLocalBytes / (1024 * 1024), 999999);
+		return typeRank * 10000000 + (capabilities.m_RayTracing ? 1000000 : 0) + deviceLocalMB;
 	}
 
 	inline VkPhysicalDevice pickPhysicalDevice() {
@@ -59,19 +139,33 @@ namespace wVkHelpers {
 		std::vector<VkPhysicalDevice> devices(deviceCount);
 		vkEnumeratePhysicalDevices(wVkGlobals::g_Instance, &deviceCount, devices.data());
 
+		// Best score of the suitable ones, not the first suitable one
+		VkPhysicalDevice bestDevice = VK_NULL_HANDLE;
+		uint64_t bestScore = 0;
 		for (const auto& device : devices) {
 			VkPhysicalDeviceProperties deviceProperties;
 			vkGetPhysicalDeviceProperties(device, &deviceProperties);
 
-			VK_LOG_INFO("%s", deviceProperties.deviceName);
+			if (!isDeviceSuitable(device)) {
+				VK_LOG_INFO("%s: not suitable", deviceProperties.deviceName);
+				continue;
+			}
+
+			const wVkDeviceCapabilities capabilities = queryDeviceCapabilities(device);
+			const uint64_t score = scorePhysicalDevice(device, capabilities);
+			VK_LOG_INFO("%s: score %i, ray tracing %s", deviceProperties.deviceName, static_cast<int>(score), capabilities.m_RayTracing ? "yes" : "no");
 
-			if (isDeviceSuitable(device)) {
-				return device;
+			if (bestDevice == VK_NULL_HANDLE || score > bestScore) {
+				bestDevice = device;
+				bestScore = score;
 			}
 		}
 
-		VK_LOG_ERROR("Failed to find a suitable GPU!");
-		throw std::runtime_error("");
-		return VK_NULL_HANDLE;
+		if (bestDevice == VK_NULL_HANDLE) {
+			VK_LOG_ERROR("Failed to find a suitable GPU!");
+			throw std::runtime_error("");
+		}
+
+		return bestDevice;
 	}
-}
+}
\ No newline at end of file
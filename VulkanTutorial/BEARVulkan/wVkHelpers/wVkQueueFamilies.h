@@ -37,8 +37,12 @@ namespace wVkHelpers {
 			}
 
 			// Querying whether the queue family we found also supports "presentation"
+			// Headless nothing is presented, the graphics queue stands in so the rest doesn't need to care
 			VkBool32 presentSupport = false;
-			vkGetPhysicalDeviceSurfaceSupportKHR(device, i, wVkGlobals::g_Surface, &presentSupport);
+			if (wVkGlobals::g_Headless)
+				presentSupport = (queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT) ? VK_TRUE : VK_FALSE;
+			else
+				vkGetPhysicalDeviceSurfaceSupportKHR(device, i, wVkGlobals::g_Surface, &presentSupport);
 			if (presentSupport) {
 				indices.presentFamily = i;
 			}
@@ -141,7 +141,7 @@ namespace wVkHelpers {
 		// Ref: https://vulkan-tutorial.com/en/Drawing_a_triangle/Swap_chain_recreation
 		createInfo.oldSwapchain = VK_NULL_HANDLE;
 
-		if (vkCreateSwapchainKHR(wVkGlobals::g_Device, &createInfo, nullptr, &swapchain.swapChain) != VK_SUCCESS) {
+		if (vkCreateSwapchainKHR(wVkGlobals::g_Device, &createInfo, wVkGlobals::g_AllocationCallbacks, &swapchain.swapChain) != VK_SUCCESS) {
 			throw std::runtime_error("failed to create swap chain!");
 		}
 
@@ -155,29 +155,4 @@ namespace wVkHelpers {
 
 	}
 
-	inline VkFramebuffer createFramebuffer(int index)
-	{
-		VkFramebuffer framebuffer;
-		const std::array<VkImageView, 2> attachments = {
-				wVkGlobals::g_SwapChainImageViews[index],
-				wVkGlobals::g_DepthImageView
-		};
-
-		VkFramebufferCreateInfo framebufferInfo{};
-		framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
-		framebufferInfo.renderPass = wVkGlobals::g_RenderPass;
-		framebufferInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
-		framebufferInfo.pAttachments = attachments.data();
-		framebufferInfo.width = wVkGlobals::g_SwapChain.swapChainExtent.width;
-		framebufferInfo.height = wVkGlobals::g_SwapChain.swapChainExtent.height;
-		framebufferInfo.layers = 1;
-
-
-		if (vkCreateFramebuffer(wVkGlobals::g_Device, &framebufferInfo, nullptr, &framebuffer) != VK_SUCCESS) {
-			throw std::runtime_error("failed to create framebuffer!");
-		}
-
-		return framebuffer;
-	}
-
 }
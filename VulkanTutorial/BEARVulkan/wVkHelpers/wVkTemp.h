@@ -3,6 +3,7 @@
 #include <stdexcept>
 
 #include "wVkHelpers.h"
+#include "wVkMemory.h"
 #include "BEARVulkan/wVkGlobalVariables.h"
 #include "BEARVulkan/wVkHelpers/wVkCommands.h"
 #include "vulkan/vulkan.h"
@@ -18,7 +19,7 @@ namespace wVkHelpers
 		bufferInfo.usage = usage;
 		bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
 
-		if (vkCreateBuffer(wVkGlobals::g_Device, &bufferInfo, nullptr, &buffer) != VK_SUCCESS) {
+		if (vkCreateBuffer(wVkGlobals::g_Device, &bufferInfo, wVkGlobals::g_AllocationCallbacks, &buffer) != VK_SUCCESS) {
 			throw std::runtime_error("failed to create buffer!");
 		}
 
@@ -30,13 +31,44 @@ namespace wVkHelpers
 		allocInfo.allocationSize = memRequirements.size;
 		allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, properties);
 
-		if (vkAllocateMemory(wVkGlobals::g_Device, &allocInfo, nullptr, &bufferMemory) != VK_SUCCESS) {
+		if (vkAllocateMemory(wVkGlobals::g_Device, &allocInfo, wVkGlobals::g_AllocationCallbacks, &bufferMemory) != VK_SUCCESS) {
 			throw std::runtime_error("failed to allocate buffer memory!");
 		}
 
 		vkBindBufferMemory(wVkGlobals::g_Device, buffer, bufferMemory, 0);
 	}
 
+	// Picks the memory type through the scoring policy, returns the memory type index that was used
+	inline uint32_t createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, const wVkMemoryPolicy& policy, VkBuffer& buffer, VkDeviceMemory& bufferMemory) {
+		VkBufferCreateInfo bufferInfo{};
+		bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+		bufferInfo.size = size;
+		bufferInfo.usage = usage;
+		bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+		if (vkCreateBuffer(wVkGlobals::g_Device, &bufferInfo, wVkGlobals::g_AllocationCallbacks, &buffer) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create buffer!");
+		}
+
+		VkMemoryRequirements memRequirements;
+		vkGetBufferMemoryRequirements(wVkGlobals::g_Device, buffer, &memRequirements);
+
+		const uint32_t memoryType = findMemoryType(memRequirements.memoryTypeBits, policy, memRequirements.size);
+
+		VkMemoryAllocateInfo allocInfo{};
+		allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+		allocInfo.allocationSize = memRequirements.size;
+		allocInfo.memoryTypeIndex = memoryType;
+
+		if (vkAllocateMemory(wVkGlobals::g_Device, &allocInfo, wVkGlobals::g_AllocationCallbacks, &bufferMemory) != VK_SUCCESS) {
+			throw std::runtime_error("failed to allocate buffer memory!");
+		}
+
+		vkBindBufferMemory(wVkGlobals::g_Device, buffer, bufferMemory, 0);
+
+		return memoryType;
+	}
+
 	inline void copyBufferNewCmd(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size) {
 
 		VkCommandBuffer commandBuffer = beginSingleTimeCommand();
@@ -50,8 +82,50 @@ namespace wVkHelpers
 		endSingleTimeCommand(commandBuffer);
 	}
 
+	// Just the VkBuffer, memory comes from wVkGlobals::g_DeviceAllocator
+	inline VkBuffer createBufferObject(VkDeviceSize size, VkBufferUsageFlags usage) {
+		VkBufferCreateInfo bufferInfo{};
+		bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+		bufferInfo.size = size;
+		bufferInfo.usage = usage;
+		bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+		VkBuffer buffer = VK_NULL_HANDLE;
+		if (vkCreateBuffer(wVkGlobals::g_Device, &bufferInfo, wVkGlobals::g_AllocationCallbacks, &buffer) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create buffer!");
+		}
+
+		return buffer;
+	}
+
+	// Just the VkImage, memory comes from wVkGlobals::g_DeviceAllocator
+	inline VkImage createImage2DObject(uint32_t width, uint32_t height, uint32_t mipLevels, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage, uint32_t arrayLayers = 1) {
+		VkImageCreateInfo imageInfo{};
+		imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+		imageInfo.imageType = VK_IMAGE_TYPE_2D;
+		imageInfo.extent.width = width;
+		imageInfo.extent.height = height;
+		imageInfo.extent.depth = 1;
+		imageInfo.mipLevels = mipLevels;
+		imageInfo.arrayLayers = arrayLayers;
+		imageInfo.format = format;
+		imageInfo.tiling = tiling;
+		imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		imageInfo.usage = usage;
+		imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+		imageInfo.flags = 0; // Optional
+
+		VkImage image = VK_NULL_HANDLE;
+		if (vkCreateImage(wVkGlobals::g_Device, &imageInfo, wVkGlobals::g_AllocationCallbacks, &image) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create image!");
+		}
+
+		return image;
+	}
+
 	// ToDo delete, keep completely within Texture
-	inline void createImage2D(uint32_t width, uint32_t height, uint32_t mipLevels, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkImage& image, VkDeviceMemory& imageMemory) {
+	// Returns the memory type index that was used
+	inline uint32_t createImage2D(uint32_t width, uint32_t height, uint32_t mipLevels, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkImage& image, VkDeviceMemory& imageMemory) {
 
 		VkImageCreateInfo imageInfo{};
 		imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
@@ -68,7 +142,7 @@ namespace wVkHelpers
 		imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
 		imageInfo.flags = 0; // Optional
 
-		if (vkCreateImage(wVkGlobals::g_Device, &imageInfo, nullptr, &image) != VK_SUCCESS) {
+		if (vkCreateImage(wVkGlobals::g_Device, &imageInfo, wVkGlobals::g_AllocationCallbacks, &image) != VK_SUCCESS) {
 			throw std::runtime_error("failed to create image!");
 		}
 
@@ -80,11 +154,13 @@ namespace wVkHelpers
 		allocInfo.allocationSize = memRequirements.size;
 		allocInfo.memoryTypeIndex = wVkHelpers::findMemoryType(memRequirements.memoryTypeBits, properties);
 
-		if (vkAllocateMemory(wVkGlobals::g_Device, &allocInfo, nullptr, &imageMemory) != VK_SUCCESS) {
+		if (vkAllocateMemory(wVkGlobals::g_Device, &allocInfo, wVkGlobals::g_AllocationCallbacks, &imageMemory) != VK_SUCCESS) {
 			throw std::runtime_error("failed to allocate image memory!");
 		}
 
 		vkBindImageMemory(wVkGlobals::g_Device, image, imageMemory, 0);
+
+		return allocInfo.memoryTypeIndex;
 	}
 
 
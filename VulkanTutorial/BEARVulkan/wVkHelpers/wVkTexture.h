@@ -1,6 +1,8 @@
 #pragma once
 
+#include "BEARHeaders/Texture.h"
 #include "BEARVulkan/wVkHelpers/wVkCommands.h"
+#include "Utils/ConsoleLogger.h"
 #include "vulkan/vulkan.h"
 
 namespace wVkHelpers {
@@ -20,13 +22,71 @@ namespace wVkHelpers {
 		viewInfo.subresourceRange.layerCount = 1;
 
 		VkImageView imageView;
-		if (vkCreateImageView(wVkGlobals::g_Device, &viewInfo, nullptr, &imageView) != VK_SUCCESS) {
+		if (vkCreateImageView(wVkGlobals::g_Device, &viewInfo, wVkGlobals::g_AllocationCallbacks, &imageView) != VK_SUCCESS) {
 			throw std::runtime_error("failed to create texture image view!");
 		}
 
 		return imageView;
 	}
 
+	// Image of arrayLayers 2D layers, sampled as a sampler2DArray
+	inline VkImageView createImageArrayView(VkImage image, uint32_t mipLevels, uint32_t arrayLayers, VkFormat format) {
+		VkImageViewCreateInfo viewInfo{};
+		viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+		viewInfo.image = image;
+		viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D_ARRAY;
+		viewInfo.format = format;
+		viewInfo.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, mipLevels, 0, arrayLayers };
+
+		VkImageView imageView;
+		if (vkCreateImageView(wVkGlobals::g_Device, &viewInfo, wVkGlobals::g_AllocationCallbacks, &imageView) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create texture array image view!");
+		}
+
+		return imageView;
+	}
+
+	inline VkImageLayout getVulkanLayout(TextureLayout layout)
+	{
+		switch (layout) {
+		case TextureLayout::SHADER_READ:
+			return VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		case TextureLayout::RENDER_TARGET:
+			return VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+		case TextureLayout::UNORDERED_ACCESS:
+			return VK_IMAGE_LAYOUT_GENERAL;
+		case TextureLayout::COPY_SOURCE:
+			return VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+		case TextureLayout::COPY_DEST:
+			return VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		default:
+			ASSERT(false, "Texture layout not implemented");
+			return VK_IMAGE_LAYOUT_UNDEFINED;
+		}
+	}
+
+	// Records a layout transition into an existing command buffer, access masks and stages are up to the caller
+	inline void recordImageBarrier(VkCommandBuffer commandBuffer, VkImage image, uint32_t baseMipLevel, uint32_t mipLevels, VkImageLayout oldLayout, VkImageLayout newLayout,
+		VkAccessFlags srcAccess, VkAccessFlags dstAccess, VkPipelineStageFlags srcStage, VkPipelineStageFlags dstStage, uint32_t layerCount = 1) {
+
+		VkImageMemoryBarrier barrier{};
+		barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		barrier.oldLayout = oldLayout;
+		barrier.newLayout = newLayout;
+		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.image = image;
+		barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		barrier.subresourceRange.baseMipLevel = baseMipLevel;
+		barrier.subresourceRange.levelCount = mipLevels;
+		barrier.subresourceRange.baseArrayLayer = 0;
+		barrier.subresourceRange.layerCount = layerCount;
+		barrier.srcAccessMask = srcAccess;
+		barrier.dstAccessMask = dstAccess;
+
+		vkCmdPipelineBarrier(commandBuffer, srcStage, dstStage, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+	}
+
 	inline void transitionImageLayout(VkImage image, VkFormat format, uint32_t mipLevels, VkImageLayout oldLayout, VkImageLayout newLayout) {
 
 		// ToDo, move this out to be able to pass multiple transitions into 1 Command Buffer
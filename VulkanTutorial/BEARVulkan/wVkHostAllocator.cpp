@@ -0,0 +1,478 @@
+#include "wVkHostAllocator.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+
+#include "imgui.h"
+
+#include "wVkGlobalVariables.h"
+#include "Utils/ConsoleLogger.h"
+#include "wVkHelpers/wVkMemory.h"
+
+// Sits right in front of every pointer we hand out.
+// malloc and the pool chunks are 16 byte aligned on 64 bit, so is every block carved from them.
+struct wVkHostAllocationHeader
+{
+	uint64_t m_Size;
+	uint32_t m_Offset; // From the start of the block to the pointer handed out
+	uint16_t m_Scope;
+	uint16_t m_SizeClass; // NUM_SIZE_CLASSES for heap allocations
+};
+
+constexpr size_t HEADER_SIZE = sizeof(wVkHostAllocationHeader);
+static_assert(HEADER_SIZE == 16, "The header has to keep 16 byte aligned blocks 16 byte aligned");
+
+constexpr size_t MIN_BLOCK_SIZE = 32;
+
+wVkHostAllocationHeader* GetAllocationHeader(void* memory)
+{
+	return reinterpret_cast<wVkHostAllocationHeader*>(static_cast<uint8_t*>(memory) - HEADER_SIZE);
+}
+
+size_t GetSizeClassBlockSize(uint32_t sizeClass)
+{
+	return MIN_BLOCK_SIZE << sizeClass;
+}
+
+uint32_t GetSizeClass(size_t blockSize)
+{
+	for (uint32_t i = 0; i < wVkHostAllocator::NUM_SIZE_CLASSES; i++) {
+		if (blockSize <= GetSizeClassBlockSize(i))
+			return i;
+	}
+
+	return wVkHostAllocator::NUM_SIZE_CLASSES;
+}
+
+void TrackAllocation(wVkHostAllocator::ScopeStats& stats, uint64_t size)
+{
+	stats.m_CurrentBytes += size;
+	stats.m_PeakBytes = std::max(stats.m_PeakBytes, stats.m_CurrentBytes);
+	stats.m_NumAllocations++;
+	stats.m_PeakAllocations = std::max(stats.m_PeakAllocations, stats.m_NumAllocations);
+	stats.m_TotalAllocations++;
+}
+
+void TrackFree(wVkHostAllocator::ScopeStats& stats, uint64_t size)
+{
+	stats.m_CurrentBytes -= size;
+	stats.m_NumAllocations--;
+}
+
+wVkHostAllocator::wVkHostAllocator()
+{
+	m_Callbacks.pUserData = this;
+	m_Callbacks.pfnAllocation = &AllocationCallback;
+	m_Callbacks.pfnReallocation = &ReallocationCallback;
+	m_Callbacks.pfnFree = &FreeCallback;
+	m_Callbacks.pfnInternalAllocation = &InternalAllocationCallback;
+	m_Callbacks.pfnInternalFree = &InternalFreeCallback;
+}
+
+void wVkHostAllocator::Destroy()
+{
+	for (uint32_t scope = 0; scope < NUM_SCOPES; scope++)
+	{
+		ScopePools& pools = m_Scopes[scope];
+		std::lock_guard<std::mutex> lock(pools.m_Mutex);
+
+		// The driver still owns blocks in these chunks, leaking them beats a use after free
+		if (pools.m_Stats.m_NumAllocations != 0) {
+			LOG_WARNING("Host allocator scope %s still has %i allocations (%s) alive, keeping its chunks", GetScopeName(static_cast<VkSystemAllocationScope>(scope)),
+				static_cast<int>(pools.m_Stats.m_NumAllocations), wVkHelpers::formatBytes(pools.m_Stats.m_CurrentBytes).c_str());
+			continue;
+		}
+
+		for (void* chunk : pools.m_Chunks)
+			std::free(chunk);
+
+		pools.m_Chunks.clear();
+		for (auto& sizeClass : pools.m_SizeClasses)
+			sizeClass = {};
+
+		pools.m_Stats.m_ReservedBytes = 0;
+	}
+}
+
+wVkHostAllocator::ScopeStats wVkHostAllocator::GetScopeStats(VkSystemAllocationScope scope)
+{
+	ScopePools& pools = m_Scopes[scope];
+	std::lock_guard<std::mutex> lock(pools.m_Mutex);
+	return pools.m_Stats;
+}
+
+wVkHostAllocator::ScopeStats wVkHostAllocator::GetTotalStats()
+{
+	// Peaks of different scopes didn't necessarily happen at the same time, the summed peaks are an upper bound
+	ScopeStats total;
+	for (uint32_t scope = 0; scope < NUM_SCOPES; scope++)
+	{
+		const ScopeStats stats = GetScopeStats(static_cast<VkSystemAllocationScope>(scope));
+		total.m_CurrentBytes += stats.m_CurrentBytes;
+		total.m_PeakBytes += stats.m_PeakBytes;
+		total.m_NumAllocations += stats.m_NumAllocations;
+		total.m_PeakAllocations += stats.m_PeakAllocations;
+		total.m_TotalAllocations += stats.m_TotalAllocations;
+		total.m_NumHeapAllocations += stats.m_NumHeapAllocations;
+		total.m_ReservedBytes += stats.m_ReservedBytes;
+		total.m_InternalBytes += stats.m_InternalBytes;
+		total.m_PeakInternalBytes += stats.m_PeakInternalBytes;
+	}
+
+	return total;
+}
+
+void wVkHostAllocator::ResetPeaks()
+{
+	for (auto& pools : m_Scopes)
+	{
+		std::lock_guard<std::mutex> lock(pools.m_Mutex);
+		pools.m_Stats.m_PeakBytes = pools.m_Stats.m_CurrentBytes;
+		pools.m_Stats.m_PeakAllocations = pools.m_Stats.m_NumAllocations;
+		pools.m_Stats.m_PeakInternalBytes = pools.m_Stats.m_InternalBytes;
+	}
+}
+
+const char* wVkHostAllocator::GetScopeName(VkSystemAllocationScope scope)
+{
+	switch (scope)
+	{
+	case VK_SYSTEM_ALLOCATION_SCOPE_COMMAND: return "Command";
+	case VK_SYSTEM_ALLOCATION_SCOPE_OBJECT: return "Object";
+	case VK_SYSTEM_ALLOCATION_SCOPE_CACHE: return "Cache";
+	case VK_SYSTEM_ALLOCATION_SCOPE_DEVICE: return "Device";
+	case VK_SYSTEM_ALLOCATION_SCOPE_INSTANCE: return "Instance";
+	default: return "Unknown";
+	}
+}
+
+VKAPI_ATTR void* VKAPI_CALL wVkHostAllocator::AllocationCallback(void* userData, size_t size, size_t alignment, VkSystemAllocationScope scope)
+{
+	return static_cast<wVkHostAllocator*>(userData)->Allocate(size, alignment, scope);
+}
+
+VKAPI_ATTR void* VKAPI_CALL wVkHostAllocator::ReallocationCallback(void* userData, void* original, size_t size, size_t alignment, VkSystemAllocationScope scope)
+{
+	return static_cast<wVkHostAllocator*>(userData)->Reallocate(original, size, alignment, scope);
+}
+
+VKAPI_ATTR void VKAPI_CALL wVkHostAllocator::FreeCallback(void* userData, void* memory)
+{
+	static_cast<wVkHostAllocator*>(userData)->Free(memory);
+}
+
+VKAPI_ATTR void VKAPI_CALL wVkHostAllocator::InternalAllocationCallback(void* userData, size_t size, VkInternalAllocationType type, VkSystemAllocationScope scope)
+{
+	ScopePools& pools = static_cast<wVkHostAllocator*>(userData)->m_Scopes[scope];
+	std::lock_guard<std::mutex> lock(pools.m_Mutex);
+	pools.m_Stats.m_InternalBytes += size;
+	pools.m_Stats.m_PeakInternalBytes = std::max(pools.m_Stats.m_PeakInternalBytes, pools.m_Stats.m_InternalBytes);
+}
+
+VKAPI_ATTR void VKAPI_CALL wVkHostAllocator::InternalFreeCallback(void* userData, size_t size, VkInternalAllocationType type, VkSystemAllocationScope scope)
+{
+	ScopePools& pools = static_cast<wVkHostAllocator*>(userData)->m_Scopes[scope];
+	std::lock_guard<std::mutex> lock(pools.m_Mutex);
+	pools.m_Stats.m_InternalBytes -= std::min<uint64_t>(size, pools.m_Stats.m_InternalBytes);
+}
+
+void* wVkHostAllocator::Allocate(size_t size, size_t alignment, VkSystemAllocationScope scope)
+{
+	if (size == 0)
+		return nullptr;
+
+	// Blocks are 16 byte aligned, the header fits in the padding of anything aligned to more than that
+	alignment = std::max(alignment, HEADER_SIZE);
+	const size_t blockSize = size + alignment;
+
+	const uint32_t sizeClass = m_PoolingEnabled ? GetSizeClass(blockSize) : NUM_SIZE_CLASSES;
+
+	ScopePools& pools = m_Scopes[scope];
+	std::lock_guard<std::mutex> lock(pools.m_Mutex);
+
+	uint8_t* block;
+	if (sizeClass < NUM_SIZE_CLASSES) {
+		block = static_cast<uint8_t*>(AllocateBlock(scope, sizeClass));
+	}
+	else {
+		block = static_cast<uint8_t*>(std::malloc(blockSize));
+		pools.m_Stats.m_NumHeapAllocations++;
+	}
+
+	// The spec wants nullptr back on failure, the driver turns it into VK_ERROR_OUT_OF_HOST_MEMORY
+	if (block == nullptr)
+		return nullptr;
+
+	const uintptr_t blockAddress = reinterpret_cast<uintptr_t>(block);
+	const uintptr_t userAddress = (blockAddress + HEADER_SIZE + alignment - 1) & ~(static_cast<uintptr_t>(alignment) - 1);
+	void* memory = reinterpret_cast<void*>(userAddress);
+
+	wVkHostAllocationHeader* header = GetAllocationHeader(memory);
+	header->m_Size = size;
+	header->m_Offset = static_cast<uint32_t>(userAddress - blockAddress);
+	header->m_Scope = static_cast<uint16_t>(scope);
+	header->m_SizeClass = static_cast<uint16_t>(sizeClass);
+
+	TrackAllocation(pools.m_Stats, size);
+
+	return memory;
+}
+
+void* wVkHostAllocator::Reallocate(void* original, size_t size, size_t alignment, VkSystemAllocationScope scope)
+{
+	if (original == nullptr)
+		return Allocate(size, alignment, scope);
+
+	if (size == 0) {
+		Free(original);
+		return nullptr;
+	}
+
+	wVkHostAllocationHeader* header = GetAllocationHeader(original);
+
+	// Grow or shrink in place if the block is big enough and nothing else changes
+	const bool sameScope = header->m_Scope == scope;
+	const bool aligned = (reinterpret_cast<uintptr_t>(original) & (alignment - 1)) == 0;
+	if (sameScope && aligned && header->m_SizeClass < NUM_SIZE_CLASSES) {
+		const size_t capacity = GetSizeClassBlockSize(header->m_SizeClass) - header->m_Offset;
+		if (size <= capacity) {
+			ScopePools& pools = m_Scopes[scope];
+			std::lock_guard<std::mutex> lock(pools.m_Mutex);
+
+			TrackFree(pools.m_Stats, header->m_Size);
+			TrackAllocation(pools.m_Stats, size);
+			header->m_Size = size;
+			return original;
+		}
+	}
+
+	// On failure the original allocation has to stay untouched
+	void* memory = Allocate(size, alignment, scope);
+	if (memory == nullptr)
+		return nullptr;
+
+	memcpy(memory, original, std::min<size_t>(size, header->m_Size));
+	Free(original);
+
+	return memory;
+}
+
+void wVkHostAllocator::Free(void* memory)
+{
+	if (memory == nullptr)
+		return;
+
+	const wVkHostAllocationHeader* header = GetAllocationHeader(memory);
+	const uint32_t scope = header->m_Scope;
+	const uint32_t sizeClass = header->m_SizeClass;
+	uint8_t* block = static_cast<uint8_t*>(memory) - header->m_Offset;
+
+	ScopePools& pools = m_Scopes[scope];
+	std::lock_guard<std::mutex> lock(pools.m_Mutex);
+
+	TrackFree(pools.m_Stats, header->m_Size);
+
+	if (sizeClass < NUM_SIZE_CLASSES)
+		FreeBlock(scope, sizeClass, block);
+	else
+		std::free(block);
+}
+
+void* wVkHostAllocator::AllocateBlock(uint32_t scope, uint32_t sizeClass)
+{
+	ScopePools& pools = m_Scopes[scope];
+	SizeClassPool& pool = pools.m_SizeClasses[sizeClass];
+
+	if (pool.m_FreeList != nullptr) {
+		void* block = pool.m_FreeList;
+		pool.m_FreeList = *static_cast<void**>(block);
+		return block;
+	}
+
+	const size_t blockSize = GetSizeClassBlockSize(sizeClass);
+	if (pool.m_BumpPtr == nullptr || pool.m_BumpPtr + blockSize > pool.m_BumpEnd) {
+		// Whatever is left of the previous chunk is wasted, at most one block worth
+		uint8_t* chunk = static_cast<uint8_t*>(std::malloc(CHUNK_SIZE));
+		if (chunk == nullptr)
+			return nullptr;
+
+		pools.m_Chunks.push_back(chunk);
+		pools.m_Stats.m_ReservedBytes += CHUNK_SIZE;
+
+		pool.m_BumpPtr = chunk;
+		pool.m_BumpEnd = chunk + CHUNK_SIZE;
+	}
+
+	void* block = pool.m_BumpPtr;
+	pool.m_BumpPtr += blockSize;
+	return block;
+}
+
+void wVkHostAllocator::FreeBlock(uint32_t scope, uint32_t sizeClass, void* block)
+{
+	SizeClassPool& pool = m_Scopes[scope].m_SizeClasses[sizeClass];
+	*static_cast<void**>(block) = pool.m_FreeList;
+	pool.m_FreeList = block;
+}
+
+wVkHostAllocator::BenchmarkResult wVkHostAllocator::RunBenchmark(uint32_t numObjects, uint32_t numRounds)
+{
+	ASSERT(wVkGlobals::g_Device != VK_NULL_HANDLE, "The host allocator benchmark needs a device");
+
+	// Keeps us well below maxSamplerAllocationCount (4000 on most drivers) with the samplers the app already has
+	numObjects = std::min(numObjects, 1024u);
+
+	std::vector<VkBuffer> buffers(numObjects);
+	std::vector<VkSampler> samplers(numObjects);
+	std::vector<VkDescriptorSetLayout> layouts(numObjects);
+	std::vector<VkSemaphore> semaphores(numObjects);
+
+	VkBufferCreateInfo bufferInfo{};
+	bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	bufferInfo.size = 256;
+	bufferInfo.usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT;
+	bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+	VkSamplerCreateInfo samplerInfo{};
+	samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+	samplerInfo.magFilter = VK_FILTER_LINEAR;
+	samplerInfo.minFilter = VK_FILTER_LINEAR;
+	samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+	samplerInfo.maxLod = VK_LOD_CLAMP_NONE;
+
+	VkDescriptorSetLayoutBinding binding{};
+	binding.binding = 0;
+	binding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+	binding.descriptorCount = 1;
+	binding.stageFlags = VK_SHADER_STAGE_ALL;
+
+	VkDescriptorSetLayoutCreateInfo layoutInfo{};
+	layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	layoutInfo.bindingCount = 1;
+	layoutInfo.pBindings = &binding;
+
+	VkSemaphoreCreateInfo semaphoreInfo{};
+	semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+
+	auto runRounds = [&](const VkAllocationCallbacks* callbacks) -> double
+	{
+		// The first round is a warm up, it fills the pools and whatever caches the driver has
+		auto start = std::chrono::high_resolution_clock::now();
+		for (uint32_t round = 0; round <= numRounds; round++)
+		{
+			if (round == 1)
+				start = std::chrono::high_resolution_clock::now();
+
+			for (uint32_t i = 0; i < numObjects; i++)
+			{
+				if (vkCreateBuffer(wVkGlobals::g_Device, &bufferInfo, callbacks, &buffers[i]) != VK_SUCCESS ||
+					vkCreateSampler(wVkGlobals::g_Device, &samplerInfo, callbacks, &samplers[i]) != VK_SUCCESS ||
+					vkCreateDescriptorSetLayout(wVkGlobals::g_Device, &layoutInfo, callbacks, &layouts[i]) != VK_SUCCESS ||
+					vkCreateSemaphore(wVkGlobals::g_Device, &semaphoreInfo, callbacks, &semaphores[i]) != VK_SUCCESS) {
+					throw std::runtime_error("failed to create host allocator benchmark objects!");
+				}
+			}
+
+			for (uint32_t i = 0; i < numObjects; i++)
+			{
+				vkDestroyBuffer(wVkGlobals::g_Device, buffers[i], callbacks);
+				vkDestroySampler(wVkGlobals::g_Device, samplers[i], callbacks);
+				vkDestroyDescriptorSetLayout(wVkGlobals::g_Device, layouts[i], callbacks);
+				vkDestroySemaphore(wVkGlobals::g_Device, semaphores[i], callbacks);
+			}
+		}
+
+		const auto end = std::chrono::high_resolution_clock::now();
+		return std::chrono::duration<double, std::milli>(end - start).count();
+	};
+
+	const bool wasPoolingEnabled = m_PoolingEnabled;
+
+	BenchmarkResult result;
+	result.m_NumObjects = numObjects;
+	result.m_DriverMs = runRounds(nullptr);
+
+	m_PoolingEnabled = false;
+	result.m_MallocMs = runRounds(&m_Callbacks);
+
+	m_PoolingEnabled = true;
+	result.m_PooledMs = runRounds(&m_Callbacks);
+
+	m_PoolingEnabled = wasPoolingEnabled;
+	m_LastBenchmark = result;
+
+	char text[256];
+	snprintf(text, sizeof(text), "pooled %.3f ms, malloc %.3f ms, driver %.3f ms", result.m_PooledMs, result.m_MallocMs, result.m_DriverMs);
+	LOG_INFO("Host allocator benchmark, %i rounds of %i buffers/samplers/layouts/semaphores: %s", static_cast<int>(numRounds), static_cast<int>(numObjects), text);
+
+	return result;
+}
+
+void wVkHostAllocator::DrawImGuiPanel()
+{
+	ImGui::Begin("Host Memory");
+
+	bool poolingEnabled = m_PoolingEnabled;
+	if (ImGui::Checkbox("Pooled allocations", &poolingEnabled))
+		m_PoolingEnabled = poolingEnabled;
+
+	ImGui::SameLine();
+	if (ImGui::Button("Reset Peaks"))
+		ResetPeaks();
+
+	const ImGuiTableFlags tableFlags = ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg | ImGuiTableFlags_SizingFixedFit;
+	if (ImGui::BeginTable("HostMemoryScopes", 8, tableFlags))
+	{
+		ImGui::TableSetupColumn("Scope");
+		ImGui::TableSetupColumn("Current");
+		ImGui::TableSetupColumn("Peak");
+		ImGui::TableSetupColumn("Allocs");
+		ImGui::TableSetupColumn("Peak Allocs");
+		ImGui::TableSetupColumn("Heap Allocs");
+		ImGui::TableSetupColumn("Reserved");
+		ImGui::TableSetupColumn("Internal");
+		ImGui::TableHeadersRow();
+
+		auto drawRow = [](const char* name, const ScopeStats& stats)
+		{
+			ImGui::TableNextRow();
+			ImGui::TableNextColumn(); ImGui::TextUnformatted(name);
+			ImGui::TableNextColumn(); ImGui::TextUnformatted(wVkHelpers::formatBytes(stats.m_CurrentBytes).c_str());
+			ImGui::TableNextColumn(); ImGui::TextUnformatted(wVkHelpers::formatBytes(stats.m_PeakBytes).c_str());
+			ImGui::TableNextColumn(); ImGui::Text("%llu", static_cast<unsigned long long>(stats.m_NumAllocations));
+			ImGui::TableNextColumn(); ImGui::Text("%llu", static_cast<unsigned long long>(stats.m_PeakAllocations));
+			ImGui::TableNextColumn(); ImGui::Text("%llu / %llu", static_cast<unsigned long long>(stats.m_NumHeapAllocations), static_cast<unsigned long long>(stats.m_TotalAllocations));
+			ImGui::TableNextColumn(); ImGui::TextUnformatted(wVkHelpers::formatBytes(stats.m_ReservedBytes).c_str());
+			ImGui::TableNextColumn(); ImGui::TextUnformatted(wVkHelpers::formatBytes(stats.m_InternalBytes).c_str());
+		};
+
+		for (uint32_t scope = 0; scope < NUM_SCOPES; scope++)
+			drawRow(GetScopeName(static_cast<VkSystemAllocationScope>(scope)), GetScopeStats(static_cast<VkSystemAllocationScope>(scope)));
+
+		drawRow("Total", GetTotalStats());
+
+		ImGui::EndTable();
+	}
+
+	ImGui::SeparatorText("Benchmark");
+
+	static int numObjects = 1000;
+	static int numRounds = 20;
+	ImGui::SliderInt("Objects per type", &numObjects, 16, 1024);
+	ImGui::SliderInt("Rounds", &numRounds, 1, 100);
+
+	if (ImGui::Button("Run Benchmark"))
+		RunBenchmark(static_cast<uint32_t>(numObjects), static_cast<uint32_t>(numRounds));
+
+	if (m_LastBenchmark.m_NumObjects != 0)
+	{
+		ImGui::Text("Pooled: %.3f ms", m_LastBenchmark.m_PooledMs);
+		ImGui::Text("Malloc: %.3f ms (%.2fx)", m_LastBenchmark.m_MallocMs, m_LastBenchmark.m_MallocMs / std::max(m_LastBenchmark.m_PooledMs, 0.001));
+		ImGui::Text("Driver: %.3f ms (%.2fx)", m_LastBenchmark.m_DriverMs, m_LastBenchmark.m_DriverMs / std::max(m_LastBenchmark.m_PooledMs, 0.001));
+	}
+
+	ImGui::End();
+}
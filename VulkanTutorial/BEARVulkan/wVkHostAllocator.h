@@ -0,0 +1,107 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+#include "vulkan/vulkan.h"
+
+// Host memory allocator handed to the driver through VkAllocationCallbacks.
+// Every allocation scope gets its own size class pools, allocations of different lifetimes
+// (per command buffer, per object, per device...) don't end up interleaved in the same chunks.
+// Anything bigger than the largest size class goes straight to malloc.
+// Memory is tracked per scope, including the internal allocations the driver only notifies us about.
+class wVkHostAllocator
+{
+public:
+	static constexpr uint32_t NUM_SCOPES = VK_SYSTEM_ALLOCATION_SCOPE_INSTANCE + 1;
+	static constexpr uint32_t NUM_SIZE_CLASSES = 8; // 32 bytes to 4KB
+	static constexpr size_t CHUNK_SIZE = 64 * 1024;
+
+	struct ScopeStats
+	{
+		uint64_t m_CurrentBytes = 0;
+		uint64_t m_PeakBytes = 0;
+		uint64_t m_NumAllocations = 0;
+		uint64_t m_PeakAllocations = 0;
+		uint64_t m_TotalAllocations = 0;
+		uint64_t m_NumHeapAllocations = 0; // Too big for a pool, or pooling was disabled
+		uint64_t m_ReservedBytes = 0; // Chunk memory owned by the pools of this scope
+
+		// Reported through the internal allocation notifications, the driver allocates these itself
+		uint64_t m_InternalBytes = 0;
+		uint64_t m_PeakInternalBytes = 0;
+	};
+
+	struct BenchmarkResult
+	{
+		uint32_t m_NumObjects = 0;
+		double m_PooledMs = 0.0;
+		double m_MallocMs = 0.0;
+		double m_DriverMs = 0.0; // nullptr callbacks, the driver's own allocator
+	};
+
+	wVkHostAllocator();
+	~wVkHostAllocator() = default;
+
+	// The callbacks point back at this object
+	wVkHostAllocator(const wVkHostAllocator&) = delete;
+	wVkHostAllocator& operator=(const wVkHostAllocator&) = delete;
+
+	// Frees the pool chunks. Call after the instance has been destroyed.
+	void Destroy();
+
+	const VkAllocationCallbacks* GetCallbacks() const { return &m_Callbacks; }
+
+	// Disabled pooling sends every allocation to malloc, allocations made while it was enabled are still freed correctly
+	void SetPoolingEnabled(bool enabled) { m_PoolingEnabled = enabled; }
+	bool IsPoolingEnabled() const { return m_PoolingEnabled; }
+
+	ScopeStats GetScopeStats(VkSystemAllocationScope scope);
+	ScopeStats GetTotalStats();
+	void ResetPeaks();
+
+	// Creates and destroys numObjects of a few cheap object types per round, with pools, with malloc and without callbacks.
+	// Needs a device, doesn't need it to be idle.
+	BenchmarkResult RunBenchmark(uint32_t numObjects, uint32_t numRounds);
+	const BenchmarkResult& GetLastBenchmark() const { return m_LastBenchmark; }
+
+	void DrawImGuiPanel();
+
+	static const char* GetScopeName(VkSystemAllocationScope scope);
+
+private:
+	static VKAPI_ATTR void* VKAPI_CALL AllocationCallback(void* userData, size_t size, size_t alignment, VkSystemAllocationScope scope);
+	static VKAPI_ATTR void* VKAPI_CALL ReallocationCallback(void* userData, void* original, size_t size, size_t alignment, VkSystemAllocationScope scope);
+	static VKAPI_ATTR void VKAPI_CALL FreeCallback(void* userData, void* memory);
+	static VKAPI_ATTR void VKAPI_CALL InternalAllocationCallback(void* userData, size_t size, VkInternalAllocationType type, VkSystemAllocationScope scope);
+	static VKAPI_ATTR void VKAPI_CALL InternalFreeCallback(void* userData, size_t size, VkInternalAllocationType type, VkSystemAllocationScope scope);
+
+	void* Allocate(size_t size, size_t alignment, VkSystemAllocationScope scope);
+	void* Reallocate(void* original, size_t size, size_t alignment, VkSystemAllocationScope scope);
+	void Free(void* memory);
+
+	void* AllocateBlock(uint32_t scope, uint32_t sizeClass);
+	void FreeBlock(uint32_t scope, uint32_t sizeClass, void* block);
+
+	struct SizeClassPool
+	{
+		void* m_FreeList = nullptr;
+		uint8_t* m_BumpPtr = nullptr;
+		uint8_t* m_BumpEnd = nullptr;
+	};
+
+	struct ScopePools
+	{
+		std::mutex m_Mutex;
+		SizeClassPool m_SizeClasses[NUM_SIZE_CLASSES];
+		std::vector<void*> m_Chunks;
+		ScopeStats m_Stats;
+	};
+
+	VkAllocationCallbacks m_Callbacks = {};
+	ScopePools m_Scopes[NUM_SCOPES];
+	std::atomic<bool> m_PoolingEnabled{ true };
+
+	BenchmarkResult m_LastBenchmark;
+};
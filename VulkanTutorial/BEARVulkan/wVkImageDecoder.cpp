@@ -0,0 +1,317 @@
+#include "wVkImageDecoder.h"
+
+#include <algorithm>
+#include <fstream>
+
+#include "stb/stb_image.h"
+
+#include "wVkGlobalVariables.h"
+#include "wVkPixelConverter.h"
+#include "Utils/ConsoleLogger.h"
+#include "wVkHelpers/wVkFormats.h"
+
+// Whole file, nullptr if it can't be read
+std::shared_ptr<const std::vector<uint8_t>> ReadSourceFile(const std::string& path)
+{
+	std::ifstream file(path, std::ios::ate | std::ios::binary);
+	if (!file.is_open())
+		return nullptr;
+
+	auto bytes = std::make_shared<std::vector<uint8_t>>(static_cast<size_t>(file.tellg()));
+	file.seekg(0);
+	file.read(reinterpret_cast<char*>(bytes->data()), static_cast<std::streamsize>(bytes->size()));
+
+	return file ? bytes : nullptr;
+}
+
+void wVkImageDecoder::Initialize(uint32_t numWorkers)
+{
+	if (numWorkers == 0)
+		numWorkers = std::max(std::thread::hardware_concurrency(), 2u) - 1;
+
+	m_StopWorkers = false;
+	for (uint32_t i = 0; i < numWorkers; i++)
+		m_Workers.emplace_back(&wVkImageDecoder::WorkerLoop, this);
+
+	m_Stats.m_NumWorkers = numWorkers;
+	LOG_INFO("Image decoder: %i worker threads", static_cast<int>(numWorkers));
+
+#ifndef NDEBUG
+	// The workers convert with the SSE2 paths, they have to match the scalar tails bit for bit
+	ASSERT(wVkPixelConverter::VerifyHalfConversions(), "SSE2 and scalar half conversions differ");
+#endif
+}
+
+void wVkImageDecoder::Destroy()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		m_StopWorkers = true;
+		m_Queue.clear();
+		m_Jobs.clear();
+	}
+	m_Condition.notify_all();
+
+	for (std::thread& worker : m_Workers)
+		worker.join();
+
+	m_Workers.clear();
+}
+
+wVkDecodeHandle wVkImageDecoder::DecodeFile(const std::string& path, bool buildMips, VkFormat format, float priority)
+{
+	auto job = std::make_shared<wVkDecodeJob>();
+	job->m_Key = path;
+	job->m_Path = path;
+	job->m_BuildMips = buildMips;
+	job->m_Format = format;
+	job->m_Priority = priority;
+
+	return Submit(std::move(job));
+}
+
+wVkDecodeHandle wVkImageDecoder::DecodeMemory(const std::string& key, std::shared_ptr<const std::vector<uint8_t>> encoded, bool buildMips, VkFormat format, float priority)
+{
+	auto job = std::make_shared<wVkDecodeJob>();
+	job->m_Key = key;
+	job->m_Data = std::move(encoded);
+	job->m_BuildMips = buildMips;
+	job->m_Format = format;
+	job->m_Priority = priority;
+
+	return Submit(std::move(job));
+}
+
+wVkDecodeHandle wVkImageDecoder::DecodeRaw(const std::string& key, std::shared_ptr<const std::vector<uint8_t>> rgba, uint32_t width, uint32_t height, bool buildMips, VkFormat format, float priority)
+{
+	ASSERT(rgba->size() == static_cast<size_t>(width) * height * 4, "Raw texels have to be tightly packed RGBA8");
+
+	auto job = std::make_shared<wVkDecodeJob>();
+	job->m_Key = key;
+	job->m_Data = std::move(rgba);
+	job->m_RawWidth = width;
+	job->m_RawHeight = height;
+	job->m_BuildMips = buildMips;
+	job->m_Format = format;
+	job->m_Priority = priority;
+
+	return Submit(std::move(job));
+}
+
+void wVkImageDecoder::SetPriority(const wVkDecodeHandle& job, float priority)
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	job->m_Priority = priority;
+}
+
+wVkImageDecoder::Stats wVkImageDecoder::GetStats()
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	m_Stats.m_NumQueued = static_cast<uint32_t>(m_Queue.size());
+	return m_Stats;
+}
+
+wVkDecodeHandle wVkImageDecoder::Submit(wVkDecodeHandle job)
+{
+	ASSERT(job->m_Format == VK_FORMAT_R8G8B8A8_UNORM || job->m_Format == VK_FORMAT_R8G8B8A8_SRGB || job->m_Format == VK_FORMAT_R16G16B16A16_SFLOAT
+		|| wVkHelpers::isBlockCompressed(job->m_Format), "The image decoder can't produce that format: %s", job->m_Key.c_str());
+
+	// The options are part of what's being asked for, a mip chain isn't interchangeable with a single level
+	const std::string dedupKey = job->m_Key + (job->m_BuildMips ? "|mips" : "") + "|format" + std::to_string(static_cast<int>(job->m_Format));
+
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		m_Stats.m_NumRequests++;
+
+		// Whoever held on to these is done with them
+		for (auto it = m_Jobs.begin(); it != m_Jobs.end();) {
+			if (it->second.expired())
+				it = m_Jobs.erase(it);
+			else
+				++it;
+		}
+
+		// The last handle can be dropped on another thread after the sweep, an expired entry is a miss
+		auto existing = m_Jobs.find(dedupKey);
+		if (existing != m_Jobs.end()) {
+			if (wVkDecodeHandle shared = existing->second.lock()) {
+				m_Stats.m_NumDeduplicated++;
+				shared->m_Priority = std::max(shared->m_Priority, job->m_Priority);
+				return shared;
+			}
+			m_Jobs.erase(existing);
+		}
+
+		m_Jobs[dedupKey] = job;
+		m_Queue.push_back(job);
+	}
+	m_Condition.notify_one();
+
+	return job;
+}
+
+void wVkImageDecoder::WorkerLoop()
+{
+	while (true) {
+		wVkDecodeHandle job;
+		{
+			std::unique_lock<std::mutex> lock(m_Mutex);
+			m_Condition.wait(lock, [this]() { return m_StopWorkers || !m_Queue.empty(); });
+			if (m_StopWorkers)
+				return;
+
+			auto it = std::max_element(m_Queue.begin(), m_Queue.end(), [](const wVkDecodeHandle& a, const wVkDecodeHandle& b) { return a->m_Priority < b->m_Priority; });
+			job = std::move(*it);
+			m_Queue.erase(it);
+		}
+
+		Decode(*job);
+
+		{
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			m_Stats.m_NumDecoded++;
+			m_Stats.m_DecodedBytes += job->m_Image.m_Mips ? job->m_Image.m_Mips->GetLevelSize(0) : 0;
+		}
+
+		job->m_Done.store(true, std::memory_order_release);
+	}
+}
+
+void wVkImageDecoder::Decode(wVkDecodeJob& job)
+{
+	wVkDecodedImage& image = job.m_Image;
+
+	// Files are read in whole up front, the bytes are what the bake is keyed on as well as what gets decoded
+	std::shared_ptr<const std::vector<uint8_t>> source = job.m_Data;
+	if (!source && wVkConstants::g_UseBakedTextures) {
+		source = ReadSourceFile(job.m_Path);
+		if (!source) {
+			image.m_Error = "can't read file";
+			return;
+		}
+	}
+
+	// Unchanged since it was last baked, there's nothing left to decode, convert, build or encode
+	const VkFormat format = job.m_Format;
+	uint64_t bakeKey = 0;
+	if (wVkConstants::g_UseBakedTextures) {
+		bakeKey = wVkTextureBaker::HashSource(source->data(), source->size(), job.m_RawWidth, job.m_RawHeight, job.m_BuildMips, format);
+		image.m_Mips = wVkGlobals::g_TextureBaker.Find(bakeKey, format);
+		if (image.m_Mips) {
+			image.m_Width = image.m_Mips->m_Width;
+			image.m_Height = image.m_Mips->m_Height;
+			return;
+		}
+	}
+
+	if (!DecodeSource(job, source.get()))
+		return;
+
+	CompressMips(job);
+
+	if (wVkConstants::g_UseBakedTextures)
+		wVkGlobals::g_TextureBaker.Store(bakeKey, *image.m_Mips, format);
+}
+
+bool wVkImageDecoder::DecodeSource(wVkDecodeJob& job, const std::vector<uint8_t>* source)
+{
+	wVkDecodedImage& image = job.m_Image;
+	const bool halfFloat = job.m_Format == VK_FORMAT_R16G16B16A16_SFLOAT;
+
+	int width, height, channels;
+	void* decoded = nullptr;
+	if (job.m_RawWidth > 0) {
+		width = static_cast<int>(job.m_RawWidth);
+		height = static_cast<int>(job.m_RawHeight);
+		channels = 4;
+	}
+	else {
+		// Decoded with the channels the image has, and expanded below rather than by stb. HDR images (.hdr) are
+		// decoded to floats when they're going to a float format, stb tone maps them to 8 bit otherwise.
+		const bool hdr = halfFloat && (source != nullptr ? stbi_is_hdr_from_memory(source->data(), static_cast<int>(source->size())) : stbi_is_hdr(job.m_Path.c_str()));
+		if (hdr && source != nullptr)
+			decoded = stbi_loadf_from_memory(source->data(), static_cast<int>(source->size()), &width, &height, &channels, 0);
+		else if (hdr)
+			decoded = stbi_loadf(job.m_Path.c_str(), &width, &height, &channels, 0);
+		else if (source != nullptr)
+			decoded = stbi_load_from_memory(source->data(), static_cast<int>(source->size()), &width, &height, &channels, 0);
+		else
+			decoded = stbi_load(job.m_Path.c_str(), &width, &height, &channels, 0);
+
+		if (decoded == nullptr) {
+			// Thread local in stb (checked where it's compiled), copied before anything else on this worker decodes
+			const char* reason = stbi_failure_reason();
+			image.m_Error = reason != nullptr ? reason : "unknown";
+			return false;
+		}
+
+		if (hdr) {
+			image.m_Width = static_cast<uint32_t>(width);
+			image.m_Height = static_cast<uint32_t>(height);
+
+			const size_t numTexels = static_cast<size_t>(width) * height;
+			std::vector<float> linear(numTexels * 4);
+			wVkPixelConverter::ExpandToRgba(static_cast<const float*>(decoded), static_cast<uint32_t>(channels), linear.data(), numTexels);
+			stbi_image_free(decoded);
+
+			BuildHalfMips(job, linear);
+			return true;
+		}
+	}
+
+	image.m_Width = static_cast<uint32_t>(width);
+	image.m_Height = static_cast<uint32_t>(height);
+
+	const size_t numTexels = static_cast<size_t>(width) * height;
+	const uint8_t* rgba = job.m_RawWidth > 0 ? source->data() : static_cast<const uint8_t*>(decoded);
+	std::vector<uint8_t> expanded;
+	if (channels != 4) {
+		expanded.resize(numTexels * 4);
+		wVkPixelConverter::ExpandToRgba(rgba, static_cast<uint32_t>(channels), expanded.data(), numTexels);
+		rgba = expanded.data();
+	}
+
+	if (halfFloat) {
+		// 8 bit sources of a float texture are taken to be sRGB colour, the texture holds it linear
+		std::vector<float> linear(numTexels * 4);
+		wVkPixelConverter::SrgbToLinear(rgba, linear.data(), numTexels);
+		BuildHalfMips(job, linear);
+	}
+	else {
+		// Every worker already has a core of its own, the builder doesn't split on top of that.
+		// Baked chains are cached by the baker, the mip cache would hold a second copy.
+		const bool srgb = wVkHelpers::isSrgbFormat(job.m_Format);
+		if (job.m_BuildMips)
+			image.m_Mips = wVkGlobals::g_MipBuilder.Build(rgba, image.m_Width, image.m_Height, srgb, 1, wVkMipChain::BYTES_PER_PIXEL, !wVkConstants::g_UseBakedTextures);
+		else
+			image.m_Mips = wVkMipBuilder::WrapLevel(rgba, image.m_Width, image.m_Height, srgb);
+	}
+
+	stbi_image_free(decoded);
+
+	return true;
+}
+
+void wVkImageDecoder::BuildHalfMips(wVkDecodeJob& job, const std::vector<float>& linear)
+{
+	wVkDecodedImage& image = job.m_Image;
+
+	std::vector<uint16_t> half(linear.size());
+	wVkPixelConverter::FloatToHalf(linear.data(), half.data(), linear.size());
+
+	const auto* texels = reinterpret_cast<const uint8_t*>(half.data());
+	if (job.m_BuildMips)
+		image.m_Mips = wVkGlobals::g_MipBuilder.Build(texels, image.m_Width, image.m_Height, false, 1, wVkMipChain::BYTES_PER_HALF_PIXEL, !wVkConstants::g_UseBakedTextures);
+	else
+		image.m_Mips = wVkMipBuilder::WrapLevel(texels, image.m_Width, image.m_Height, false, wVkMipChain::BYTES_PER_HALF_PIXEL);
+}
+
+void wVkImageDecoder::CompressMips(wVkDecodeJob& job)
+{
+	const wVkBlockFormat blockFormat = wVkHelpers::getBlockFormat(job.m_Format);
+	if (blockFormat == wVkBlockFormat::NONE)
+		return;
+
+	// The RGBA8 chain is dropped once it's encoded, only the block compressed one goes to the GPU
+	job.m_Image.m_Mips = wVkGlobals::g_BlockEncoder.Encode(*job.m_Image.m_Mips, blockFormat, 1);
+}
@@ -0,0 +1,100 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "vulkan/vulkan.h"
+
+#include "wVkMipBuilder.h"
+
+// Result of a decode, in the format that was asked for
+struct wVkDecodedImage
+{
+	uint32_t m_Width = 0;
+	uint32_t m_Height = 0;
+	std::shared_ptr<const wVkMipChain> m_Mips; // Level 0 is the image, the rest is only there when the chain was asked for
+	std::string m_Error;
+};
+
+// One decode, shared by everyone who asked for the same thing
+struct wVkDecodeJob
+{
+	std::string m_Key;
+	bool m_BuildMips = false;
+	// RGBA8 (UNORM/SRGB), RGBA16F or one of the BCn formats, the chain is converted/encoded to it after it's built
+	VkFormat m_Format = VK_FORMAT_R8G8B8A8_UNORM;
+
+	// Either a file, encoded bytes in memory (PNG, JPG, HDR, ... as embedded in a glTF) or RGBA8 texels of m_RawWidth x m_RawHeight
+	std::string m_Path;
+	std::shared_ptr<const std::vector<uint8_t>> m_Data;
+	uint32_t m_RawWidth = 0;
+	uint32_t m_RawHeight = 0;
+
+	float m_Priority = 0.0f; // Guarded by the decoder's mutex
+	std::atomic<bool> m_Done{ false };
+	wVkDecodedImage m_Image; // Only read once m_Done is set
+
+	bool IsDone() const { return m_Done.load(std::memory_order_acquire); }
+};
+
+using wVkDecodeHandle = std::shared_ptr<wVkDecodeJob>;
+
+// Decodes images on a pool of worker threads, one per core minus the main thread.
+// Identical requests (same source, same mip/sRGB options) made while an earlier one is still held on to share its
+// job and are only decoded once. Callers poll IsDone on the handle, nothing blocks the frame.
+// Results are baked by wVkTextureBaker, a source that's been decoded on an earlier run is memory mapped instead.
+class wVkImageDecoder
+{
+public:
+	struct Stats
+	{
+		uint32_t m_NumWorkers = 0;
+		uint32_t m_NumQueued = 0;
+		uint64_t m_NumRequests = 0;
+		uint64_t m_NumDeduplicated = 0;
+		uint64_t m_NumDecoded = 0;
+		uint64_t m_DecodedBytes = 0; // Level 0 bytes, in the format they go to the GPU in
+	};
+
+	// 0 picks one worker per core, leaving one for the main thread
+	void Initialize(uint32_t numWorkers = 0);
+	// Jobs still queued never complete
+	void Destroy();
+
+	// format is what the chain comes out as, the texture's. Sources of any channel count are expanded to RGBA,
+	// RGBA16F is filled from HDR images as they are and from 8 bit ones linearized, BCn is encoded by wVkBlockEncoder.
+	wVkDecodeHandle DecodeFile(const std::string& path, bool buildMips, VkFormat format, float priority = 0.0f);
+	// The key identifies the data for deduplication, e.g. the model path and texture index
+	wVkDecodeHandle DecodeMemory(const std::string& key, std::shared_ptr<const std::vector<uint8_t>> encoded, bool buildMips, VkFormat format, float priority = 0.0f);
+	wVkDecodeHandle DecodeRaw(const std::string& key, std::shared_ptr<const std::vector<uint8_t>> rgba, uint32_t width, uint32_t height, bool buildMips, VkFormat format, float priority = 0.0f);
+
+	// Queued jobs with a higher priority are decoded first
+	void SetPriority(const wVkDecodeHandle& job, float priority);
+
+	Stats GetStats();
+
+private:
+	wVkDecodeHandle Submit(wVkDecodeHandle job);
+	void WorkerLoop();
+	static void Decode(wVkDecodeJob& job);
+	// Into an RGBA8 or RGBA16F chain, from source when it's been read already. false with m_Error set if it can't be decoded.
+	static bool DecodeSource(wVkDecodeJob& job, const std::vector<uint8_t>* source);
+	static void BuildHalfMips(wVkDecodeJob& job, const std::vector<float>& linear);
+	static void CompressMips(wVkDecodeJob& job);
+
+	std::vector<std::thread> m_Workers;
+	std::mutex m_Mutex;
+	std::condition_variable m_Condition;
+	bool m_StopWorkers = false;
+
+	// Guarded by m_Mutex
+	std::vector<wVkDecodeHandle> m_Queue;
+	std::unordered_map<std::string, std::weak_ptr<wVkDecodeJob>> m_Jobs;
+	Stats m_Stats;
+};
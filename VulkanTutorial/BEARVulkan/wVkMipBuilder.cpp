@@ -0,0 +1,299 @@
+#include "wVkMipBuilder.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <thread>
+
+#define STB_IMAGE_RESIZE_IMPLEMENTATION
+#include "stb/stb_image_resize2.h"
+
+#include "wVkConstants.h"
+#include "Utils/ConsoleLogger.h"
+#include "wVkHelpers/wVkMipmaps.h"
+
+// Written in front of the levels in every cache file, anything that doesn't match is rebuilt
+struct MipCacheHeader
+{
+	uint32_t m_Magic = 0;
+	uint32_t m_Version = 0;
+	uint32_t m_Width = 0;
+	uint32_t m_Height = 0;
+	uint32_t m_Srgb = 0;
+	uint32_t m_NumLevels = 0;
+	uint64_t m_DataSize = 0;
+};
+
+constexpr uint32_t MIP_CACHE_MAGIC = 0x50494D57; // "WMIP"
+// Bump whenever the filtering changes, old files then get rebuilt rather than served
+constexpr uint32_t MIP_CACHE_VERSION = 1;
+
+void wVkMipBuilder::Initialize(uint32_t numHelpers)
+{
+	if (numHelpers == 0)
+		numHelpers = std::max(std::thread::hardware_concurrency(), 2u) - 1;
+
+	m_StopHelpers = false;
+	for (uint32_t i = 0; i < numHelpers; i++)
+		m_Helpers.emplace_back(&wVkMipBuilder::HelperLoop, this);
+
+	LOG_INFO("Mip builder: %i helper threads", static_cast<int>(numHelpers));
+}
+
+void wVkMipBuilder::Destroy()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		m_StopHelpers = true;
+	}
+	m_TaskCondition.notify_all();
+
+	for (std::thread& helper : m_Helpers)
+		helper.join();
+
+	m_Helpers.clear();
+}
+
+void wVkMipChain::Allocate(uint32_t width, uint32_t height, bool srgb, uint32_t numLevels)
+{
+	m_Width = width;
+	m_Height = height;
+	m_Srgb = srgb;
+	m_LevelOffsets.resize(numLevels);
+
+	uint64_t size = 0;
+	for (uint32_t mip = 0; mip < numLevels; mip++) {
+		m_LevelOffsets[mip] = size;
+		size += GetLevelSize(mip);
+	}
+
+	m_Data.resize(static_cast<size_t>(size));
+}
+
+std::shared_ptr<const wVkMipChain> wVkMipBuilder::Build(const uint8_t* pixels, uint32_t width, uint32_t height, bool srgb, uint32_t maxThreads, uint32_t bytesPerPixel, bool useCache)
+{
+	ASSERT(bytesPerPixel == wVkMipChain::BYTES_PER_PIXEL || (bytesPerPixel == wVkMipChain::BYTES_PER_HALF_PIXEL && !srgb), "Mip chains are RGBA8 or linear RGBA16F");
+
+	// Helpers and the calling thread, without helpers (not initialized) everything runs here
+	const uint32_t numThreads = static_cast<uint32_t>(m_Helpers.size()) + 1;
+	maxThreads = maxThreads == 0 ? numThreads : std::min(maxThreads, numThreads);
+
+	auto chain = std::make_shared<wVkMipChain>();
+	chain->m_BytesPerBlock = bytesPerPixel;
+	chain->Allocate(width, height, srgb, wVkHelpers::getMipLevelCount(width, height));
+
+	useCache = useCache && wVkConstants::g_UseMipCache;
+	std::string cachePath;
+	if (useCache) {
+		cachePath = GetCachePath(HashImage(pixels, width, height, srgb, bytesPerPixel));
+		if (ReadCache(cachePath, *chain)) {
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			m_Stats.m_NumCacheHits++;
+			m_Stats.m_BuiltBytes += chain->m_Data.size();
+			return chain;
+		}
+	}
+
+	const auto start = std::chrono::steady_clock::now();
+
+	memcpy(chain->m_Data.data(), pixels, static_cast<size_t>(chain->GetLevelSize(0)));
+
+	// Each level from the one above it, 2:1 every time so the box filter is an exact 2x2 average
+	for (uint32_t mip = 1; mip < chain->GetNumLevels(); mip++)
+		ResizeLevel(*chain, mip, maxThreads);
+
+	const double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+	if (useCache)
+		WriteCache(cachePath, *chain);
+
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	m_Stats.m_NumBuilt++;
+	m_Stats.m_BuiltBytes += chain->m_Data.size();
+	m_Stats.m_BuildMilliseconds += milliseconds;
+
+	return chain;
+}
+
+std::shared_ptr<const wVkMipChain> wVkMipBuilder::WrapLevel(const uint8_t* pixels, uint32_t width, uint32_t height, bool srgb, uint32_t bytesPerPixel)
+{
+	auto chain = std::make_shared<wVkMipChain>();
+	chain->m_BytesPerBlock = bytesPerPixel;
+	chain->Allocate(width, height, srgb, 1);
+	memcpy(chain->m_Data.data(), pixels, chain->m_Data.size());
+
+	return chain;
+}
+
+wVkMipBuilder::Stats wVkMipBuilder::GetStats()
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	return m_Stats;
+}
+
+void wVkMipBuilder::ResizeLevel(wVkMipChain& chain, uint32_t mip, uint32_t maxThreads)
+{
+	const uint32_t srcWidth = chain.GetLevelWidth(mip - 1);
+	const uint32_t srcHeight = chain.GetLevelHeight(mip - 1);
+	const uint32_t dstWidth = chain.GetLevelWidth(mip);
+	const uint32_t dstHeight = chain.GetLevelHeight(mip);
+
+	// STBIR_RGBA is straight alpha, stb weights colour by alpha while filtering so transparent texels don't bleed in.
+	// With the SRGB type colour is filtered in linear space, alpha stays linear. Half floats are linear already.
+	stbir_datatype type = chain.m_Srgb ? STBIR_TYPE_UINT8_SRGB : STBIR_TYPE_UINT8;
+	if (chain.m_BytesPerBlock == wVkMipChain::BYTES_PER_HALF_PIXEL)
+		type = STBIR_TYPE_HALF_FLOAT;
+
+	STBIR_RESIZE resize;
+	stbir_resize_init(&resize, chain.GetLevel(mip - 1), static_cast<int>(srcWidth), static_cast<int>(srcHeight), 0,
+		chain.m_Data.data() + chain.m_LevelOffsets[mip], static_cast<int>(dstWidth), static_cast<int>(dstHeight), 0,
+		STBIR_RGBA, type);
+	stbir_set_filters(&resize, STBIR_FILTER_BOX, STBIR_FILTER_BOX);
+	stbir_set_edgemodes(&resize, STBIR_EDGE_CLAMP, STBIR_EDGE_CLAMP);
+
+	const uint32_t wantedSplits = dstWidth * dstHeight >= wVkConstants::g_MipBuilderMinSplitPixels ? maxThreads : 1;
+	const int splits = stbir_build_samplers_with_splits(&resize, static_cast<int>(wantedSplits));
+	if (splits == 0) {
+		throw std::runtime_error("failed to build mip resize samplers!");
+	}
+
+	// Every split is a band of output rows, the calling thread takes the first one and the helpers the rest
+	int remaining = splits - 1; // Guarded by m_Mutex
+	if (remaining > 0) {
+		{
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			for (int split = 1; split < splits; split++) {
+				m_Tasks.emplace_back([this, &resize, &remaining, split]()
+				{
+					stbir_resize_extended_split(&resize, split, 1);
+
+					std::lock_guard<std::mutex> doneLock(m_Mutex);
+					if (--remaining == 0)
+						m_DoneCondition.notify_all();
+				});
+			}
+		}
+		m_TaskCondition.notify_all();
+	}
+
+	stbir_resize_extended_split(&resize, 0, 1);
+
+	{
+		std::unique_lock<std::mutex> lock(m_Mutex);
+		m_DoneCondition.wait(lock, [&remaining]() { return remaining == 0; });
+	}
+
+	stbir_free_samplers(&resize);
+}
+
+void wVkMipBuilder::HelperLoop()
+{
+	while (true) {
+		std::function<void()> task;
+		{
+			std::unique_lock<std::mutex> lock(m_Mutex);
+			m_TaskCondition.wait(lock, [this]() { return m_StopHelpers || !m_Tasks.empty(); });
+			if (m_StopHelpers)
+				return;
+
+			task = std::move(m_Tasks.front());
+			m_Tasks.pop_front();
+		}
+
+		task();
+	}
+}
+
+uint64_t wVkMipBuilder::HashImage(const uint8_t* pixels, uint32_t width, uint32_t height, bool srgb, uint32_t bytesPerPixel)
+{
+	// FNV-1a a word at a time, the whole top level goes through it so this has to keep up with memcpy more or less
+	constexpr uint64_t prime = 0x100000001B3ull;
+	uint64_t hash = 0xCBF29CE484222325ull;
+
+	auto mix = [&hash](uint64_t value) { hash = (hash ^ value) * prime; };
+	mix(width);
+	mix(height);
+	mix(srgb ? 1 : 0);
+	mix(bytesPerPixel);
+	mix(MIP_CACHE_VERSION);
+
+	const size_t size = static_cast<size_t>(width) * height * bytesPerPixel;
+	size_t offset = 0;
+	for (; offset + sizeof(uint64_t) <= size; offset += sizeof(uint64_t)) {
+		uint64_t word;
+		memcpy(&word, pixels + offset, sizeof(word));
+		mix(word);
+	}
+	for (; offset < size; offset++)
+		mix(pixels[offset]);
+
+	return hash;
+}
+
+std::string wVkMipBuilder::GetCachePath(uint64_t hash)
+{
+	char name[32];
+	snprintf(name, sizeof(name), "%016llx.mip", static_cast<unsigned long long>(hash));
+
+	return wVkConstants::g_MipCacheDirectory + name;
+}
+
+bool wVkMipBuilder::ReadCache(const std::string& path, wVkMipChain& chain)
+{
+	std::ifstream file(path, std::ios::binary);
+	if (!file.is_open())
+		return false;
+
+	MipCacheHeader header;
+	file.read(reinterpret_cast<char*>(&header), sizeof(header));
+
+	// The hash covers all of this already, a mismatch means a collision or a file from an older build
+	if (!file || header.m_Magic != MIP_CACHE_MAGIC || header.m_Version != MIP_CACHE_VERSION || header.m_Width != chain.m_Width || header.m_Height != chain.m_Height
+		|| header.m_Srgb != (chain.m_Srgb ? 1u : 0u) || header.m_NumLevels != chain.GetNumLevels() || header.m_DataSize != chain.m_Data.size())
+	{
+		LOG_WARNING("Ignoring stale mip cache file: %s", path.c_str());
+		return false;
+	}
+
+	file.read(reinterpret_cast<char*>(chain.m_Data.data()), static_cast<std::streamsize>(chain.m_Data.size()));
+	return static_cast<bool>(file);
+}
+
+void wVkMipBuilder::WriteCache(const std::string& path, const wVkMipChain& chain)
+{
+	std::error_code error;
+	std::filesystem::create_directories(wVkConstants::g_MipCacheDirectory, error);
+
+	MipCacheHeader header;
+	header.m_Magic = MIP_CACHE_MAGIC;
+	header.m_Version = MIP_CACHE_VERSION;
+	header.m_Width = chain.m_Width;
+	header.m_Height = chain.m_Height;
+	header.m_Srgb = chain.m_Srgb ? 1 : 0;
+	header.m_NumLevels = chain.GetNumLevels();
+	header.m_DataSize = chain.m_Data.size();
+
+	// Written under a name of our own and renamed once complete, so nobody ever reads half a file
+	const std::string tempPath = path + "." + std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id())) + ".tmp";
+	{
+		std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+		file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		file.write(reinterpret_cast<const char*>(chain.m_Data.data()), static_cast<std::streamsize>(chain.m_Data.size()));
+
+		if (!file) {
+			LOG_WARNING("Failed to write mip cache file: %s", path.c_str());
+			file.close();
+			std::filesystem::remove(tempPath, error);
+			return;
+		}
+	}
+
+	// Someone else writing the same chain at the same time is fine, theirs is identical
+	std::filesystem::rename(tempPath, path, error);
+	if (error)
+		std::filesystem::remove(tempPath, error);
+}
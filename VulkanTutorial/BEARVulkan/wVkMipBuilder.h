@@ -0,0 +1,96 @@
+#pragma once
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// A full mip chain in one allocation, levels tightly packed back to back from level 0 down to 1x1.
+// Laid out the way it gets copied, so all of it goes to the GPU in one vkCmdCopyBufferToImage.
+// RGBA8 or RGBA16F, unless it came out of wVkBlockEncoder, then every level is a grid of 4x4 blocks.
+// Chains loaded from a baked texture point into the mapped file instead of owning their levels.
+struct wVkMipChain
+{
+	uint32_t m_Width = 0;
+	uint32_t m_Height = 0;
+	bool m_Srgb = false;
+	std::vector<uint8_t> m_Data;
+	std::vector<uint64_t> m_LevelOffsets; // Into m_Data, one per level
+
+	// Used instead of m_Data when set, m_Mapping keeps the memory mapped for as long as the chain is around
+	const uint8_t* m_MappedData = nullptr;
+	std::shared_ptr<const void> m_Mapping;
+
+	static constexpr uint32_t BYTES_PER_PIXEL = 4;
+	static constexpr uint32_t BYTES_PER_HALF_PIXEL = 8; // RGBA16F
+
+	// Texels along a block edge and bytes per block, RGBA8 chains are 1x1 blocks of a pixel
+	uint32_t m_BlockDimension = 1;
+	uint32_t m_BytesPerBlock = BYTES_PER_PIXEL;
+
+	// Sets up the offsets and storage of every level for the block layout above, the levels are left zeroed
+	void Allocate(uint32_t width, uint32_t height, bool srgb, uint32_t numLevels);
+
+	uint32_t GetNumLevels() const { return static_cast<uint32_t>(m_LevelOffsets.size()); }
+	uint32_t GetLevelWidth(uint32_t mip) const { return m_Width >> mip > 0 ? m_Width >> mip : 1; }
+	uint32_t GetLevelHeight(uint32_t mip) const { return m_Height >> mip > 0 ? m_Height >> mip : 1; }
+	uint32_t GetLevelBlocksWide(uint32_t mip) const { return (GetLevelWidth(mip) + m_BlockDimension - 1) / m_BlockDimension; }
+	uint32_t GetLevelBlocksHigh(uint32_t mip) const { return (GetLevelHeight(mip) + m_BlockDimension - 1) / m_BlockDimension; }
+	uint64_t GetLevelSize(uint32_t mip) const { return static_cast<uint64_t>(GetLevelBlocksWide(mip)) * GetLevelBlocksHigh(mip) * m_BytesPerBlock; }
+	const uint8_t* GetLevel(uint32_t mip) const { return (m_MappedData != nullptr ? m_MappedData : m_Data.data()) + m_LevelOffsets[mip]; }
+	uint64_t GetSize() const { return m_LevelOffsets.empty() ? 0 : m_LevelOffsets.back() + GetLevelSize(GetNumLevels() - 1) - m_LevelOffsets.front(); }
+};
+
+// Builds mip chains on the CPU with stb_image_resize2, SIMD and split over a pool of helper threads for the big levels.
+// sRGB images are filtered in linear space and alpha is weighted, which the GPU blit chain does neither of.
+// Chains are also written to wVkConstants::g_MipCacheDirectory, the next run reads them back instead of rebuilding them.
+// Safe to call from several threads at once, the image decoder's workers all build through it.
+class wVkMipBuilder
+{
+public:
+	struct Stats
+	{
+		uint64_t m_NumBuilt = 0;
+		uint64_t m_NumCacheHits = 0;
+		uint64_t m_BuiltBytes = 0; // Whole chains, built or read from the cache
+		double m_BuildMilliseconds = 0.0; // Spent filtering, cache hits not included
+	};
+
+	// 0 picks one helper per core, leaving one for the thread calling Build
+	void Initialize(uint32_t numHelpers = 0);
+	void Destroy();
+
+	// maxThreads 0 uses every helper plus the calling thread, callers already running on a worker of their own pass 1.
+	// Pixels are RGBA8, or RGBA16F with bytesPerPixel BYTES_PER_HALF_PIXEL (linear, srgb has to be false).
+	// useCache false skips the mip cache, for chains that get cached further down the line (baked textures).
+	std::shared_ptr<const wVkMipChain> Build(const uint8_t* pixels, uint32_t width, uint32_t height, bool srgb, uint32_t maxThreads = 0,
+		uint32_t bytesPerPixel = wVkMipChain::BYTES_PER_PIXEL, bool useCache = true);
+
+	// A chain of just the top level, for images that don't need mips but go through the same paths
+	static std::shared_ptr<const wVkMipChain> WrapLevel(const uint8_t* pixels, uint32_t width, uint32_t height, bool srgb, uint32_t bytesPerPixel = wVkMipChain::BYTES_PER_PIXEL);
+
+	Stats GetStats();
+
+private:
+	static uint64_t HashImage(const uint8_t* pixels, uint32_t width, uint32_t height, bool srgb, uint32_t bytesPerPixel);
+	static std::string GetCachePath(uint64_t hash);
+	static bool ReadCache(const std::string& path, wVkMipChain& chain);
+	static void WriteCache(const std::string& path, const wVkMipChain& chain);
+
+	void ResizeLevel(wVkMipChain& chain, uint32_t mip, uint32_t maxThreads);
+	void HelperLoop();
+
+	std::vector<std::thread> m_Helpers;
+	std::mutex m_Mutex;
+	std::condition_variable m_TaskCondition; // Helpers wait for splits
+	std::condition_variable m_DoneCondition; // Build waits for the splits it handed out
+	bool m_StopHelpers = false;
+
+	// Guarded by m_Mutex
+	std::deque<std::function<void()>> m_Tasks;
+	Stats m_Stats;
+};
@@ -0,0 +1,368 @@
+#include "wVkPixelConverter.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+// SSE2 is part of x64, nothing newer is assumed so there's no dispatch on what the CPU supports
+#if defined(_M_X64) || defined(__SSE2__)
+#define PIXELS_SSE2 1
+#include <emmintrin.h>
+#endif
+
+// The sRGB transfer function, the exact one and not the 2.2 power
+float SrgbToLinearValue(float value)
+{
+	return value <= 0.04045f ? value / 12.92f : std::pow((value + 0.055f) / 1.055f, 2.4f);
+}
+
+struct SrgbTables
+{
+	std::array<float, 256> m_ToLinear;
+	// Linear value halfway between code i and i + 1, the last one is never crossed
+	std::array<float, 256> m_Thresholds;
+
+	SrgbTables()
+	{
+		for (uint32_t code = 0; code < 256; code++) {
+			m_ToLinear[code] = SrgbToLinearValue(static_cast<float>(code) / 255.0f);
+			m_Thresholds[code] = code < 255 ? SrgbToLinearValue((static_cast<float>(code) + 0.5f) / 255.0f) : INFINITY;
+		}
+	}
+};
+
+const SrgbTables& GetSrgbTables()
+{
+	static const SrgbTables tables;
+	return tables;
+}
+
+// Bit exact with the SSE2 version below
+uint16_t FloatToHalfScalar(float value)
+{
+	uint32_t bits;
+	memcpy(&bits, &value, sizeof(bits));
+	const uint32_t sign = bits & 0x80000000u;
+	bits ^= sign;
+
+	uint32_t half;
+	if (bits >= 0x47800000u) {
+		// 65520 and up round to infinity, NaN keeps a mantissa bit
+		half = bits > 0x7F800000u ? 0x7E00u : 0x7C00u;
+	}
+	else if (bits < 0x38800000u) {
+		// Subnormal half, adding 0.5 lines the mantissa up so the FPU does the rounding
+		float shifted;
+		memcpy(&shifted, &bits, sizeof(shifted));
+		shifted += 0.5f;
+		memcpy(&half, &shifted, sizeof(half));
+		half -= 0x3F000000u;
+	}
+	else {
+		// Rebias the exponent, add just under half an ulp plus the odd bit for round to nearest even
+		const uint32_t mantissaOdd = (bits >> 13) & 1u;
+		bits += 0xC8000FFFu + mantissaOdd;
+		half = bits >> 13;
+	}
+
+	return static_cast<uint16_t>(half | (sign >> 16));
+}
+
+float HalfToFloatScalar(uint16_t half)
+{
+	const uint32_t shiftedExponent = 0x7C00u << 13;
+	uint32_t bits = (half & 0x7FFFu) << 13;
+	const uint32_t exponent = bits & shiftedExponent;
+	bits += (127u - 15u) << 23;
+
+	float value;
+	if (exponent == shiftedExponent) {
+		// Inf/NaN
+		bits += (128u - 16u) << 23;
+		memcpy(&value, &bits, sizeof(value));
+	}
+	else if (exponent == 0) {
+		// Zero/subnormal, renormalized by the FPU
+		bits += 1u << 23;
+		memcpy(&value, &bits, sizeof(value));
+		value -= 6.103515625e-05f; // 2^-14
+	}
+	else {
+		memcpy(&value, &bits, sizeof(value));
+	}
+
+	uint32_t result;
+	memcpy(&result, &value, sizeof(result));
+	result |= static_cast<uint32_t>(half & 0x8000u) << 16;
+	memcpy(&value, &result, sizeof(value));
+	return value;
+}
+
+#ifdef PIXELS_SSE2
+// Four floats to four halves in the low 16 bits of every lane, sign extended so _mm_packs_epi32 keeps them intact
+__m128i FloatToHalfSse2(__m128 value)
+{
+	const __m128i infinityOrAbove = _mm_set1_epi32(0x47800000);
+	const __m128i smallestNormal = _mm_set1_epi32(0x38800000);
+	const __m128i subnormalMagic = _mm_set1_epi32(0x3F000000);
+	const __m128i normalBias = _mm_set1_epi32(static_cast<int>(0xC8000FFFu));
+
+	const __m128 sign = _mm_and_ps(value, _mm_set1_ps(-0.0f));
+	const __m128 absolute = _mm_xor_ps(value, sign);
+	const __m128i bits = _mm_castps_si128(absolute);
+
+	const __m128i isNan = _mm_castps_si128(_mm_cmpunord_ps(absolute, absolute));
+	const __m128i isRegular = _mm_cmpgt_epi32(infinityOrAbove, bits);
+	const __m128i special = _mm_or_si128(_mm_and_si128(isNan, _mm_set1_epi32(0x0200)), _mm_set1_epi32(0x7C00));
+
+	const __m128i isSubnormal = _mm_cmpgt_epi32(smallestNormal, bits);
+	const __m128i subnormal = _mm_sub_epi32(_mm_castps_si128(_mm_add_ps(absolute, _mm_castsi128_ps(subnormalMagic))), subnormalMagic);
+
+	const __m128i mantissaOdd = _mm_and_si128(_mm_srli_epi32(bits, 13), _mm_set1_epi32(1));
+	const __m128i normal = _mm_srli_epi32(_mm_add_epi32(_mm_add_epi32(bits, normalBias), mantissaOdd), 13);
+
+	const __m128i finite = _mm_or_si128(_mm_and_si128(isSubnormal, subnormal), _mm_andnot_si128(isSubnormal, normal));
+	const __m128i half = _mm_or_si128(_mm_and_si128(isRegular, finite), _mm_andnot_si128(isRegular, special));
+
+	return _mm_or_si128(half, _mm_srai_epi32(_mm_castps_si128(sign), 16));
+}
+
+// Four halves, zero extended to 32 bits, to four floats. Subnormal halves go through a float multiply, which
+// comes out as zero if the thread has denormals-are-zero set.
+__m128 HalfToFloatSse2(__m128i half)
+{
+	const __m128i exponentMantissa = _mm_and_si128(half, _mm_set1_epi32(0x7FFF));
+	const __m128i sign = _mm_slli_epi32(_mm_xor_si128(half, exponentMantissa), 16);
+
+	// Shifted into place the half is a float 2^-112 too small, the multiply fixes the exponent and renormalizes
+	const __m128 scaled = _mm_mul_ps(_mm_castsi128_ps(_mm_slli_epi32(exponentMantissa, 13)), _mm_castsi128_ps(_mm_set1_epi32((254 - 15) << 23)));
+	const __m128i wasInfinityOrNan = _mm_cmpgt_epi32(exponentMantissa, _mm_set1_epi32(0x7BFF));
+	const __m128i infinityExponent = _mm_and_si128(wasInfinityOrNan, _mm_set1_epi32(255 << 23));
+
+	return _mm_or_ps(scaled, _mm_castsi128_ps(_mm_or_si128(sign, infinityExponent)));
+}
+#endif
+
+void wVkPixelConverter::ExpandToRgba(const uint8_t* source, uint32_t channels, uint8_t* rgba, size_t numTexels)
+{
+	size_t texel = 0;
+
+	switch (channels) {
+	case 1:
+#ifdef PIXELS_SSE2
+		// 16 grey texels to 64 bytes of RGBA, each byte doubled twice and alpha or'ed in
+		for (; texel + 16 <= numTexels; texel += 16) {
+			const __m128i grey = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + texel));
+			const __m128i alpha = _mm_set1_epi32(static_cast<int>(0xFF000000u));
+			const __m128i low = _mm_unpacklo_epi8(grey, grey);
+			const __m128i high = _mm_unpackhi_epi8(grey, grey);
+
+			__m128i* destination = reinterpret_cast<__m128i*>(rgba + texel * 4);
+			_mm_storeu_si128(destination + 0, _mm_or_si128(_mm_unpacklo_epi16(low, low), alpha));
+			_mm_storeu_si128(destination + 1, _mm_or_si128(_mm_unpackhi_epi16(low, low), alpha));
+			_mm_storeu_si128(destination + 2, _mm_or_si128(_mm_unpacklo_epi16(high, high), alpha));
+			_mm_storeu_si128(destination + 3, _mm_or_si128(_mm_unpackhi_epi16(high, high), alpha));
+		}
+#endif
+		for (; texel < numTexels; texel++) {
+			const uint8_t grey = source[texel];
+			rgba[texel * 4 + 0] = grey;
+			rgba[texel * 4 + 1] = grey;
+			rgba[texel * 4 + 2] = grey;
+			rgba[texel * 4 + 3] = 255;
+		}
+		break;
+
+	case 2:
+		for (; texel < numTexels; texel++) {
+			const uint8_t grey = source[texel * 2 + 0];
+			rgba[texel * 4 + 0] = grey;
+			rgba[texel * 4 + 1] = grey;
+			rgba[texel * 4 + 2] = grey;
+			rgba[texel * 4 + 3] = source[texel * 2 + 1];
+		}
+		break;
+
+	case 3:
+		// A whole (little endian) word per texel with the byte after it replaced by alpha. The last texel can't read past the end.
+		for (; texel + 1 < numTexels; texel++) {
+			uint32_t word;
+			memcpy(&word, source + texel * 3, sizeof(word));
+			word = (word & 0x00FFFFFFu) | 0xFF000000u;
+			memcpy(rgba + texel * 4, &word, sizeof(word));
+		}
+		for (; texel < numTexels; texel++) {
+			rgba[texel * 4 + 0] = source[texel * 3 + 0];
+			rgba[texel * 4 + 1] = source[texel * 3 + 1];
+			rgba[texel * 4 + 2] = source[texel * 3 + 2];
+			rgba[texel * 4 + 3] = 255;
+		}
+		break;
+
+	default:
+		memcpy(rgba, source, numTexels * 4);
+		break;
+	}
+}
+
+void wVkPixelConverter::ExpandToRgba(const float* source, uint32_t channels, float* rgba, size_t numTexels)
+{
+	if (channels == 4) {
+		memcpy(rgba, source, numTexels * 4 * sizeof(float));
+		return;
+	}
+
+	// Floats are four times the bytes for the same texels, these loops are bound by memory and not by the shuffles
+	for (size_t texel = 0; texel < numTexels; texel++) {
+		const float* in = source + texel * channels;
+		float* out = rgba + texel * 4;
+		out[0] = in[0];
+		out[1] = channels >= 3 ? in[1] : in[0];
+		out[2] = channels >= 3 ? in[2] : in[0];
+		out[3] = channels == 2 ? in[1] : 1.0f;
+	}
+}
+
+void wVkPixelConverter::FloatToHalf(const float* source, uint16_t* half, size_t count)
+{
+	size_t i = 0;
+#ifdef PIXELS_SSE2
+	for (; i + 8 <= count; i += 8) {
+		const __m128i low = FloatToHalfSse2(_mm_loadu_ps(source + i));
+		const __m128i high = FloatToHalfSse2(_mm_loadu_ps(source + i + 4));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(half + i), _mm_packs_epi32(low, high));
+	}
+#endif
+	for (; i < count; i++)
+		half[i] = FloatToHalfScalar(source[i]);
+}
+
+void wVkPixelConverter::HalfToFloat(const uint16_t* half, float* destination, size_t count)
+{
+	size_t i = 0;
+#ifdef PIXELS_SSE2
+	for (; i + 8 <= count; i += 8) {
+		const __m128i halves = _mm_loadu_si128(reinterpret_cast<const __m128i*>(half + i));
+		_mm_storeu_ps(destination + i, HalfToFloatSse2(_mm_unpacklo_epi16(halves, _mm_setzero_si128())));
+		_mm_storeu_ps(destination + i + 4, HalfToFloatSse2(_mm_unpackhi_epi16(halves, _mm_setzero_si128())));
+	}
+#endif
+	for (; i < count; i++)
+		destination[i] = HalfToFloatScalar(half[i]);
+}
+
+bool wVkPixelConverter::VerifyHalfConversions()
+{
+#ifdef PIXELS_SSE2
+	constexpr size_t numHalves = 65536;
+	std::vector<uint16_t> halves(numHalves);
+	for (size_t i = 0; i < numHalves; i++)
+		halves[i] = static_cast<uint16_t>(i);
+
+	auto bitsOf = [](float value) { uint32_t bits; memcpy(&bits, &value, sizeof(bits)); return bits; };
+
+	// A multiple of 8, every value goes through the SSE2 loop
+	std::vector<float> floats(numHalves);
+	HalfToFloat(halves.data(), floats.data(), numHalves);
+	for (size_t i = 0; i < numHalves; i++) {
+		if (bitsOf(floats[i]) != bitsOf(HalfToFloatScalar(halves[i])))
+			return false;
+	}
+
+	// Halfway between two normal halves is where round to nearest even decides
+	std::vector<float> sources(numHalves * 2);
+	for (size_t i = 0; i < numHalves; i++) {
+		const uint32_t halfway = bitsOf(floats[i]) + (1u << 12);
+		sources[i * 2] = floats[i];
+		memcpy(&sources[i * 2 + 1], &halfway, sizeof(halfway));
+	}
+
+	std::vector<uint16_t> converted(sources.size());
+	FloatToHalf(sources.data(), converted.data(), sources.size());
+	for (size_t i = 0; i < sources.size(); i++) {
+		if (converted[i] != FloatToHalfScalar(sources[i]))
+			return false;
+	}
+#endif
+
+	return true;
+}
+
+void wVkPixelConverter::SrgbToLinear(const uint8_t* rgba, float* linear, size_t numTexels)
+{
+	// 256 entries, a lookup beats evaluating the curve in any width
+	const std::array<float, 256>& toLinear = GetSrgbTables().m_ToLinear;
+
+	for (size_t texel = 0; texel < numTexels; texel++) {
+		linear[texel * 4 + 0] = toLinear[rgba[texel * 4 + 0]];
+		linear[texel * 4 + 1] = toLinear[rgba[texel * 4 + 1]];
+		linear[texel * 4 + 2] = toLinear[rgba[texel * 4 + 2]];
+		linear[texel * 4 + 3] = static_cast<float>(rgba[texel * 4 + 3]) * (1.0f / 255.0f);
+	}
+}
+
+void wVkPixelConverter::LinearToSrgb(const float* linear, uint8_t* rgba, size_t numTexels)
+{
+	const std::array<float, 256>& thresholds = GetSrgbTables().m_Thresholds;
+
+	// Branchless binary search over the 255 code boundaries, NaN compares false everywhere and ends up as 0
+	auto encode = [&thresholds](float value) {
+		uint32_t code = 0;
+		for (uint32_t step = 128; step > 0; step >>= 1)
+			code += value >= thresholds[code + step - 1] ? step : 0;
+		return static_cast<uint8_t>(code);
+	};
+
+	for (size_t texel = 0; texel < numTexels; texel++) {
+		rgba[texel * 4 + 0] = encode(linear[texel * 4 + 0]);
+		rgba[texel * 4 + 1] = encode(linear[texel * 4 + 1]);
+		rgba[texel * 4 + 2] = encode(linear[texel * 4 + 2]);
+
+		const float alpha = std::min(std::max(linear[texel * 4 + 3], 0.0f), 1.0f);
+		rgba[texel * 4 + 3] = static_cast<uint8_t>(alpha * 255.0f + 0.5f);
+	}
+}
+
+void wVkPixelConverter::PremultiplyAlpha(uint8_t* rgba, size_t numTexels)
+{
+	size_t texel = 0;
+#ifdef PIXELS_SSE2
+	// c * a / 255 rounded, as (t + (t >> 8)) >> 8 with t = c * a + 128 in 16 bit lanes
+	for (; texel + 4 <= numTexels; texel += 4) {
+		__m128i* pixels = reinterpret_cast<__m128i*>(rgba + texel * 4);
+		const __m128i texels = _mm_loadu_si128(pixels);
+		const __m128i alphaMask = _mm_set1_epi32(static_cast<int>(0xFF000000u));
+
+		auto multiply = [](__m128i colour) {
+			const __m128i alpha = _mm_shufflehi_epi16(_mm_shufflelo_epi16(colour, 0xFF), 0xFF);
+			const __m128i product = _mm_add_epi16(_mm_mullo_epi16(colour, alpha), _mm_set1_epi16(128));
+			return _mm_srli_epi16(_mm_add_epi16(product, _mm_srli_epi16(product, 8)), 8);
+		};
+
+		const __m128i low = multiply(_mm_unpacklo_epi8(texels, _mm_setzero_si128()));
+		const __m128i high = multiply(_mm_unpackhi_epi8(texels, _mm_setzero_si128()));
+		const __m128i premultiplied = _mm_packus_epi16(low, high);
+
+		_mm_storeu_si128(pixels, _mm_or_si128(_mm_andnot_si128(alphaMask, premultiplied), _mm_and_si128(alphaMask, texels)));
+	}
+#endif
+	for (; texel < numTexels; texel++) {
+		const uint32_t alpha = rgba[texel * 4 + 3];
+		for (uint32_t channel = 0; channel < 3; channel++) {
+			const uint32_t product = rgba[texel * 4 + channel] * alpha + 128;
+			rgba[texel * 4 + channel] = static_cast<uint8_t>((product + (product >> 8)) >> 8);
+		}
+	}
+}
+
+void wVkPixelConverter::PremultiplyAlpha(float* rgba, size_t numTexels)
+{
+	for (size_t texel = 0; texel < numTexels; texel++) {
+		const float alpha = rgba[texel * 4 + 3];
+		rgba[texel * 4 + 0] *= alpha;
+		rgba[texel * 4 + 1] *= alpha;
+		rgba[texel * 4 + 2] *= alpha;
+	}
+}
@@ -0,0 +1,32 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+// Texel conversions the image decoder runs on its workers before building a chain, so sources can come in any
+// channel count or as floats and still end up in the layout the texture is created with.
+// SSE2 on x64, plain loops anywhere else. Every function gives the same result on both paths.
+class wVkPixelConverter
+{
+public:
+	// 1 (grey), 2 (grey + alpha) or 3 channel texels to RGBA, grey is replicated to RGB and missing alpha is opaque.
+	// 4 channels is a copy.
+	static void ExpandToRgba(const uint8_t* source, uint32_t channels, uint8_t* rgba, size_t numTexels);
+	static void ExpandToRgba(const float* source, uint32_t channels, float* rgba, size_t numTexels);
+
+	// IEEE half floats, rounded to nearest even. Too big for a half goes to infinity, NaN stays NaN.
+	static void FloatToHalf(const float* source, uint16_t* half, size_t count);
+	static void HalfToFloat(const uint16_t* half, float* destination, size_t count);
+
+	// Compares the SSE2 half conversions with the scalar ones bit for bit: every half, and for FloatToHalf every half's
+	// float and the float halfway to the next half. Always true without SSE2. Debug builds run it once at startup.
+	static bool VerifyHalfConversions();
+
+	// Colour channels through the sRGB curve, alpha is linear in both and only rescaled.
+	// LinearToSrgb rounds to the nearest code, out of range values are clamped.
+	static void SrgbToLinear(const uint8_t* rgba, float* linear, size_t numTexels);
+	static void LinearToSrgb(const float* linear, uint8_t* rgba, size_t numTexels);
+
+	// Colour times alpha in place, on the values as they're stored (no sRGB decode first)
+	static void PremultiplyAlpha(uint8_t* rgba, size_t numTexels);
+	static void PremultiplyAlpha(float* rgba, size_t numTexels);
+};
@@ -0,0 +1,868 @@
+#include "wVkRenderGraph.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+#include "wVkGlobalVariables.h"
+#include "Utils/ConsoleLogger.h"
+#include "wVkHelpers/wVkDepth.h"
+#include "wVkHelpers/wVkHelpers.h"
+#include "wVkHelpers/wVkTemp.h"
+#include "wVkHelpers/wVkTexture.h"
+
+constexpr VkAccessFlags WRITE_ACCESS = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT
+	| VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+
+constexpr VkPipelineStageFlags DEPTH_STAGES = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+
+bool IsDepthFormat(VkFormat format)
+{
+	switch (format) {
+	case VK_FORMAT_D16_UNORM:
+	case VK_FORMAT_X8_D24_UNORM_PACK32:
+	case VK_FORMAT_D32_SFLOAT:
+	case VK_FORMAT_D16_UNORM_S8_UINT:
+	case VK_FORMAT_D24_UNORM_S8_UINT:
+	case VK_FORMAT_D32_SFLOAT_S8_UINT:
+		return true;
+	default:
+		return false;
+	}
+}
+
+VkImageAspectFlags GetAspect(VkFormat format)
+{
+	if (!IsDepthFormat(format))
+		return VK_IMAGE_ASPECT_COLOR_BIT;
+
+	return wVkHelpers::hasStencilComponent(format) ? VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT : VK_IMAGE_ASPECT_DEPTH_BIT;
+}
+
+// UINT32_MAX when the device has none, desktop GPUs usually don't
+uint32_t FindLazyMemoryType(uint32_t typeFilter)
+{
+	VkPhysicalDeviceMemoryProperties memProperties;
+	vkGetPhysicalDeviceMemoryProperties(wVkGlobals::g_PhysicalDevice, &memProperties);
+
+	for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++) {
+		if ((typeFilter & (1 << i)) && (memProperties.memoryTypes[i].propertyFlags & VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT))
+			return i;
+	}
+
+	return UINT32_MAX;
+}
+
+bool wVkTransientDesc::operator==(const wVkTransientDesc& other) const
+{
+	return m_Format == other.m_Format && m_Extent.width == other.m_Extent.width && m_Extent.height == other.m_Extent.height && m_Usage == other.m_Usage;
+}
+
+VkPipelineRenderingCreateInfoKHR wVkRenderingFormats::GetCreateInfo() const
+{
+	VkPipelineRenderingCreateInfoKHR createInfo{};
+	createInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO_KHR;
+	createInfo.colorAttachmentCount = static_cast<uint32_t>(m_ColorFormats.size());
+	createInfo.pColorAttachmentFormats = m_ColorFormats.data();
+	createInfo.depthAttachmentFormat = m_DepthFormat;
+	createInfo.stencilAttachmentFormat = wVkHelpers::hasStencilComponent(m_DepthFormat) ? m_DepthFormat : VK_FORMAT_UNDEFINED;
+	return createInfo;
+}
+
+bool wVkRenderGraph::TransientPlanEntry::operator==(const TransientPlanEntry& other) const
+{
+	return m_Desc == other.m_Desc && m_Usage == other.m_Usage && m_FirstPass == other.m_FirstPass && m_LastPass == other.m_LastPass;
+}
+
+// Pass
+
+wVkRenderGraph::Pass& wVkRenderGraph::Pass::WriteColor(wVkGraphResource resource, const VkClearColorValue* clear)
+{
+	Use use;
+	use.m_Resource = resource;
+	use.m_Type = UseType::COLOR_ATTACHMENT;
+	use.m_Read = clear == nullptr;
+	use.m_Write = true;
+	use.m_Clear = clear != nullptr;
+	if (clear)
+		use.m_ClearValue.color = *clear;
+	use.m_Stages = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+	return AddUse(use);
+}
+
+wVkRenderGraph::Pass& wVkRenderGraph::Pass::WriteDepth(wVkGraphResource resource, const VkClearDepthStencilValue* clear)
+{
+	Use use;
+	use.m_Resource = resource;
+	use.m_Type = UseType::DEPTH_ATTACHMENT;
+	use.m_Read = clear == nullptr;
+	use.m_Write = true;
+	use.m_Clear = clear != nullptr;
+	if (clear)
+		use.m_ClearValue.depthStencil = *clear;
+	use.m_Stages = DEPTH_STAGES;
+	return AddUse(use);
+}
+
+wVkRenderGraph::Pass& wVkRenderGraph::Pass::ReadDepth(wVkGraphResource resource)
+{
+	Use use;
+	use.m_Resource = resource;
+	use.m_Type = UseType::DEPTH_ATTACHMENT;
+	use.m_Read = true;
+	use.m_Stages = DEPTH_STAGES;
+	return AddUse(use);
+}
+
+wVkRenderGraph::Pass& wVkRenderGraph::Pass::ReadTexture(wVkGraphResource resource, VkPipelineStageFlags stages)
+{
+	Use use;
+	use.m_Resource = resource;
+	use.m_Type = UseType::SAMPLED;
+	use.m_Read = true;
+	use.m_Stages = stages;
+	return AddUse(use);
+}
+
+wVkRenderGraph::Pass& wVkRenderGraph::Pass::ReadTransfer(wVkGraphResource resource)
+{
+	Use use;
+	use.m_Resource = resource;
+	use.m_Type = UseType::TRANSFER_SRC;
+	use.m_Read = true;
+	use.m_Stages = VK_PIPELINE_STAGE_TRANSFER_BIT;
+	return AddUse(use);
+}
+
+wVkRenderGraph::Pass& wVkRenderGraph::Pass::WriteTransfer(wVkGraphResource resource)
+{
+	Use use;
+	use.m_Resource = resource;
+	use.m_Type = UseType::TRANSFER_DST;
+	use.m_Write = true;
+	use.m_Stages = VK_PIPELINE_STAGE_TRANSFER_BIT;
+	return AddUse(use);
+}
+
+wVkRenderGraph::Pass& wVkRenderGraph::Pass::SetSideEffects()
+{
+	m_SideEffects = true;
+	return *this;
+}
+
+wVkRenderGraph::Pass& wVkRenderGraph::Pass::AddUse(const Use& use)
+{
+	ASSERT(use.m_Resource < m_Graph->m_Resources.size(), "Pass \"%s\" uses a resource that doesn't exist", m_Name.c_str());
+	for (const Use& existing : m_Uses)
+		ASSERT(existing.m_Resource != use.m_Resource, "Pass \"%s\" uses \"%s\" twice", m_Name.c_str(), m_Graph->m_Resources[use.m_Resource].m_Name.c_str());
+
+	const bool depth = IsDepthFormat(m_Graph->m_Resources[use.m_Resource].m_Format);
+	ASSERT(use.m_Type != UseType::COLOR_ATTACHMENT || !depth, "Pass \"%s\" uses depth \"%s\" as a color attachment", m_Name.c_str(), m_Graph->m_Resources[use.m_Resource].m_Name.c_str());
+	ASSERT(use.m_Type != UseType::DEPTH_ATTACHMENT || depth, "Pass \"%s\" uses \"%s\" as depth", m_Name.c_str(), m_Graph->m_Resources[use.m_Resource].m_Name.c_str());
+
+	m_Uses.push_back(use);
+	return *this;
+}
+
+bool wVkRenderGraph::Pass::IsRenderPass() const
+{
+	for (const Use& use : m_Uses) {
+		if (use.m_Type == UseType::COLOR_ATTACHMENT || use.m_Type == UseType::DEPTH_ATTACHMENT)
+			return true;
+	}
+
+	return false;
+}
+
+// Graph
+
+void wVkRenderGraph::Initialize()
+{
+	m_CmdBeginRendering = reinterpret_cast<PFN_vkCmdBeginRenderingKHR>(vkGetDeviceProcAddr(wVkGlobals::g_Device, "vkCmdBeginRenderingKHR"));
+	m_CmdEndRendering = reinterpret_cast<PFN_vkCmdEndRenderingKHR>(vkGetDeviceProcAddr(wVkGlobals::g_Device, "vkCmdEndRenderingKHR"));
+
+	if (m_CmdBeginRendering == nullptr || m_CmdEndRendering == nullptr) {
+		throw std::runtime_error("failed to load the dynamic rendering functions!");
+	}
+}
+
+void wVkRenderGraph::Reset()
+{
+	m_Resources.clear();
+	m_Passes.clear();
+	m_States.clear();
+	m_Scopes.clear();
+	m_Compiled = false;
+}
+
+wVkGraphResource wVkRenderGraph::ImportImage(const std::string& name, VkImage image, VkImageView view, VkFormat format, VkExtent2D extent,
+	VkImageLayout initialLayout, VkPipelineStageFlags initialStages, VkImageLayout finalLayout)
+{
+	ASSERT(m_Passes.empty(), "Import \"%s\" before adding passes", name.c_str());
+
+	Resource resource;
+	resource.m_Name = name;
+	resource.m_Format = format;
+	resource.m_Extent = extent;
+	resource.m_Aspect = GetAspect(format);
+	resource.m_Imported = true;
+	resource.m_Image = image;
+	resource.m_View = view;
+	resource.m_InitialLayout = initialLayout;
+	resource.m_InitialStages = initialStages;
+	resource.m_FinalLayout = finalLayout;
+
+	m_Resources.push_back(resource);
+	return static_cast<wVkGraphResource>(m_Resources.size() - 1);
+}
+
+wVkGraphResource wVkRenderGraph::CreateTransient(const std::string& name, const wVkTransientDesc& desc)
+{
+	ASSERT(m_Passes.empty(), "Create \"%s\" before adding passes", name.c_str());
+	ASSERT(desc.m_Extent.width > 0 && desc.m_Extent.height > 0, "Transient \"%s\" has no size", name.c_str());
+
+	uint32_t numTransients = 0;
+	for (const Resource& existing : m_Resources)
+		numTransients += existing.m_Imported ? 0 : 1;
+
+	Resource resource;
+	resource.m_Name = name;
+	resource.m_Format = desc.m_Format;
+	resource.m_Extent = desc.m_Extent;
+	resource.m_Aspect = GetAspect(desc.m_Format);
+	resource.m_Desc = desc;
+	resource.m_Transient = numTransients;
+
+	m_Resources.push_back(resource);
+	return static_cast<wVkGraphResource>(m_Resources.size() - 1);
+}
+
+wVkRenderGraph::Pass& wVkRenderGraph::AddPass(const std::string& name, std::function<void(VkCommandBuffer)> execute)
+{
+	ASSERT(!m_Compiled, "Pass \"%s\" added after the graph was compiled", name.c_str());
+
+	Pass& pass = m_Passes.emplace_back();
+	pass.m_Graph = this;
+	pass.m_Name = name;
+	pass.m_Execute = std::move(execute);
+	return pass;
+}
+
+void wVkRenderGraph::Compile()
+{
+	ASSERT(!m_Compiled, "Render graph compiled twice, Reset it first");
+
+	Cull();
+	BuildScopes();
+	ComputeLifetimes();
+
+	// Same transients with the same lifetimes as last frame, the images and memory are reused as they are
+	std::vector<TransientPlanEntry> plan;
+	for (const Resource& resource : m_Resources) {
+		if (resource.m_Imported)
+			continue;
+
+		TransientPlanEntry entry;
+		entry.m_Desc = resource.m_Desc;
+		entry.m_Usage = resource.m_Usage;
+		entry.m_FirstPass = resource.m_FirstPass;
+		entry.m_LastPass = resource.m_LastPass;
+		plan.push_back(entry);
+	}
+
+	if (plan != m_Plan) {
+		ReleaseTransients();
+		m_Plan = std::move(plan);
+		AllocateTransients();
+	}
+
+	for (MemorySlot& slot : m_Slots) {
+		slot.m_Stages = 0;
+		slot.m_WriteAccess = 0;
+	}
+
+	// Execution state of everything, transients start out undefined every frame
+	m_States.assign(m_Resources.size(), {});
+	for (size_t i = 0; i < m_Resources.size(); i++) {
+		const Resource& resource = m_Resources[i];
+		if (!resource.m_Imported)
+			continue;
+
+		m_States[i].m_Layout = resource.m_InitialLayout;
+		m_States[i].m_Stages = resource.m_InitialStages;
+		m_States[i].m_Written = resource.m_InitialLayout != VK_IMAGE_LAYOUT_UNDEFINED;
+	}
+
+	m_Stats.m_NumPasses = 0;
+	m_Stats.m_NumCulled = 0;
+	for (const Pass& pass : m_Passes) {
+		if (pass.m_Culled) {
+			m_Stats.m_NumCulled++;
+			continue;
+		}
+
+		m_Stats.m_NumPasses++;
+		for (const Pass::Use& use : pass.m_Uses) {
+			const Resource& resource = m_Resources[use.m_Resource];
+			if (resource.m_Imported || m_Transients[resource.m_Transient].m_Image == VK_NULL_HANDLE)
+				continue;
+
+			MemorySlot& slot = m_Slots[m_Transients[resource.m_Transient].m_Slot];
+			slot.m_Stages |= use.m_Stages;
+			if (use.m_Write)
+				slot.m_WriteAccess |= VK_ACCESS_MEMORY_WRITE_BIT;
+		}
+	}
+
+	m_Stats.m_NumBarriers = 0;
+	m_Compiled = true;
+}
+
+void wVkRenderGraph::Cull()
+{
+	for (Resource& resource : m_Resources)
+		resource.m_References = 0;
+
+	for (Pass& pass : m_Passes) {
+		pass.m_Culled = false;
+		pass.m_References = 0;
+		for (const Pass::Use& use : pass.m_Uses) {
+			pass.m_References += use.m_Write ? 1 : 0;
+			m_Resources[use.m_Resource].m_References += use.m_Read ? 1 : 0;
+		}
+	}
+
+	// Resources nobody reads, imported ones are read after the frame
+	std::vector<wVkGraphResource> unread;
+	auto cullPass = [this, &unread](Pass& pass)
+	{
+		pass.m_Culled = true;
+		for (const Pass::Use& use : pass.m_Uses) {
+			Resource& resource = m_Resources[use.m_Resource];
+			if (use.m_Read && --resource.m_References == 0 && !resource.m_Imported)
+				unread.push_back(use.m_Resource);
+		}
+	};
+
+	for (wVkGraphResource i = 0; i < m_Resources.size(); i++) {
+		if (m_Resources[i].m_References == 0 && !m_Resources[i].m_Imported)
+			unread.push_back(i);
+	}
+
+	for (Pass& pass : m_Passes) {
+		if (pass.m_References == 0 && !pass.m_SideEffects)
+			cullPass(pass);
+	}
+
+	while (!unread.empty()) {
+		const wVkGraphResource resource = unread.back();
+		unread.pop_back();
+
+		for (Pass& pass : m_Passes) {
+			if (pass.m_Culled)
+				continue;
+
+			for (const Pass::Use& use : pass.m_Uses) {
+				if (use.m_Resource == resource && use.m_Write && --pass.m_References == 0 && !pass.m_SideEffects)
+					cullPass(pass);
+			}
+		}
+	}
+}
+
+void wVkRenderGraph::BuildScopes()
+{
+	m_Scopes.clear();
+	m_Stats.m_NumMerged = 0;
+
+	// Only neighbours join, whatever runs in between would need a barrier or break the scope anyway
+	bool previousInScope = false;
+	for (uint32_t i = 0; i < m_Passes.size(); i++) {
+		Pass& pass = m_Passes[i];
+		pass.m_Scope = UINT32_MAX;
+		if (pass.m_Culled)
+			continue;
+
+		if (!pass.IsRenderPass()) {
+			previousInScope = false;
+			continue;
+		}
+
+		if (previousInScope && CanJoinScope(m_Scopes.back(), pass)) {
+			m_Scopes.back().m_LastPass = i;
+			m_Stats.m_NumMerged++;
+		}
+		else {
+			m_Scopes.push_back({ i, i });
+		}
+
+		pass.m_Scope = static_cast<uint32_t>(m_Scopes.size() - 1);
+		previousInScope = true;
+	}
+
+	m_Stats.m_NumScopes = static_cast<uint32_t>(m_Scopes.size());
+}
+
+bool wVkRenderGraph::CanJoinScope(const RenderingScope& scope, const Pass& pass) const
+{
+	const Pass& first = m_Passes[scope.m_FirstPass];
+
+	std::vector<wVkGraphResource> scopeColors;
+	const Pass::Use* scopeDepth = nullptr;
+	for (const Pass::Use& use : first.m_Uses) {
+		if (use.m_Type == Pass::UseType::COLOR_ATTACHMENT)
+			scopeColors.push_back(use.m_Resource);
+		else if (use.m_Type == Pass::UseType::DEPTH_ATTACHMENT)
+			scopeDepth = &use;
+	}
+
+	std::vector<wVkGraphResource> colors;
+	for (const Pass::Use& use : pass.m_Uses) {
+		if (use.m_Clear)
+			return false;
+
+		switch (use.m_Type) {
+		case Pass::UseType::COLOR_ATTACHMENT:
+			colors.push_back(use.m_Resource);
+			break;
+		case Pass::UseType::DEPTH_ATTACHMENT:
+			// Read only and writable depth are in different layouts
+			if (scopeDepth == nullptr || scopeDepth->m_Resource != use.m_Resource || scopeDepth->m_Write != use.m_Write)
+				return false;
+			break;
+		default:
+			return false;
+		}
+	}
+
+	return colors == scopeColors;
+}
+
+void wVkRenderGraph::ComputeLifetimes()
+{
+	for (Resource& resource : m_Resources) {
+		resource.m_FirstPass = UINT32_MAX;
+		resource.m_LastPass = 0;
+		resource.m_Usage = resource.m_Desc.m_Usage;
+	}
+
+	for (uint32_t i = 0; i < m_Passes.size(); i++) {
+		if (m_Passes[i].m_Culled)
+			continue;
+
+		for (const Pass::Use& use : m_Passes[i].m_Uses) {
+			Resource& resource = m_Resources[use.m_Resource];
+			resource.m_FirstPass = std::min(resource.m_FirstPass, i);
+			resource.m_LastPass = std::max(resource.m_LastPass, i);
+
+			switch (use.m_Type) {
+			case Pass::UseType::COLOR_ATTACHMENT: resource.m_Usage |= VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT; break;
+			case Pass::UseType::DEPTH_ATTACHMENT: resource.m_Usage |= VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT; break;
+			case Pass::UseType::SAMPLED: resource.m_Usage |= VK_IMAGE_USAGE_SAMPLED_BIT; break;
+			case Pass::UseType::TRANSFER_SRC: resource.m_Usage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT; break;
+			case Pass::UseType::TRANSFER_DST: resource.m_Usage |= VK_IMAGE_USAGE_TRANSFER_DST_BIT; break;
+			}
+		}
+	}
+
+	// Content that never leaves a scope is never stored, it doesn't need memory behind it
+	constexpr VkImageUsageFlags attachmentUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+	for (Resource& resource : m_Resources) {
+		if (resource.m_Imported || resource.m_FirstPass == UINT32_MAX || (resource.m_Usage & ~attachmentUsage) != 0)
+			continue;
+
+		const uint32_t scope = m_Passes[resource.m_FirstPass].m_Scope;
+		if (scope != UINT32_MAX && scope == m_Passes[resource.m_LastPass].m_Scope)
+			resource.m_Usage |= VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT;
+	}
+}
+
+void wVkRenderGraph::AllocateTransients()
+{
+	m_Transients.assign(m_Plan.size(), {});
+	m_Slots.clear();
+
+	// Transients in the order they start living, each goes into the first slot whose occupants are all done by then
+	std::vector<uint32_t> order;
+	for (uint32_t i = 0; i < m_Plan.size(); i++) {
+		if (m_Plan[i].m_FirstPass != UINT32_MAX)
+			order.push_back(i);
+	}
+	std::stable_sort(order.begin(), order.end(), [this](uint32_t a, uint32_t b) { return m_Plan[a].m_FirstPass < m_Plan[b].m_FirstPass; });
+
+	struct SlotRequirements
+	{
+		VkMemoryRequirements m_Requirements = {};
+		uint32_t m_LastPass = 0;
+		bool m_Lazy = false;
+	};
+	std::vector<SlotRequirements> requirements;
+
+	m_Stats.m_TransientBytes = 0;
+	for (uint32_t index : order) {
+		const TransientPlanEntry& entry = m_Plan[index];
+		TransientImage& transient = m_Transients[index];
+
+		transient.m_Image = wVkHelpers::createImage2DObject(entry.m_Desc.m_Extent.width, entry.m_Desc.m_Extent.height, 1, entry.m_Desc.m_Format, VK_IMAGE_TILING_OPTIMAL, entry.m_Usage);
+
+		VkMemoryRequirements memRequirements;
+		vkGetImageMemoryRequirements(wVkGlobals::g_Device, transient.m_Image, &memRequirements);
+		m_Stats.m_TransientBytes += memRequirements.size;
+
+		// Lazily allocated transients only share with each other, the rest may be stored and needs real memory
+		const bool lazy = (entry.m_Usage & VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT) != 0;
+
+		uint32_t slot = 0;
+		for (; slot < requirements.size(); slot++) {
+			if (requirements[slot].m_LastPass < entry.m_FirstPass && requirements[slot].m_Lazy == lazy
+				&& (requirements[slot].m_Requirements.memoryTypeBits & memRequirements.memoryTypeBits) != 0)
+				break;
+		}
+
+		if (slot == requirements.size()) {
+			requirements.push_back({ memRequirements, entry.m_LastPass, lazy });
+			m_Slots.emplace_back();
+		}
+		else {
+			VkMemoryRequirements& shared = requirements[slot].m_Requirements;
+			shared.size = std::max(shared.size, memRequirements.size);
+			shared.alignment = std::max(shared.alignment, memRequirements.alignment);
+			shared.memoryTypeBits &= memRequirements.memoryTypeBits;
+			requirements[slot].m_LastPass = entry.m_LastPass;
+		}
+
+		transient.m_Slot = slot;
+		m_Slots[slot].m_Occupants.push_back(index);
+	}
+
+	// Names only live in the frame's resources, the registry gets them from there
+	std::vector<std::string> names(m_Plan.size());
+	for (const Resource& resource : m_Resources) {
+		if (!resource.m_Imported)
+			names[resource.m_Transient] = resource.m_Name;
+	}
+
+	m_Stats.m_AllocatedBytes = 0;
+	m_Stats.m_NumLazy = 0;
+	for (uint32_t slot = 0; slot < m_Slots.size(); slot++) {
+		MemorySlot& memorySlot = m_Slots[slot];
+		const VkMemoryRequirements& memRequirements = requirements[slot].m_Requirements;
+
+		uint32_t memoryType = requirements[slot].m_Lazy ? FindLazyMemoryType(memRequirements.memoryTypeBits) : UINT32_MAX;
+		if (memoryType != UINT32_MAX)
+			m_Stats.m_NumLazy++;
+		else
+			memoryType = wVkHelpers::findMemoryType(memRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+		memorySlot.m_Allocation = wVkGlobals::g_DeviceAllocator.Allocate(memRequirements, memoryType, wVkAllocationKind::OPTIMAL, {});
+		m_Stats.m_AllocatedBytes += memRequirements.size;
+
+		std::string name = "Transient";
+		for (uint32_t i = 0; i < memorySlot.m_Occupants.size(); i++) {
+			const uint32_t index = memorySlot.m_Occupants[i];
+			TransientImage& transient = m_Transients[index];
+
+			vkBindImageMemory(wVkGlobals::g_Device, transient.m_Image, memorySlot.m_Allocation.m_Memory, memorySlot.m_Allocation.m_Offset);
+			transient.m_View = wVkHelpers::createImageView(transient.m_Image, 1, m_Plan[index].m_Desc.m_Format, GetAspect(m_Plan[index].m_Desc.m_Format));
+
+			name += (i == 0 ? ": " : " + ") + names[index];
+		}
+
+		memorySlot.m_RegistryId = wVkGlobals::g_ResourceRegistry.RegisterImage(m_Transients[memorySlot.m_Occupants[0]].m_Image, memoryType, memRequirements.size,
+			wVkResourceType::TRANSIENT, name, Callsite::Current());
+	}
+
+	m_Stats.m_NumTransients = static_cast<uint32_t>(order.size());
+	m_Stats.m_NumAllocations = static_cast<uint32_t>(m_Slots.size());
+	m_Stats.m_NumPlans++;
+
+	LOG_INFO("Render graph: %i transients in %i allocations (%i lazy), %f MB instead of %f MB", static_cast<int>(m_Stats.m_NumTransients), static_cast<int>(m_Stats.m_NumAllocations),
+		static_cast<int>(m_Stats.m_NumLazy), static_cast<float>(m_Stats.m_AllocatedBytes) / (1024.0f * 1024.0f), static_cast<float>(m_Stats.m_TransientBytes) / (1024.0f * 1024.0f));
+}
+
+void wVkRenderGraph::ReleaseTransients()
+{
+	// Frames in flight may still render into them
+	for (const MemorySlot& slot : m_Slots) {
+		std::vector<TransientImage> occupants;
+		for (uint32_t index : slot.m_Occupants)
+			occupants.push_back(m_Transients[index]);
+
+		wVkGlobals::g_RetireQueue.Retire([occupants = std::move(occupants), allocation = slot.m_Allocation, registryId = slot.m_RegistryId]()
+		{
+			for (const TransientImage& transient : occupants) {
+				vkDestroyImageView(wVkGlobals::g_Device, transient.m_View, wVkGlobals::g_AllocationCallbacks);
+				vkDestroyImage(wVkGlobals::g_Device, transient.m_Image, wVkGlobals::g_AllocationCallbacks);
+			}
+			wVkGlobals::g_DeviceAllocator.Free(allocation);
+			wVkGlobals::g_ResourceRegistry.Unregister(registryId);
+		});
+	}
+
+	m_Slots.clear();
+	m_Transients.clear();
+	m_Plan.clear();
+}
+
+void wVkRenderGraph::Execute(VkCommandBuffer commandBuffer)
+{
+	ASSERT(m_Compiled, "Render graph executed without being compiled");
+
+	for (uint32_t i = 0; i < m_Passes.size(); i++) {
+		const Pass& pass = m_Passes[i];
+		if (pass.m_Culled)
+			continue;
+
+		if (pass.m_Scope == UINT32_MAX) {
+			RecordBarriers(commandBuffer, pass, i);
+			pass.m_Execute(commandBuffer);
+		}
+		else {
+			const RenderingScope& scope = m_Scopes[pass.m_Scope];
+			if (scope.m_FirstPass == i) {
+				RecordBarriers(commandBuffer, pass, i);
+				BeginRendering(commandBuffer, scope);
+			}
+			else {
+				// The first pass already moved everything into place, attachment writes within a scope are in rasterization order
+				for (const Pass::Use& use : pass.m_Uses) {
+					VkImageLayout layout;
+					VkAccessFlags access;
+					GetLayoutAndAccess(use, layout, access);
+					m_States[use.m_Resource].m_Stages |= use.m_Stages;
+					m_States[use.m_Resource].m_Access |= access;
+				}
+			}
+
+			pass.m_Execute(commandBuffer);
+
+			if (scope.m_LastPass == i)
+				m_CmdEndRendering(commandBuffer);
+		}
+
+		for (const Pass::Use& use : pass.m_Uses)
+			m_States[use.m_Resource].m_Written |= use.m_Write;
+	}
+
+	// Imported images are handed back in the layout whoever uses them next expects
+	std::vector<VkImageMemoryBarrier> barriers;
+	VkPipelineStageFlags srcStages = 0;
+	for (uint32_t i = 0; i < m_Resources.size(); i++) {
+		const Resource& resource = m_Resources[i];
+		const ResourceState& state = m_States[i];
+		if (!resource.m_Imported || resource.m_FinalLayout == VK_IMAGE_LAYOUT_UNDEFINED || resource.m_FinalLayout == state.m_Layout)
+			continue;
+
+		VkImageMemoryBarrier barrier{};
+		barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		barrier.oldLayout = state.m_Layout;
+		barrier.newLayout = resource.m_FinalLayout;
+		barrier.srcAccessMask = state.m_Access & WRITE_ACCESS;
+		barrier.dstAccessMask = 0;
+		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.image = resource.m_Image;
+		barrier.subresourceRange = { resource.m_Aspect, 0, 1, 0, 1 };
+		barriers.push_back(barrier);
+
+		srcStages |= state.m_Stages;
+	}
+
+	if (!barriers.empty()) {
+		vkCmdPipelineBarrier(commandBuffer, srcStages, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 0, nullptr, static_cast<uint32_t>(barriers.size()), barriers.data());
+		m_Stats.m_NumBarriers += static_cast<uint32_t>(barriers.size());
+	}
+}
+
+void wVkRenderGraph::RecordBarriers(VkCommandBuffer commandBuffer, const Pass& pass, uint32_t passIndex)
+{
+	std::vector<VkImageMemoryBarrier> barriers;
+	VkPipelineStageFlags srcStages = 0;
+	VkPipelineStageFlags dstStages = 0;
+
+	for (const Pass::Use& use : pass.m_Uses) {
+		const Resource& resource = m_Resources[use.m_Resource];
+		ResourceState& state = m_States[use.m_Resource];
+
+		VkImageLayout layout;
+		VkAccessFlags access;
+		GetLayoutAndAccess(use, layout, access);
+
+		// A transient's first use starts from nothing, it only has to wait for whoever used its memory before
+		const bool firstUse = !resource.m_Imported && passIndex == resource.m_FirstPass;
+		VkImageLayout oldLayout = state.m_Layout;
+		VkPipelineStageFlags waitStages = state.m_Stages;
+		VkAccessFlags waitAccess = state.m_Access & WRITE_ACCESS;
+		if (firstUse) {
+			const MemorySlot& slot = m_Slots[m_Transients[resource.m_Transient].m_Slot];
+			oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+			waitStages = slot.m_Stages;
+			waitAccess = slot.m_WriteAccess;
+		}
+
+		// Reads after reads in the same layout don't need a barrier, a later write has to wait for all of them though
+		if (!firstUse && oldLayout == layout && waitAccess == 0 && (access & WRITE_ACCESS) == 0) {
+			state.m_Stages |= use.m_Stages;
+			state.m_Access |= access;
+			continue;
+		}
+
+		VkImageMemoryBarrier barrier{};
+		barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		barrier.oldLayout = oldLayout;
+		barrier.newLayout = layout;
+		barrier.srcAccessMask = waitAccess;
+		barrier.dstAccessMask = access;
+		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.image = GetImage(use.m_Resource);
+		barrier.subresourceRange = { resource.m_Aspect, 0, 1, 0, 1 };
+		barriers.push_back(barrier);
+
+		srcStages |= waitStages;
+		dstStages |= use.m_Stages;
+
+		state.m_Layout = layout;
+		state.m_Stages = use.m_Stages;
+		state.m_Access = access;
+	}
+
+	if (barriers.empty())
+		return;
+
+	// Nothing ran before, only happens for imported images that came in undefined
+	if (srcStages == 0)
+		srcStages = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+
+	vkCmdPipelineBarrier(commandBuffer, srcStages, dstStages, 0, 0, nullptr, 0, nullptr, static_cast<uint32_t>(barriers.size()), barriers.data());
+	m_Stats.m_NumBarriers += static_cast<uint32_t>(barriers.size());
+}
+
+void wVkRenderGraph::BeginRendering(VkCommandBuffer commandBuffer, const RenderingScope& scope)
+{
+	const Pass& first = m_Passes[scope.m_FirstPass];
+
+	// Color attachments in declaration order (the shader's output locations)
+	std::vector<VkRenderingAttachmentInfoKHR> colorAttachments;
+	VkRenderingAttachmentInfoKHR depthAttachment{};
+	bool hasDepth = false;
+	bool hasStencil = false;
+	VkExtent2D extent = {};
+
+	for (const Pass::Use& use : first.m_Uses) {
+		if (use.m_Type != Pass::UseType::COLOR_ATTACHMENT && use.m_Type != Pass::UseType::DEPTH_ATTACHMENT)
+			continue;
+
+		const Resource& resource = m_Resources[use.m_Resource];
+		const ResourceState& state = m_States[use.m_Resource];
+
+		if (colorAttachments.empty() && !hasDepth)
+			extent = resource.m_Extent;
+		ASSERT(resource.m_Extent.width == extent.width && resource.m_Extent.height == extent.height, "Attachments of pass \"%s\" differ in size", first.m_Name.c_str());
+
+		// Barriers already moved it into its layout, beginning the scope doesn't transition anything
+		VkAttachmentLoadOp loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+		if (use.m_Clear)
+			loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+		else if (state.m_Written)
+			loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+
+		// Whoever reads it next is after the whole scope. Read only depth stores what it loaded, there's nothing to write back.
+		const bool keep = !use.m_Write || IsReadLater(use.m_Resource, scope.m_LastPass);
+
+		VkRenderingAttachmentInfoKHR attachment{};
+		attachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO_KHR;
+		attachment.imageView = GetView(use.m_Resource);
+		attachment.imageLayout = state.m_Layout;
+		attachment.resolveMode = VK_RESOLVE_MODE_NONE;
+		attachment.loadOp = loadOp;
+		attachment.storeOp = keep ? VK_ATTACHMENT_STORE_OP_STORE : VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		attachment.clearValue = use.m_ClearValue;
+
+		if (use.m_Type == Pass::UseType::COLOR_ATTACHMENT) {
+			colorAttachments.push_back(attachment);
+		}
+		else {
+			ASSERT(!hasDepth, "Pass \"%s\" has more than one depth attachment", first.m_Name.c_str());
+			depthAttachment = attachment;
+			hasDepth = true;
+			hasStencil = (resource.m_Aspect & VK_IMAGE_ASPECT_STENCIL_BIT) != 0;
+		}
+	}
+
+	VkRenderingInfoKHR renderingInfo{};
+	renderingInfo.sType = VK_STRUCTURE_TYPE_RENDERING_INFO_KHR;
+	renderingInfo.renderArea.offset = { 0, 0 };
+	renderingInfo.renderArea.extent = extent;
+	renderingInfo.layerCount = 1;
+	renderingInfo.colorAttachmentCount = static_cast<uint32_t>(colorAttachments.size());
+	renderingInfo.pColorAttachments = colorAttachments.data();
+	renderingInfo.pDepthAttachment = hasDepth ? &depthAttachment : nullptr;
+	// Same view, stencil is loaded and stored along with depth
+	renderingInfo.pStencilAttachment = hasStencil ? &depthAttachment : nullptr;
+
+	m_CmdBeginRendering(commandBuffer, &renderingInfo);
+}
+
+void wVkRenderGraph::GetLayoutAndAccess(const Pass::Use& use, VkImageLayout& layout, VkAccessFlags& access)
+{
+	layout = VK_IMAGE_LAYOUT_UNDEFINED;
+	access = 0;
+	switch (use.m_Type) {
+	case Pass::UseType::COLOR_ATTACHMENT:
+		layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+		access = (use.m_Read ? VK_ACCESS_COLOR_ATTACHMENT_READ_BIT : 0) | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+		break;
+	case Pass::UseType::DEPTH_ATTACHMENT:
+		layout = use.m_Write ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL : VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+		access = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | (use.m_Write ? VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT : 0);
+		break;
+	case Pass::UseType::SAMPLED:
+		layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		access = VK_ACCESS_SHADER_READ_BIT;
+		break;
+	case Pass::UseType::TRANSFER_SRC:
+		layout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+		access = VK_ACCESS_TRANSFER_READ_BIT;
+		break;
+	case Pass::UseType::TRANSFER_DST:
+		layout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		access = VK_ACCESS_TRANSFER_WRITE_BIT;
+		break;
+	}
+}
+
+bool wVkRenderGraph::IsReadLater(wVkGraphResource resource, uint32_t passIndex) const
+{
+	if (m_Resources[resource].m_Imported)
+		return true;
+
+	for (uint32_t i = passIndex + 1; i < m_Passes.size(); i++) {
+		if (m_Passes[i].m_Culled)
+			continue;
+
+		for (const Pass::Use& use : m_Passes[i].m_Uses) {
+			if (use.m_Resource == resource && use.m_Read)
+				return true;
+		}
+	}
+
+	return false;
+}
+
+VkImage wVkRenderGraph::GetImage(wVkGraphResource resource) const
+{
+	const Resource& graphResource = m_Resources[resource];
+	return graphResource.m_Imported ? graphResource.m_Image : m_Transients[graphResource.m_Transient].m_Image;
+}
+
+VkImageView wVkRenderGraph::GetView(wVkGraphResource resource) const
+{
+	const Resource& graphResource = m_Resources[resource];
+	return graphResource.m_Imported ? graphResource.m_View : m_Transients[graphResource.m_Transient].m_View;
+}
+
+void wVkRenderGraph::Destroy()
+{
+	ReleaseTransients();
+	Reset();
+}
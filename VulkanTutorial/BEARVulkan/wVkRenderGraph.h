@@ -0,0 +1,259 @@
+#pragma once
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "vulkan/vulkan.h"
+
+#include "wVkDeviceAllocator.h"
+
+// Index of a resource in the frame's graph, only valid until the next Reset
+using wVkGraphResource = uint32_t;
+constexpr wVkGraphResource INVALID_GRAPH_RESOURCE = UINT32_MAX;
+
+// An attachment that only lives inside the frame, the graph owns its image and memory
+struct wVkTransientDesc
+{
+	VkFormat m_Format = VK_FORMAT_UNDEFINED;
+	VkExtent2D m_Extent = {};
+	VkImageUsageFlags m_Usage = 0; // On top of what the passes using it need
+
+	bool operator==(const wVkTransientDesc& other) const;
+};
+
+// Attachment formats of a rendering scope. There are no render passes, pipelines chain GetCreateInfo into
+// VkGraphicsPipelineCreateInfo::pNext instead and have to match the scope they draw in exactly, depth included.
+struct wVkRenderingFormats
+{
+	std::vector<VkFormat> m_ColorFormats;
+	VkFormat m_DepthFormat = VK_FORMAT_UNDEFINED; // Stencil too when it has it
+
+	// Points into m_ColorFormats, valid as long as this is
+	VkPipelineRenderingCreateInfoKHR GetCreateInfo() const;
+};
+
+// The frame as a list of passes that declare which resources they read and write.
+// Rebuilt every frame: Reset, import the images that outlive the frame, declare transients, add passes, Compile, Execute.
+// - Passes whose results nothing reads are culled, unless they have side effects. Imported images count as read.
+// - Barriers and layout transitions are placed between passes from the declared uses, nothing records its own.
+// - Attachments load and store only what's needed: a clear or DONT_CARE when the content is undefined, DONT_CARE
+//   stores when no later pass (or nobody after the frame) reads it.
+// - Render passes (those with attachments) draw in dynamic rendering scopes, no VkRenderPass or VkFramebuffer. A pass that
+//   only draws into the same attachments as the one before it, without clearing, joins its scope: no barrier, no
+//   store and reload in between. Depth it leaves out is still bound, its pipelines are created with the scope's formats.
+// - Transients that live in a single scope and are only attachments are lazily allocated where the device has such memory,
+//   on tilers they never leave tile memory.
+// - Transients whose lifetimes don't overlap share memory. The plan is kept as long as the frame looks the same,
+//   transients outlive the frame and are shared by the frames in flight, the barriers order the frames' uses.
+// Passes run in the order they were added, which is already a valid order as a pass can only use what exists.
+class wVkRenderGraph
+{
+public:
+	struct Stats
+	{
+		uint32_t m_NumPasses = 0; // Last compile
+		uint32_t m_NumCulled = 0;
+		uint32_t m_NumScopes = 0; // Rendering scopes
+		uint32_t m_NumMerged = 0; // Passes that joined the scope of the pass before
+		uint32_t m_NumBarriers = 0;
+		uint32_t m_NumTransients = 0;
+		uint32_t m_NumAllocations = 0; // Transients in memory of their own or shared
+		uint32_t m_NumLazy = 0; // Allocations in lazily allocated memory
+		VkDeviceSize m_TransientBytes = 0; // Without aliasing
+		VkDeviceSize m_AllocatedBytes = 0;
+		uint64_t m_NumPlans = 0; // Times the transients were (re)allocated
+	};
+
+	class Pass
+	{
+	public:
+		// Clears when given a value, loads otherwise
+		Pass& WriteColor(wVkGraphResource resource, const VkClearColorValue* clear = nullptr);
+		Pass& WriteDepth(wVkGraphResource resource, const VkClearDepthStencilValue* clear = nullptr);
+		// Depth test without writing
+		Pass& ReadDepth(wVkGraphResource resource);
+		Pass& ReadTexture(wVkGraphResource resource, VkPipelineStageFlags stages = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+		Pass& ReadTransfer(wVkGraphResource resource);
+		Pass& WriteTransfer(wVkGraphResource resource);
+
+		// The pass does something outside the graph (readbacks, queries), it's never culled
+		Pass& SetSideEffects();
+
+	private:
+		friend class wVkRenderGraph;
+
+		enum class UseType
+		{
+			COLOR_ATTACHMENT,
+			DEPTH_ATTACHMENT,
+			SAMPLED,
+			TRANSFER_SRC,
+			TRANSFER_DST,
+		};
+
+		struct Use
+		{
+			wVkGraphResource m_Resource = INVALID_GRAPH_RESOURCE;
+			UseType m_Type = UseType::SAMPLED;
+			bool m_Read = false;
+			bool m_Write = false;
+			bool m_Clear = false;
+			VkClearValue m_ClearValue = {};
+			VkPipelineStageFlags m_Stages = 0;
+		};
+
+		Pass& AddUse(const Use& use);
+		bool IsRenderPass() const;
+
+		wVkRenderGraph* m_Graph = nullptr;
+		std::string m_Name;
+		std::function<void(VkCommandBuffer)> m_Execute;
+		std::vector<Use> m_Uses;
+		bool m_SideEffects = false;
+
+		// Filled by Compile
+		bool m_Culled = false;
+		uint32_t m_References = 0;
+		uint32_t m_Scope = UINT32_MAX; // Into m_Scopes, render passes only
+	};
+
+	// Loads vkCmdBeginRenderingKHR and vkCmdEndRenderingKHR, once the device exists
+	void Initialize();
+
+	// Starts a new frame, every resource and pass of the previous one is gone
+	void Reset();
+
+	// An image that lives past the frame. Its content is undefined when initialLayout is UNDEFINED, initialStages is what
+	// the first use has to wait on (the acquire semaphore's wait stage for swapchain images). Left in finalLayout, or in
+	// whatever the last pass needed when that's UNDEFINED.
+	wVkGraphResource ImportImage(const std::string& name, VkImage image, VkImageView view, VkFormat format, VkExtent2D extent,
+		VkImageLayout initialLayout, VkPipelineStageFlags initialStages, VkImageLayout finalLayout);
+	wVkGraphResource CreateTransient(const std::string& name, const wVkTransientDesc& desc);
+
+	// Valid until Reset. Render passes (those with attachments) run execute inside their rendering scope.
+	Pass& AddPass(const std::string& name, std::function<void(VkCommandBuffer)> execute);
+
+	// Culls, groups render passes into scopes, (re)allocates transients if their lifetimes changed, and works out the barriers
+	void Compile();
+	void Execute(VkCommandBuffer commandBuffer);
+
+	// Everything, after the GPU went idle and before the retire queue is flushed
+	void Destroy();
+
+	const Stats& GetStats() const { return m_Stats; }
+
+private:
+	struct Resource
+	{
+		std::string m_Name;
+		VkFormat m_Format = VK_FORMAT_UNDEFINED;
+		VkExtent2D m_Extent = {};
+		VkImageAspectFlags m_Aspect = 0;
+
+		// Imported
+		bool m_Imported = false;
+		VkImage m_Image = VK_NULL_HANDLE;
+		VkImageView m_View = VK_NULL_HANDLE;
+		VkImageLayout m_InitialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		VkPipelineStageFlags m_InitialStages = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+		VkImageLayout m_FinalLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+		// Transient
+		wVkTransientDesc m_Desc;
+		VkImageUsageFlags m_Usage = 0; // Desc usage and what the passes need
+		uint32_t m_Transient = UINT32_MAX; // Index into m_Transients
+
+		// Filled by Compile
+		uint32_t m_References = 0;
+		uint32_t m_FirstPass = UINT32_MAX;
+		uint32_t m_LastPass = 0;
+	};
+
+	// Where a resource is at during Execute
+	struct ResourceState
+	{
+		VkImageLayout m_Layout = VK_IMAGE_LAYOUT_UNDEFINED;
+		VkPipelineStageFlags m_Stages = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+		VkAccessFlags m_Access = 0;
+		bool m_Written = false; // Has content worth keeping
+	};
+
+	// What the transients of a frame look like, the allocation is redone when this changes
+	struct TransientPlanEntry
+	{
+		wVkTransientDesc m_Desc;
+		VkImageUsageFlags m_Usage = 0;
+		uint32_t m_FirstPass = 0;
+		uint32_t m_LastPass = 0;
+
+		bool operator==(const TransientPlanEntry& other) const;
+	};
+
+	struct TransientImage
+	{
+		VkImage m_Image = VK_NULL_HANDLE;
+		VkImageView m_View = VK_NULL_HANDLE;
+		uint32_t m_Slot = 0;
+	};
+
+	// Memory shared by transients, used by one at a time in the order of m_Occupants
+	struct MemorySlot
+	{
+		wVkAllocation m_Allocation;
+		uint64_t m_RegistryId = 0;
+		std::vector<uint32_t> m_Occupants; // Into m_Transients
+
+		// Every use of every occupant, the first use of one waits on these. The plan is the same every frame, so that
+		// covers both the previous occupant and the last frame's.
+		VkPipelineStageFlags m_Stages = 0;
+		VkAccessFlags m_WriteAccess = 0;
+	};
+
+	// Consecutive render passes recorded between one vkCmdBeginRenderingKHR and vkCmdEndRenderingKHR, bound to the first one's attachments
+	struct RenderingScope
+	{
+		uint32_t m_FirstPass = 0;
+		uint32_t m_LastPass = 0;
+	};
+
+	void Cull();
+	void BuildScopes();
+	void ComputeLifetimes();
+	void AllocateTransients();
+	void ReleaseTransients();
+
+	// Whether the pass can draw in the scope as it is: the same color attachments in the same order, the same depth or
+	// none, no clears, and nothing that needs a barrier
+	bool CanJoinScope(const RenderingScope& scope, const Pass& pass) const;
+
+	void RecordBarriers(VkCommandBuffer commandBuffer, const Pass& pass, uint32_t passIndex);
+	void BeginRendering(VkCommandBuffer commandBuffer, const RenderingScope& scope);
+
+	static void GetLayoutAndAccess(const Pass::Use& use, VkImageLayout& layout, VkAccessFlags& access);
+
+	// Whether a pass after passIndex reads the resource's content, or the frame is followed by someone who does
+	bool IsReadLater(wVkGraphResource resource, uint32_t passIndex) const;
+
+	VkImage GetImage(wVkGraphResource resource) const;
+	VkImageView GetView(wVkGraphResource resource) const;
+
+	// Frame
+	std::vector<Resource> m_Resources;
+	std::deque<Pass> m_Passes;
+	std::vector<ResourceState> m_States;
+	std::vector<RenderingScope> m_Scopes;
+	bool m_Compiled = false;
+
+	// Kept between frames
+	std::vector<TransientPlanEntry> m_Plan;
+	std::vector<TransientImage> m_Transients;
+	std::vector<MemorySlot> m_Slots;
+
+	// VK_KHR_dynamic_rendering isn't core in 1.1, the loader doesn't export these
+	PFN_vkCmdBeginRenderingKHR m_CmdBeginRendering = nullptr;
+	PFN_vkCmdEndRenderingKHR m_CmdEndRendering = nullptr;
+
+	Stats m_Stats;
+};
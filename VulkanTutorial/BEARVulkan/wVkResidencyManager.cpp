@@ -0,0 +1,300 @@
+#include "wVkResidencyManager.h"
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "imgui.h"
+
+#include "TypeDefs.h"
+#include "wVkGlobalVariables.h"
+#include "wVkMipBuilder.h"
+#include "Utils/ConsoleLogger.h"
+#include "wVkHelpers/wVkFormats.h"
+#include "wVkHelpers/wVkHelpers.h"
+#include "wVkHelpers/wVkMemory.h"
+#include "wVkHelpers/wVkTemp.h"
+#include "wVkHelpers/wVkTexture.h"
+
+// Image with the texture's mip chain starting at firstMip, memory from the device allocator. Pinned until ReplaceImage.
+void CreateResidentImage(const wVkTexture2D& texture, uint32_t firstMip, VkImage& image, wVkAllocation& allocation)
+{
+	const uint32_t width = std::max(texture.m_FullWidth >> firstMip, 1u);
+	const uint32_t height = std::max(texture.m_FullHeight >> firstMip, 1u);
+	const uint32_t mips = texture.m_FullMipLevels - firstMip;
+
+	image = wVkHelpers::createImage2DObject(width, height, mips, texture.m_Format, VK_IMAGE_TILING_OPTIMAL, texture.m_Usage);
+
+	VkMemoryRequirements memRequirements;
+	vkGetImageMemoryRequirements(wVkGlobals::g_Device, image, &memRequirements);
+
+	const uint32_t memoryType = wVkHelpers::findMemoryType(memRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+	allocation = wVkGlobals::g_DeviceAllocator.Allocate(memRequirements, memoryType, wVkAllocationKind::OPTIMAL, {});
+
+	vkBindImageMemory(wVkGlobals::g_Device, image, allocation.m_Memory, allocation.m_Offset);
+}
+
+void wVkResidencyManager::Register(wVkTexture2D* texture)
+{
+	texture->m_LastUsedFrame = wVkGlobals::g_RetireQueue.GetCurrentFrame();
+	m_Textures.insert(texture);
+}
+
+void wVkResidencyManager::Unregister(wVkTexture2D* texture)
+{
+	m_Textures.erase(texture);
+}
+
+void wVkResidencyManager::Replace(wVkTexture2D* oldTexture, wVkTexture2D* newTexture)
+{
+	if (m_Textures.erase(oldTexture) > 0)
+		m_Textures.insert(newTexture);
+}
+
+void wVkResidencyManager::MarkUsed(wVkTexture2D& texture)
+{
+	texture.m_LastUsedFrame = wVkGlobals::g_RetireQueue.GetCurrentFrame();
+}
+
+void wVkResidencyManager::Update()
+{
+	const uint64_t currentFrame = wVkGlobals::g_RetireQueue.GetCurrentFrame();
+	const bool heapPressure = IsHeapUnderPressure();
+
+	uint32_t numChanges = 0;
+	uint64_t residentBytes = GetResidentBytes();
+
+	// Over budget, take the top mip off the least recently used texture until we're not
+	while (numChanges < wVkConstants::g_ResidencyMaxChangesPerFrame && (residentBytes > m_BudgetBytes || heapPressure)) {
+		wVkTexture2D* victim = nullptr;
+		for (wVkTexture2D* texture : m_Textures) {
+			if (texture->m_TexMipLevels > 1 && (victim == nullptr || texture->m_LastUsedFrame < victim->m_LastUsedFrame))
+				victim = texture;
+		}
+
+		if (victim == nullptr)
+			break;
+
+		Demote(*victim);
+		numChanges++;
+		m_Stats.m_TotalEvictions++;
+		residentBytes = GetResidentBytes();
+	}
+
+	// Demoted textures that were used last frame get their full chain back, most recently used first, if it fits
+	if (!heapPressure) {
+		std::vector<wVkTexture2D*> candidates;
+		for (wVkTexture2D* texture : m_Textures) {
+			if (texture->m_FirstResidentMip > 0 && texture->m_LastUsedFrame + 1 >= currentFrame)
+				candidates.push_back(texture);
+		}
+
+		std::sort(candidates.begin(), candidates.end(), [](const wVkTexture2D* a, const wVkTexture2D* b) { return a->m_LastUsedFrame > b->m_LastUsedFrame; });
+
+		for (wVkTexture2D* texture : candidates) {
+			if (numChanges >= wVkConstants::g_ResidencyMaxChangesPerFrame)
+				break;
+
+			const uint64_t extraBytes = GetChainBytes(*texture, 0) - GetChainBytes(*texture, texture->m_FirstResidentMip);
+			if (residentBytes + extraBytes > m_BudgetBytes)
+				continue;
+
+			Promote(*texture);
+			numChanges++;
+			m_Stats.m_TotalPromotions++;
+			residentBytes = GetResidentBytes();
+		}
+	}
+
+	m_Stats.m_ResidentBytes = residentBytes;
+	m_Stats.m_FullChainBytes = 0;
+	m_Stats.m_NumDemoted = 0;
+	m_Stats.m_NumTextures = static_cast<uint32_t>(m_Textures.size());
+	m_Stats.m_HeapPressure = heapPressure;
+
+	for (const wVkTexture2D* texture : m_Textures) {
+		m_Stats.m_FullChainBytes += GetChainBytes(*texture, 0);
+		if (texture->m_FirstResidentMip > 0)
+			m_Stats.m_NumDemoted++;
+	}
+}
+
+bool wVkResidencyManager::IsHeapUnderPressure() const
+{
+	// Without the extension the usage is only what we tracked ourselves, the texture budget covers that
+	if (!wVkGlobals::g_DeviceCapabilities.m_MemoryBudget || m_Textures.empty())
+		return false;
+
+	std::vector<uint32_t> textureHeaps;
+	for (const wVkTexture2D* texture : m_Textures) {
+		uint32_t heapIndex = 0;
+		wVkHelpers::getMemoryTypeProperties(texture->m_Allocation.m_MemoryTypeIndex, &heapIndex);
+		if (std::find(textureHeaps.begin(), textureHeaps.end(), heapIndex) == textureHeaps.end())
+			textureHeaps.push_back(heapIndex);
+	}
+
+	for (const wVkHeapUsage& heap : wVkGlobals::g_ResourceRegistry.GetHeapUsage()) {
+		const bool holdsTextures = std::find(textureHeaps.begin(), textureHeaps.end(), heap.m_HeapIndex) != textureHeaps.end();
+		if (holdsTextures && static_cast<double>(heap.m_Usage) > static_cast<double>(heap.m_Budget) * wVkConstants::g_ResidencyHeapPressure)
+			return true;
+	}
+
+	return false;
+}
+
+uint64_t wVkResidencyManager::GetResidentBytes() const
+{
+	uint64_t bytes = 0;
+	for (const wVkTexture2D* texture : m_Textures)
+		bytes += texture->m_Allocation.m_Size;
+
+	return bytes;
+}
+
+void wVkResidencyManager::Demote(wVkTexture2D& texture)
+{
+	const uint32_t firstMip = texture.m_FirstResidentMip + 1;
+	const uint32_t mips = texture.m_FullMipLevels - firstMip;
+
+	VkImage image = VK_NULL_HANDLE;
+	wVkAllocation allocation;
+	CreateResidentImage(texture, firstMip, image, allocation);
+
+	VkCommandBuffer commandBuffer = wVkHelpers::beginSingleTimeCommand();
+
+	// Frames in flight may still sample the old image, the barrier waits for them and it goes back to SHADER_READ_ONLY after
+	wVkHelpers::recordImageBarrier(commandBuffer, texture.m_TextureImage, 1, mips, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+		VK_ACCESS_SHADER_READ_BIT, VK_ACCESS_TRANSFER_READ_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+	wVkHelpers::recordImageBarrier(commandBuffer, image, 0, mips, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+		0, VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+
+	// Mip i of the new image is mip i + 1 of the old one
+	std::vector<VkImageCopy> regions(mips);
+	for (uint32_t mip = 0; mip < mips; mip++) {
+		VkImageCopy& region = regions[mip];
+		region = {};
+		region.srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, mip + 1, 0, 1 };
+		region.dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, mip, 0, 1 };
+		region.extent = { std::max(texture.m_FullWidth >> (firstMip + mip), 1u), std::max(texture.m_FullHeight >> (firstMip + mip), 1u), 1 };
+	}
+
+	vkCmdCopyImage(commandBuffer, texture.m_TextureImage, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, mips, regions.data());
+
+	wVkHelpers::recordImageBarrier(commandBuffer, texture.m_TextureImage, 1, mips, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+		VK_ACCESS_TRANSFER_READ_BIT, VK_ACCESS_SHADER_READ_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT);
+	wVkHelpers::recordImageBarrier(commandBuffer, image, 0, mips, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+		VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT);
+
+	wVkHelpers::endSingleTimeCommand(commandBuffer);
+
+	ReplaceImage(texture, image, allocation, firstMip);
+}
+
+void wVkResidencyManager::Promote(wVkTexture2D& texture)
+{
+	VkImage image = VK_NULL_HANDLE;
+	wVkAllocation allocation;
+	CreateResidentImage(texture, 0, image, allocation);
+
+	// Same path as a freshly created Texture, the whole CPU built chain in one go
+	wVkHelpers::transitionImageLayout(image, texture.m_Format, texture.m_FullMipLevels, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+	wVkGlobals::g_UploadContext.UploadMipChain(image, *texture.m_SourceMips);
+	wVkHelpers::transitionImageLayout(image, texture.m_Format, texture.m_FullMipLevels, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+
+	ReplaceImage(texture, image, allocation, 0);
+}
+
+void wVkResidencyManager::UploadResidentMips(wVkTexture2D& texture, uint32_t firstMip, const wVkMipChain& chain)
+{
+	const uint32_t mips = texture.m_FullMipLevels - firstMip;
+
+	VkImage image = VK_NULL_HANDLE;
+	wVkAllocation allocation;
+	CreateResidentImage(texture, firstMip, image, allocation);
+
+	wVkHelpers::transitionImageLayout(image, texture.m_Format, mips, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+	wVkGlobals::g_UploadContext.UploadMipChain(image, chain, firstMip);
+	wVkHelpers::transitionImageLayout(image, texture.m_Format, mips, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+
+	ReplaceImage(texture, image, allocation, firstMip);
+}
+
+void wVkResidencyManager::ReplaceImage(wVkTexture2D& texture, VkImage image, const wVkAllocation& allocation, uint32_t firstResidentMip)
+{
+	// The registry entry stays, it follows the texture rather than the image
+	wVkGlobals::g_DeviceAllocator.SetOwner(texture.m_Allocation, {});
+	wVkGlobals::g_RetireQueue.Retire([view = texture.m_TextureImageView, oldImage = texture.m_TextureImage, oldAllocation = texture.m_Allocation]()
+	{
+		vkDestroyImageView(wVkGlobals::g_Device, view, wVkGlobals::g_AllocationCallbacks);
+		vkDestroyImage(wVkGlobals::g_Device, oldImage, wVkGlobals::g_AllocationCallbacks);
+		wVkGlobals::g_DeviceAllocator.Free(oldAllocation);
+	});
+
+	texture.m_FirstResidentMip = firstResidentMip;
+	texture.m_TexMipLevels = texture.m_FullMipLevels - firstResidentMip;
+	texture.m_Width = std::max(texture.m_FullWidth >> firstResidentMip, 1u);
+	texture.m_Height = std::max(texture.m_FullHeight >> firstResidentMip, 1u);
+	texture.m_TextureImage = image;
+	texture.m_TextureImageView = wVkHelpers::createImageView(image, texture.m_TexMipLevels, texture.m_Format, VK_IMAGE_ASPECT_COLOR_BIT);
+	texture.m_Allocation = allocation;
+	texture.m_Relocations++;
+
+	wVkGlobals::g_DeviceAllocator.SetOwner(allocation, { nullptr, &texture });
+	wVkGlobals::g_ResourceRegistry.UpdateImage(texture.m_RegistryId, image, GetChainBytes(texture, firstResidentMip));
+}
+
+uint64_t wVkResidencyManager::GetChainBytes(const wVkTexture2D& texture, uint32_t firstMip)
+{
+	uint64_t bytes = 0;
+	for (uint32_t mip = firstMip; mip < texture.m_FullMipLevels; mip++)
+		bytes += wVkHelpers::getImageSize(texture.m_Format, std::max(texture.m_FullWidth >> mip, 1u), std::max(texture.m_FullHeight >> mip, 1u));
+
+	return bytes;
+}
+
+void wVkResidencyManager::DrawImGuiPanel()
+{
+	ImGui::Begin("Texture Residency");
+
+	int budgetMb = static_cast<int>(m_BudgetBytes / (1024 * 1024));
+	if (ImGui::SliderInt("Budget (MB)", &budgetMb, 1, 2048))
+		m_BudgetBytes = static_cast<uint64_t>(budgetMb) * 1024 * 1024;
+
+	const float fraction = m_BudgetBytes != 0 ? static_cast<float>(static_cast<double>(m_Stats.m_ResidentBytes) / static_cast<double>(m_BudgetBytes)) : 0.0f;
+	const std::string overlay = wVkHelpers::formatBytes(m_Stats.m_ResidentBytes) + " / " + wVkHelpers::formatBytes(m_BudgetBytes);
+	ImGui::ProgressBar(std::min(fraction, 1.0f), ImVec2(-1.0f, 0.0f), overlay.c_str());
+
+	ImGui::Text("%u textures, %u with mips evicted, full chains would take %s", m_Stats.m_NumTextures, m_Stats.m_NumDemoted, wVkHelpers::formatBytes(m_Stats.m_FullChainBytes).c_str());
+	ImGui::Text("Evictions: %llu, promotions: %llu", static_cast<unsigned long long>(m_Stats.m_TotalEvictions), static_cast<unsigned long long>(m_Stats.m_TotalPromotions));
+	if (m_Stats.m_HeapPressure)
+		ImGui::TextColored(ImVec4(0.9f, 0.2f, 0.2f, 1.0f), "Heap over %.0f%% of its VK_EXT_memory_budget", wVkConstants::g_ResidencyHeapPressure * 100.0f);
+
+	std::vector<const wVkTexture2D*> textures(m_Textures.begin(), m_Textures.end());
+	std::sort(textures.begin(), textures.end(), [](const wVkTexture2D* a, const wVkTexture2D* b) { return a->m_LastUsedFrame > b->m_LastUsedFrame; });
+
+	const uint64_t currentFrame = wVkGlobals::g_RetireQueue.GetCurrentFrame();
+
+	if (ImGui::BeginTable("ResidentTextures", 5, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg | ImGuiTableFlags_SizingFixedFit))
+	{
+		ImGui::TableSetupColumn("Texture");
+		ImGui::TableSetupColumn("Resident");
+		ImGui::TableSetupColumn("Mips");
+		ImGui::TableSetupColumn("Allocated");
+		ImGui::TableSetupColumn("Last used");
+		ImGui::TableHeadersRow();
+
+		for (const wVkTexture2D* texture : textures)
+		{
+			ImGui::TableNextRow();
+			ImGui::TableNextColumn(); ImGui::TextUnformatted(wVkGlobals::g_ResourceRegistry.GetName(texture->m_RegistryId).c_str());
+			ImGui::TableNextColumn(); ImGui::Text("%ux%u", texture->m_Width, texture->m_Height);
+			ImGui::TableNextColumn(); ImGui::Text("%u / %u", texture->m_TexMipLevels, texture->m_FullMipLevels);
+			ImGui::TableNextColumn(); ImGui::TextUnformatted(wVkHelpers::formatBytes(texture->m_Allocation.m_Size).c_str());
+			ImGui::TableNextColumn(); ImGui::Text("%llu frames ago", static_cast<unsigned long long>(currentFrame - std::min(texture->m_LastUsedFrame, currentFrame)));
+		}
+
+		ImGui::EndTable();
+	}
+
+	ImGui::End();
+}
@@ -0,0 +1,72 @@
+#pragma once
+#include <cstdint>
+#include <unordered_set>
+#include <vector>
+
+#include "vulkan/vulkan.h"
+
+#include "wVkConstants.h"
+#include "wVkDeviceAllocator.h"
+
+struct wVkMipChain;
+struct wVkTexture2D;
+
+// Keeps sampled textures under a VRAM cap by dropping their highest resolution mips.
+// Textures are registered by Texture when they have a CPU built mip chain to come back from.
+// Every Update, while the textures (or their heap, per VK_EXT_memory_budget) are over budget, the least recently used
+// texture gets recreated one mip smaller. Textures that are used again get their full chain back once there's room.
+// Both recreate the image and view and bump m_Relocations, the old ones go through the retire queue.
+class wVkResidencyManager
+{
+public:
+	struct Stats
+	{
+		uint64_t m_ResidentBytes = 0;
+		uint64_t m_FullChainBytes = 0; // What everything would take with every mip resident
+		uint32_t m_NumTextures = 0;
+		uint32_t m_NumDemoted = 0;
+		uint64_t m_TotalEvictions = 0;
+		uint64_t m_TotalPromotions = 0;
+		bool m_HeapPressure = false;
+	};
+
+	void Register(wVkTexture2D* texture);
+	void Unregister(wVkTexture2D* texture);
+
+	// Textures move with their Texture, the pointer we hold has to follow
+	void Replace(wVkTexture2D* oldTexture, wVkTexture2D* newTexture);
+
+	// Call whenever the texture is bound for drawing, it's what the LRU order comes from
+	void MarkUsed(wVkTexture2D& texture);
+
+	// Once per frame, after waiting on the frame's fence and before recording
+	void Update();
+
+	// Recreates the texture with mips firstMip and smaller of the chain resident.
+	// Works on any texture, registered or not, the texture streamer grows textures with it.
+	void UploadResidentMips(wVkTexture2D& texture, uint32_t firstMip, const wVkMipChain& chain);
+
+	void SetBudgetBytes(uint64_t budget) { m_BudgetBytes = budget; }
+	uint64_t GetBudgetBytes() const { return m_BudgetBytes; }
+	const Stats& GetStats() const { return m_Stats; }
+
+	void DrawImGuiPanel();
+
+private:
+	bool IsHeapUnderPressure() const;
+	uint64_t GetResidentBytes() const;
+
+	// Recreates the texture without its top resident mip
+	void Demote(wVkTexture2D& texture);
+	// Recreates the texture with its full chain, from the CPU built one
+	void Promote(wVkTexture2D& texture);
+
+	// Swaps the new image in and retires the old one
+	void ReplaceImage(wVkTexture2D& texture, VkImage image, const wVkAllocation& allocation, uint32_t firstResidentMip);
+
+	static uint64_t GetChainBytes(const wVkTexture2D& texture, uint32_t firstMip);
+
+	std::unordered_set<wVkTexture2D*> m_Textures;
+	uint64_t m_BudgetBytes = wVkConstants::g_TextureResidencyBudget;
+	Stats m_Stats;
+};
@@ -0,0 +1,427 @@
+#include "wVkResourceRegistry.h"
+
+#include <algorithm>
+#include <cctype>
+#include <fstream>
+#include <map>
+
+#include "imgui.h"
+
+#include "wVkGlobalVariables.h"
+#include "Utils/ConsoleLogger.h"
+#include "wVkHelpers/wVkMemory.h"
+
+enum RegistryColumn
+{
+	COLUMN_NAME,
+	COLUMN_TYPE,
+	COLUMN_HEAP,
+	COLUMN_MEMORY_TYPE,
+	COLUMN_SIZE,
+	COLUMN_ALLOCATION,
+	COLUMN_WASTE,
+	COLUMN_CALLSITE,
+	COLUMN_COUNT
+};
+
+std::string FormatCallsite(const Callsite& callsite)
+{
+	// Only the file name, full paths make the table unreadable
+	std::string file = callsite.m_File;
+	const size_t slash = file.find_last_of("/\\");
+	if (slash != std::string::npos)
+		file = file.substr(slash + 1);
+
+	return file + ":" + std::to_string(callsite.m_Line);
+}
+
+// "Particle Buffer 2" and "Particle Buffer 0" are the same class of resource
+std::string GetResourceClass(const std::string& name)
+{
+	size_t end = name.size();
+	while (end > 0 && (isdigit(static_cast<unsigned char>(name[end - 1])) || name[end - 1] == ' ' || name[end - 1] == '_'))
+		end--;
+
+	return end == 0 ? name : name.substr(0, end);
+}
+
+std::string EscapeJson(const std::string& text)
+{
+	std::string result;
+	result.reserve(text.size());
+	for (const char c : text)
+	{
+		switch (c)
+		{
+		case '"': result += "\\\""; break;
+		case '\\': result += "\\\\"; break;
+		case '\n': result += "\\n"; break;
+		case '\r': result += "\\r"; break;
+		case '\t': result += "\\t"; break;
+		default:
+			if (static_cast<unsigned char>(c) < 0x20) {
+				char escaped[8];
+				snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+				result += escaped;
+			}
+			else {
+				result += c;
+			}
+		}
+	}
+
+	return result;
+}
+
+uint64_t wVkResourceRegistry::RegisterBuffer(VkBuffer buffer, uint32_t memoryTypeIndex, VkDeviceSize size, wVkResourceType type, const std::string& name, const Callsite& callsite)
+{
+	VkMemoryRequirements requirements;
+	vkGetBufferMemoryRequirements(wVkGlobals::g_Device, buffer, &requirements);
+
+	wVkResourceRecord record;
+	record.m_Name = name;
+	record.m_Type = type;
+	record.m_MemoryTypeIndex = memoryTypeIndex;
+	record.m_Size = size;
+
+	return Register(std::move(record), requirements, callsite);
+}
+
+uint64_t wVkResourceRegistry::RegisterImage(VkImage image, uint32_t memoryTypeIndex, VkDeviceSize size, wVkResourceType type, const std::string& name, const Callsite& callsite)
+{
+	VkMemoryRequirements requirements;
+	vkGetImageMemoryRequirements(wVkGlobals::g_Device, image, &requirements);
+
+	wVkResourceRecord record;
+	record.m_Name = name;
+	record.m_Type = type;
+	record.m_MemoryTypeIndex = memoryTypeIndex;
+	record.m_Size = size;
+
+	return Register(std::move(record), requirements, callsite);
+}
+
+uint64_t wVkResourceRegistry::Register(wVkResourceRecord&& record, const VkMemoryRequirements& requirements, const Callsite& callsite)
+{
+	record.m_MemoryProperties = wVkHelpers::getMemoryTypeProperties(record.m_MemoryTypeIndex, &record.m_HeapIndex);
+	record.m_AllocationSize = requirements.size;
+	record.m_Alignment = requirements.alignment;
+	record.m_Callsite = FormatCallsite(callsite);
+
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	record.m_Id = m_NextId++;
+
+	const uint64_t id = record.m_Id;
+	m_Records.emplace(id, std::move(record));
+
+	return id;
+}
+
+void wVkResourceRegistry::Unregister(uint64_t id)
+{
+	if (id == 0)
+		return;
+
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	const size_t numErased = m_Records.erase(id);
+	ASSERT(numErased == 1, "Unregistering unknown GPU resource %i", static_cast<int>(id));
+}
+
+void wVkResourceRegistry::UpdateImage(uint64_t id, VkImage image, VkDeviceSize size)
+{
+	if (id == 0)
+		return;
+
+	VkMemoryRequirements requirements;
+	vkGetImageMemoryRequirements(wVkGlobals::g_Device, image, &requirements);
+
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	auto it = m_Records.find(id);
+	if (it == m_Records.end())
+		return;
+
+	it->second.m_Size = size;
+	it->second.m_AllocationSize = requirements.size;
+	it->second.m_Alignment = requirements.alignment;
+}
+
+std::string wVkResourceRegistry::GetName(uint64_t id) const
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	auto it = m_Records.find(id);
+	return it != m_Records.end() ? it->second.m_Name : std::string();
+}
+
+std::vector<wVkResourceRecord> wVkResourceRegistry::GetRecords() const
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+
+	std::vector<wVkResourceRecord> records;
+	records.reserve(m_Records.size());
+	for (const auto& [id, record] : m_Records)
+		records.push_back(record);
+
+	// Creation order is the most useful default
+	std::sort(records.begin(), records.end(), [](const wVkResourceRecord& a, const wVkResourceRecord& b) { return a.m_Id < b.m_Id; });
+	return records;
+}
+
+std::vector<wVkHeapUsage> wVkResourceRegistry::GetHeapUsage() const
+{
+	VkPhysicalDeviceMemoryBudgetPropertiesEXT budgetProperties{};
+	budgetProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+
+	VkPhysicalDeviceMemoryProperties2 memProperties2{};
+	memProperties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2;
+	memProperties2.pNext = wVkGlobals::g_DeviceCapabilities.m_MemoryBudget ? &budgetProperties : nullptr;
+	vkGetPhysicalDeviceMemoryProperties2(wVkGlobals::g_PhysicalDevice, &memProperties2);
+
+	const VkPhysicalDeviceMemoryProperties& memProperties = memProperties2.memoryProperties;
+
+	std::vector<wVkHeapUsage> heaps(memProperties.memoryHeapCount);
+	for (uint32_t i = 0; i < memProperties.memoryHeapCount; i++)
+	{
+		heaps[i].m_HeapIndex = i;
+		heaps[i].m_Flags = memProperties.memoryHeaps[i].flags;
+		heaps[i].m_HeapSize = memProperties.memoryHeaps[i].size;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		for (const auto& [id, record] : m_Records)
+		{
+			heaps[record.m_HeapIndex].m_TrackedBytes += record.m_AllocationSize;
+			heaps[record.m_HeapIndex].m_NumResources++;
+		}
+	}
+
+	for (auto& heap : heaps)
+	{
+		if (wVkGlobals::g_DeviceCapabilities.m_MemoryBudget) {
+			heap.m_Usage = budgetProperties.heapUsage[heap.m_HeapIndex];
+			heap.m_Budget = budgetProperties.heapBudget[heap.m_HeapIndex];
+		}
+		else {
+			heap.m_Usage = heap.m_TrackedBytes;
+			heap.m_Budget = heap.m_HeapSize;
+		}
+	}
+
+	return heaps;
+}
+
+uint32_t wVkResourceRegistry::GetNumResources() const
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	return static_cast<uint32_t>(m_Records.size());
+}
+
+bool wVkResourceRegistry::ExportJson(const std::string& path) const
+{
+	std::ofstream file(path);
+	if (!file.is_open()) {
+		LOG_ERROR("Failed to open \"%s\" for the GPU memory dump", path.c_str());
+		return false;
+	}
+
+	const std::vector<wVkHeapUsage> heaps = GetHeapUsage();
+	const std::vector<wVkResourceRecord> records = GetRecords();
+
+	file << "{\n";
+	file << "\t\"memoryBudgetSupported\": " << (wVkGlobals::g_DeviceCapabilities.m_MemoryBudget ? "true" : "false") << ",\n";
+
+	file << "\t\"heaps\": [\n";
+	for (size_t i = 0; i < heaps.size(); i++)
+	{
+		const wVkHeapUsage& heap = heaps[i];
+		file << "\t\t{ \"index\": " << heap.m_HeapIndex
+			<< ", \"deviceLocal\": " << ((heap.m_Flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) ? "true" : "false")
+			<< ", \"size\": " << heap.m_HeapSize
+			<< ", \"tracked\": " << heap.m_TrackedBytes
+			<< ", \"resources\": " << heap.m_NumResources
+			<< ", \"usage\": " << heap.m_Usage
+			<< ", \"budget\": " << heap.m_Budget
+			<< " }" << (i + 1 < heaps.size() ? "," : "") << "\n";
+	}
+	file << "\t],\n";
+
+	file << "\t\"resources\": [\n";
+	for (size_t i = 0; i < records.size(); i++)
+	{
+		const wVkResourceRecord& record = records[i];
+		file << "\t\t{ \"name\": \"" << EscapeJson(record.m_Name) << "\""
+			<< ", \"type\": \"" << GetTypeName(record.m_Type) << "\""
+			<< ", \"memoryType\": " << record.m_MemoryTypeIndex
+			<< ", \"heap\": " << record.m_HeapIndex
+			<< ", \"properties\": \"" << wVkHelpers::memoryPropertiesToString(record.m_MemoryProperties) << "\""
+			<< ", \"size\": " << record.m_Size
+			<< ", \"allocationSize\": " << record.m_AllocationSize
+			<< ", \"alignment\": " << record.m_Alignment
+			<< ", \"alignmentWaste\": " << record.GetAlignmentWaste()
+			<< ", \"callsite\": \"" << EscapeJson(record.m_Callsite) << "\""
+			<< " }" << (i + 1 < records.size() ? "," : "") << "\n";
+	}
+	file << "\t]\n";
+	file << "}\n";
+
+	LOG_INFO("Dumped %i GPU resources to \"%s\"", static_cast<int>(records.size()), path.c_str());
+	return true;
+}
+
+void wVkResourceRegistry::DrawImGuiPanel()
+{
+	ImGui::Begin("GPU Memory");
+
+	const std::vector<wVkHeapUsage> heaps = GetHeapUsage();
+	std::vector<wVkResourceRecord> records = GetRecords();
+
+	if (!wVkGlobals::g_DeviceCapabilities.m_MemoryBudget)
+		ImGui::TextUnformatted("VK_EXT_memory_budget not supported, budgets are the heap sizes");
+
+	// Per heap, the budget bar turns red once we're over it
+	for (const wVkHeapUsage& heap : heaps)
+	{
+		const bool deviceLocal = (heap.m_Flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) != 0;
+		const float fraction = heap.m_Budget != 0 ? static_cast<float>(static_cast<double>(heap.m_Usage) / static_cast<double>(heap.m_Budget)) : 0.0f;
+
+		const std::string overlay = wVkHelpers::formatBytes(heap.m_Usage) + " / " + wVkHelpers::formatBytes(heap.m_Budget);
+		ImGui::Text("Heap %i (%s): %i resources, %s tracked", static_cast<int>(heap.m_HeapIndex), deviceLocal ? "DEVICE_LOCAL" : "HOST",
+			static_cast<int>(heap.m_NumResources), wVkHelpers::formatBytes(heap.m_TrackedBytes).c_str());
+
+		if (fraction > 1.0f)
+			ImGui::PushStyleColor(ImGuiCol_PlotHistogram, ImVec4(0.9f, 0.2f, 0.2f, 1.0f));
+
+		ImGui::ProgressBar(std::min(fraction, 1.0f), ImVec2(-1.0f, 0.0f), overlay.c_str());
+
+		if (fraction > 1.0f)
+			ImGui::PopStyleColor();
+	}
+
+	ImGui::InputText("##ExportPath", m_ExportPath, sizeof(m_ExportPath));
+	ImGui::SameLine();
+	if (ImGui::Button("Export JSON"))
+		m_ExportStatus = ExportJson(m_ExportPath) ? "Exported" : "Export failed";
+
+	if (!m_ExportStatus.empty()) {
+		ImGui::SameLine();
+		ImGui::TextUnformatted(m_ExportStatus.c_str());
+	}
+
+	// Grouping by name tells which kind of resource is eating the budget
+	if (ImGui::CollapsingHeader("By resource class", ImGuiTreeNodeFlags_DefaultOpen))
+	{
+		struct ClassTotal
+		{
+			VkDeviceSize m_Bytes = 0;
+			uint32_t m_Count = 0;
+		};
+
+		std::map<std::string, ClassTotal> classes;
+		for (const wVkResourceRecord& record : records)
+		{
+			ClassTotal& total = classes[GetResourceClass(record.m_Name)];
+			total.m_Bytes += record.m_AllocationSize;
+			total.m_Count++;
+		}
+
+		std::vector<std::pair<std::string, ClassTotal>> sortedClasses(classes.begin(), classes.end());
+		std::sort(sortedClasses.begin(), sortedClasses.end(), [](const auto& a, const auto& b) { return a.second.m_Bytes > b.second.m_Bytes; });
+
+		if (ImGui::BeginTable("GpuResourceClasses", 3, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg | ImGuiTableFlags_SizingFixedFit))
+		{
+			ImGui::TableSetupColumn("Class");
+			ImGui::TableSetupColumn("Count");
+			ImGui::TableSetupColumn("Allocated");
+			ImGui::TableHeadersRow();
+
+			for (const auto& [name, total] : sortedClasses)
+			{
+				ImGui::TableNextRow();
+				ImGui::TableNextColumn(); ImGui::TextUnformatted(name.c_str());
+				ImGui::TableNextColumn(); ImGui::Text("%u", total.m_Count);
+				ImGui::TableNextColumn(); ImGui::TextUnformatted(wVkHelpers::formatBytes(total.m_Bytes).c_str());
+			}
+
+			ImGui::EndTable();
+		}
+	}
+
+	if (ImGui::CollapsingHeader("Resources", ImGuiTreeNodeFlags_DefaultOpen))
+	{
+		const ImGuiTableFlags tableFlags = ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg | ImGuiTableFlags_Sortable | ImGuiTableFlags_Resizable
+			| ImGuiTableFlags_ScrollY | ImGuiTableFlags_SizingFixedFit;
+
+		if (ImGui::BeginTable("GpuResources", COLUMN_COUNT, tableFlags, ImVec2(0.0f, 300.0f)))
+		{
+			ImGui::TableSetupScrollFreeze(0, 1);
+			ImGui::TableSetupColumn("Name", ImGuiTableColumnFlags_DefaultSort, 0.0f, COLUMN_NAME);
+			ImGui::TableSetupColumn("Type", 0, 0.0f, COLUMN_TYPE);
+			ImGui::TableSetupColumn("Heap", 0, 0.0f, COLUMN_HEAP);
+			ImGui::TableSetupColumn("Memory Type", 0, 0.0f, COLUMN_MEMORY_TYPE);
+			ImGui::TableSetupColumn("Size", ImGuiTableColumnFlags_PreferSortDescending, 0.0f, COLUMN_SIZE);
+			ImGui::TableSetupColumn("Allocated", ImGuiTableColumnFlags_PreferSortDescending, 0.0f, COLUMN_ALLOCATION);
+			ImGui::TableSetupColumn("Waste", ImGuiTableColumnFlags_PreferSortDescending, 0.0f, COLUMN_WASTE);
+			ImGui::TableSetupColumn("Callsite", 0, 0.0f, COLUMN_CALLSITE);
+			ImGui::TableHeadersRow();
+
+			// Records change every frame, so sort every frame instead of only when the specs are dirty
+			const ImGuiTableSortSpecs* sortSpecs = ImGui::TableGetSortSpecs();
+			if (sortSpecs != nullptr && sortSpecs->SpecsCount > 0)
+			{
+				const ImGuiTableColumnSortSpecs& spec = sortSpecs->Specs[0];
+				const bool ascending = spec.SortDirection == ImGuiSortDirection_Ascending;
+
+				std::stable_sort(records.begin(), records.end(), [&](const wVkResourceRecord& a, const wVkResourceRecord& b)
+				{
+					int compare = 0;
+					switch (spec.ColumnUserID)
+					{
+					case COLUMN_NAME: compare = a.m_Name.compare(b.m_Name); break;
+					case COLUMN_TYPE: compare = static_cast<int>(a.m_Type) - static_cast<int>(b.m_Type); break;
+					case COLUMN_HEAP: compare = static_cast<int>(a.m_HeapIndex) - static_cast<int>(b.m_HeapIndex); break;
+					case COLUMN_MEMORY_TYPE: compare = static_cast<int>(a.m_MemoryTypeIndex) - static_cast<int>(b.m_MemoryTypeIndex); break;
+					case COLUMN_SIZE: compare = (a.m_Size > b.m_Size) - (a.m_Size < b.m_Size); break;
+					case COLUMN_ALLOCATION: compare = (a.m_AllocationSize > b.m_AllocationSize) - (a.m_AllocationSize < b.m_AllocationSize); break;
+					case COLUMN_WASTE: compare = (a.GetAlignmentWaste() > b.GetAlignmentWaste()) - (a.GetAlignmentWaste() < b.GetAlignmentWaste()); break;
+					case COLUMN_CALLSITE: compare = a.m_Callsite.compare(b.m_Callsite); break;
+					default: break;
+					}
+
+					return ascending ? compare < 0 : compare > 0;
+				});
+			}
+
+			for (const wVkResourceRecord& record : records)
+			{
+				ImGui::TableNextRow();
+				ImGui::TableNextColumn(); ImGui::TextUnformatted(record.m_Name.c_str());
+				ImGui::TableNextColumn(); ImGui::TextUnformatted(GetTypeName(record.m_Type));
+				ImGui::TableNextColumn(); ImGui::Text("%u", record.m_HeapIndex);
+				ImGui::TableNextColumn(); ImGui::Text("%u", record.m_MemoryTypeIndex);
+				if (ImGui::IsItemHovered())
+					ImGui::SetTooltip("%s", wVkHelpers::memoryPropertiesToString(record.m_MemoryProperties).c_str());
+				ImGui::TableNextColumn(); ImGui::TextUnformatted(wVkHelpers::formatBytes(record.m_Size).c_str());
+				ImGui::TableNextColumn(); ImGui::TextUnformatted(wVkHelpers::formatBytes(record.m_AllocationSize).c_str());
+				ImGui::TableNextColumn(); ImGui::TextUnformatted(wVkHelpers::formatBytes(record.GetAlignmentWaste()).c_str());
+				ImGui::TableNextColumn(); ImGui::TextUnformatted(record.m_Callsite.c_str());
+			}
+
+			ImGui::EndTable();
+		}
+	}
+
+	ImGui::End();
+}
+
+const char* wVkResourceRegistry::GetTypeName(wVkResourceType type)
+{
+	switch (type)
+	{
+	case wVkResourceType::BUFFER: return "Buffer";
+	case wVkResourceType::TEXTURE: return "Texture";
+	case wVkResourceType::TRANSIENT: return "Transient";
+	case wVkResourceType::STAGING: return "Staging";
+	}
+
+	return "Unknown";
+}
@@ -0,0 +1,84 @@
+#pragma once
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "vulkan/vulkan.h"
+
+#include "BEARHeaders/Callsite.h"
+
+enum class wVkResourceType
+{
+	BUFFER,
+	TEXTURE,
+	TRANSIENT, // Render graph attachments, one record per allocation however many share it
+	STAGING,
+};
+
+struct wVkResourceRecord
+{
+	uint64_t m_Id = 0;
+	std::string m_Name;
+	wVkResourceType m_Type = wVkResourceType::BUFFER;
+	uint32_t m_MemoryTypeIndex = UINT32_MAX;
+	uint32_t m_HeapIndex = UINT32_MAX;
+	VkMemoryPropertyFlags m_MemoryProperties = 0;
+	VkDeviceSize m_Size = 0; // What the resource asked for
+	VkDeviceSize m_AllocationSize = 0; // What the driver made us allocate for it
+	VkDeviceSize m_Alignment = 0;
+	std::string m_Callsite;
+
+	VkDeviceSize GetAlignmentWaste() const { return m_AllocationSize > m_Size ? m_AllocationSize - m_Size : 0; }
+};
+
+struct wVkHeapUsage
+{
+	uint32_t m_HeapIndex = 0;
+	VkMemoryHeapFlags m_Flags = 0;
+	VkDeviceSize m_HeapSize = 0;
+	VkDeviceSize m_TrackedBytes = 0; // Allocations of registered resources
+	uint32_t m_NumResources = 0;
+
+	// From VK_EXT_memory_budget, the whole process (and the driver) counts towards the usage.
+	// Without the extension the usage is what we tracked and the budget is the heap size.
+	VkDeviceSize m_Usage = 0;
+	VkDeviceSize m_Budget = 0;
+};
+
+// Every GPU allocation the renderer makes, by name.
+// Buffers and Textures register themselves on creation and unregister once their memory is actually freed,
+// so retired resources keep counting until the retire queue lets go of them.
+class wVkResourceRegistry
+{
+public:
+	// The memory requirements are queried from the object, returns the id to unregister with
+	uint64_t RegisterBuffer(VkBuffer buffer, uint32_t memoryTypeIndex, VkDeviceSize size, wVkResourceType type, const std::string& name, const Callsite& callsite);
+	uint64_t RegisterImage(VkImage image, uint32_t memoryTypeIndex, VkDeviceSize size, wVkResourceType type, const std::string& name, const Callsite& callsite);
+	void Unregister(uint64_t id);
+
+	// The resource was recreated with a different size (mip residency changes), the record keeps its name and callsite
+	void UpdateImage(uint64_t id, VkImage image, VkDeviceSize size);
+	std::string GetName(uint64_t id) const;
+
+	std::vector<wVkResourceRecord> GetRecords() const;
+	std::vector<wVkHeapUsage> GetHeapUsage() const;
+	uint32_t GetNumResources() const;
+
+	bool ExportJson(const std::string& path) const;
+
+	void DrawImGuiPanel();
+
+	static const char* GetTypeName(wVkResourceType type);
+
+private:
+	uint64_t Register(wVkResourceRecord&& record, const VkMemoryRequirements& requirements, const Callsite& callsite);
+
+	mutable std::mutex m_Mutex;
+	std::unordered_map<uint64_t, wVkResourceRecord> m_Records;
+	uint64_t m_NextId = 1;
+
+	char m_ExportPath[260] = "gpu_memory.json";
+	std::string m_ExportStatus;
+};
@@ -0,0 +1,53 @@
+#include "wVkRetireQueue.h"
+
+
+void wVkRetireQueue::Retire(std::function<void()>&& destroyFn)
+{
+	auto& list = m_RetireLists[m_CurrentFrame % wVkConstants::g_MaxFramesInFlight];
+	list.push_back({ m_CurrentFrame, std::move(destroyFn) });
+}
+
+void wVkRetireQueue::AdvanceFrame()
+{
+	m_CurrentFrame++;
+}
+
+void wVkRetireQueue::Collect(uint64_t completedFrame)
+{
+	for (auto& list : m_RetireLists)
+	{
+		// A list can hold objects from more than one frame if Collect wasn't called for a while
+		size_t numKept = 0;
+		for (size_t i = 0; i < list.size(); i++)
+		{
+			if (list[i].m_Frame <= completedFrame)
+				list[i].m_DestroyFn();
+			else if (i != numKept)
+				list[numKept++] = std::move(list[i]);
+			else
+				numKept++;
+		}
+
+		list.resize(numKept);
+	}
+}
+
+void wVkRetireQueue::Flush()
+{
+	for (auto& list : m_RetireLists)
+	{
+		for (auto& retired : list)
+			retired.m_DestroyFn();
+
+		list.clear();
+	}
+}
+
+uint32_t wVkRetireQueue::GetNumPending() const
+{
+	uint32_t numPending = 0;
+	for (const auto& list : m_RetireLists)
+		numPending += static_cast<uint32_t>(list.size());
+
+	return numPending;
+}
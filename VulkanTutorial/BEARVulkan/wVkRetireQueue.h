@@ -0,0 +1,41 @@
+#pragma once
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include "vulkan/vulkan.h"
+
+#include "wVkConstants.h"
+
+// Deferred destruction of Vulkan objects.
+// Anything that might still be referenced by a frame in flight gets retired here instead of
+// being destroyed on the spot. It's destroyed once the frame it was retired in has been
+// waited on, which is at most g_MaxFramesInFlight frames later.
+class wVkRetireQueue
+{
+public:
+	// Queue a destroy function for the current frame
+	void Retire(std::function<void()>&& destroyFn);
+
+	// Called once at the end of every frame
+	void AdvanceFrame();
+
+	// Destroys everything retired in (or before) completedFrame
+	void Collect(uint64_t completedFrame);
+
+	// Destroys everything. Only call once the GPU is idle.
+	void Flush();
+
+	uint64_t GetCurrentFrame() const { return m_CurrentFrame; }
+	uint32_t GetNumPending() const;
+
+private:
+	struct RetiredObject
+	{
+		uint64_t m_Frame = 0;
+		std::function<void()> m_DestroyFn;
+	};
+
+	std::vector<RetiredObject> m_RetireLists[wVkConstants::g_MaxFramesInFlight];
+	uint64_t m_CurrentFrame = 0;
+};
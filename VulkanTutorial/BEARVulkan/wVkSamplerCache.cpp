@@ -0,0 +1,197 @@
+#include "wVkSamplerCache.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+#include "BEARHeaders/Sampler.h"
+#include "wVkGlobalVariables.h"
+#include "Utils/ConsoleLogger.h"
+
+bool wVkSamplerCache::Key::operator==(const Key& other) const
+{
+	return m_MinFilter == other.m_MinFilter && m_MagFilter == other.m_MagFilter && m_MipmapMode == other.m_MipmapMode
+		&& m_AddressMode == other.m_AddressMode && m_MaxAnisotropy == other.m_MaxAnisotropy && m_MipLodBias == other.m_MipLodBias
+		&& m_MinLod == other.m_MinLod && m_MaxLod == other.m_MaxLod;
+}
+
+size_t wVkSamplerCache::KeyHash::operator()(const Key& key) const
+{
+	// FNV-1a over the fields, same as the mip and bake caches
+	constexpr uint64_t prime = 0x100000001B3ull;
+	uint64_t hash = 0xCBF29CE484222325ull;
+	auto mix = [&hash](uint64_t value) { hash = (hash ^ value) * prime; };
+	auto bits = [](float value) { uint32_t result; memcpy(&result, &value, sizeof(result)); return result; };
+
+	mix(key.m_MinFilter);
+	mix(key.m_MagFilter);
+	mix(key.m_MipmapMode);
+	mix(key.m_AddressMode);
+	mix(bits(key.m_MaxAnisotropy));
+	mix(bits(key.m_MipLodBias));
+	mix(bits(key.m_MinLod));
+	mix(bits(key.m_MaxLod));
+
+	return static_cast<size_t>(hash);
+}
+
+wVkSamplerCache::Key wVkSamplerCache::MakeKey(const SamplerState& state) const
+{
+	Key key;
+
+	switch (state.MinFilter) {
+	case MinFilter::NEAREST:
+	case MinFilter::NEAREST_MIPMAP_NEAREST:
+		key.m_MinFilter = VK_FILTER_NEAREST;
+		key.m_MipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+		break;
+	case MinFilter::LINEAR:
+	case MinFilter::LINEAR_MIPMAP_NEAREST:
+		key.m_MinFilter = VK_FILTER_LINEAR;
+		key.m_MipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+		break;
+	case MinFilter::NEAREST_MIPMAP_LINEAR:
+		key.m_MinFilter = VK_FILTER_NEAREST;
+		key.m_MipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+		break;
+	case MinFilter::LINEAR_MIPMAP_LINEAR:
+		key.m_MinFilter = VK_FILTER_LINEAR;
+		key.m_MipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+		break;
+	default:
+		ASSERT(false, "Min Filter case not implemented");
+	}
+
+	switch (state.MagFilter) {
+	case MagFilter::NEAREST:
+		key.m_MagFilter = VK_FILTER_NEAREST;
+		break;
+	case MagFilter::LINEAR:
+		key.m_MagFilter = VK_FILTER_LINEAR;
+		break;
+	default:
+		ASSERT(false, "Mag Filter case not implemented");
+	}
+
+	switch (state.WrapUV) {
+	case WrapUV::CLAMP_TO_EDGE:
+		key.m_AddressMode = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		break;
+	case WrapUV::MIRRORED_REPEAT:
+		key.m_AddressMode = VK_SAMPLER_ADDRESS_MODE_MIRRORED_REPEAT;
+		break;
+	case WrapUV::REPEAT:
+		key.m_AddressMode = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+		break;
+	default:
+		ASSERT(false, "Wrap UV case not implemented");
+	}
+
+	key.m_MaxAnisotropy = std::clamp(state.MaxAnisotropy, 1.0f, m_MaxDeviceAnisotropy);
+	key.m_MipLodBias = state.MipLodBias;
+	key.m_MinLod = state.MinLod;
+	key.m_MaxLod = std::max(state.MaxLod, state.MinLod);
+
+	return key;
+}
+
+VkSampler wVkSamplerCache::Acquire(const SamplerState& state)
+{
+	ASSERT(state.valid, "Can't create a sampler from an empty SamplerState");
+
+	std::lock_guard<std::mutex> lock(m_Mutex);
+
+	if (m_MaxSamplers == 0) {
+		VkPhysicalDeviceProperties properties{};
+		vkGetPhysicalDeviceProperties(wVkGlobals::g_PhysicalDevice, &properties);
+		// The feature is only enabled on devices that have it, without it every sampler is created with anisotropy off
+		m_MaxDeviceAnisotropy = wVkGlobals::g_DeviceCapabilities.m_SamplerAnisotropy ? std::max(properties.limits.maxSamplerAnisotropy, 1.0f) : 1.0f;
+		m_MaxSamplers = properties.limits.maxSamplerAllocationCount;
+	}
+
+	const Key key = MakeKey(state);
+	m_Stats.m_NumReferences++;
+
+	auto found = m_Samplers.find(key);
+	if (found != m_Samplers.end()) {
+		found->second.m_References++;
+		m_Stats.m_NumShared++;
+		return found->second.m_Sampler;
+	}
+
+	ASSERT(m_Samplers.size() < m_MaxSamplers, "%i distinct sampler states, the device allows %i samplers", static_cast<int>(m_Samplers.size()), static_cast<int>(m_MaxSamplers));
+
+	VkSamplerCreateInfo samplerInfo{};
+	samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+	samplerInfo.magFilter = key.m_MagFilter;
+	samplerInfo.minFilter = key.m_MinFilter;
+	samplerInfo.addressModeU = key.m_AddressMode;
+	samplerInfo.addressModeV = key.m_AddressMode;
+	samplerInfo.addressModeW = key.m_AddressMode;
+	samplerInfo.mipmapMode = key.m_MipmapMode;
+	samplerInfo.anisotropyEnable = key.m_MaxAnisotropy > 1.0f ? VK_TRUE : VK_FALSE;
+	samplerInfo.maxAnisotropy = key.m_MaxAnisotropy;
+	samplerInfo.borderColor = VK_BORDER_COLOR_INT_OPAQUE_BLACK;
+	samplerInfo.unnormalizedCoordinates = VK_FALSE;
+	samplerInfo.compareEnable = VK_FALSE;
+	samplerInfo.compareOp = VK_COMPARE_OP_ALWAYS;
+	samplerInfo.mipLodBias = key.m_MipLodBias;
+	samplerInfo.minLod = key.m_MinLod;
+	samplerInfo.maxLod = key.m_MaxLod;
+
+	VkSampler sampler;
+	if (vkCreateSampler(wVkGlobals::g_Device, &samplerInfo, wVkGlobals::g_AllocationCallbacks, &sampler) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create texture sampler!");
+	}
+
+	m_Samplers[key] = { sampler, 1 };
+	m_Keys[sampler] = key;
+	m_Stats.m_NumCreated++;
+	m_Stats.m_NumSamplers = static_cast<uint32_t>(m_Samplers.size());
+
+	return sampler;
+}
+
+void wVkSamplerCache::Release(VkSampler sampler)
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+
+	auto key = m_Keys.find(sampler);
+	ASSERT(key != m_Keys.end(), "Releasing a sampler that didn't come from the cache");
+
+	auto entry = m_Samplers.find(key->second);
+	m_Stats.m_NumReferences--;
+	if (--entry->second.m_References > 0)
+		return;
+
+	// Frames in flight may still sample with it
+	wVkGlobals::g_RetireQueue.Retire([sampler]()
+	{
+		vkDestroySampler(wVkGlobals::g_Device, sampler, wVkGlobals::g_AllocationCallbacks);
+	});
+
+	m_Samplers.erase(entry);
+	m_Keys.erase(key);
+	m_Stats.m_NumSamplers = static_cast<uint32_t>(m_Samplers.size());
+}
+
+void wVkSamplerCache::Destroy()
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+
+	if (!m_Samplers.empty())
+		LOG_WARNING("%i samplers still referenced at shutdown", static_cast<int>(m_Samplers.size()));
+
+	for (const auto& [key, entry] : m_Samplers)
+		vkDestroySampler(wVkGlobals::g_Device, entry.m_Sampler, wVkGlobals::g_AllocationCallbacks);
+
+	m_Samplers.clear();
+	m_Keys.clear();
+	m_Stats = {};
+}
+
+wVkSamplerCache::Stats wVkSamplerCache::GetStats()
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	return m_Stats;
+}
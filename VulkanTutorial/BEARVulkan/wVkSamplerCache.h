@@ -0,0 +1,73 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+
+#include "vulkan/vulkan.h"
+
+struct SamplerState;
+
+// Every Sampler's VkSampler comes from here, one per distinct state, shared and reference counted.
+// The key is the resolved create info, so states that end up the same on this device (NEAREST and
+// NEAREST_MIPMAP_NEAREST, anisotropy beyond what it supports) share a sampler too.
+// Drivers only guarantee maxSamplerAllocationCount (4000) samplers at once, with the cache that's a limit on distinct
+// states rather than on Sampler objects.
+class wVkSamplerCache
+{
+public:
+	struct Stats
+	{
+		uint32_t m_NumSamplers = 0; // Alive right now
+		uint64_t m_NumReferences = 0;
+		uint64_t m_NumCreated = 0;
+		uint64_t m_NumShared = 0; // Acquires that got an existing sampler
+	};
+
+	// Adds a reference, the first one creates the sampler
+	VkSampler Acquire(const SamplerState& state);
+	// Drops a reference, the last one retires the sampler
+	void Release(VkSampler sampler);
+
+	// Anything still referenced is a leak, it's reported and destroyed. Call once the retire queue has been flushed.
+	void Destroy();
+
+	Stats GetStats();
+
+private:
+	struct Key
+	{
+		VkFilter m_MinFilter = VK_FILTER_NEAREST;
+		VkFilter m_MagFilter = VK_FILTER_NEAREST;
+		VkSamplerMipmapMode m_MipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+		VkSamplerAddressMode m_AddressMode = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+		float m_MaxAnisotropy = 1.0f; // 1 is off
+		float m_MipLodBias = 0.0f;
+		float m_MinLod = 0.0f;
+		float m_MaxLod = 0.0f;
+
+		bool operator==(const Key& other) const;
+	};
+
+	struct KeyHash
+	{
+		size_t operator()(const Key& key) const;
+	};
+
+	struct Entry
+	{
+		VkSampler m_Sampler = VK_NULL_HANDLE;
+		uint32_t m_References = 0;
+	};
+
+	Key MakeKey(const SamplerState& state) const;
+
+	std::mutex m_Mutex;
+	std::unordered_map<Key, Entry, KeyHash> m_Samplers; // Guarded by m_Mutex
+	std::unordered_map<VkSampler, Key> m_Keys; // Guarded by m_Mutex
+	Stats m_Stats; // Guarded by m_Mutex
+
+	// Queried on the first Acquire, the device doesn't exist yet when the cache is constructed
+	float m_MaxDeviceAnisotropy = 0.0f;
+	uint32_t m_MaxSamplers = 0;
+};
@@ -0,0 +1,226 @@
+#include "wVkTextureAtlas.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+// imgui_draw.cpp compiles its copy of the packer static, this one is ours
+#define STBRP_STATIC
+#define STB_RECT_PACK_IMPLEMENTATION
+#include "imstb_rectpack.h"
+
+#include "wVkGlobalVariables.h"
+#include "wVkMipBuilder.h"
+#include "Utils/ConsoleLogger.h"
+#include "wVkHelpers/wVkHelpers.h"
+#include "wVkHelpers/wVkMipmaps.h"
+#include "wVkHelpers/wVkTemp.h"
+#include "wVkHelpers/wVkTexture.h"
+
+// Space a sub-texture takes in a layer, gutter and alignment included
+struct AtlasCell
+{
+	uint32_t m_Layer = 0;
+	uint32_t m_X = 0;
+	uint32_t m_Y = 0;
+	uint32_t m_Width = 0;
+	uint32_t m_Height = 0;
+};
+
+wVkTextureAtlas::~wVkTextureAtlas()
+{
+	Destroy();
+}
+
+uint32_t wVkTextureAtlas::Add(const uint8_t* rgba, uint32_t width, uint32_t height)
+{
+	ASSERT(m_Image == VK_NULL_HANDLE, "Textures can't be added to an atlas that's been built");
+	ASSERT(width > 0 && height > 0, "Atlas textures can't be empty");
+
+	PendingTexture texture;
+	texture.m_Texels.assign(rgba, rgba + static_cast<size_t>(width) * height * wVkMipChain::BYTES_PER_PIXEL);
+	texture.m_Width = width;
+	texture.m_Height = height;
+	m_Pending.push_back(std::move(texture));
+
+	return static_cast<uint32_t>(m_Pending.size() - 1);
+}
+
+void wVkTextureAtlas::Build(const std::string& name, uint32_t layerSize, uint32_t padding, bool srgb, const Callsite& callsite)
+{
+	ASSERT(m_Image == VK_NULL_HANDLE, "Atlas %s has already been built", name.c_str());
+	ASSERT(!m_Pending.empty(), "Atlas %s has nothing in it", name.c_str());
+
+	// The gutter halves every mip, the chain ends at the last one where it's still a texel wide
+	const uint32_t maxMips = wVkHelpers::getMipLevelCount(layerSize, layerSize);
+	uint32_t mips = 1;
+	while ((padding >> mips) > 0 && mips < maxMips)
+		mips++;
+
+	// Cells start and end on whole texels of the smallest mip, packing in those units keeps them there
+	const uint32_t unit = 1u << (mips - 1);
+	ASSERT(layerSize % unit == 0, "Atlas %s layers of %i texels can't be split in cells of %i", name.c_str(), static_cast<int>(layerSize), static_cast<int>(unit));
+	const int gridSize = static_cast<int>(layerSize / unit);
+
+	std::vector<stbrp_rect> remaining(m_Pending.size());
+	for (size_t i = 0; i < m_Pending.size(); i++) {
+		const PendingTexture& texture = m_Pending[i];
+		stbrp_rect& rect = remaining[i];
+		rect = {};
+		rect.id = static_cast<int>(i);
+		rect.w = static_cast<int>((texture.m_Width + 2 * padding + unit - 1) / unit);
+		rect.h = static_cast<int>((texture.m_Height + 2 * padding + unit - 1) / unit);
+		ASSERT(rect.w <= gridSize && rect.h <= gridSize, "Texture %i of atlas %s doesn't fit in a layer with its gutter", static_cast<int>(i), name.c_str());
+	}
+
+	// A layer at a time, whatever didn't fit goes to the next. Every rect fits an empty layer, so each pass places some.
+	std::vector<AtlasCell> cells(m_Pending.size());
+	std::vector<stbrp_node> nodes(static_cast<size_t>(gridSize));
+	uint32_t numLayers = 0;
+
+	while (!remaining.empty()) {
+		stbrp_context context;
+		stbrp_init_target(&context, gridSize, gridSize, nodes.data(), gridSize);
+		stbrp_pack_rects(&context, remaining.data(), static_cast<int>(remaining.size()));
+
+		std::vector<stbrp_rect> unpacked;
+		for (const stbrp_rect& rect : remaining) {
+			if (!rect.was_packed) {
+				unpacked.push_back(rect);
+				continue;
+			}
+
+			cells[rect.id] = { numLayers, rect.x * unit, rect.y * unit, rect.w * unit, rect.h * unit };
+		}
+
+		remaining.swap(unpacked);
+		numLayers++;
+	}
+
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(wVkGlobals::g_PhysicalDevice, &properties);
+	ASSERT(numLayers <= properties.limits.maxImageArrayLayers, "Atlas %s needs %i layers, the device allows %i", name.c_str(), static_cast<int>(numLayers), static_cast<int>(properties.limits.maxImageArrayLayers));
+
+	const VkFormat format = srgb ? VK_FORMAT_R8G8B8A8_SRGB : VK_FORMAT_R8G8B8A8_UNORM;
+	m_Image = wVkHelpers::createImage2DObject(layerSize, layerSize, mips, format, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT, numLayers);
+
+	VkMemoryRequirements memRequirements;
+	vkGetImageMemoryRequirements(wVkGlobals::g_Device, m_Image, &memRequirements);
+
+	// Pinned, neither the defragmenter nor the residency manager know about array images
+	const uint32_t memoryType = wVkHelpers::findMemoryType(memRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+	m_Allocation = wVkGlobals::g_DeviceAllocator.Allocate(memRequirements, memoryType, wVkAllocationKind::OPTIMAL, {});
+	vkBindImageMemory(wVkGlobals::g_Device, m_Image, m_Allocation.m_Memory, m_Allocation.m_Offset);
+
+	uint64_t layerBytes = 0;
+	for (uint32_t mip = 0; mip < mips; mip++)
+		layerBytes += static_cast<uint64_t>(std::max(layerSize >> mip, 1u)) * std::max(layerSize >> mip, 1u) * wVkMipChain::BYTES_PER_PIXEL;
+	m_RegistryId = wVkGlobals::g_ResourceRegistry.RegisterImage(m_Image, memoryType, layerBytes * numLayers, wVkResourceType::TEXTURE, name, callsite);
+
+	VkCommandBuffer commandBuffer = wVkHelpers::beginSingleTimeCommand();
+	wVkHelpers::recordImageBarrier(commandBuffer, m_Image, 0, mips, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+		0, VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, numLayers);
+	wVkHelpers::endSingleTimeCommand(commandBuffer);
+
+	// Space no cell took stays transparent black
+	std::vector<uint8_t> layer(static_cast<size_t>(layerSize) * layerSize * wVkMipChain::BYTES_PER_PIXEL);
+	wVkMipChain chain;
+
+	for (uint32_t layerIndex = 0; layerIndex < numLayers; layerIndex++) {
+		std::fill(layer.begin(), layer.end(), static_cast<uint8_t>(0));
+		for (size_t i = 0; i < cells.size(); i++) {
+			const AtlasCell& cell = cells[i];
+			if (cell.m_Layer == layerIndex)
+				FillCell(layer, layerSize, m_Pending[i], cell.m_X, cell.m_Y, cell.m_Width, cell.m_Height, padding);
+		}
+
+		// The builder goes down to 1x1, only the mips that still have gutters are kept
+		const std::shared_ptr<const wVkMipChain> fullChain = wVkGlobals::g_MipBuilder.Build(layer.data(), layerSize, layerSize, srgb);
+		chain.Allocate(layerSize, layerSize, srgb, mips);
+		memcpy(chain.m_Data.data(), fullChain->GetLevel(0), chain.m_Data.size());
+
+		wVkGlobals::g_UploadContext.UploadMipChain(m_Image, chain, 0, layerIndex);
+	}
+
+	commandBuffer = wVkHelpers::beginSingleTimeCommand();
+	wVkHelpers::recordImageBarrier(commandBuffer, m_Image, 0, mips, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+		VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, numLayers);
+	wVkHelpers::endSingleTimeCommand(commandBuffer);
+
+	m_ImageView = wVkHelpers::createImageArrayView(m_Image, mips, numLayers, format);
+
+	m_Stats = {};
+	m_Entries.resize(m_Pending.size());
+	for (size_t i = 0; i < m_Pending.size(); i++) {
+		const AtlasCell& cell = cells[i];
+		wVkAtlasEntry& entry = m_Entries[i];
+		entry.m_Layer = cell.m_Layer;
+		entry.m_X = cell.m_X + padding;
+		entry.m_Y = cell.m_Y + padding;
+		entry.m_Width = m_Pending[i].m_Width;
+		entry.m_Height = m_Pending[i].m_Height;
+		entry.m_UvScale[0] = static_cast<float>(entry.m_Width) / static_cast<float>(layerSize);
+		entry.m_UvScale[1] = static_cast<float>(entry.m_Height) / static_cast<float>(layerSize);
+		entry.m_UvOffset[0] = static_cast<float>(entry.m_X) / static_cast<float>(layerSize);
+		entry.m_UvOffset[1] = static_cast<float>(entry.m_Y) / static_cast<float>(layerSize);
+
+		m_Stats.m_EntryTexels += static_cast<uint64_t>(entry.m_Width) * entry.m_Height;
+	}
+
+	m_Stats.m_NumEntries = static_cast<uint32_t>(m_Entries.size());
+	m_Stats.m_NumLayers = numLayers;
+	m_Stats.m_NumMips = mips;
+	m_Stats.m_LayerTexels = static_cast<uint64_t>(layerSize) * layerSize * numLayers;
+	m_Pending.clear();
+
+	LOG_INFO("Atlas %s: %i textures in %i layers of %i, %i mips, %f of the texels used", name.c_str(), static_cast<int>(m_Stats.m_NumEntries), static_cast<int>(numLayers),
+		static_cast<int>(layerSize), static_cast<int>(mips), static_cast<double>(m_Stats.m_EntryTexels) / static_cast<double>(m_Stats.m_LayerTexels));
+}
+
+void wVkTextureAtlas::Destroy()
+{
+	m_Pending.clear();
+	m_Entries.clear();
+	m_Stats = {};
+
+	if (m_Image == VK_NULL_HANDLE)
+		return;
+
+	wVkGlobals::g_RetireQueue.Retire([view = m_ImageView, image = m_Image, allocation = m_Allocation, registryId = m_RegistryId]()
+	{
+		vkDestroyImageView(wVkGlobals::g_Device, view, wVkGlobals::g_AllocationCallbacks);
+		vkDestroyImage(wVkGlobals::g_Device, image, wVkGlobals::g_AllocationCallbacks);
+		wVkGlobals::g_DeviceAllocator.Free(allocation);
+		wVkGlobals::g_ResourceRegistry.Unregister(registryId);
+	});
+
+	m_Image = VK_NULL_HANDLE;
+	m_ImageView = VK_NULL_HANDLE;
+	m_Allocation = {};
+	m_RegistryId = 0;
+}
+
+void wVkTextureAtlas::FillCell(std::vector<uint8_t>& layer, uint32_t layerSize, const PendingTexture& texture, uint32_t cellX, uint32_t cellY, uint32_t cellWidth, uint32_t cellHeight, uint32_t padding)
+{
+	constexpr uint32_t bytesPerPixel = wVkMipChain::BYTES_PER_PIXEL;
+	const size_t rowBytes = static_cast<size_t>(texture.m_Width) * bytesPerPixel;
+
+	// Cells are rounded up, there's padding or more on the right and bottom
+	const uint32_t right = cellWidth - padding - texture.m_Width;
+
+	for (uint32_t y = 0; y < cellHeight; y++) {
+		const uint32_t sourceY = static_cast<uint32_t>(std::clamp(static_cast<int64_t>(y) - padding, int64_t(0), static_cast<int64_t>(texture.m_Height) - 1));
+		const uint8_t* source = texture.m_Texels.data() + rowBytes * sourceY;
+		uint8_t* destination = layer.data() + (static_cast<size_t>(cellY + y) * layerSize + cellX) * bytesPerPixel;
+
+		for (uint32_t x = 0; x < padding; x++, destination += bytesPerPixel)
+			memcpy(destination, source, bytesPerPixel);
+
+		memcpy(destination, source, rowBytes);
+		destination += rowBytes;
+
+		const uint8_t* last = source + rowBytes - bytesPerPixel;
+		for (uint32_t x = 0; x < right; x++, destination += bytesPerPixel)
+			memcpy(destination, last, bytesPerPixel);
+	}
+}
@@ -0,0 +1,80 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "vulkan/vulkan.h"
+
+#include "BEARHeaders/Callsite.h"
+#include "wVkDeviceAllocator.h"
+
+// Where a sub-texture ended up, sample it at (uv * m_UvScale + m_UvOffset, m_Layer).
+// UVs have to stay in [0, 1], sub-textures can't repeat on their own.
+struct wVkAtlasEntry
+{
+	float m_UvScale[2] = { 1.0f, 1.0f };
+	float m_UvOffset[2] = { 0.0f, 0.0f };
+	uint32_t m_Layer = 0;
+
+	// Texels of the sub-texture in its layer, without the gutter
+	uint32_t m_X = 0;
+	uint32_t m_Y = 0;
+	uint32_t m_Width = 0;
+	uint32_t m_Height = 0;
+};
+
+// Packs many small RGBA8 textures into the layers of one 2D array image (imstb_rectpack), so all of them are a
+// single descriptor instead of an image and a descriptor each.
+// Every sub-texture gets a gutter of its own edge texels around it, padding texels wide at mip 0. Sub-textures are
+// placed on multiples of the largest mip's texel size and the chain stops at the last mip that still has a texel of
+// gutter, so filtering never reaches into a neighbour.
+// Built once and read only after that, nothing can be added to an atlas that's been built.
+class wVkTextureAtlas
+{
+public:
+	struct Stats
+	{
+		uint32_t m_NumEntries = 0;
+		uint32_t m_NumLayers = 0;
+		uint32_t m_NumMips = 0;
+		uint64_t m_EntryTexels = 0; // Without gutters
+		uint64_t m_LayerTexels = 0; // All layers at mip 0
+	};
+
+	~wVkTextureAtlas();
+
+	// Texels are copied, returns the index of the entry once the atlas is built
+	uint32_t Add(const uint8_t* rgba, uint32_t width, uint32_t height);
+
+	// Every sub-texture has to fit in a layer with its gutter. Mips are built on the CPU like Texture's.
+	void Build(const std::string& name, uint32_t layerSize, uint32_t padding, bool srgb, const Callsite& callsite = Callsite::Current());
+
+	// Retires the image, the atlas can be filled and built again after
+	void Destroy();
+
+	const wVkAtlasEntry& GetEntry(uint32_t index) const { return m_Entries[index]; }
+	VkImageView GetImageView() const { return m_ImageView; }
+	VkImage GetImage() const { return m_Image; }
+	const Stats& GetStats() const { return m_Stats; }
+
+private:
+	struct PendingTexture
+	{
+		std::vector<uint8_t> m_Texels;
+		uint32_t m_Width = 0;
+		uint32_t m_Height = 0;
+	};
+
+	// Copies a sub-texture into its cell of the layer and clamps its edges out to the border of the cell
+	static void FillCell(std::vector<uint8_t>& layer, uint32_t layerSize, const PendingTexture& texture, uint32_t cellX, uint32_t cellY, uint32_t cellWidth, uint32_t cellHeight, uint32_t padding);
+
+	std::vector<PendingTexture> m_Pending;
+	std::vector<wVkAtlasEntry> m_Entries;
+
+	VkImage m_Image = VK_NULL_HANDLE;
+	VkImageView m_ImageView = VK_NULL_HANDLE;
+	wVkAllocation m_Allocation;
+	uint64_t m_RegistryId = 0;
+
+	Stats m_Stats;
+};
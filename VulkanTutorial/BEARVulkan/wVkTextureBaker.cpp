@@ -0,0 +1,332 @@
+#include "wVkTextureBaker.h"
+
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "stb/stb_image.h"
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include "stb/stb_image_write.h"
+
+#include "wVkConstants.h"
+#include "Utils/ConsoleLogger.h"
+#include "wVkHelpers/wVkFormats.h"
+
+// At the start of every baked texture, followed by a BakedLevel per level
+struct BakedHeader
+{
+	uint32_t m_Magic = 0;
+	uint32_t m_Version = 0;
+	uint64_t m_Key = 0;
+	uint32_t m_Format = 0; // VkFormat
+	uint32_t m_Width = 0;
+	uint32_t m_Height = 0;
+	uint32_t m_NumLevels = 0;
+	uint32_t m_Srgb = 0;
+	uint32_t m_Supercompression = 0;
+};
+
+struct BakedLevel
+{
+	uint64_t m_Offset = 0; // From the start of the file
+	uint64_t m_StoredSize = 0; // Same as the level size when it's stored as is
+};
+
+constexpr uint32_t BAKED_MAGIC = 0x58455457; // "WTEX"
+// Bump whenever the layout, the filtering or the block encoder changes, old bakes then get redone rather than served
+constexpr uint32_t BAKED_VERSION = 1;
+// The first level starts on a cache line
+constexpr uint64_t BAKED_DATA_ALIGNMENT = 64;
+constexpr uint32_t BAKED_MAX_LEVELS = 32;
+
+wVkMappedFile::~wVkMappedFile()
+{
+	if (m_Data == nullptr)
+		return;
+
+#ifdef _WIN32
+	UnmapViewOfFile(m_Data);
+#else
+	munmap(const_cast<uint8_t*>(m_Data), static_cast<size_t>(m_Size));
+#endif
+}
+
+std::shared_ptr<const wVkMappedFile> wVkMappedFile::Open(const std::string& path)
+{
+	std::shared_ptr<wVkMappedFile> mapped(new wVkMappedFile());
+
+#ifdef _WIN32
+	HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+		return nullptr;
+
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(file, &size) || size.QuadPart == 0) {
+		CloseHandle(file);
+		return nullptr;
+	}
+
+	// The view holds on to the mapping and the file by itself, neither handle is needed after this
+	HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	CloseHandle(file);
+	if (mapping == nullptr)
+		return nullptr;
+
+	void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	CloseHandle(mapping);
+	if (view == nullptr)
+		return nullptr;
+
+	mapped->m_Size = static_cast<uint64_t>(size.QuadPart);
+#else
+	const int file = open(path.c_str(), O_RDONLY);
+	if (file < 0)
+		return nullptr;
+
+	struct stat info;
+	if (fstat(file, &info) != 0 || info.st_size == 0) {
+		close(file);
+		return nullptr;
+	}
+
+	void* view = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, file, 0);
+	close(file);
+	if (view == MAP_FAILED)
+		return nullptr;
+
+	mapped->m_Size = static_cast<uint64_t>(info.st_size);
+#endif
+
+	mapped->m_Data = static_cast<const uint8_t*>(view);
+	return mapped;
+}
+
+uint64_t wVkTextureBaker::HashSource(const uint8_t* data, size_t size, uint32_t rawWidth, uint32_t rawHeight, bool buildMips, VkFormat format)
+{
+	// FNV-1a a word at a time, the same as the mip cache. Source files are hashed whole on every load, it has to be quick.
+	constexpr uint64_t prime = 0x100000001B3ull;
+	uint64_t hash = 0xCBF29CE484222325ull;
+
+	auto mix = [&hash](uint64_t value) { hash = (hash ^ value) * prime; };
+	mix(rawWidth);
+	mix(rawHeight);
+	mix(buildMips ? 1 : 0);
+	mix(static_cast<uint64_t>(format));
+	mix(BAKED_VERSION);
+	mix(size);
+
+	size_t offset = 0;
+	for (; offset + sizeof(uint64_t) <= size; offset += sizeof(uint64_t)) {
+		uint64_t word;
+		memcpy(&word, data + offset, sizeof(word));
+		mix(word);
+	}
+	for (; offset < size; offset++)
+		mix(data[offset]);
+
+	return hash;
+}
+
+std::shared_ptr<const wVkMipChain> wVkTextureBaker::Find(uint64_t key, VkFormat format)
+{
+	std::shared_ptr<const wVkMipChain> chain = Load(GetCachePath(key), format, key);
+	if (!chain)
+		return nullptr;
+
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	m_Stats.m_NumLoaded++;
+	m_Stats.m_LoadedBytes += chain->GetSize();
+
+	return chain;
+}
+
+void wVkTextureBaker::Store(uint64_t key, const wVkMipChain& chain, VkFormat format)
+{
+	std::error_code error;
+	std::filesystem::create_directories(wVkConstants::g_BakedTextureDirectory, error);
+
+	const wVkSupercompression supercompression = wVkConstants::g_SupercompressBakedTextures ? wVkSupercompression::ZLIB : wVkSupercompression::NONE;
+	const uint64_t written = Write(GetCachePath(key), chain, format, key, supercompression);
+	if (written == 0)
+		return;
+
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	m_Stats.m_NumBaked++;
+	m_Stats.m_WrittenBytes += written;
+}
+
+uint64_t wVkTextureBaker::Write(const std::string& path, const wVkMipChain& chain, VkFormat format, uint64_t key, wVkSupercompression supercompression)
+{
+	const uint32_t numLevels = chain.GetNumLevels();
+	ASSERT(numLevels > 0 && numLevels <= BAKED_MAX_LEVELS, "Can't bake a chain of %i levels", static_cast<int>(numLevels));
+	ASSERT(chain.m_BlockDimension == wVkHelpers::getBlockDimension(format) && chain.m_BytesPerBlock == wVkHelpers::getBytesPerBlock(format), "Baked chain doesn't match its format: %s", path.c_str());
+
+	BakedHeader header;
+	header.m_Magic = BAKED_MAGIC;
+	header.m_Version = BAKED_VERSION;
+	header.m_Key = key;
+	header.m_Format = static_cast<uint32_t>(format);
+	header.m_Width = chain.m_Width;
+	header.m_Height = chain.m_Height;
+	header.m_NumLevels = numLevels;
+	header.m_Srgb = chain.m_Srgb ? 1 : 0;
+	header.m_Supercompression = static_cast<uint32_t>(supercompression);
+
+	// Levels that don't get smaller deflated are stored as they are
+	std::vector<std::vector<uint8_t>> deflated(numLevels);
+	if (supercompression == wVkSupercompression::ZLIB) {
+		for (uint32_t mip = 0; mip < numLevels; mip++) {
+			int deflatedSize = 0;
+			unsigned char* compressed = stbi_zlib_compress(const_cast<unsigned char*>(chain.GetLevel(mip)), static_cast<int>(chain.GetLevelSize(mip)), &deflatedSize, 8);
+			if (compressed != nullptr && static_cast<uint64_t>(deflatedSize) < chain.GetLevelSize(mip))
+				deflated[mip].assign(compressed, compressed + deflatedSize);
+			STBIW_FREE(compressed);
+		}
+	}
+
+	std::vector<BakedLevel> levels(numLevels);
+	const uint64_t tableEnd = sizeof(BakedHeader) + sizeof(BakedLevel) * numLevels;
+	uint64_t offset = (tableEnd + BAKED_DATA_ALIGNMENT - 1) / BAKED_DATA_ALIGNMENT * BAKED_DATA_ALIGNMENT;
+	for (uint32_t mip = 0; mip < numLevels; mip++) {
+		levels[mip].m_Offset = offset;
+		levels[mip].m_StoredSize = deflated[mip].empty() ? chain.GetLevelSize(mip) : deflated[mip].size();
+		offset += levels[mip].m_StoredSize;
+	}
+
+	// Written under a name of our own and renamed once complete, so nobody ever maps half a file
+	const std::string tempPath = path + "." + std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id())) + ".tmp";
+	std::error_code error;
+	{
+		std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+		file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		file.write(reinterpret_cast<const char*>(levels.data()), static_cast<std::streamsize>(sizeof(BakedLevel) * numLevels));
+
+		const char padding[BAKED_DATA_ALIGNMENT] = {};
+		file.write(padding, static_cast<std::streamsize>(levels[0].m_Offset - tableEnd));
+
+		for (uint32_t mip = 0; mip < numLevels; mip++) {
+			const uint8_t* level = deflated[mip].empty() ? chain.GetLevel(mip) : deflated[mip].data();
+			file.write(reinterpret_cast<const char*>(level), static_cast<std::streamsize>(levels[mip].m_StoredSize));
+		}
+
+		if (!file) {
+			LOG_WARNING("Failed to write baked texture: %s", path.c_str());
+			file.close();
+			std::filesystem::remove(tempPath, error);
+			return 0;
+		}
+	}
+
+	// Someone else baking the same source at the same time is fine, theirs is identical
+	std::filesystem::rename(tempPath, path, error);
+	if (error) {
+		std::filesystem::remove(tempPath, error);
+		return 0;
+	}
+
+	return offset;
+}
+
+std::shared_ptr<const wVkMipChain> wVkTextureBaker::Load(const std::string& path, VkFormat format, uint64_t key)
+{
+	std::shared_ptr<const wVkMappedFile> file = wVkMappedFile::Open(path);
+	if (!file)
+		return nullptr;
+
+	const uint64_t fileSize = file->GetSize();
+
+	BakedHeader header;
+	if (fileSize >= sizeof(header))
+		memcpy(&header, file->GetData(), sizeof(header));
+
+	// The key covers all of this already, a mismatch means a collision, a file from an older build or a damaged one
+	if (fileSize < sizeof(header) || header.m_Magic != BAKED_MAGIC || header.m_Version != BAKED_VERSION || header.m_Key != key || header.m_Format != static_cast<uint32_t>(format)
+		|| header.m_Width == 0 || header.m_Height == 0 || header.m_NumLevels == 0 || header.m_NumLevels > BAKED_MAX_LEVELS
+		|| header.m_Supercompression > static_cast<uint32_t>(wVkSupercompression::ZLIB) || fileSize < sizeof(header) + sizeof(BakedLevel) * header.m_NumLevels)
+	{
+		LOG_WARNING("Ignoring stale baked texture: %s", path.c_str());
+		return nullptr;
+	}
+
+	std::vector<BakedLevel> levels(header.m_NumLevels);
+	memcpy(levels.data(), file->GetData() + sizeof(header), sizeof(BakedLevel) * header.m_NumLevels);
+
+	auto chain = std::make_shared<wVkMipChain>();
+	chain->m_BlockDimension = wVkHelpers::getBlockDimension(format);
+	chain->m_BytesPerBlock = wVkHelpers::getBytesPerBlock(format);
+
+	bool valid = true;
+	if (static_cast<wVkSupercompression>(header.m_Supercompression) == wVkSupercompression::NONE) {
+		chain->m_Width = header.m_Width;
+		chain->m_Height = header.m_Height;
+		chain->m_Srgb = header.m_Srgb != 0;
+		chain->m_LevelOffsets.resize(header.m_NumLevels);
+
+		// Levels have to follow each other without gaps, the upload copies runs of them in one go
+		for (uint32_t mip = 0; mip < header.m_NumLevels && valid; mip++) {
+			const BakedLevel& level = levels[mip];
+			const uint64_t size = chain->GetLevelSize(mip);
+			const bool contiguous = mip == 0 || level.m_Offset == levels[mip - 1].m_Offset + levels[mip - 1].m_StoredSize;
+			valid = contiguous && level.m_StoredSize == size && level.m_Offset <= fileSize && size <= fileSize - level.m_Offset;
+			chain->m_LevelOffsets[mip] = level.m_Offset;
+		}
+
+		// Pages are only read in as the upload touches them, and can be dropped and read back by the OS after that
+		chain->m_MappedData = file->GetData();
+		chain->m_Mapping = file;
+	}
+	else {
+		chain->Allocate(header.m_Width, header.m_Height, header.m_Srgb != 0, header.m_NumLevels);
+
+		for (uint32_t mip = 0; mip < header.m_NumLevels && valid; mip++) {
+			const BakedLevel& level = levels[mip];
+			const uint64_t size = chain->GetLevelSize(mip);
+			if (level.m_Offset > fileSize || level.m_StoredSize > fileSize - level.m_Offset || level.m_StoredSize > size) {
+				valid = false;
+				break;
+			}
+
+			const char* stored = reinterpret_cast<const char*>(file->GetData() + level.m_Offset);
+			char* destination = reinterpret_cast<char*>(chain->m_Data.data() + chain->m_LevelOffsets[mip]);
+			if (level.m_StoredSize == size)
+				memcpy(destination, stored, static_cast<size_t>(size));
+			else
+				valid = stbi_zlib_decode_buffer(destination, static_cast<int>(size), stored, static_cast<int>(level.m_StoredSize)) == static_cast<int>(size);
+		}
+	}
+
+	if (!valid) {
+		LOG_WARNING("Ignoring damaged baked texture: %s", path.c_str());
+		return nullptr;
+	}
+
+	return chain;
+}
+
+wVkTextureBaker::Stats wVkTextureBaker::GetStats()
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	return m_Stats;
+}
+
+std::string wVkTextureBaker::GetCachePath(uint64_t key)
+{
+	char name[32];
+	snprintf(name, sizeof(name), "%016llx.wtex", static_cast<unsigned long long>(key));
+
+	return wVkConstants::g_BakedTextureDirectory + name;
+}
@@ -0,0 +1,73 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include "vulkan/vulkan.h"
+
+#include "wVkMipBuilder.h"
+
+// Read only mapping of a whole file, unmapped once the last reference is gone
+class wVkMappedFile
+{
+public:
+	~wVkMappedFile();
+
+	// nullptr if the file doesn't exist, is empty or can't be mapped
+	static std::shared_ptr<const wVkMappedFile> Open(const std::string& path);
+
+	const uint8_t* GetData() const { return m_Data; }
+	uint64_t GetSize() const { return m_Size; }
+
+private:
+	wVkMappedFile() = default;
+
+	const uint8_t* m_Data = nullptr;
+	uint64_t m_Size = 0;
+};
+
+// How the levels of a baked texture are stored on disk
+enum class wVkSupercompression : uint32_t
+{
+	NONE, // As they go to the GPU, the chain reads them straight out of the mapping
+	ZLIB, // Deflated per level, inflated on load. Smaller on disk but every load costs a copy of the whole chain.
+};
+
+// Baked textures (.wtex): a mip chain in the format it's sampled in, so loading one is a map and a copy per chunk of
+// levels into staging, with no decoding, filtering or block encoding left to do.
+// A file is a header, a table with the offset and size of every level, then the levels back to back in the same
+// layout as wVkMipChain. The image decoder bakes everything it decodes to wVkConstants::g_BakedTextureDirectory,
+// keyed by a hash of the source bytes and the bake options, so an asset is only ever baked again once it changes.
+// Safe to call from several threads at once.
+class wVkTextureBaker
+{
+public:
+	struct Stats
+	{
+		uint64_t m_NumBaked = 0;
+		uint64_t m_NumLoaded = 0;
+		uint64_t m_WrittenBytes = 0; // On disk, after supercompression
+		uint64_t m_LoadedBytes = 0; // Whole chains, as the GPU gets them
+	};
+
+	// Key of a bake. Covers the source (an encoded image, or raw texels of rawWidth x rawHeight) and what it's baked to.
+	static uint64_t HashSource(const uint8_t* data, size_t size, uint32_t rawWidth, uint32_t rawHeight, bool buildMips, VkFormat format);
+
+	// The chain baked under key, nullptr when there's none (or it's from an older build or damaged, it's rebaked then)
+	std::shared_ptr<const wVkMipChain> Find(uint64_t key, VkFormat format);
+	void Store(uint64_t key, const wVkMipChain& chain, VkFormat format);
+
+	// Outside the cache, e.g. for baking assets ahead of time. Write returns the file size, 0 if it failed.
+	// Load fails on a file of a different format or key.
+	static uint64_t Write(const std::string& path, const wVkMipChain& chain, VkFormat format, uint64_t key, wVkSupercompression supercompression);
+	static std::shared_ptr<const wVkMipChain> Load(const std::string& path, VkFormat format, uint64_t key);
+
+	Stats GetStats();
+
+private:
+	static std::string GetCachePath(uint64_t key);
+
+	std::mutex m_Mutex;
+	Stats m_Stats; // Guarded by m_Mutex
+};
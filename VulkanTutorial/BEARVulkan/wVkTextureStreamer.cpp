@@ -0,0 +1,224 @@
+#include "wVkTextureStreamer.h"
+
+#include <algorithm>
+#include <memory>
+
+#include "imgui.h"
+
+#include "TypeDefs.h"
+#include "wVkGlobalVariables.h"
+#include "Utils/ConsoleLogger.h"
+#include "wVkHelpers/wVkFormats.h"
+#include "wVkHelpers/wVkMemory.h"
+
+// Tightly packed bytes of mips firstMip and smaller
+uint64_t GetStreamedChainBytes(const wVkTexture2D& texture, uint32_t firstMip)
+{
+	uint64_t bytes = 0;
+	for (uint32_t mip = firstMip; mip < texture.m_FullMipLevels; mip++)
+		bytes += wVkHelpers::getImageSize(texture.m_Format, std::max(texture.m_FullWidth >> mip, 1u), std::max(texture.m_FullHeight >> mip, 1u));
+
+	return bytes;
+}
+
+// First mip that fits in g_StreamingTailSize, it's what a texture shows right after decoding
+uint32_t GetTailMip(const wVkTexture2D& texture)
+{
+	uint32_t mip = 0;
+	while (mip + 1 < texture.m_FullMipLevels && std::max(texture.m_FullWidth >> mip, texture.m_FullHeight >> mip) > wVkConstants::g_StreamingTailSize)
+		mip++;
+
+	return mip;
+}
+
+void wVkTextureStreamer::Destroy()
+{
+	m_Textures.clear();
+}
+
+void wVkTextureStreamer::Stream(wVkTexture2D& texture, const std::string& path)
+{
+	Stream(texture, wVkGlobals::g_ImageDecoder.DecodeFile(path, true, texture.m_Format), path);
+}
+
+void wVkTextureStreamer::Stream(wVkTexture2D& texture, wVkDecodeHandle decode, const std::string& name)
+{
+	// The decode's chain is uploaded as is, it has to be in the texture's format already
+	ASSERT(decode->m_Format == texture.m_Format, "Streamed texture and its decode disagree on the format");
+	ASSERT(texture.m_FirstResidentMip + 1 == texture.m_FullMipLevels, "Texture wasn't created with TextureFlags::STREAMED");
+	ASSERT(decode->m_BuildMips, "Streamed textures need the decode to build their mip chain");
+
+	StreamedTexture streamed;
+	streamed.m_Texture = &texture;
+	streamed.m_Name = name;
+	streamed.m_Decode = std::move(decode);
+	m_Textures.push_back(std::move(streamed));
+}
+
+void wVkTextureStreamer::Replace(wVkTexture2D* oldTexture, wVkTexture2D* newTexture)
+{
+	if (StreamedTexture* streamed = Find(oldTexture))
+		streamed->m_Texture = newTexture;
+}
+
+void wVkTextureStreamer::Cancel(wVkTexture2D* texture)
+{
+	// The decode is left to finish, it's dropped once nobody holds on to it
+	StreamedTexture* streamed = Find(texture);
+	if (streamed != nullptr)
+		m_Textures.erase(m_Textures.begin() + (streamed - m_Textures.data()));
+}
+
+void wVkTextureStreamer::SetScreenCoverage(wVkTexture2D& texture, float pixels)
+{
+	StreamedTexture* streamed = Find(&texture);
+	if (streamed == nullptr)
+		return;
+
+	streamed->m_ScreenCoverage = pixels;
+	if (!streamed->m_Decoded)
+		wVkGlobals::g_ImageDecoder.SetPriority(streamed->m_Decode, pixels);
+}
+
+void wVkTextureStreamer::Update()
+{
+	uint32_t numPending = 0;
+	for (auto it = m_Textures.begin(); it != m_Textures.end();) {
+		if (it->m_Decoded || !it->m_Decode->IsDone()) {
+			numPending += it->m_Decoded ? 0 : 1;
+			++it;
+			continue;
+		}
+
+		const wVkDecodedImage& image = it->m_Decode->m_Image;
+		if (!image.m_Error.empty()) {
+			// The texture keeps its placeholder
+			LOG_ERROR("Failed to stream texture: %s", it->m_Name.c_str());
+			LOG_ERROR("STB_IMAGE Error: %s", image.m_Error.c_str());
+			it = m_Textures.erase(it);
+			continue;
+		}
+
+		if (image.m_Width != it->m_Texture->m_FullWidth || image.m_Height != it->m_Texture->m_FullHeight) {
+			LOG_ERROR("Streamed texture %s is %ix%i, the Texture was created %ix%i", it->m_Name.c_str(), static_cast<int>(image.m_Width), static_cast<int>(image.m_Height),
+				static_cast<int>(it->m_Texture->m_FullWidth), static_cast<int>(it->m_Texture->m_FullHeight));
+			it = m_Textures.erase(it);
+			continue;
+		}
+
+		it->m_Decoded = true;
+		++it;
+	}
+	m_Stats.m_NumPending = numPending;
+
+	// Largest on screen first, the first step of a frame always goes through so big mips can't starve
+	std::stable_sort(m_Textures.begin(), m_Textures.end(), [](const StreamedTexture& a, const StreamedTexture& b) { return a.m_ScreenCoverage > b.m_ScreenCoverage; });
+
+	uint64_t uploadedBytes = 0;
+	bool budgetSpent = false;
+	for (StreamedTexture& streamed : m_Textures) {
+		while (!budgetSpent && streamed.m_Decoded && (!streamed.m_TailUploaded || streamed.m_Texture->m_FirstResidentMip > 0)) {
+			const uint32_t nextMip = streamed.m_TailUploaded ? streamed.m_Texture->m_FirstResidentMip - 1 : GetTailMip(*streamed.m_Texture);
+			const uint64_t stepBytes = GetStreamedChainBytes(*streamed.m_Texture, nextMip);
+			if (uploadedBytes > 0 && uploadedBytes + stepBytes > wVkConstants::g_StreamingBytesPerFrame) {
+				budgetSpent = true;
+				break;
+			}
+
+			uploadedBytes += Grow(streamed);
+		}
+	}
+
+	// Fully resident, the residency manager takes it from here
+	uint32_t numStreaming = 0;
+	for (auto it = m_Textures.begin(); it != m_Textures.end();) {
+		if (it->m_TailUploaded && it->m_Texture->m_FirstResidentMip == 0) {
+			// Shared with the decode rather than copied, promotions upload it as is
+			it->m_Texture->m_SourceMips = it->m_Decode->m_Image.m_Mips;
+			wVkGlobals::g_ResidencyManager.Register(it->m_Texture);
+			m_Stats.m_TotalStreamed++;
+			it = m_Textures.erase(it);
+			continue;
+		}
+
+		if (it->m_Decoded)
+			numStreaming++;
+		++it;
+	}
+
+	m_Stats.m_NumStreaming = numStreaming;
+	m_Stats.m_UploadedBytesLastFrame = uploadedBytes;
+	m_Stats.m_TotalUploadedBytes += uploadedBytes;
+}
+
+uint64_t wVkTextureStreamer::Grow(StreamedTexture& streamed)
+{
+	wVkTexture2D& texture = *streamed.m_Texture;
+	const uint32_t firstMip = streamed.m_TailUploaded ? texture.m_FirstResidentMip - 1 : GetTailMip(texture);
+
+	// Reuploads the smaller mips along with the new one, a third on top of the level itself but no GPU side copies
+	wVkGlobals::g_ResidencyManager.UploadResidentMips(texture, firstMip, *streamed.m_Decode->m_Image.m_Mips);
+	streamed.m_TailUploaded = true;
+
+	return GetStreamedChainBytes(texture, firstMip);
+}
+
+wVkTextureStreamer::StreamedTexture* wVkTextureStreamer::Find(const wVkTexture2D* texture)
+{
+	for (StreamedTexture& streamed : m_Textures) {
+		if (streamed.m_Texture == texture)
+			return &streamed;
+	}
+
+	return nullptr;
+}
+
+void wVkTextureStreamer::DrawImGuiPanel()
+{
+	ImGui::Begin("Texture Streaming");
+
+	ImGui::Text("Decoding: %u, growing: %u, done: %llu", m_Stats.m_NumPending, m_Stats.m_NumStreaming, static_cast<unsigned long long>(m_Stats.m_TotalStreamed));
+	ImGui::Text("Uploaded last frame: %s (budget %s)", wVkHelpers::formatBytes(m_Stats.m_UploadedBytesLastFrame).c_str(), wVkHelpers::formatBytes(wVkConstants::g_StreamingBytesPerFrame).c_str());
+	ImGui::Text("Uploaded total: %s", wVkHelpers::formatBytes(m_Stats.m_TotalUploadedBytes).c_str());
+
+	const wVkImageDecoder::Stats decoder = wVkGlobals::g_ImageDecoder.GetStats();
+	ImGui::Text("Decoder: %u workers, %u queued, %llu decoded (%s), %llu of %llu requests deduplicated", decoder.m_NumWorkers, decoder.m_NumQueued,
+		static_cast<unsigned long long>(decoder.m_NumDecoded), wVkHelpers::formatBytes(decoder.m_DecodedBytes).c_str(),
+		static_cast<unsigned long long>(decoder.m_NumDeduplicated), static_cast<unsigned long long>(decoder.m_NumRequests));
+
+	const wVkMipBuilder::Stats mips = wVkGlobals::g_MipBuilder.GetStats();
+	ImGui::Text("Mip chains: %llu built (%.1f ms), %llu from cache, %s total", static_cast<unsigned long long>(mips.m_NumBuilt), mips.m_BuildMilliseconds,
+		static_cast<unsigned long long>(mips.m_NumCacheHits), wVkHelpers::formatBytes(mips.m_BuiltBytes).c_str());
+
+	const wVkBlockEncoder::Stats blocks = wVkGlobals::g_BlockEncoder.GetStats();
+	ImGui::Text("Block compressed: %llu chains (%.1f ms), %s down to %s", static_cast<unsigned long long>(blocks.m_NumEncoded), blocks.m_EncodeMilliseconds,
+		wVkHelpers::formatBytes(blocks.m_SourceBytes).c_str(), wVkHelpers::formatBytes(blocks.m_EncodedBytes).c_str());
+
+	const wVkTextureBaker::Stats baked = wVkGlobals::g_TextureBaker.GetStats();
+	ImGui::Text("Baked textures: %llu mapped (%s), %llu baked (%s on disk)", static_cast<unsigned long long>(baked.m_NumLoaded), wVkHelpers::formatBytes(baked.m_LoadedBytes).c_str(),
+		static_cast<unsigned long long>(baked.m_NumBaked), wVkHelpers::formatBytes(baked.m_WrittenBytes).c_str());
+
+	if (!m_Textures.empty() && ImGui::BeginTable("StreamedTextures", 4, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg | ImGuiTableFlags_SizingFixedFit))
+	{
+		ImGui::TableSetupColumn("Texture");
+		ImGui::TableSetupColumn("State");
+		ImGui::TableSetupColumn("Resident");
+		ImGui::TableSetupColumn("Coverage (px)");
+		ImGui::TableHeadersRow();
+
+		for (const StreamedTexture& streamed : m_Textures)
+		{
+			const wVkTexture2D& texture = *streamed.m_Texture;
+
+			ImGui::TableNextRow();
+			ImGui::TableNextColumn(); ImGui::TextUnformatted(streamed.m_Name.c_str());
+			ImGui::TableNextColumn(); ImGui::TextUnformatted(streamed.m_Decoded ? "Uploading" : "Decoding");
+			ImGui::TableNextColumn(); ImGui::Text("%ux%u (mip %u)", texture.m_Width, texture.m_Height, texture.m_FirstResidentMip);
+			ImGui::TableNextColumn(); ImGui::Text("%.0f", streamed.m_ScreenCoverage);
+		}
+
+		ImGui::EndTable();
+	}
+
+	ImGui::End();
+}
@@ -0,0 +1,69 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "vulkan/vulkan.h"
+
+#include "wVkImageDecoder.h"
+
+struct wVkTexture2D;
+
+// Streams textures in from disk without blocking the frame.
+// A streamed Texture (TextureFlags::STREAMED) starts out with only a 1x1 placeholder resident. Its image is decoded and
+// its mip chain built by wVkGlobals::g_ImageDecoder, after which Update uploads it small mips first, a level per step,
+// within a per frame byte budget. Textures with more screen coverage are decoded and grown first.
+// Every step recreates the image and view and bumps m_Relocations, cached descriptors follow like they do for the
+// defragmenter. Fully streamed textures are handed to the residency manager.
+class wVkTextureStreamer
+{
+public:
+	struct Stats
+	{
+		uint32_t m_NumPending = 0; // Waiting for or being decoded
+		uint32_t m_NumStreaming = 0; // Decoded, still growing
+		uint64_t m_TotalStreamed = 0;
+		uint64_t m_TotalUploadedBytes = 0;
+		uint64_t m_UploadedBytesLastFrame = 0;
+	};
+
+	void Destroy();
+
+	// The texture has to have been created with TextureFlags::STREAMED, its size has to match the image's
+	void Stream(wVkTexture2D& texture, const std::string& path);
+	// For images that don't come from a file of their own, the decode has to build the mip chain
+	void Stream(wVkTexture2D& texture, wVkDecodeHandle decode, const std::string& name);
+
+	// Textures move with their Texture, the pointer we hold has to follow
+	void Replace(wVkTexture2D* oldTexture, wVkTexture2D* newTexture);
+	void Cancel(wVkTexture2D* texture);
+
+	// Pixels the texture covers on screen, sets its priority
+	void SetScreenCoverage(wVkTexture2D& texture, float pixels);
+
+	// Once per frame, after waiting on the frame's fence and before recording
+	void Update();
+
+	const Stats& GetStats() const { return m_Stats; }
+
+	void DrawImGuiPanel();
+
+private:
+	struct StreamedTexture
+	{
+		wVkTexture2D* m_Texture = nullptr;
+		std::string m_Name;
+		wVkDecodeHandle m_Decode;
+		float m_ScreenCoverage = 0.0f;
+		bool m_Decoded = false;
+		bool m_TailUploaded = false; // The placeholder has been replaced by the real mip tail
+	};
+
+	StreamedTexture* Find(const wVkTexture2D* texture);
+
+	// Uploads the next step of the texture, returns the bytes it took
+	uint64_t Grow(StreamedTexture& streamed);
+
+	std::vector<StreamedTexture> m_Textures;
+	Stats m_Stats;
+};
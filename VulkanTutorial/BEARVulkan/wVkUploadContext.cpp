@@ -0,0 +1,362 @@
+#include "wVkUploadContext.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+#include "TypeDefs.h"
+#include "wVkGlobalVariables.h"
+#include "wVkMipBuilder.h"
+#include "Utils/ConsoleLogger.h"
+#include "wVkHelpers/wVkCommands.h"
+#include "wVkHelpers/wVkTemp.h"
+#include "wVkHelpers/wVkTexture.h"
+
+void wVkUploadContext::Initialize()
+{
+	const wVkHelpers::wVkMemoryPolicy policy = wVkHelpers::getMemoryPolicy(wVkHelpers::wVkMemoryUsage::CPU_ONLY);
+	const uint32_t memoryType = wVkHelpers::createBuffer(wVkConstants::g_StagingWindowSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, policy, m_StagingBuffer, m_StagingMemory);
+	m_MemoryProperties = wVkHelpers::getMemoryTypeProperties(memoryType);
+	m_RegistryId = wVkGlobals::g_ResourceRegistry.RegisterBuffer(m_StagingBuffer, memoryType, wVkConstants::g_StagingWindowSize, wVkResourceType::STAGING, "Staging Window", Callsite::Current());
+
+	void* mapped = nullptr;
+	if (vkMapMemory(wVkGlobals::g_Device, m_StagingMemory, 0, VK_WHOLE_SIZE, 0, &mapped) != VK_SUCCESS) {
+		throw std::runtime_error("failed to map staging window!");
+	}
+	m_MappedData = static_cast<uint8_t*>(mapped);
+
+	// Own pool, so our command buffers can be reset individually without touching anyone else's
+	const wVkHelpers::QueueFamilyIndices queueFamilyIndices = wVkHelpers::findQueueFamilies(wVkGlobals::g_PhysicalDevice);
+
+	VkCommandPoolCreateInfo poolInfo{};
+	poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+	poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT | VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+	poolInfo.queueFamilyIndex = queueFamilyIndices.graphicsFamily.value();
+
+	if (vkCreateCommandPool(wVkGlobals::g_Device, &poolInfo, wVkGlobals::g_AllocationCallbacks, &m_CommandPool) != VK_SUCCESS) {
+		throw std::runtime_error("failed to create upload command pool!");
+	}
+
+	VkCommandBufferAllocateInfo allocInfo{};
+	allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+	allocInfo.commandPool = m_CommandPool;
+	allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+	allocInfo.commandBufferCount = NUM_CHUNKS;
+
+	if (vkAllocateCommandBuffers(wVkGlobals::g_Device, &allocInfo, m_CommandBuffers) != VK_SUCCESS) {
+		throw std::runtime_error("failed to allocate upload command buffers!");
+	}
+
+	VkFenceCreateInfo fenceInfo{};
+	fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+
+	for (auto& fence : m_Fences) {
+		if (vkCreateFence(wVkGlobals::g_Device, &fenceInfo, wVkGlobals::g_AllocationCallbacks, &fence) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create upload fence!");
+		}
+	}
+
+	LOG_INFO("Staging window: %s in %i chunks", wVkHelpers::formatBytes(wVkConstants::g_StagingWindowSize).c_str(), static_cast<int>(NUM_CHUNKS));
+}
+
+void wVkUploadContext::Destroy()
+{
+	WaitForAll();
+
+	for (auto& fence : m_Fences) {
+		vkDestroyFence(wVkGlobals::g_Device, fence, wVkGlobals::g_AllocationCallbacks);
+		fence = VK_NULL_HANDLE;
+	}
+
+	vkDestroyCommandPool(wVkGlobals::g_Device, m_CommandPool, wVkGlobals::g_AllocationCallbacks);
+	vkDestroyBuffer(wVkGlobals::g_Device, m_StagingBuffer, wVkGlobals::g_AllocationCallbacks);
+	vkFreeMemory(wVkGlobals::g_Device, m_StagingMemory, wVkGlobals::g_AllocationCallbacks);
+	wVkGlobals::g_ResourceRegistry.Unregister(m_RegistryId);
+
+	m_CommandPool = VK_NULL_HANDLE;
+	m_StagingBuffer = VK_NULL_HANDLE;
+	m_StagingMemory = VK_NULL_HANDLE;
+	m_MappedData = nullptr;
+	m_RegistryId = 0;
+}
+
+VkCommandBuffer wVkUploadContext::BeginChunk()
+{
+	if (m_InFlight[m_CurrentChunk]) {
+		vkWaitForFences(wVkGlobals::g_Device, 1, &m_Fences[m_CurrentChunk], VK_TRUE, UINT64_MAX);
+		vkResetFences(wVkGlobals::g_Device, 1, &m_Fences[m_CurrentChunk]);
+		m_InFlight[m_CurrentChunk] = false;
+	}
+
+	const VkCommandBuffer commandBuffer = m_CommandBuffers[m_CurrentChunk];
+	vkResetCommandBuffer(commandBuffer, 0);
+
+	VkCommandBufferBeginInfo beginInfo{};
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+	vkBeginCommandBuffer(commandBuffer, &beginInfo);
+
+	return commandBuffer;
+}
+
+void wVkUploadContext::SubmitChunk(VkDeviceSize usedBytes)
+{
+	if ((m_MemoryProperties & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) == 0) {
+		// Chunks start at multiples of CHUNK_SIZE, which is a multiple of any sane nonCoherentAtomSize
+		VkMappedMemoryRange range{};
+		range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+		range.memory = m_StagingMemory;
+		range.offset = m_CurrentChunk * CHUNK_SIZE;
+		range.size = CHUNK_SIZE;
+		vkFlushMappedMemoryRanges(wVkGlobals::g_Device, 1, &range);
+	}
+
+	const VkCommandBuffer commandBuffer = m_CommandBuffers[m_CurrentChunk];
+	vkEndCommandBuffer(commandBuffer);
+
+	VkSubmitInfo submitInfo{};
+	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submitInfo.commandBufferCount = 1;
+	submitInfo.pCommandBuffers = &commandBuffer;
+
+	if (vkQueueSubmit(wVkGlobals::g_GraphicsQueue, 1, &submitInfo, m_Fences[m_CurrentChunk]) != VK_SUCCESS) {
+		throw std::runtime_error("failed to submit upload command buffer!");
+	}
+
+	m_InFlight[m_CurrentChunk] = true;
+	m_TotalUploadedBytes += usedBytes;
+	m_CurrentChunk = (m_CurrentChunk + 1) % NUM_CHUNKS;
+}
+
+void wVkUploadContext::WaitForAll()
+{
+	for (uint32_t i = 0; i < NUM_CHUNKS; i++) {
+		if (!m_InFlight[i])
+			continue;
+
+		vkWaitForFences(wVkGlobals::g_Device, 1, &m_Fences[i], VK_TRUE, UINT64_MAX);
+		vkResetFences(wVkGlobals::g_Device, 1, &m_Fences[i]);
+		m_InFlight[i] = false;
+	}
+}
+
+void wVkUploadContext::UploadToBuffer(VkBuffer dstBuffer, VkDeviceSize dstOffset, const void* data, VkDeviceSize size)
+{
+	const uint8_t* src = static_cast<const uint8_t*>(data);
+
+	UploadToBuffer(dstBuffer, dstOffset, size, 1, [src](uint8_t* destination, VkDeviceSize offset, VkDeviceSize chunkSize)
+	{
+		memcpy(destination, src + offset, static_cast<size_t>(chunkSize));
+	});
+}
+
+void wVkUploadContext::UploadToBuffer(VkBuffer dstBuffer, VkDeviceSize dstOffset, VkDeviceSize size, VkDeviceSize granularity, const FillFn& fill)
+{
+	ASSERT(granularity > 0 && granularity <= CHUNK_SIZE, "Upload granularity of %s doesn't fit in a staging chunk", wVkHelpers::formatBytes(granularity).c_str());
+	const VkDeviceSize maxChunkBytes = CHUNK_SIZE / granularity * granularity;
+
+	for (VkDeviceSize uploaded = 0; uploaded < size;) {
+		const VkDeviceSize chunkBytes = std::min(maxChunkBytes, size - uploaded);
+
+		const VkCommandBuffer commandBuffer = BeginChunk();
+
+		// Frames in flight may still read or write the range, the copy waits for them (same queue, submitted earlier)
+		if (uploaded == 0) {
+			VkMemoryBarrier barrier{};
+			barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+			barrier.srcAccessMask = VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+			barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+		}
+
+		const VkDeviceSize stagingOffset = m_CurrentChunk * CHUNK_SIZE;
+		fill(m_MappedData + stagingOffset, uploaded, chunkBytes);
+
+		VkBufferCopy copyRegion{};
+		copyRegion.srcOffset = stagingOffset;
+		copyRegion.dstOffset = dstOffset + uploaded;
+		copyRegion.size = chunkBytes;
+		vkCmdCopyBuffer(commandBuffer, m_StagingBuffer, dstBuffer, 1, &copyRegion);
+
+		// And frames recorded after it see the new bytes
+		uploaded += chunkBytes;
+		if (uploaded == size) {
+			VkMemoryBarrier barrier{};
+			barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+			barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+			vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+		}
+
+		SubmitChunk(chunkBytes);
+	}
+
+	WaitForAll();
+}
+
+void wVkUploadContext::UploadToImage(VkImage dstImage, uint32_t mipLevel, uint32_t width, uint32_t height, uint32_t bytesPerPixel, const void* data)
+{
+	const uint8_t* src = static_cast<const uint8_t*>(data);
+
+	UploadToImage(dstImage, mipLevel, width, height, bytesPerPixel, [src](uint8_t* destination, VkDeviceSize offset, VkDeviceSize size)
+	{
+		memcpy(destination, src + offset, static_cast<size_t>(size));
+	});
+}
+
+void wVkUploadContext::UploadToImage(VkImage dstImage, uint32_t mipLevel, uint32_t width, uint32_t height, uint32_t bytesPerPixel, const FillFn& fill)
+{
+	const VkDeviceSize rowBytes = static_cast<VkDeviceSize>(width) * bytesPerPixel;
+
+	ASSERT(rowBytes <= CHUNK_SIZE, "A single row of %i pixels doesn't fit in a staging chunk", static_cast<int>(width));
+	const uint32_t rowsPerChunk = static_cast<uint32_t>(std::min<VkDeviceSize>(CHUNK_SIZE / rowBytes, height));
+
+	for (uint32_t row = 0; row < height;) {
+		const uint32_t numRows = std::min(rowsPerChunk, height - row);
+		const VkDeviceSize chunkBytes = rowBytes * numRows;
+
+		const VkCommandBuffer commandBuffer = BeginChunk();
+
+		const VkDeviceSize stagingOffset = m_CurrentChunk * CHUNK_SIZE;
+		fill(m_MappedData + stagingOffset, rowBytes * row, chunkBytes);
+
+		VkBufferImageCopy region{};
+		region.bufferOffset = stagingOffset;
+		region.bufferRowLength = 0;
+		region.bufferImageHeight = 0;
+		region.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, mipLevel, 0, 1 };
+		region.imageOffset = { 0, static_cast<int32_t>(row), 0 };
+		region.imageExtent = { width, numRows, 1 };
+		vkCmdCopyBufferToImage(commandBuffer, m_StagingBuffer, dstImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+
+		SubmitChunk(chunkBytes);
+		row += numRows;
+	}
+
+	WaitForAll();
+}
+
+void wVkUploadContext::UploadMipChain(VkImage dstImage, const wVkMipChain& chain, uint32_t firstMip, uint32_t arrayLayer)
+{
+	std::vector<VkBufferImageCopy> regions;
+
+	for (uint32_t mip = firstMip; mip < chain.GetNumLevels();) {
+		const VkDeviceSize levelBytes = chain.GetLevelSize(mip);
+		if (levelBytes > CHUNK_SIZE) {
+			UploadLevelRows(dstImage, mip - firstMip, arrayLayer, chain, mip);
+			mip++;
+			continue;
+		}
+
+		const VkCommandBuffer commandBuffer = BeginChunk();
+		const VkDeviceSize stagingOffset = m_CurrentChunk * CHUNK_SIZE;
+
+		// Levels are contiguous in the chain, so are the ones we take, a single memcpy fills the chunk
+		const uint32_t chunkFirstMip = mip;
+		VkDeviceSize chunkBytes = 0;
+		regions.clear();
+		while (mip < chain.GetNumLevels() && chunkBytes + chain.GetLevelSize(mip) <= CHUNK_SIZE) {
+			VkBufferImageCopy region{};
+			region.bufferOffset = stagingOffset + chunkBytes;
+			region.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, mip - firstMip, arrayLayer, 1 };
+			region.imageExtent = { chain.GetLevelWidth(mip), chain.GetLevelHeight(mip), 1 };
+			regions.push_back(region);
+
+			chunkBytes += chain.GetLevelSize(mip);
+			mip++;
+		}
+
+		memcpy(m_MappedData + stagingOffset, chain.GetLevel(chunkFirstMip), static_cast<size_t>(chunkBytes));
+		vkCmdCopyBufferToImage(commandBuffer, m_StagingBuffer, dstImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, static_cast<uint32_t>(regions.size()), regions.data());
+
+		SubmitChunk(chunkBytes);
+	}
+
+	WaitForAll();
+}
+
+void wVkUploadContext::UploadLevelRows(VkImage dstImage, uint32_t dstMip, uint32_t arrayLayer, const wVkMipChain& chain, uint32_t mip)
+{
+	const uint32_t width = chain.GetLevelWidth(mip);
+	const uint32_t height = chain.GetLevelHeight(mip);
+	const uint32_t blockRows = chain.GetLevelBlocksHigh(mip);
+	const VkDeviceSize blockRowBytes = static_cast<VkDeviceSize>(chain.GetLevelBlocksWide(mip)) * chain.m_BytesPerBlock;
+	const uint8_t* level = chain.GetLevel(mip);
+
+	ASSERT(blockRowBytes <= CHUNK_SIZE, "A single row of blocks %i texels wide doesn't fit in a staging chunk", static_cast<int>(width));
+	const uint32_t rowsPerChunk = static_cast<uint32_t>(std::min<VkDeviceSize>(CHUNK_SIZE / blockRowBytes, blockRows));
+
+	for (uint32_t row = 0; row < blockRows;) {
+		const uint32_t numRows = std::min(rowsPerChunk, blockRows - row);
+		const VkDeviceSize chunkBytes = blockRowBytes * numRows;
+
+		const VkCommandBuffer commandBuffer = BeginChunk();
+
+		const VkDeviceSize stagingOffset = m_CurrentChunk * CHUNK_SIZE;
+		memcpy(m_MappedData + stagingOffset, level + blockRowBytes * row, static_cast<size_t>(chunkBytes));
+
+		// The last row of blocks can hang over the bottom of the level, the extent stops at the edge
+		const uint32_t firstTexelRow = row * chain.m_BlockDimension;
+		VkBufferImageCopy region{};
+		region.bufferOffset = stagingOffset;
+		region.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, dstMip, arrayLayer, 1 };
+		region.imageOffset = { 0, static_cast<int32_t>(firstTexelRow), 0 };
+		region.imageExtent = { width, std::min(numRows * chain.m_BlockDimension, height - firstTexelRow), 1 };
+		vkCmdCopyBufferToImage(commandBuffer, m_StagingBuffer, dstImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+
+		SubmitChunk(chunkBytes);
+		row += numRows;
+	}
+
+	WaitForAll();
+}
+
+void wVkUploadContext::UpdateImageRegion(wVkTexture2D& texture, uint32_t mipLevel, uint32_t x, uint32_t y, uint32_t width, uint32_t height, uint32_t bytesPerPixel, const void* data)
+{
+	ASSERT(mipLevel < texture.m_TexMipLevels, "Mip %i isn't resident", static_cast<int>(mipLevel));
+
+	const uint32_t mipWidth = std::max(texture.m_Width >> mipLevel, 1u);
+	const uint32_t mipHeight = std::max(texture.m_Height >> mipLevel, 1u);
+	ASSERT(width > 0 && height > 0 && x + width <= mipWidth && y + height <= mipHeight, "Region doesn't fit in mip %i", static_cast<int>(mipLevel));
+
+	const VkDeviceSize rowBytes = static_cast<VkDeviceSize>(width) * bytesPerPixel;
+	ASSERT(rowBytes <= CHUNK_SIZE, "A single row of %i pixels doesn't fit in a staging chunk", static_cast<int>(width));
+	const uint32_t rowsPerChunk = static_cast<uint32_t>(std::min<VkDeviceSize>(CHUNK_SIZE / rowBytes, height));
+
+	// Frames in flight may still sample the mip, the first barrier waits for them (same queue, submitted earlier).
+	// Between command lists every mip rests in SHADER_READ_ONLY, a partial update has to keep the texels outside the region.
+	const bool wholeMip = width == mipWidth && height == mipHeight;
+	const VkImageLayout oldLayout = wholeMip ? VK_IMAGE_LAYOUT_UNDEFINED : VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	const uint8_t* src = static_cast<const uint8_t*>(data);
+
+	for (uint32_t row = 0; row < height;) {
+		const uint32_t numRows = std::min(rowsPerChunk, height - row);
+		const VkDeviceSize chunkBytes = rowBytes * numRows;
+
+		const VkCommandBuffer commandBuffer = BeginChunk();
+
+		if (row == 0) {
+			wVkHelpers::recordImageBarrier(commandBuffer, texture.m_TextureImage, mipLevel, 1, oldLayout, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+				VK_ACCESS_MEMORY_WRITE_BIT, VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+		}
+
+		const VkDeviceSize stagingOffset = m_CurrentChunk * CHUNK_SIZE;
+		memcpy(m_MappedData + stagingOffset, src + rowBytes * row, static_cast<size_t>(chunkBytes));
+
+		VkBufferImageCopy region{};
+		region.bufferOffset = stagingOffset;
+		region.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, mipLevel, 0, 1 };
+		region.imageOffset = { static_cast<int32_t>(x), static_cast<int32_t>(y + row), 0 };
+		region.imageExtent = { width, numRows, 1 };
+		vkCmdCopyBufferToImage(commandBuffer, m_StagingBuffer, texture.m_TextureImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+
+		row += numRows;
+		if (row == height) {
+			wVkHelpers::recordImageBarrier(commandBuffer, texture.m_TextureImage, mipLevel, 1, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+				VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT);
+		}
+
+		SubmitChunk(chunkBytes);
+	}
+}
@@ -0,0 +1,74 @@
+#pragma once
+#include <cstdint>
+#include <functional>
+
+#include "vulkan/vulkan.h"
+
+#include "wVkConstants.h"
+
+struct wVkMipChain;
+struct wVkTexture2D;
+
+// Fixed size staging window all CPU -> GPU uploads stream through.
+// The window is split in halves that get filled and submitted in turns, so the CPU copy of one chunk overlaps
+// the GPU copy of the previous one and host visible memory stays bounded no matter how big the resource is.
+// Uploads are synchronous, they return once the last chunk has been copied on the GPU.
+class wVkUploadContext
+{
+public:
+	void Initialize();
+	void Destroy();
+
+	// Writes bytes [offset, offset + size) of what's being uploaded to destination, which points into the mapped staging
+	// window. Called in order, so data can be generated or decoded straight into staging without a copy of its own.
+	using FillFn = std::function<void(uint8_t* destination, VkDeviceSize offset, VkDeviceSize size)>;
+
+	// Ordered after everything submitted before it, the buffer can still be in use by frames in flight
+	void UploadToBuffer(VkBuffer dstBuffer, VkDeviceSize dstOffset, const void* data, VkDeviceSize size);
+	// Chunks are split on multiples of granularity, e.g. the element stride, so fill never gets part of an element
+	void UploadToBuffer(VkBuffer dstBuffer, VkDeviceSize dstOffset, VkDeviceSize size, VkDeviceSize granularity, const FillFn& fill);
+
+	// Image has to be in TRANSFER_DST_OPTIMAL. Rows are tightly packed, chunks are split on row boundaries.
+	void UploadToImage(VkImage dstImage, uint32_t mipLevel, uint32_t width, uint32_t height, uint32_t bytesPerPixel, const void* data);
+	void UploadToImage(VkImage dstImage, uint32_t mipLevel, uint32_t width, uint32_t height, uint32_t bytesPerPixel, const FillFn& fill);
+
+	// Levels firstMip and smaller of the chain go to image mips 0 and up of one array layer, image has to be in TRANSFER_DST_OPTIMAL.
+	// As many whole levels as fit share a chunk and a single copy, only levels bigger than a chunk get split in rows
+	// (rows of blocks for block compressed chains).
+	void UploadMipChain(VkImage dstImage, const wVkMipChain& chain, uint32_t firstMip = 0, uint32_t arrayLayer = 0);
+
+	// Rows of width x height texels at (x, y) of one resident mip, tightly packed. Unlike the uploads above it doesn't wait,
+	// the texels are in staging when it returns and the copies are queued ahead of the next frame, which is what textures
+	// that change every frame need. Only the touched mip is transitioned, from and back to SHADER_READ_ONLY where textures
+	// rest between command lists. A region covering the whole mip discards the old texels instead of waiting on them.
+	void UpdateImageRegion(wVkTexture2D& texture, uint32_t mipLevel, uint32_t x, uint32_t y, uint32_t width, uint32_t height, uint32_t bytesPerPixel, const void* data);
+
+	VkDeviceSize GetWindowSize() const { return wVkConstants::g_StagingWindowSize; }
+	uint64_t GetTotalUploadedBytes() const { return m_TotalUploadedBytes; }
+
+private:
+	static constexpr uint32_t NUM_CHUNKS = 2;
+	static constexpr VkDeviceSize CHUNK_SIZE = wVkConstants::g_StagingWindowSize / NUM_CHUNKS;
+
+	// Waits for the chunk to be free and starts recording into it
+	VkCommandBuffer BeginChunk();
+	void SubmitChunk(VkDeviceSize usedBytes);
+	void WaitForAll();
+
+	// A level too big for a chunk, in as many rows of blocks as fit per chunk
+	void UploadLevelRows(VkImage dstImage, uint32_t dstMip, uint32_t arrayLayer, const wVkMipChain& chain, uint32_t mip);
+
+	VkBuffer m_StagingBuffer = VK_NULL_HANDLE;
+	VkDeviceMemory m_StagingMemory = VK_NULL_HANDLE;
+	VkMemoryPropertyFlags m_MemoryProperties = 0;
+	uint8_t* m_MappedData = nullptr;
+	uint64_t m_RegistryId = 0;
+
+	VkCommandPool m_CommandPool = VK_NULL_HANDLE;
+	VkCommandBuffer m_CommandBuffers[NUM_CHUNKS] = {};
+	VkFence m_Fences[NUM_CHUNKS] = {};
+	bool m_InFlight[NUM_CHUNKS] = {};
+	uint32_t m_CurrentChunk = 0;
+
+	uint64_t m_TotalUploadedBytes = 0;
+};
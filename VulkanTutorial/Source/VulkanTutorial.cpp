@@ -11,19 +11,28 @@
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb/stb_image.h"
 
+// The decoder's workers call stbi_failure_reason concurrently, it's only safe with a per thread reason
+#ifndef STBI_THREAD_LOCAL
+#error "stb_image has no thread local failure reason on this compiler"
+#endif
+
 #include <vulkan/vulkan.h>
 
 #include <glm/glm.hpp>
+#include <glm/gtc/constants.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
 #include <cstdint>		// Necessary for uint32_t
 #include <algorithm>	// Necessary for std::clamp
 #include <array>
 #include <cassert>
+#include <chrono>
+#include <cmath>
 #include <iostream>
 #include <string>
 #include <stdexcept>
 #include <cstdlib>
+#include <memory>
 #include <optional>
 #include <vector>
 
@@ -44,6 +53,7 @@
 #include "BEARHeaders/CommandList.h"
 #include "BEARHeaders/ComputePipelineDescription.h"
 #include "BEARHeaders/ResourceDescriptorHeap.h"
+#include "BEARHeaders/ResourcePool.h"
 #include "BEARHeaders/Sampler.h"
 #include "BEARHeaders/SamplerDescriptorHeap.h"
 #include "BEARHeaders/ShaderLayout.h"
@@ -51,9 +61,9 @@
 #include "BEARHeaders/TLAS.h"
 
 #include "BEARVulkan/TypeDefs.h"
+#include "BEARVulkan/wVkFrameRecorder.h"
 #include "BEARVulkan/wVkGlobalVariables.h"
 #include "BEARVulkan/wVkHelpers/wVkCommands.h"
-#include "BEARVulkan/wVkHelpers/wVkDepth.h"
 #include "BEARVulkan/wVkHelpers/wVkImGui.h"
 #include "BEARVulkan/wVkHelpers/wVkInstance.h"
 #include "BEARVulkan/wVkHelpers/wVkQueueFamilies.h"
@@ -75,7 +85,15 @@ std::vector<VkDynamicState> g_dynamicStatesOps = {
 };
 
 
-constexpr int PARTICLE_COUNT = (5000 * 256);
+constexpr uint64_t PARTICLE_COUNT = (5000 * 256);
+
+// Headless runs render this many frames unless told otherwise, on a fixed clock of this step
+constexpr uint32_t HEADLESS_DEFAULT_FRAMES = 600;
+constexpr float HEADLESS_FRAME_TIME_MS = 1000.0f / 60.0f;
+
+// Recordings fly one orbit around the model over all of their frames, starting where the interactive camera does
+constexpr float RECORD_ORBIT_RADIUS = 10.0f;
+constexpr float RECORD_ORBIT_HEIGHT = 2.0f;
 struct Particle {
 	glm::vec3 position;
 	float pad0;
@@ -275,12 +293,19 @@ const std::vector<uint16_t> g_indices = {
 
 class HelloTriangleApplication {
 public:
-	void Run() {
+	// Headless there's no window, frames render offscreen on a fixed clock and the app exits after numFrames.
+	// With a recordDirectory every frame is also written there as a PNG, recording is always headless.
+	void Run(bool headless, uint32_t numFrames, const std::string& recordDirectory) {
 
 		float i = 35.f;
 		fnDependencyProj(i);
 
-		InitWindow();
+		m_Headless = headless;
+		m_HeadlessFrames = numFrames;
+		m_RecordDirectory = recordDirectory;
+
+		if (!m_Headless)
+			InitWindow();
 		InitVulkan();
 		MainLoop();
 		Cleanup();
@@ -466,7 +491,7 @@ private:
 		pipelineLayoutInfo.pPushConstantRanges = nullptr; // Optional
 		pipelineLayoutInfo.setLayoutCount = 1;
 
-		if (vkCreatePipelineLayout(wVkGlobals::g_Device, &pipelineLayoutInfo, nullptr, &m_PipelineLayout) != VK_SUCCESS) {
+		if (vkCreatePipelineLayout(wVkGlobals::g_Device, &pipelineLayoutInfo, wVkGlobals::g_AllocationCallbacks, &m_PipelineLayout) != VK_SUCCESS) {
 			throw std::runtime_error("failed to create pipeline layout!");
 		}
 
@@ -489,8 +514,12 @@ private:
 
 	void createRenderPass() {
 
+		// No render pass, the pipelines draw in the graph's rendering scope
+		const VkPipelineRenderingCreateInfoKHR renderingInfo = wVkGlobals::g_RenderingFormats.GetCreateInfo();
+
 		VkGraphicsPipelineCreateInfo pipelineInfo{};
 		pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+		pipelineInfo.pNext = &renderingInfo;
 
 		// Shader Stages
 		pipelineInfo.stageCount = 2;
@@ -507,13 +536,13 @@ private:
 		pipelineInfo.pDynamicState = &m_FixedFuncStages.dynamicState;
 
 		pipelineInfo.layout = m_PipelineLayout; // Empty 
-		pipelineInfo.renderPass = wVkGlobals::g_RenderPass;
+		pipelineInfo.renderPass = VK_NULL_HANDLE;
 		pipelineInfo.subpass = 0;
 
 		pipelineInfo.basePipelineHandle = VK_NULL_HANDLE; // Optional
 		pipelineInfo.basePipelineIndex = -1; // Optional
 
-		if (vkCreateGraphicsPipelines(wVkGlobals::g_Device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &m_GraphicsPipeline) != VK_SUCCESS) {
+		if (vkCreateGraphicsPipelines(wVkGlobals::g_Device, VK_NULL_HANDLE, 1, &pipelineInfo, wVkGlobals::g_AllocationCallbacks, &m_GraphicsPipeline) != VK_SUCCESS) {
 			throw std::runtime_error("failed to create graphics pipeline!");
 		}
 
@@ -551,13 +580,13 @@ private:
 		pipelineInfo.pDynamicState = &m_FixedFuncStages.dynamicState;
 
 		pipelineInfo.layout = m_PipelineLayout; // Empty 
-		pipelineInfo.renderPass = wVkGlobals::g_RenderPass;
+		pipelineInfo.renderPass = VK_NULL_HANDLE;
 		pipelineInfo.subpass = 0;
 
 		pipelineInfo.basePipelineHandle = VK_NULL_HANDLE; // Optional
 		pipelineInfo.basePipelineIndex = -1; // Optional
 
-		if (vkCreateGraphicsPipelines(wVkGlobals::g_Device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &m_GraphicsPipelinePoints) != VK_SUCCESS) {
+		if (vkCreateGraphicsPipelines(wVkGlobals::g_Device, VK_NULL_HANDLE, 1, &pipelineInfo, wVkGlobals::g_AllocationCallbacks, &m_GraphicsPipelinePoints) != VK_SUCCESS) {
 			throw std::runtime_error("failed to create graphics pipeline!");
 		}
 
@@ -590,99 +619,81 @@ private:
 			throw std::runtime_error("failed to begin recording command buffer!");
 		}
 
-		VkRenderPassBeginInfo renderPassInfo{};
-		renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-		renderPassInfo.renderPass = wVkGlobals::g_RenderPass;
-		renderPassInfo.framebuffer = wVkGlobals::g_SwapChainFramebuffers[imageIndex];
-
-		renderPassInfo.renderArea.offset = { 0, 0 };
-		renderPassInfo.renderArea.extent = wVkGlobals::g_SwapChain.swapChainExtent;
-
-		std::array<VkClearValue, 2> clearValues{};
-		clearValues[0].color = { m_ClearColor.r, m_ClearColor.g, m_ClearColor.b, m_ClearColor.a};
-		clearValues[1].depthStencil = { 1.0f, 0 };
-
-		renderPassInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
-		renderPassInfo.pClearValues = clearValues.data();
-
-		vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
-
-		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_GraphicsPipeline);
-
-		// Bind scissor and other shit here if dynamic
-		VkViewport viewport{};
-		viewport.x = 0.0f;
-		viewport.y = 0.0f;
-		viewport.width = static_cast<float>(wVkGlobals::g_SwapChain.swapChainExtent.width);
-		viewport.height = static_cast<float>(wVkGlobals::g_SwapChain.swapChainExtent.height);
-		viewport.minDepth = 0.0f;
-		viewport.maxDepth = 1.0f;
-		vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
-
-		VkRect2D scissor{};
-		scissor.offset = { 0, 0 };
-		scissor.extent = wVkGlobals::g_SwapChain.swapChainExtent;
-		vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
-
-		VkBuffer vertexBuffers[] = { m_VertexBuffer->GetGPUHandleRef().m_Buffers };
-		VkDeviceSize offsets[] = { 0 };
-		vkCmdBindVertexBuffers(commandBuffer, 0, 1, vertexBuffers, offsets);
-		vkCmdBindIndexBuffer(commandBuffer, m_IndexBuffer->GetGPUHandleRef().m_Buffers, 0, VK_INDEX_TYPE_UINT16);
-		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_PipelineLayout, 0, 1, &m_DescriptorSets[currentFrame], 0, nullptr);
-		vkCmdDrawIndexed(commandBuffer, static_cast<uint32_t>(g_indices.size()), 1, 0, 0, 0);
-		
-		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_GraphicsPipelinePoints);
-
-		vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
-		vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
-		vkCmdBindVertexBuffers(commandBuffer, 0, 1, &m_ParticleBuffers[currentFrame]->GetGPUHandleRef().m_Buffers, offsets);
-		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_PipelineLayout, 0, 1, &m_DescriptorSets[currentFrame], 0, nullptr);
-
-		vkCmdDraw(commandBuffer, PARTICLE_COUNT, 1, 0, 0);
-
-		vkCmdEndRenderPass(commandBuffer);
-
-		// Synchronize depth as both the ImGui Render Pass and the
-		// Draw render pass will try to run at the same time (WAW error)
-		VkImageMemoryBarrier barrier = {};
-		barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-		barrier.oldLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
-		barrier.newLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
-		barrier.srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
-		barrier.dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT ;
-		barrier.image = wVkGlobals::g_DepthImage;
-		barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
-		barrier.subresourceRange.baseMipLevel = 0;
-		barrier.subresourceRange.levelCount = 1;
-		barrier.subresourceRange.baseArrayLayer = 0;
-		barrier.subresourceRange.layerCount = 1;
-
-		vkCmdPipelineBarrier(
-			commandBuffer,
-			VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT, // Source stage
-			VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT, // Destination stage
-			0, // Dependency flags
-			0, nullptr, // Memory barrier count and pointer
-			0, nullptr, // Buffer barrier count and pointer
-			1, &barrier); // Image barrier count and pointer
-
-		// ImGui Render Pass
+		const VkExtent2D extent = wVkGlobals::g_SwapChain.swapChainExtent;
+
+		// Barriers, layouts, load/store ops and the depth buffer all come from what the passes declare
+		wVkRenderGraph& graph = wVkGlobals::g_RenderGraph;
+		graph.Reset();
+
+		// Swapchain images are handed over by the acquire semaphore, which the submit waits on at COLOR_ATTACHMENT_OUTPUT
+		const VkImageLayout backBufferFinalLayout = wVkGlobals::g_Headless ? VK_IMAGE_LAYOUT_UNDEFINED : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+		const wVkGraphResource backBuffer = graph.ImportImage("Back Buffer", wVkGlobals::g_SwapChainImages[imageIndex], wVkGlobals::g_SwapChainImageViews[imageIndex],
+			wVkGlobals::g_SwapChain.swapChainImageFormat, extent, VK_IMAGE_LAYOUT_UNDEFINED, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, backBufferFinalLayout);
+		const wVkGraphResource depth = graph.CreateTransient("Depth", { m_DepthFormat, extent, 0 });
+
+		const VkClearColorValue clearColor = { { m_ClearColor.r, m_ClearColor.g, m_ClearColor.b, m_ClearColor.a } };
+		const VkClearDepthStencilValue clearDepth = { 1.0f, 0 };
+
+		graph.AddPass("Scene", [&](VkCommandBuffer cmd)
 		{
-			VkRenderPassBeginInfo info = {};
-			info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-			info.renderPass = wVkGlobals::g_ImGuiRenderPass;
-			info.framebuffer = wVkGlobals::g_SwapChainFramebuffers[imageIndex];
-			info.renderArea.offset = { 0 , 0 };
-			info.renderArea.extent = wVkGlobals::g_SwapChain.swapChainExtent;
-			info.clearValueCount = static_cast<uint32_t>(clearValues.size());
-			info.pClearValues = clearValues.data();
-			vkCmdBeginRenderPass(commandBuffer, &info, VK_SUBPASS_CONTENTS_INLINE);
+			vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, m_GraphicsPipeline);
+
+			// Bind scissor and other shit here if dynamic
+			VkViewport viewport{};
+			viewport.x = 0.0f;
+			viewport.y = 0.0f;
+			viewport.width = static_cast<float>(extent.width);
+			viewport.height = static_cast<float>(extent.height);
+			viewport.minDepth = 0.0f;
+			viewport.maxDepth = 1.0f;
+			vkCmdSetViewport(cmd, 0, 1, &viewport);
+
+			VkRect2D scissor{};
+			scissor.offset = { 0, 0 };
+			scissor.extent = extent;
+			vkCmdSetScissor(cmd, 0, 1, &scissor);
+
+			VkBuffer vertexBuffers[] = { m_BufferPool[m_VertexBuffer].GetGPUHandleRef().m_Buffers };
+			VkDeviceSize offsets[] = { 0 };
+			vkCmdBindVertexBuffers(cmd, 0, 1, vertexBuffers, offsets);
+			vkCmdBindIndexBuffer(cmd, m_BufferPool[m_IndexBuffer].GetGPUHandleRef().m_Buffers, 0, VK_INDEX_TYPE_UINT16);
+			bindDescriptorSet(cmd, currentFrame);
+			vkCmdDrawIndexed(cmd, static_cast<uint32_t>(g_indices.size()), 1, 0, 0, 0);
+
+			vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, m_GraphicsPipelinePoints);
+
+			vkCmdSetViewport(cmd, 0, 1, &viewport);
+			vkCmdSetScissor(cmd, 0, 1, &scissor);
+			vkCmdBindVertexBuffers(cmd, 0, 1, &m_BufferPool[m_ParticleBuffers[currentFrame]].GetGPUHandleRef().m_Buffers, offsets);
+			bindDescriptorSet(cmd, currentFrame);
+
+			vkCmdDraw(cmd, static_cast<uint32_t>(PARTICLE_COUNT), 1, 0, 0);
+		})
+			.WriteColor(backBuffer, &clearColor)
+			.WriteDepth(depth, &clearDepth);
+
+		// Copies the finished scene out to this slot's readback
+		if (m_FrameRecorder.IsInitialized()) {
+			graph.AddPass("Frame Readback", [&](VkCommandBuffer cmd)
+			{
+				m_FrameRecorder.Record(cmd, wVkGlobals::g_SwapChainImages[imageIndex], currentFrame, m_HeadlessFrame);
+			})
+				.ReadTransfer(backBuffer)
+				.SetSideEffects();
 		}
 
-		// Record Imgui Draw Data and draw funcs into command buffer
-		ImGui_ImplVulkan_RenderDrawData(ImGui::GetDrawData(), commandBuffer);
+		// Headless there's no UI, the scene pass is the whole frame
+		if (!wVkGlobals::g_Headless) {
+			// Draws over the scene without depth, it joins the scene's rendering scope so depth is never stored
+			graph.AddPass("ImGui", [](VkCommandBuffer cmd)
+			{
+				ImGui_ImplVulkan_RenderDrawData(ImGui::GetDrawData(), cmd);
+			})
+				.WriteColor(backBuffer);
+		}
 
-		vkCmdEndRenderPass(commandBuffer);
+		graph.Compile();
+		graph.Execute(commandBuffer);
 
 		if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
 			throw std::runtime_error("failed to record command buffer!");
@@ -699,9 +710,9 @@ private:
 		fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT; //To make sure we get to our first frame
 
 		for (size_t i = 0; i < wVkConstants::g_MaxFramesInFlight; i++) {
-			if (vkCreateSemaphore(wVkGlobals::g_Device, &semaphoreInfo, nullptr, &m_ImageAvailableSemaphore[i]) != VK_SUCCESS ||
-				vkCreateSemaphore(wVkGlobals::g_Device, &semaphoreInfo, nullptr, &m_RenderFinishedSemaphore[i]) != VK_SUCCESS ||
-				vkCreateFence(wVkGlobals::g_Device, &fenceInfo, nullptr, &m_InFlightFence[i]) != VK_SUCCESS) {
+			if (vkCreateSemaphore(wVkGlobals::g_Device, &semaphoreInfo, wVkGlobals::g_AllocationCallbacks, &m_ImageAvailableSemaphore[i]) != VK_SUCCESS ||
+				vkCreateSemaphore(wVkGlobals::g_Device, &semaphoreInfo, wVkGlobals::g_AllocationCallbacks, &m_RenderFinishedSemaphore[i]) != VK_SUCCESS ||
+				vkCreateFence(wVkGlobals::g_Device, &fenceInfo, wVkGlobals::g_AllocationCallbacks, &m_InFlightFence[i]) != VK_SUCCESS) {
 				throw std::runtime_error("failed to create semaphores!");
 			}
 		}
@@ -719,7 +730,7 @@ private:
 		for (size_t i = 0; i < wVkConstants::g_MaxFramesInFlight; i++) {
 			constexpr BufferFlags uboFlags = BufferFlags::CBV;
 			const std::string uboName = "Camera Ubo " + std::to_string(i);
-			m_CameraBuffer[i] = new Buffer(nullptr, sizeof(UniformBufferObject), 1, uboFlags, uboName);
+			m_CameraBuffer[i] = m_BufferPool.Create(nullptr, sizeof(UniformBufferObject), 1, uboFlags, uboName, Callsite::Current());
 		}
 	}
 
@@ -737,8 +748,8 @@ private:
 		for (size_t i = 0; i < wVkConstants::g_MaxFramesInFlight; i++) {
 			const BufferFlags flags = BufferFlags::CBV;
 			std::string name = "DeltaTime Buffer for Particles " + std::to_string(i);
-			m_DtConstbuffer[i] = new Buffer(nullptr, sizeof(float), 1, flags, name);
-			m_ColourBuffer[i] = new Buffer(nullptr, sizeof(glm::vec4), 1, flags, name);
+			m_DtConstbuffer[i] = m_BufferPool.Create(nullptr, sizeof(float), 1, flags, name, Callsite::Current());
+			m_ColourBuffer[i] = m_BufferPool.Create(nullptr, sizeof(glm::vec4), 1, flags, name, Callsite::Current());
 		}
 	}
 
@@ -766,7 +777,7 @@ private:
 		layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
 		layoutInfo.pBindings = bindings.data();
 
-		if (vkCreateDescriptorSetLayout(wVkGlobals::g_Device, &layoutInfo, nullptr, &m_DescSetLayout) != VK_SUCCESS) {
+		if (vkCreateDescriptorSetLayout(wVkGlobals::g_Device, &layoutInfo, wVkGlobals::g_AllocationCallbacks, &m_DescSetLayout) != VK_SUCCESS) {
 			throw std::runtime_error("failed to create descriptor set layout!");
 		}
 	}
@@ -786,7 +797,7 @@ private:
 		poolInfo.maxSets = static_cast<uint32_t>(wVkConstants::g_MaxFramesInFlight);
 
 
-		if (vkCreateDescriptorPool(wVkGlobals::g_Device, &poolInfo, nullptr, &m_DescPool) != VK_SUCCESS) {
+		if (vkCreateDescriptorPool(wVkGlobals::g_Device, &poolInfo, wVkGlobals::g_AllocationCallbacks, &m_DescPool) != VK_SUCCESS) {
 			throw std::runtime_error("failed to create descriptor pool!");
 		}
 
@@ -807,108 +818,262 @@ private:
 		}
 
 		for (size_t i = 0; i < wVkConstants::g_MaxFramesInFlight; i++) {
-			VkDescriptorBufferInfo bufferInfo{};
-			bufferInfo.buffer = m_CameraBuffer[i]->GetGPUHandleRef().m_Buffers;
-			bufferInfo.offset = 0;
-			bufferInfo.range = sizeof(UniformBufferObject);
-
-			VkDescriptorImageInfo imageInfo{};
-			imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-			imageInfo.imageView = m_Texture->GetGPUHandleRef().m_TextureImageView;
-			imageInfo.sampler = m_Sampler->GetGPUHandleRef().m_Sampler;
-
-			std::array<VkWriteDescriptorSet, 2> descriptorWrites{};
-
-			descriptorWrites[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-			descriptorWrites[0].dstSet = m_DescriptorSets[i];
-			descriptorWrites[0].dstBinding = 0;
-			descriptorWrites[0].dstArrayElement = 0;
-			descriptorWrites[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-			descriptorWrites[0].descriptorCount = 1;
-			descriptorWrites[0].pBufferInfo = &bufferInfo;
-
-			descriptorWrites[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-			descriptorWrites[1].dstSet = m_DescriptorSets[i];
-			descriptorWrites[1].dstBinding = 1;
-			descriptorWrites[1].dstArrayElement = 0;
-			descriptorWrites[1].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-			descriptorWrites[1].descriptorCount = 1;
-			descriptorWrites[1].pImageInfo = &imageInfo;
-
-			vkUpdateDescriptorSets(wVkGlobals::g_Device, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
+			writeDescriptorSet(i);
 		}
 	}
 
+	// Sum of the relocation counters of everything in the set, the defragmenter bumps them when it moves a resource
+	uint32_t getDescriptorSetRelocations(size_t frame)
+	{
+		return m_BufferPool[m_CameraBuffer[frame]].GetGPUHandleRef().m_Relocations + m_TexturePool[m_Texture].GetGPUHandleRef().m_Relocations;
+	}
+
+	// Every texture the set holds counts as used this frame, it's what the residency manager evicts by
+	void bindDescriptorSet(VkCommandBuffer cmd, size_t frame)
+	{
+		vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, m_PipelineLayout, 0, 1, &m_DescriptorSets[frame], 0, nullptr);
+		wVkGlobals::g_ResidencyManager.MarkUsed(m_TexturePool[m_Texture].GetGPUHandleRef());
+	}
+
+	void writeDescriptorSet(size_t i)
+	{
+		VkDescriptorBufferInfo bufferInfo{};
+		bufferInfo.buffer = m_BufferPool[m_CameraBuffer[i]].GetGPUHandleRef().m_Buffers;
+		bufferInfo.offset = 0;
+		bufferInfo.range = sizeof(UniformBufferObject);
+
+		VkDescriptorImageInfo imageInfo{};
+		imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		imageInfo.imageView = m_TexturePool[m_Texture].GetGPUHandleRef().m_TextureImageView;
+		imageInfo.sampler = m_SamplerPool[m_Sampler].GetGPUHandleRef().m_Sampler;
+
+		std::array<VkWriteDescriptorSet, 2> descriptorWrites{};
+
+		descriptorWrites[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		descriptorWrites[0].dstSet = m_DescriptorSets[i];
+		descriptorWrites[0].dstBinding = 0;
+		descriptorWrites[0].dstArrayElement = 0;
+		descriptorWrites[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+		descriptorWrites[0].descriptorCount = 1;
+		descriptorWrites[0].pBufferInfo = &bufferInfo;
+
+		descriptorWrites[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		descriptorWrites[1].dstSet = m_DescriptorSets[i];
+		descriptorWrites[1].dstBinding = 1;
+		descriptorWrites[1].dstArrayElement = 0;
+		descriptorWrites[1].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		descriptorWrites[1].descriptorCount = 1;
+		descriptorWrites[1].pImageInfo = &imageInfo;
+
+		vkUpdateDescriptorSets(wVkGlobals::g_Device, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
+
+		m_DescriptorSetRelocations[i] = getDescriptorSetRelocations(i);
+	}
+
 
 	void createTextureImage()
 	{
+		// Only the header is read here, the pixels are decoded and uploaded in the background by the texture streamer
 		int texWidth, texHeight, texChannels;
 		constexpr auto filePath = R"(Resources\Images\bricks.png)";
-		stbi_uc* pixels = stbi_load(filePath, &texWidth, &texHeight, &texChannels, STBI_rgb_alpha);
-
-		if (!pixels) {
+		if (!stbi_info(filePath, &texWidth, &texHeight, &texChannels)) {
+			LOG_ERROR("STB_IMAGE Error: %s", stbi_failure_reason());
 			throw std::runtime_error("failed to load texture image!");
 		}
 
+		LOG_INFO("Streaming image: %s ", filePath);
+		LOG_INFO("Dimensions: %i x %i", texWidth, texHeight);
+		LOG_INFO("Channels: %i", texChannels);
+
+		// BC7 is a quarter of the memory, the streamer encodes it on the decode workers
 		TextureSpec spec{
 			texWidth,
 			texHeight,
-			TextureFormat::R8G8B8A8_SRGB,
+			Texture::IsFormatSupported(TextureFormat::BC7_SRGB) ? TextureFormat::BC7_SRGB : TextureFormat::R8G8B8A8_SRGB,
 			TextureType::R_TEXTURE,
-			TextureFlags::MIPMAP_GENERATE
+			TextureFlags::MIPMAP_GENERATE | TextureFlags::STREAMED
 		};
 		
-		m_Texture = new Texture(pixels, spec, "Test Texture");
+		m_Texture = m_TexturePool.Create(nullptr, spec, "Test Texture", Callsite::Current());
+		wVkGlobals::g_TextureStreamer.Stream(m_TexturePool[m_Texture].GetGPUHandleRef(), filePath);
+	}
+
+	// Embedded textures (as in a .glb) go through the image decoder and are streamed in like any other
+	void loadModelTextures(const aiScene* scene, const std::string& modelPath)
+	{
+		// Colour textures are sRGB, the rest (normals, metallic/roughness, occlusion) is data
+		std::vector<bool> isColour(scene->mNumTextures, false);
+		for (unsigned int m = 0; m < scene->mNumMaterials; m++) {
+			for (const aiTextureType type : { aiTextureType_BASE_COLOR, aiTextureType_DIFFUSE, aiTextureType_EMISSIVE }) {
+				aiString path;
+				if (scene->mMaterials[m]->GetTexture(type, 0, &path) != AI_SUCCESS || path.data[0] != '*')
+					continue;
+
+				const int index = std::atoi(path.C_Str() + 1);
+				if (index >= 0 && index < static_cast<int>(scene->mNumTextures))
+					isColour[index] = true;
+			}
+		}
+
+		const bool useBc7 = Texture::IsFormatSupported(TextureFormat::BC7_SRGB) && Texture::IsFormatSupported(TextureFormat::BC7_UNORM);
+
+		for (unsigned int i = 0; i < scene->mNumTextures; i++) {
+			const aiTexture* texture = scene->mTextures[i];
+			const std::string key = modelPath + "/*" + std::to_string(i);
+			const std::string name = texture->mFilename.length > 0 ? texture->mFilename.C_Str() : key;
+			const bool srgb = isColour[i];
+
+			int width, height;
+			std::shared_ptr<const std::vector<uint8_t>> encoded;
+			std::shared_ptr<std::vector<uint8_t>> rgba;
+			if (texture->mHeight == 0) {
+				// Compressed, mWidth is the size in bytes. Only the header is read here.
+				const uint8_t* bytes = reinterpret_cast<const uint8_t*>(texture->pcData);
+				encoded = std::make_shared<const std::vector<uint8_t>>(bytes, bytes + texture->mWidth);
+
+				int channels;
+				if (!stbi_info_from_memory(encoded->data(), static_cast<int>(encoded->size()), &width, &height, &channels)) {
+					LOG_ERROR("Unsupported embedded texture: %s (%s)", name.c_str(), texture->achFormatHint);
+					continue;
+				}
+			}
+			else {
+				// Uncompressed, aiTexels are BGRA
+				width = static_cast<int>(texture->mWidth);
+				height = static_cast<int>(texture->mHeight);
+
+				const size_t numTexels = static_cast<size_t>(width) * height;
+				rgba = std::make_shared<std::vector<uint8_t>>(numTexels * 4);
+				for (size_t t = 0; t < numTexels; t++) {
+					const aiTexel& texel = texture->pcData[t];
+					(*rgba)[t * 4 + 0] = texel.r;
+					(*rgba)[t * 4 + 1] = texel.g;
+					(*rgba)[t * 4 + 2] = texel.b;
+					(*rgba)[t * 4 + 3] = texel.a;
+				}
+			}
 
-		stbi_image_free(pixels);
+			TextureFormat format = srgb ? TextureFormat::R8G8B8A8_SRGB : TextureFormat::R8G8B8A8_UNORM;
+			if (useBc7)
+				format = srgb ? TextureFormat::BC7_SRGB : TextureFormat::BC7_UNORM;
+
+			TextureSpec spec{
+				width,
+				height,
+				format,
+				TextureType::R_TEXTURE,
+				TextureFlags::MIPMAP_GENERATE | TextureFlags::STREAMED
+			};
+
+			const TextureHandle handle = m_TexturePool.Create(nullptr, spec, name, Callsite::Current());
+			wVkTexture2D& gpuTexture = m_TexturePool[handle].GetGPUHandleRef();
+
+			// Decoded straight to the format the texture was created in
+			wVkDecodeHandle decode;
+			if (encoded)
+				decode = wVkGlobals::g_ImageDecoder.DecodeMemory(key, std::move(encoded), true, gpuTexture.m_Format);
+			else
+				decode = wVkGlobals::g_ImageDecoder.DecodeRaw(key, std::move(rgba), texture->mWidth, texture->mHeight, true, gpuTexture.m_Format);
+
+			wVkGlobals::g_TextureStreamer.Stream(gpuTexture, std::move(decode), name);
+			m_ModelTextures.push_back(handle);
+		}
+
+		LOG_INFO("Embedded textures: %i", static_cast<int>(scene->mNumTextures));
 	}
 
-	void createShaderStorageBuffers()
+	// Pixels the textured quads cover on screen, from the bounding rectangle of their projected vertices
+	float estimateScreenCoverage()
 	{
-		// Initialize particles
-		std::default_random_engine rndEngine((unsigned)time(nullptr));
-		std::uniform_real_distribution<float> rndDist(0.0f, 1.0f);
-
-		// Initial particle positions on a circle
-		std::vector<Particle> particles(PARTICLE_COUNT);
-		for (auto& particle : particles) {
-			// Spherical coordinates
-			float phi = acos(2.0f * rndDist(rndEngine) - 1.0f);  // phi angle
-			float theta = rndDist(rndEngine) * 2.0f * glm::pi<float>();  // theta angle
-
-			constexpr float RADIUS = .5f;        // Radius of the sphere
-			// Conversion to Cartesian coordinates
-			float x = RADIUS * sin(phi) * cos(theta);
-			float y = RADIUS * sin(phi) * sin(theta);
-			float z = RADIUS * cos(phi);
-			particle.position = glm::vec3(x, y, z) * glm::vec3(rndDist(rndEngine));
-
-			// Velocity outward from the center
-			glm::vec3 direction = (particle.position); // Normalize to get the direction
-			constexpr float initialSpeed = 0.01f;  // Modify this value to adjust the initial speed
-			particle.velocity = direction * initialSpeed;
-
-			// Random color for each particle
-			particle.color = glm::vec3(rndDist(rndEngine), rndDist(rndEngine), rndDist(rndEngine));
+		const glm::mat4 mvp = camera.GetProjection() * camera.GetView() * cubeModel.GetModelMatrix();
+
+		glm::vec2 minNdc(1.0f);
+		glm::vec2 maxNdc(-1.0f);
+		bool visible = false;
+		for (const Vertex& vertex : g_vertices) {
+			const glm::vec4 clip = mvp * glm::vec4(vertex.pos, 1.0f);
+			if (clip.w <= 0.0f)
+				continue; // Behind the camera
+
+			const glm::vec2 ndc = glm::vec2(clip) / clip.w;
+			minNdc = glm::min(minNdc, ndc);
+			maxNdc = glm::max(maxNdc, ndc);
+			visible = true;
 		}
 
+		if (!visible)
+			return 0.0f;
+
+		minNdc = glm::clamp(minNdc, glm::vec2(-1.0f), glm::vec2(1.0f));
+		maxNdc = glm::clamp(maxNdc, glm::vec2(-1.0f), glm::vec2(1.0f));
+
+		const VkExtent2D extent = wVkGlobals::g_SwapChain.swapChainExtent;
+		const glm::vec2 size = glm::max(maxNdc - minNdc, glm::vec2(0.0f)) * 0.5f * glm::vec2(extent.width, extent.height);
+		return size.x * size.y;
+	}
+
+	void createShaderStorageBuffers()
+	{
+		// Every frame's buffer starts out with the same particles, each generator replays the same random sequence
+		const unsigned seed = static_cast<unsigned>(time(nullptr));
+
 		const BufferFlags partFlags = BufferFlags::UAV | BufferFlags::ALLOW_UA | BufferFlags::VERTEX_BUFFER; 
 		for(int i = 0; i < wVkConstants::g_MaxFramesInFlight; i++)
 		{
+			std::default_random_engine rndEngine(seed);
+			std::uniform_real_distribution<float> rndDist(0.0f, 1.0f);
+
+			// Initial particle positions on a circle, generated straight into mapped memory instead of a CPU side vector
+			const BufferGenerator generator = [&rndEngine, &rndDist](void* destination, uint64_t, uint64_t numElements) {
+				Particle* particles = static_cast<Particle*>(destination);
+				for (uint64_t p = 0; p < numElements; p++) {
+					Particle& particle = particles[p];
+					particle = Particle{};
+
+					// Spherical coordinates
+					float phi = acos(2.0f * rndDist(rndEngine) - 1.0f);  // phi angle
+					float theta = rndDist(rndEngine) * 2.0f * glm::pi<float>();  // theta angle
+
+					constexpr float RADIUS = .5f;        // Radius of the sphere
+					// Conversion to Cartesian coordinates
+					float x = RADIUS * sin(phi) * cos(theta);
+					float y = RADIUS * sin(phi) * sin(theta);
+					float z = RADIUS * cos(phi);
+					particle.position = glm::vec3(x, y, z) * glm::vec3(rndDist(rndEngine));
+
+					// Velocity outward from the center
+					glm::vec3 direction = (particle.position); // Normalize to get the direction
+					constexpr float initialSpeed = 0.01f;  // Modify this value to adjust the initial speed
+					particle.velocity = direction * initialSpeed;
+
+					// Random color for each particle
+					particle.color = glm::vec3(rndDist(rndEngine), rndDist(rndEngine), rndDist(rndEngine));
+				}
+			};
+
 			std::string name = "Particle Buffer " + std::to_string(i);
-			m_ParticleBuffers[i] = new Buffer(particles.data(), sizeof(Particle), particles.size(), partFlags, name);
+			m_ParticleBuffers[i] = m_BufferPool.Create(sizeof(Particle), PARTICLE_COUNT, generator, partFlags, name, Callsite::Current());
 		}
 	}
 
 	void InitVulkan() {
 
-		m_BackEndRenderer.Initialize(m_Window, nullptr, nullptr);
+		if (m_Headless)
+			m_BackEndRenderer.InitializeHeadless(WIDTH, HEIGHT);
+		else
+			m_BackEndRenderer.Initialize(m_Window, nullptr, nullptr);
+
+		if (!m_RecordDirectory.empty())
+			m_FrameRecorder.Initialize(WIDTH, HEIGHT, m_RecordDirectory);
 
 		createUniformBuffers();
 		createDtBuffers();
 
 		createTextureImage();
-		m_Sampler = new Sampler(MinFilter::NEAREST_MIPMAP_NEAREST, MagFilter::NEAREST, WrapUV::MIRRORED_REPEAT);
+		m_Sampler = m_SamplerPool.Create(MinFilter::NEAREST_MIPMAP_NEAREST, MagFilter::NEAREST, WrapUV::MIRRORED_REPEAT);
+
+		// Has to be what the pipelines were created with
+		m_DepthFormat = wVkGlobals::g_RenderingFormats.m_DepthFormat;
 
 		createDescriptorSetLayout();
 		createDescriptorPool();
@@ -918,11 +1083,11 @@ private:
 
 		const BufferFlags vbFlags = BufferFlags::SRV | BufferFlags::VERTEX_BUFFER;
 		const std::string vbName = "Vertex Buffer";
-		m_VertexBuffer = new Buffer(g_vertices.data(), sizeof(g_vertices[0]), g_vertices.size(), vbFlags, vbName);
+		m_VertexBuffer = m_BufferPool.Create(g_vertices.data(), sizeof(g_vertices[0]), g_vertices.size(), vbFlags, vbName, Callsite::Current());
 
 		const BufferFlags ibFlags = BufferFlags::SRV | BufferFlags::INDEX_BUFFER;
 		const std::string ibName = "Index Buffer";
-		m_IndexBuffer = new Buffer(g_indices.data(), sizeof(g_indices[0]), g_indices.size(), ibFlags, ibName);
+		m_IndexBuffer = m_BufferPool.Create(g_indices.data(), sizeof(g_indices[0]), g_indices.size(), ibFlags, ibName, Callsite::Current());
 
 		// Compute Stuff
 		createShaderStorageBuffers();
@@ -933,7 +1098,8 @@ private:
 		m_ParticleLayout.AddParameter(ShaderParameter::UAV);
 		m_ParticleLayout.Initialize();
 
-		m_ParticlePipeline.Initialize(wVkConstants::shaderDir + "particle.spv", m_ParticleLayout);
+		m_ParticlePipeline = m_ComputePipelinePool.Create();
+		m_ComputePipelinePool[m_ParticlePipeline].Initialize(wVkConstants::shaderDir + "particle.spv", m_ParticleLayout);
 
 		createCommandBuffer();
 		createSyncObjects();
@@ -950,7 +1116,7 @@ private:
 		// Y Coordinate of Clip Coordinates is flipped, this fixes that.
 		ubo.proj[1][1] *= -1;
 
-		m_CameraBuffer[currentImage]->UpdateData(&ubo, sizeof(ubo));
+		m_BufferPool[m_CameraBuffer[currentImage]].UpdateData(&ubo, sizeof(ubo));
 
 	}
 
@@ -963,17 +1129,30 @@ private:
 		m_BackEndRenderer.BeginFrame();
 
 		const auto& currentFrame = m_BackEndRenderer.GetFrameIndex();
+
+		// Grab the newest particle readback that finished, before Begin recycles this frame's readback ring
+		const ReadbackTicket* newestReadback = nullptr;
+		for (const auto& ticket : m_ParticleReadbacks) {
+			if (m_ComputeCmdList.IsReadbackReady(ticket) && (newestReadback == nullptr || ticket.m_Submission > newestReadback->m_Submission))
+				newestReadback = &ticket;
+		}
+
+		if (newestReadback != nullptr)
+			m_ComputeCmdList.GetReadbackData(*newestReadback, &m_ReadbackParticle);
+
 		m_ComputeCmdList.Begin(currentFrame);
 
-		m_DtConstbuffer[currentFrame]->UpdateData(&dt, sizeof(float));
-		m_ColourBuffer[currentFrame]->UpdateData(&m_ParticleColor, sizeof(m_ParticleColor));
+		m_BufferPool[m_DtConstbuffer[currentFrame]].UpdateData(&dt, sizeof(float));
+		m_BufferPool[m_ColourBuffer[currentFrame]].UpdateData(&m_ParticleColor, sizeof(m_ParticleColor));
 
-		m_ComputeCmdList.SetComputePipeline(m_ParticlePipeline);
-		m_ComputeCmdList.BindResourceCBV(0, *m_DtConstbuffer[currentFrame]);
-		m_ComputeCmdList.BindResourceCBV(1, *m_ColourBuffer[currentFrame]);
-		m_ComputeCmdList.BindResourceSRV(2, *m_ParticleBuffers[(currentFrame - 1) % wVkConstants::g_MaxFramesInFlight]);
-		m_ComputeCmdList.BindResourceUAV(3, *m_ParticleBuffers[currentFrame % wVkConstants::g_MaxFramesInFlight]);
-		m_ComputeCmdList.Dispatch(PARTICLE_COUNT / 256, 1, 1);
+		m_ComputeCmdList.SetComputePipeline(m_ComputePipelinePool[m_ParticlePipeline]);
+		m_ComputeCmdList.BindResourceCBV(0, m_BufferPool[m_DtConstbuffer[currentFrame]]);
+		m_ComputeCmdList.BindResourceCBV(1, m_BufferPool[m_ColourBuffer[currentFrame]]);
+		m_ComputeCmdList.BindResourceSRV(2, m_BufferPool[m_ParticleBuffers[(currentFrame - 1) % wVkConstants::g_MaxFramesInFlight]]);
+		m_ComputeCmdList.BindResourceUAV(3, m_BufferPool[m_ParticleBuffers[currentFrame % wVkConstants::g_MaxFramesInFlight]]);
+		m_ComputeCmdList.Dispatch(static_cast<uint32_t>(PARTICLE_COUNT / 256), 1, 1);
+
+		m_ParticleReadbacks[currentFrame] = m_ComputeCmdList.ReadbackAsync(m_BufferPool[m_ParticleBuffers[currentFrame]], 0, sizeof(Particle));
 
 		m_ComputeCmdList.Execute();
 
@@ -982,18 +1161,42 @@ private:
 		const auto inFlightFence = m_InFlightFence[currentFrame];
 
 		// Graphics submission
+		const auto fenceWaitStart = std::chrono::steady_clock::now();
 		vkWaitForFences(wVkGlobals::g_Device, 1, &inFlightFence, VK_TRUE, UINT64_MAX);
+		m_FenceWaitSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - fenceWaitStart).count();
+
+		// The frame this slot rendered g_MaxFramesInFlight frames ago has landed in its readback
+		if (m_FrameRecorder.IsInitialized())
+			m_FrameRecorder.Collect(currentFrame);
+
+		// Everything retired 'g_MaxFramesInFlight' frames ago is no longer in use
+		m_BackEndRenderer.ReleaseRetiredResources();
+
+		// Compacts device memory a little and streams in/evicts texture mips, the fence above means this frame's descriptor set
+		// is free to rewrite if something in it moved
+		wVkGlobals::g_Defragmenter.Step();
+		wVkGlobals::g_TextureStreamer.SetScreenCoverage(m_TexturePool[m_Texture].GetGPUHandleRef(), estimateScreenCoverage());
+		wVkGlobals::g_TextureStreamer.Update();
+		wVkGlobals::g_ResidencyManager.Update();
+		if (getDescriptorSetRelocations(currentFrame) != m_DescriptorSetRelocations[currentFrame])
+			writeDescriptorSet(currentFrame);
 
 		uint32_t imageIndex;
 		const auto imageAvailableS = m_ImageAvailableSemaphore[currentFrame];
-		res = vkAcquireNextImageKHR(wVkGlobals::g_Device, wVkGlobals::g_SwapChain.swapChain, UINT64_MAX, imageAvailableS, VK_NULL_HANDLE, &imageIndex);
-
-		if (res == VK_ERROR_OUT_OF_DATE_KHR) {
-			recreateSwapChain();
-			return;
+		if (wVkGlobals::g_Headless) {
+			// Nothing to acquire, the fence above means the last frame that rendered into this slot's target is done
+			imageIndex = m_BackEndRenderer.GetCurrentBackBufferIndex();
 		}
-		else if (res != VK_SUCCESS && res != VK_SUBOPTIMAL_KHR) {
-			throw std::runtime_error("failed to acquire swap chain image!");
+		else {
+			res = vkAcquireNextImageKHR(wVkGlobals::g_Device, wVkGlobals::g_SwapChain.swapChain, UINT64_MAX, imageAvailableS, VK_NULL_HANDLE, &imageIndex);
+
+			if (res == VK_ERROR_OUT_OF_DATE_KHR) {
+				recreateSwapChain();
+				return;
+			}
+			else if (res != VK_SUCCESS && res != VK_SUBOPTIMAL_KHR) {
+				throw std::runtime_error("failed to acquire swap chain image!");
+			}
 		}
 
 		updateUniformBuffer(currentFrame, dt);
@@ -1006,22 +1209,28 @@ private:
 		const VkSemaphore waitSemaphores[] = { m_ComputeCmdList.GetSyncObject(), imageAvailableS };
 		const VkPipelineStageFlags waitStages[] = { VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
 
+		// Headless only the compute work is waited on, and nothing waits on the render finishing but the fence
 		VkSubmitInfo submitInfo{};
 		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-		submitInfo.waitSemaphoreCount = static_cast<uint32_t>(std::size(waitSemaphores));
+		submitInfo.waitSemaphoreCount = wVkGlobals::g_Headless ? 1 : static_cast<uint32_t>(std::size(waitSemaphores));
 		submitInfo.pWaitSemaphores = waitSemaphores;
 		submitInfo.pWaitDstStageMask = waitStages;
 
 		submitInfo.commandBufferCount = 1;
 		submitInfo.pCommandBuffers = &commandBuffer;
 
-		submitInfo.signalSemaphoreCount = 1;
+		submitInfo.signalSemaphoreCount = wVkGlobals::g_Headless ? 0 : 1;
 		submitInfo.pSignalSemaphores = &renderedS;
 
 		if (vkQueueSubmit(wVkGlobals::g_GraphicsQueue, 1, &submitInfo, inFlightFence) != VK_SUCCESS) {
 			throw std::runtime_error("failed to submit draw command buffer!");
 		}
 
+		if (wVkGlobals::g_Headless) {
+			m_BackEndRenderer.EndFrame();
+			return;
+		}
+
 		VkPresentInfoKHR presentInfo{};
 		presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
 
@@ -1049,10 +1258,6 @@ private:
 
 	void MainLoop() {
 
-		double lastFpsTime = glfwGetTime();
-		int frameCount = 0;
-		double deltaTimeAccumulator = 0;  // Accumulator for delta times
-
 		camera = FreeCamera();
 		camera.m_Transform.SetPosition(0.0, 2.0, 10.0);
 
@@ -1066,28 +1271,23 @@ private:
 		if (scene) {
 			LOG_INFO("Successfully loaded model: %s ", filePath);
 			LOG_INFO("Number of meshes: %i", scene->mNumMeshes);
+			loadModelTextures(scene, filePath);
 		}
 		else {
 			LOG_ERROR("Failed to load model: %s", filePath);
 			LOG_ERROR("ASSIMP Error: %s", importer.GetErrorString());
 		}
 
-		int width, height, channels;
-		// Load the image
-		filePath = R"(Resources\Images\bricks.png)";
-		if (unsigned char* data = stbi_load(filePath, &width, &height, &channels, 0)) {
-			LOG_INFO("Loaded image: %s ", filePath);
-			LOG_INFO("Dimensions: %i x %i", width, height);
-			LOG_INFO("Channels: %i", channels);
-
-			// Free the image memory
-			stbi_image_free(data);
-		}
-		else {
-			LOG_ERROR("Failed to load image: %s", filePath);
-			LOG_ERROR("STB_IMAGE Error: %s", stbi_failure_reason());
+		// GLFW isn't initialized headless, the headless loop times itself with steady_clock
+		if (m_Headless) {
+			HeadlessLoop();
+			return;
 		}
 
+		double lastFpsTime = glfwGetTime();
+		int frameCount = 0;
+		double deltaTimeAccumulator = 0;  // Accumulator for delta times
+
 		while (!glfwWindowShouldClose(m_Window)) {
 			static float lastTime = static_cast<float>(glfwGetTime());
 			static float runningTime = static_cast<float>(glfwGetTime());
@@ -1141,8 +1341,17 @@ private:
 				ImGui::ColorEdit4("Clear Color", &m_ClearColor[0]);
 				ImGui::ColorEdit4("Particles Color", &m_ParticleColor[0]);
 				EditTransform(camera, cubeModel.GetModelMatrixPtr());
+
+				const glm::vec3& readbackPos = m_ReadbackParticle.position;
+				ImGui::Text("Particle 0 (GPU readback): %.3f %.3f %.3f", readbackPos.x, readbackPos.y, readbackPos.z);
 				ImGui::End();
 
+				wVkGlobals::g_HostAllocator.DrawImGuiPanel();
+				wVkGlobals::g_ResourceRegistry.DrawImGuiPanel();
+				wVkGlobals::g_Defragmenter.DrawImGuiPanel();
+				wVkGlobals::g_ResidencyManager.DrawImGuiPanel();
+				wVkGlobals::g_TextureStreamer.DrawImGuiPanel();
+
 				ImGui::Render();
 
 				drawFrame(runningTime / 1000);
@@ -1168,48 +1377,125 @@ private:
 
 	}
 
+	// No input, UI or wall clock. Every run simulates and renders the same frames, however fast the device is.
+	void HeadlessLoop() {
+
+		const VkExtent2D extent = wVkGlobals::g_SwapChain.swapChainExtent;
+		const bool recording = m_FrameRecorder.IsInitialized();
+		float runningTime = 0.0f;
+		m_FenceWaitSeconds = 0.0;
+
+		const auto startTime = std::chrono::steady_clock::now();
+		for (uint32_t frame = 0; frame < m_HeadlessFrames; frame++) {
+
+			if (wVkGlobals::g_errorValidationLayerTriggered)
+			{
+				LOG_ERROR("Validation layer error(s) detected");
+				assert(false);
+			}
+
+			runningTime += HEADLESS_FRAME_TIME_MS;
+			if (recording)
+				updateCameraPath(static_cast<float>(frame) / static_cast<float>(m_HeadlessFrames));
+			camera.UpdateCamera(static_cast<float>(extent.width), static_cast<float>(extent.height));
+
+			m_HeadlessFrame = frame;
+			drawFrame(runningTime / 1000);
+		}
+
+		// The last frames are still in flight, they count too
+		vkDeviceWaitIdle(wVkGlobals::g_Device);
+
+		// And a recording isn't done until the last frame is on disk
+		if (recording) {
+			m_FrameRecorder.Flush();
+			m_FrameRecorder.Destroy();
+		}
+
+		const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+
+		const double frameTimeMs = m_HeadlessFrames > 0 ? seconds * 1000.0 / m_HeadlessFrames : 0.0;
+		LOG_INFO("Headless: %i frames in %f s, %f ms per frame", static_cast<int>(m_HeadlessFrames), seconds, frameTimeMs);
+
+		if (recording)
+			reportRecording(seconds);
+	}
+
+	// One orbit around the origin over t [0, 1), looking down at it
+	void updateCameraPath(float t) {
+		const float angle = t * glm::two_pi<float>();
+		const float pitch = -std::atan2(RECORD_ORBIT_HEIGHT, RECORD_ORBIT_RADIUS);
+
+		camera.m_Transform.SetPosition(RECORD_ORBIT_RADIUS * std::sin(angle), RECORD_ORBIT_HEIGHT, RECORD_ORBIT_RADIUS * std::cos(angle));
+		camera.m_Transform.SetRotation(glm::angleAxis(angle, glm::vec3(0.0f, 1.0f, 0.0f)) * glm::angleAxis(pitch, glm::vec3(1.0f, 0.0f, 0.0f)));
+	}
+
+	// The frame loop only ever blocks on the GPU (fence waits) or on the encoders (full queue), whichever it waited on longer is what limits throughput
+	void reportRecording(double seconds) {
+		const wVkFrameRecorder::Stats stats = m_FrameRecorder.GetStats();
+
+		const double framesPerSecond = seconds > 0.0 ? static_cast<double>(stats.m_NumEncoded) / seconds : 0.0;
+		const double encoderBusy = stats.m_NumWorkers > 0 && seconds > 0.0 ? stats.m_EncodeSeconds / (stats.m_NumWorkers * seconds) : 0.0;
+
+		LOG_INFO("Recording: %i frames written to \"%s\" at %f frames/s, %i failed", static_cast<int>(stats.m_NumEncoded), m_RecordDirectory.c_str(), framesPerSecond, static_cast<int>(stats.m_NumFailed));
+		LOG_INFO("Recording: waited %f s on the GPU, %f s on encoding, %i encode threads %f busy", m_FenceWaitSeconds, stats.m_StallSeconds, static_cast<int>(stats.m_NumWorkers), encoderBusy);
+		LOG_INFO("Recording: bottleneck is %s", stats.m_StallSeconds > m_FenceWaitSeconds ? "encoding" : "rendering");
+	}
+
 	void Cleanup() {
 
 		// Wait until everything is completed until we clean-up
 		vkDeviceWaitIdle(wVkGlobals::g_Device);
 
-		vkDestroyDescriptorSetLayout(wVkGlobals::g_Device, m_DescSetLayout, nullptr);
-		vkDestroyDescriptorPool(wVkGlobals::g_Device, m_DescPool, nullptr);
+		vkDestroyDescriptorSetLayout(wVkGlobals::g_Device, m_DescSetLayout, wVkGlobals::g_AllocationCallbacks);
+		vkDestroyDescriptorPool(wVkGlobals::g_Device, m_DescPool, wVkGlobals::g_AllocationCallbacks);
 
 		for (size_t i = 0; i < wVkConstants::g_MaxFramesInFlight; i++) {
 
-			delete m_CameraBuffer[i];
-			delete m_ParticleBuffers[i];
-			delete m_DtConstbuffer[i];
-			delete m_ColourBuffer[i];
+			m_BufferPool.Destroy(m_CameraBuffer[i]);
+			m_BufferPool.Destroy(m_ParticleBuffers[i]);
+			m_BufferPool.Destroy(m_DtConstbuffer[i]);
+			m_BufferPool.Destroy(m_ColourBuffer[i]);
 
-			vkDestroySemaphore(wVkGlobals::g_Device, m_ImageAvailableSemaphore[i], nullptr);
-			vkDestroySemaphore(wVkGlobals::g_Device, m_RenderFinishedSemaphore[i], nullptr);
-			vkDestroyFence(wVkGlobals::g_Device, m_InFlightFence[i], nullptr);
+			vkDestroySemaphore(wVkGlobals::g_Device, m_ImageAvailableSemaphore[i], wVkGlobals::g_AllocationCallbacks);
+			vkDestroySemaphore(wVkGlobals::g_Device, m_RenderFinishedSemaphore[i], wVkGlobals::g_AllocationCallbacks);
+			vkDestroyFence(wVkGlobals::g_Device, m_InFlightFence[i], wVkGlobals::g_AllocationCallbacks);
 		}
 
-		delete m_Texture;
-		delete m_Sampler;
+		m_TexturePool.Destroy(m_Texture);
+		for (TextureHandle& texture : m_ModelTextures)
+			m_TexturePool.Destroy(texture);
+		m_ModelTextures.clear();
+		m_SamplerPool.Destroy(m_Sampler);
 
 		// Destroy our draw buffers
-		delete m_VertexBuffer;
-		delete m_IndexBuffer;
+		m_BufferPool.Destroy(m_VertexBuffer);
+		m_BufferPool.Destroy(m_IndexBuffer);
 
-		m_ParticlePipeline.Destroy();
+		// Anything left over in the pools
+		m_BufferPool.DestroyAll();
+		m_TexturePool.DestroyAll();
+		m_SamplerPool.DestroyAll();
 
-		vkDestroyPipeline(wVkGlobals::g_Device, m_GraphicsPipeline, nullptr);
-		vkDestroyPipeline(wVkGlobals::g_Device, m_GraphicsPipelinePoints, nullptr);
+		m_ComputePipelinePool.Destroy(m_ParticlePipeline);
+		m_ComputePipelinePool.DestroyAll();
 
-		vkDestroyPipelineLayout(wVkGlobals::g_Device, m_PipelineLayout, nullptr);
+		vkDestroyPipeline(wVkGlobals::g_Device, m_GraphicsPipeline, wVkGlobals::g_AllocationCallbacks);
+		vkDestroyPipeline(wVkGlobals::g_Device, m_GraphicsPipelinePoints, wVkGlobals::g_AllocationCallbacks);
 
-		vkDestroyShaderModule(wVkGlobals::g_Device, m_VertShaderModule, nullptr);
-		vkDestroyShaderModule(wVkGlobals::g_Device, m_FragShaderModule, nullptr);
+		vkDestroyPipelineLayout(wVkGlobals::g_Device, m_PipelineLayout, wVkGlobals::g_AllocationCallbacks);
+
+		vkDestroyShaderModule(wVkGlobals::g_Device, m_VertShaderModule, wVkGlobals::g_AllocationCallbacks);
+		vkDestroyShaderModule(wVkGlobals::g_Device, m_FragShaderModule, wVkGlobals::g_AllocationCallbacks);
 
 		m_ComputeCmdList.Destroy();
+		m_FrameRecorder.Destroy();
 		m_BackEndRenderer.Shutdown();
 
-		glfwDestroyWindow(m_Window);
-		glfwTerminate();
+		if (!m_Headless) {
+			glfwDestroyWindow(m_Window);
+			glfwTerminate();
+		}
 	}
 
 
@@ -1243,45 +1529,92 @@ private:
 	VkDescriptorSetLayout m_DescSetLayout = VK_NULL_HANDLE;
 	VkDescriptorPool m_DescPool = VK_NULL_HANDLE;
 	std::vector<VkDescriptorSet> m_DescriptorSets;
+	uint32_t m_DescriptorSetRelocations[wVkConstants::g_MaxFramesInFlight] = {};
+
+	// Transient in the render graph
+	VkFormat m_DepthFormat = VK_FORMAT_UNDEFINED;
 
 	// Encompasses Pipeline and Renderpass into 1
 	VkPipeline m_GraphicsPipeline = VK_NULL_HANDLE;
 	VkPipeline m_GraphicsPipelinePoints = VK_NULL_HANDLE;
 
+	// Resource Pools - own the resources, everything else holds handles
+	ResourcePool<Buffer> m_BufferPool;
+	ResourcePool<Texture> m_TexturePool;
+	ResourcePool<Sampler> m_SamplerPool;
+	ResourcePool<ComputePipelineDescription> m_ComputePipelinePool;
+
 	// Drawing Data
-	Buffer* m_VertexBuffer = nullptr;
-	Buffer* m_IndexBuffer = nullptr;
+	BufferHandle m_VertexBuffer;
+	BufferHandle m_IndexBuffer;
 
 	// Uniform Buffers
-	Buffer* m_CameraBuffer[wVkConstants::g_MaxFramesInFlight] = {};
+	BufferHandle m_CameraBuffer[wVkConstants::g_MaxFramesInFlight] = {};
 
 	// Textures
-	Texture* m_Texture = nullptr;
-	Sampler* m_Sampler = nullptr;
+	TextureHandle m_Texture;
+	SamplerHandle m_Sampler;
+	std::vector<TextureHandle> m_ModelTextures;
 
 	// Compute Stuff
-	Buffer* m_ParticleBuffers[wVkConstants::g_MaxFramesInFlight] = {};
-	Buffer* m_DtConstbuffer[wVkConstants::g_MaxFramesInFlight] = {};
+	BufferHandle m_ParticleBuffers[wVkConstants::g_MaxFramesInFlight] = {};
+	BufferHandle m_DtConstbuffer[wVkConstants::g_MaxFramesInFlight] = {};
 
 	glm::vec4 m_ParticleColor = glm::vec4(1.0f);
 	glm::vec4 m_ClearColor = glm::vec4(0.0f);
-	Buffer* m_ColourBuffer[wVkConstants::g_MaxFramesInFlight] = {};
+	BufferHandle m_ColourBuffer[wVkConstants::g_MaxFramesInFlight] = {};
+
+	// Readback of the first particle, one in flight per frame
+	ReadbackTicket m_ParticleReadbacks[wVkConstants::g_MaxFramesInFlight] = {};
+	Particle m_ReadbackParticle = {};
 
 	ShaderLayout m_ParticleLayout;
-	ComputePipelineDescription m_ParticlePipeline;
+	ComputePipelineHandle m_ParticlePipeline;
 
 	
 	// GLFW
 	std::string m_WindowName = "VulkanTutorial";
 	GLFWwindow* m_Window = nullptr;
 
+	// Headless
+	bool m_Headless = false;
+	uint32_t m_HeadlessFrames = HEADLESS_DEFAULT_FRAMES;
+	uint32_t m_HeadlessFrame = 0;
+	double m_FenceWaitSeconds = 0.0;
+
+	// Recording
+	std::string m_RecordDirectory;
+	wVkFrameRecorder m_FrameRecorder;
+
 };
 
-int main() {
+// --headless [frames] renders offscreen without a window, for machines without a display
+// --record <directory> [frames] renders headless along a camera path and writes every frame as a PNG
+int main(int argc, char** argv) {
+	bool headless = false;
+	uint32_t numFrames = HEADLESS_DEFAULT_FRAMES;
+	std::string recordDirectory;
+
+	for (int i = 1; i < argc; i++) {
+		const std::string arg = argv[i];
+		if (arg == "--record" && (i + 1 >= argc || argv[i + 1][0] == '-')) {
+			std::cerr << "--record needs a directory: --record <directory> [frames]" << std::endl;
+			return EXIT_FAILURE;
+		}
+
+		if (arg == "--headless" || arg == "--record") {
+			headless = true;
+			if (arg == "--record")
+				recordDirectory = argv[++i];
+			if (i + 1 < argc && argv[i + 1][0] != '-')
+				numFrames = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+		}
+	}
+
 	HelloTriangleApplication app;
 
 	try {
-		app.Run();
+		app.Run(headless, numFrames, recordDirectory);
 	}
 	catch (const std::exception& e) {
 		std::cerr << e.what() << std::endl;